@@ -0,0 +1,134 @@
+// Copyright 2026 David Robillard <d@drobilla.net>
+// SPDX-License-Identifier: ISC
+
+#ifndef JALV_ATOMIC_H
+#define JALV_ATOMIC_H
+
+#ifdef _MSC_VER
+#  include <windows.h>
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+  Minimal atomic operations on 32-bit integers for sharing between threads,
+  with loads and stores of pointer-sized integers for identifying threads.
+
+  C99 has no atomics, so these use compiler intrinsics.  Loads have acquire
+  semantics, stores have release semantics, and read-modify-write operations
+  have both (compare-exchange is sequentially consistent).
+*/
+
+static inline uint32_t
+jalv_atomic_load(const uint32_t* const ptr)
+{
+#ifdef _MSC_VER
+  const uint32_t value = *(const volatile uint32_t*)ptr;
+  MemoryBarrier();
+  return value;
+#else
+  return __atomic_load_n(ptr, __ATOMIC_ACQUIRE);
+#endif
+}
+
+static inline void
+jalv_atomic_store(uint32_t* const ptr, const uint32_t value)
+{
+#ifdef _MSC_VER
+  MemoryBarrier();
+  *(volatile uint32_t*)ptr = value;
+#else
+  __atomic_store_n(ptr, value, __ATOMIC_RELEASE);
+#endif
+}
+
+static inline uintptr_t
+jalv_atomic_load_uintptr(const uintptr_t* const ptr)
+{
+#ifdef _MSC_VER
+  const uintptr_t value = *(const volatile uintptr_t*)ptr;
+  MemoryBarrier();
+  return value;
+#else
+  return __atomic_load_n(ptr, __ATOMIC_ACQUIRE);
+#endif
+}
+
+static inline void
+jalv_atomic_store_uintptr(uintptr_t* const ptr, const uintptr_t value)
+{
+#ifdef _MSC_VER
+  MemoryBarrier();
+  *(volatile uintptr_t*)ptr = value;
+#else
+  __atomic_store_n(ptr, value, __ATOMIC_RELEASE);
+#endif
+}
+
+static inline uint32_t
+jalv_atomic_exchange(uint32_t* const ptr, const uint32_t value)
+{
+#ifdef _MSC_VER
+  return (uint32_t)InterlockedExchange((volatile LONG*)ptr, (LONG)value);
+#else
+  return __atomic_exchange_n(ptr, value, __ATOMIC_ACQ_REL);
+#endif
+}
+
+static inline uint32_t
+jalv_atomic_or(uint32_t* const ptr, const uint32_t bits)
+{
+#ifdef _MSC_VER
+  return (uint32_t)InterlockedOr((volatile LONG*)ptr, (LONG)bits);
+#else
+  return __atomic_fetch_or(ptr, bits, __ATOMIC_ACQ_REL);
+#endif
+}
+
+static inline uint32_t
+jalv_atomic_increment(uint32_t* const ptr)
+{
+#ifdef _MSC_VER
+  return (uint32_t)InterlockedIncrement((volatile LONG*)ptr);
+#else
+  return __atomic_add_fetch(ptr, 1U, __ATOMIC_ACQ_REL);
+#endif
+}
+
+static inline uint32_t
+jalv_atomic_decrement(uint32_t* const ptr)
+{
+#ifdef _MSC_VER
+  return (uint32_t)InterlockedDecrement((volatile LONG*)ptr);
+#else
+  return __atomic_sub_fetch(ptr, 1U, __ATOMIC_ACQ_REL);
+#endif
+}
+
+static inline bool
+jalv_atomic_compare_exchange(uint32_t* const ptr,
+                             uint32_t        expected,
+                             const uint32_t  desired)
+{
+#ifdef _MSC_VER
+  return (uint32_t)InterlockedCompareExchange(
+           (volatile LONG*)ptr, (LONG)desired, (LONG)expected) == expected;
+#else
+  return __atomic_compare_exchange_n(
+    ptr, &expected, desired, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+#endif
+}
+
+/// Order all earlier memory accesses before all later ones
+static inline void
+jalv_atomic_fence(void)
+{
+#ifdef _MSC_VER
+  MemoryBarrier();
+#else
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+#endif
+}
+
+#endif // JALV_ATOMIC_H
@@ -0,0 +1,511 @@
+// Copyright 2026 David Robillard <d@drobilla.net>
+// SPDX-License-Identifier: ISC
+
+#include "audio_file.h"
+
+#include <zix/status.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define WAVE_FORMAT_PCM 0x0001U
+#define WAVE_FORMAT_IEEE_FLOAT 0x0003U
+#define WAVE_FORMAT_EXTENSIBLE 0xFFFEU
+
+/// Number of frames converted at once when reading or writing
+#define AUDIO_FILE_CHUNK_FRAMES 1024U
+
+typedef enum {
+  SAMPLE_FORMAT_U8,  ///< Unsigned 8-bit integer
+  SAMPLE_FORMAT_S16, ///< Signed 16-bit little-endian integer
+  SAMPLE_FORMAT_S24, ///< Signed 24-bit little-endian integer
+  SAMPLE_FORMAT_S32, ///< Signed 32-bit little-endian integer
+  SAMPLE_FORMAT_F32, ///< 32-bit little-endian float
+  SAMPLE_FORMAT_F64, ///< 64-bit little-endian float
+  SAMPLE_FORMAT_RAW, ///< 32-bit native float
+} SampleFormat;
+
+struct JalvAudioFileImpl {
+  FILE*         fd;          ///< Open file handle
+  bool          writing;     ///< Opened for writing
+  bool          raw;         ///< Raw file with no header
+  SampleFormat  format;      ///< Sample format in file
+  uint32_t      channels;    ///< Number of interleaved channels
+  uint32_t      sample_size; ///< Size of one sample in bytes
+  float         rate;        ///< Sample rate in Hz
+  uint64_t      length;      ///< Total length in frames, or zero
+  uint64_t      position;    ///< Current position in frames
+  unsigned char buf[];       ///< Interleaved conversion buffer
+};
+
+static bool
+has_raw_extension(const char* const path)
+{
+  const size_t len = strlen(path);
+  return len > 4 && !strcmp(path + len - 4, ".raw");
+}
+
+static uint32_t
+sample_size(const SampleFormat format)
+{
+  switch (format) {
+  case SAMPLE_FORMAT_U8:
+    return 1U;
+  case SAMPLE_FORMAT_S16:
+    return 2U;
+  case SAMPLE_FORMAT_S24:
+    return 3U;
+  case SAMPLE_FORMAT_S32:
+  case SAMPLE_FORMAT_F32:
+  case SAMPLE_FORMAT_RAW:
+    return 4U;
+  case SAMPLE_FORMAT_F64:
+    return 8U;
+  }
+
+  return 0U;
+}
+
+static JalvAudioFile*
+audio_file_new(FILE* const        fd,
+               const bool         writing,
+               const SampleFormat format,
+               const uint32_t     channels,
+               const float        rate)
+{
+  const uint32_t size     = sample_size(format);
+  const size_t   buf_size = (size_t)AUDIO_FILE_CHUNK_FRAMES * channels * size;
+
+  JalvAudioFile* const file =
+    (JalvAudioFile*)calloc(1, sizeof(JalvAudioFile) + buf_size);
+
+  if (file) {
+    file->fd          = fd;
+    file->writing     = writing;
+    file->raw         = format == SAMPLE_FORMAT_RAW;
+    file->format      = format;
+    file->channels    = channels;
+    file->sample_size = size;
+    file->rate        = rate;
+  }
+
+  return file;
+}
+
+static uint16_t
+get_u16(const unsigned char* const bytes)
+{
+  return (uint16_t)(bytes[0] | (bytes[1] << 8U));
+}
+
+static uint32_t
+get_u32(const unsigned char* const bytes)
+{
+  return (uint32_t)bytes[0] | ((uint32_t)bytes[1] << 8U) |
+         ((uint32_t)bytes[2] << 16U) | ((uint32_t)bytes[3] << 24U);
+}
+
+static void
+put_u16(unsigned char* const bytes, const uint16_t value)
+{
+  bytes[0] = (unsigned char)(value & 0xFFU);
+  bytes[1] = (unsigned char)((value >> 8U) & 0xFFU);
+}
+
+static void
+put_u32(unsigned char* const bytes, const uint32_t value)
+{
+  bytes[0] = (unsigned char)(value & 0xFFU);
+  bytes[1] = (unsigned char)((value >> 8U) & 0xFFU);
+  bytes[2] = (unsigned char)((value >> 16U) & 0xFFU);
+  bytes[3] = (unsigned char)((value >> 24U) & 0xFFU);
+}
+
+static bool
+wave_format(const uint16_t tag, const uint16_t bits, SampleFormat* const format)
+{
+  if (tag == WAVE_FORMAT_PCM) {
+    switch (bits) {
+    case 8U:
+      *format = SAMPLE_FORMAT_U8;
+      return true;
+    case 16U:
+      *format = SAMPLE_FORMAT_S16;
+      return true;
+    case 24U:
+      *format = SAMPLE_FORMAT_S24;
+      return true;
+    case 32U:
+      *format = SAMPLE_FORMAT_S32;
+      return true;
+    default:
+      break;
+    }
+  } else if (tag == WAVE_FORMAT_IEEE_FLOAT) {
+    if (bits == 32U) {
+      *format = SAMPLE_FORMAT_F32;
+      return true;
+    }
+
+    if (bits == 64U) {
+      *format = SAMPLE_FORMAT_F64;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+static JalvAudioFile*
+open_wave(FILE* const fd)
+{
+  unsigned char header[12] = {0U};
+  if (fread(header, 1, sizeof(header), fd) != sizeof(header) ||
+      memcmp(header, "RIFF", 4) || memcmp(header + 8, "WAVE", 4)) {
+    return NULL;
+  }
+
+  bool          have_fmt = false;
+  SampleFormat  format   = SAMPLE_FORMAT_S16;
+  uint16_t      channels = 0U;
+  uint32_t      rate     = 0U;
+  unsigned char chunk[8] = {0U};
+  while (fread(chunk, 1, sizeof(chunk), fd) == sizeof(chunk)) {
+    const uint32_t size   = get_u32(chunk + 4);
+    const long     padded = (long)size + (long)(size & 1U);
+
+    if (!memcmp(chunk, "fmt ", 4)) {
+      unsigned char fmt[40] = {0U};
+      if (size < 16U || size > sizeof(fmt) ||
+          fread(fmt, 1, size, fd) != size) {
+        return NULL;
+      }
+
+      uint16_t       tag  = get_u16(fmt);
+      const uint16_t bits = get_u16(fmt + 14);
+      if (tag == WAVE_FORMAT_EXTENSIBLE && size >= 26U) {
+        tag = get_u16(fmt + 24); // First two bytes of the sub-format GUID
+      }
+
+      channels = get_u16(fmt + 2);
+      rate     = get_u32(fmt + 4);
+      if (!wave_format(tag, bits, &format) || !channels || !rate ||
+          ((size & 1U) && fseek(fd, 1L, SEEK_CUR))) {
+        return NULL;
+      }
+
+      have_fmt = true;
+
+    } else if (!memcmp(chunk, "data", 4)) {
+      if (!have_fmt) {
+        return NULL;
+      }
+
+      JalvAudioFile* const file =
+        audio_file_new(fd, false, format, channels, (float)rate);
+
+      if (file) {
+        const uint32_t frame_size = channels * file->sample_size;
+        file->length = (size == UINT32_MAX) ? 0U : (size / frame_size);
+      }
+
+      return file;
+
+    } else if (fseek(fd, padded, SEEK_CUR)) {
+      return NULL;
+    }
+  }
+
+  return NULL;
+}
+
+static ZixStatus
+write_wave_header(JalvAudioFile* const file)
+{
+  static const uint32_t fmt_size  = 18U;
+  static const uint32_t fact_size = 4U;
+
+  const uint32_t frame_size = file->channels * 4U;
+  const uint64_t data_size  = file->position * frame_size;
+  const uint32_t data_size32 =
+    data_size > UINT32_MAX - 64U ? UINT32_MAX - 64U : (uint32_t)data_size;
+
+  unsigned char header[58] = {0U};
+  memcpy(header, "RIFF", 4);
+  put_u32(header + 4, 50U + data_size32);
+  memcpy(header + 8, "WAVE", 4);
+
+  memcpy(header + 12, "fmt ", 4);
+  put_u32(header + 16, fmt_size);
+  put_u16(header + 20, WAVE_FORMAT_IEEE_FLOAT);
+  put_u16(header + 22, (uint16_t)file->channels);
+  put_u32(header + 24, (uint32_t)file->rate);
+  put_u32(header + 28, (uint32_t)file->rate * frame_size);
+  put_u16(header + 32, (uint16_t)frame_size);
+  put_u16(header + 34, 32U);
+  put_u16(header + 36, 0U);
+
+  memcpy(header + 38, "fact", 4);
+  put_u32(header + 42, fact_size);
+  put_u32(header + 46, (uint32_t)file->position);
+
+  memcpy(header + 50, "data", 4);
+  put_u32(header + 54, data_size32);
+
+  return fwrite(header, 1, sizeof(header), file->fd) == sizeof(header)
+           ? ZIX_STATUS_SUCCESS
+           : ZIX_STATUS_ERROR;
+}
+
+JalvAudioFile*
+jalv_audio_file_open_read(const char* const path,
+                          const uint32_t    raw_channels,
+                          const float       raw_rate)
+{
+  FILE* const fd = fopen(path, "rb");
+  if (!fd) {
+    return NULL;
+  }
+
+  JalvAudioFile* file = NULL;
+  if (has_raw_extension(path)) {
+    if (raw_channels &&
+        (file = audio_file_new(
+           fd, false, SAMPLE_FORMAT_RAW, raw_channels, raw_rate)) &&
+        !fseek(fd, 0L, SEEK_END)) {
+      const long end = ftell(fd);
+      file->length   = end > 0 ? (uint64_t)end / (raw_channels * 4U) : 0U;
+      fseek(fd, 0L, SEEK_SET);
+    }
+  } else {
+    file = open_wave(fd);
+  }
+
+  if (!file) {
+    fclose(fd);
+  }
+
+  return file;
+}
+
+JalvAudioFile*
+jalv_audio_file_open_write(const char* const path,
+                           const uint32_t    channels,
+                           const float       rate)
+{
+  if (!channels) {
+    return NULL;
+  }
+
+  FILE* const fd = fopen(path, "wb");
+  if (!fd) {
+    return NULL;
+  }
+
+  const bool         raw    = has_raw_extension(path);
+  const SampleFormat format = raw ? SAMPLE_FORMAT_RAW : SAMPLE_FORMAT_F32;
+
+  JalvAudioFile* const file = audio_file_new(fd, true, format, channels, rate);
+  if (!file || (!raw && write_wave_header(file))) {
+    free(file);
+    fclose(fd);
+    return NULL;
+  }
+
+  return file;
+}
+
+ZixStatus
+jalv_audio_file_close(JalvAudioFile* const file)
+{
+  if (!file) {
+    return ZIX_STATUS_SUCCESS;
+  }
+
+  ZixStatus st = ZIX_STATUS_SUCCESS;
+  if (file->writing && !file->raw) {
+    // Pad data to an even size, then rewrite the header with the final length
+    const uint64_t data_size = file->position * file->channels * 4U;
+    if ((data_size & 1U) && fputc(0, file->fd) == EOF) {
+      st = ZIX_STATUS_ERROR;
+    } else if (fseek(file->fd, 0L, SEEK_SET)) {
+      st = ZIX_STATUS_ERROR;
+    } else {
+      st = write_wave_header(file);
+    }
+  }
+
+  if (fclose(file->fd)) {
+    st = ZIX_STATUS_ERROR;
+  }
+
+  free(file);
+  return st;
+}
+
+uint32_t
+jalv_audio_file_channels(const JalvAudioFile* const file)
+{
+  return file->channels;
+}
+
+float
+jalv_audio_file_rate(const JalvAudioFile* const file)
+{
+  return file->rate;
+}
+
+uint64_t
+jalv_audio_file_length(const JalvAudioFile* const file)
+{
+  return file->length;
+}
+
+static float
+decode_sample(const SampleFormat format, const unsigned char* const bytes)
+{
+  switch (format) {
+  case SAMPLE_FORMAT_U8:
+    return ((float)bytes[0] - 128.0f) / 128.0f;
+
+  case SAMPLE_FORMAT_S16:
+    return (float)(int16_t)get_u16(bytes) / 32768.0f;
+
+  case SAMPLE_FORMAT_S24: {
+    const uint32_t u = (uint32_t)bytes[0] | ((uint32_t)bytes[1] << 8U) |
+                       ((uint32_t)bytes[2] << 16U);
+    const int32_t s = (u & 0x800000U) ? (int32_t)(u | 0xFF000000U)
+                                       : (int32_t)u;
+    return (float)s / 8388608.0f;
+  }
+
+  case SAMPLE_FORMAT_S32:
+    return (float)((double)(int32_t)get_u32(bytes) / 2147483648.0);
+
+  case SAMPLE_FORMAT_F32: {
+    const uint32_t u = get_u32(bytes);
+    float          f = 0.0f;
+    memcpy(&f, &u, sizeof(f));
+    return f;
+  }
+
+  case SAMPLE_FORMAT_F64: {
+    const uint64_t u = (uint64_t)get_u32(bytes) |
+                       ((uint64_t)get_u32(bytes + 4) << 32U);
+    double d = 0.0;
+    memcpy(&d, &u, sizeof(d));
+    return (float)d;
+  }
+
+  case SAMPLE_FORMAT_RAW: {
+    float f = 0.0f;
+    memcpy(&f, bytes, sizeof(f));
+    return f;
+  }
+  }
+
+  return 0.0f;
+}
+
+static void
+encode_sample(const SampleFormat   format,
+              unsigned char* const bytes,
+              const float          value)
+{
+  if (format == SAMPLE_FORMAT_RAW) {
+    memcpy(bytes, &value, sizeof(value));
+  } else {
+    uint32_t u = 0U;
+    memcpy(&u, &value, sizeof(u));
+    put_u32(bytes, u);
+  }
+}
+
+uint32_t
+jalv_audio_file_read(JalvAudioFile* const file,
+                     float* const* const  channels,
+                     const uint32_t       n_channels,
+                     const uint32_t       nframes)
+{
+  const uint32_t frame_size = file->channels * file->sample_size;
+
+  uint32_t n_read = 0U;
+  bool     done   = file->writing;
+  while (!done && n_read < nframes) {
+    uint32_t chunk = nframes - n_read;
+    if (chunk > AUDIO_FILE_CHUNK_FRAMES) {
+      chunk = AUDIO_FILE_CHUNK_FRAMES;
+    }
+
+    if (file->length && file->position + chunk > file->length) {
+      chunk = (uint32_t)(file->length - file->position);
+    }
+
+    const size_t got = chunk ? fread(file->buf, frame_size, chunk, file->fd)
+                             : 0U;
+
+    for (uint32_t c = 0U; c < n_channels; ++c) {
+      float* const out = channels[c];
+      if (out && c < file->channels) {
+        for (size_t f = 0U; f < got; ++f) {
+          const size_t offset = (f * file->channels + c) * file->sample_size;
+          out[n_read + f] = decode_sample(file->format, file->buf + offset);
+        }
+      }
+    }
+
+    n_read += (uint32_t)got;
+    file->position += got;
+    done = got < chunk || !chunk;
+  }
+
+  // Fill the remainder of every buffer with silence
+  for (uint32_t c = 0U; c < n_channels; ++c) {
+    float* const out = channels[c];
+    if (out) {
+      const uint32_t first = c < file->channels ? n_read : 0U;
+      memset(out + first, 0, (nframes - first) * sizeof(float));
+    }
+  }
+
+  return n_read;
+}
+
+ZixStatus
+jalv_audio_file_write(JalvAudioFile* const      file,
+                      const float* const* const channels,
+                      const uint32_t            nframes)
+{
+  if (!file->writing) {
+    return ZIX_STATUS_BAD_ARG;
+  }
+
+  const uint32_t frame_size = file->channels * file->sample_size;
+
+  for (uint32_t offset = 0U; offset < nframes;) {
+    uint32_t chunk = nframes - offset;
+    if (chunk > AUDIO_FILE_CHUNK_FRAMES) {
+      chunk = AUDIO_FILE_CHUNK_FRAMES;
+    }
+
+    for (uint32_t c = 0U; c < file->channels; ++c) {
+      const float* const in = channels[c];
+      for (uint32_t f = 0U; f < chunk; ++f) {
+        const size_t i = ((size_t)f * file->channels + c) * file->sample_size;
+        encode_sample(file->format, file->buf + i, in ? in[offset + f] : 0.0f);
+      }
+    }
+
+    if (fwrite(file->buf, frame_size, chunk, file->fd) != chunk) {
+      return ZIX_STATUS_ERROR;
+    }
+
+    offset += chunk;
+    file->position += chunk;
+  }
+
+  return ZIX_STATUS_SUCCESS;
+}
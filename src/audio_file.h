@@ -0,0 +1,102 @@
+// Copyright 2026 David Robillard <d@drobilla.net>
+// SPDX-License-Identifier: ISC
+
+#ifndef JALV_AUDIO_FILE_H
+#define JALV_AUDIO_FILE_H
+
+#include "attributes.h"
+
+#include <zix/attributes.h>
+#include <zix/status.h>
+
+#include <stdint.h>
+
+// Minimal audio file reading and writing for offline rendering
+JALV_BEGIN_DECLS
+
+/**
+   An audio file opened for either reading or writing.
+
+   Two formats are supported: RIFF WAVE, and "raw" headerless native-endian
+   32-bit float data for files with a ".raw" extension.  WAVE files can be
+   read in any common PCM or floating point format, but are always written as
+   32-bit float.  Samples are always transferred as non-interleaved channels.
+*/
+typedef struct JalvAudioFileImpl JalvAudioFile;
+
+/**
+   Open an audio file for reading.
+
+   @param path Path to a WAVE or raw file.
+   @param raw_channels Number of channels, used only for raw files.
+   @param raw_rate Sample rate, used only for raw files.
+   @return A newly opened file, or null on error.
+*/
+ZIX_MALLOC_FUNC JalvAudioFile*
+jalv_audio_file_open_read(const char* path,
+                          uint32_t    raw_channels,
+                          float       raw_rate);
+
+/**
+   Open an audio file for writing, truncating it if it already exists.
+
+   @param path Path to a WAVE or raw file.
+   @param channels Number of channels to write.
+   @param rate Sample rate to write in the header.
+   @return A newly opened file, or null on error.
+*/
+ZIX_MALLOC_FUNC JalvAudioFile*
+jalv_audio_file_open_write(const char* path, uint32_t channels, float rate);
+
+/**
+   Finish writing and close a file.
+
+   For written WAVE files, this updates the header with the final length.
+*/
+ZixStatus
+jalv_audio_file_close(JalvAudioFile* file);
+
+/// Return the number of channels in a file
+ZIX_PURE_FUNC uint32_t
+jalv_audio_file_channels(const JalvAudioFile* file);
+
+/// Return the sample rate of a file
+ZIX_PURE_FUNC float
+jalv_audio_file_rate(const JalvAudioFile* file);
+
+/// Return the total length of a file in frames if known, otherwise zero
+ZIX_PURE_FUNC uint64_t
+jalv_audio_file_length(const JalvAudioFile* file);
+
+/**
+   Read a block of frames from a file.
+
+   @param file File opened with jalv_audio_file_open_read().
+   @param channels Array of channel buffers, any of which may be null.
+   @param n_channels Number of buffers in `channels`.
+   @param nframes Number of frames to read into each buffer.
+   @return The number of frames read, which is less than `nframes` at the end
+   of the file.  The rest of each buffer is filled with silence.
+*/
+uint32_t
+jalv_audio_file_read(JalvAudioFile* file,
+                     float* const*  channels,
+                     uint32_t       n_channels,
+                     uint32_t       nframes);
+
+/**
+   Write a block of frames to a file.
+
+   @param file File opened with jalv_audio_file_open_write().
+   @param channels Array of channel buffers, any of which may be null for
+   silence.
+   @param nframes Number of frames to write from each buffer.
+*/
+ZixStatus
+jalv_audio_file_write(JalvAudioFile*      file,
+                      const float* const* channels,
+                      uint32_t            nframes);
+
+JALV_END_DECLS
+
+#endif // JALV_AUDIO_FILE_H
@@ -6,6 +6,7 @@
 
 #include "attributes.h"
 #include "log.h"
+#include "options.h"
 #include "process.h"
 #include "settings.h"
 #include "types.h"
@@ -28,16 +29,60 @@ jalv_backend_allocate(void);
 void
 jalv_backend_free(JalvBackend* backend);
 
+/**
+   Set up a backend to run alongside others in a single audio client.
+
+   This must be called before jalv_backend_open().  If `host` is null, then
+   the backend opens a client as usual, otherwise it uses the client of the
+   host, which must already be open but not yet activated.  In either case,
+   port names are prefixed with `name` so the ports of each plugin can be told
+   apart.
+
+   @return Zero on success, or non-zero if the backend doesn't support sharing
+   a client.
+*/
+int
+jalv_backend_share(JalvBackend* backend, JalvBackend* host, const char* name);
+
+/**
+   Feed an audio output of one plugin directly into an input of another.
+
+   Both backends must share a client (see jalv_backend_share()) and be open,
+   and the graph must not be prepared yet.  The plugin with the output is then
+   run before the one with the input in every cycle, and the input ignores any
+   connections to its own port.
+
+   @return Zero on success, or non-zero if the backend doesn't support links
+   or the ports can't be linked.
+*/
+int
+jalv_backend_link(JalvBackend* from,
+                  uint32_t     from_index,
+                  JalvBackend* to,
+                  uint32_t     to_index);
+
+/**
+   Prepare to run the plugins that share a client as a graph.
+
+   This must be called on the host after all links are made and before
+   activating.  Plugins that don't depend on each other are run concurrently
+   on up to `n_threads` threads, including the audio thread.
+
+   @return Zero on success, or non-zero if the links form a cycle or the
+   threads can't be launched.
+*/
+int
+jalv_backend_prepare_graph(JalvBackend* backend, uint32_t n_threads);
+
 /// Open the audio/MIDI system
 int
-jalv_backend_open(JalvBackend*     backend,
-                  const JalvLog*   log,
-                  const JalvURIDs* urids,
-                  JalvSettings*    settings,
-                  JalvProcess*     process,
-                  ZixSem*          done,
-                  const char*      name,
-                  bool             exact_name);
+jalv_backend_open(JalvBackend*       backend,
+                  const JalvLog*     log,
+                  const JalvURIDs*   urids,
+                  JalvSettings*      settings,
+                  JalvProcess*       process,
+                  ZixSem*            done,
+                  const JalvOptions* opts);
 
 /// Close the audio/MIDI system
 void
@@ -0,0 +1,63 @@
+// Copyright 2026 David Robillard <d@drobilla.net>
+// SPDX-License-Identifier: ISC
+
+#include "buffers.h"
+
+#include "process.h"
+#include "types.h"
+
+#include <lilv/lilv.h>
+
+#include <stdint.h>
+#include <stdlib.h>
+
+float**
+jalv_buffers_new(const uint32_t n_buffers, const uint32_t nframes)
+{
+  float** const bufs = (float**)calloc(n_buffers + 1U, sizeof(float*));
+  for (uint32_t i = 0U; bufs && i < n_buffers; ++i) {
+    if (!(bufs[i] = (float*)calloc(nframes, sizeof(float)))) {
+      jalv_buffers_free(bufs, i);
+      return NULL;
+    }
+  }
+
+  return bufs;
+}
+
+void
+jalv_buffers_free(float** const bufs, const uint32_t n_buffers)
+{
+  if (bufs) {
+    for (uint32_t i = 0U; i < n_buffers; ++i) {
+      free(bufs[i]);
+    }
+
+    free(bufs);
+  }
+}
+
+void
+jalv_buffers_connect_port(JalvProcess* const proc,
+                          const uint32_t     port_index,
+                          float** const      in_bufs,
+                          float** const      out_bufs)
+{
+  JalvProcessPort* const port = &proc->ports[port_index];
+
+  if (port->type == TYPE_CONTROL) {
+    lilv_instance_connect_port(
+      proc->instance, port_index, &proc->controls_buf[port_index]);
+  } else if (port->type == TYPE_AUDIO || port->type == TYPE_CV) {
+    uint32_t channel = 0U;
+    for (uint32_t i = 0U; i < port_index; ++i) {
+      const JalvProcessPort* const other = &proc->ports[i];
+      channel += (other->flow == port->flow &&
+                  (other->type == TYPE_AUDIO || other->type == TYPE_CV));
+    }
+
+    float** const bufs = port->flow == FLOW_INPUT ? in_bufs : out_bufs;
+
+    jalv_process_connect_port(proc, port_index, bufs[channel]);
+  }
+}
@@ -0,0 +1,53 @@
+// Copyright 2026 David Robillard <d@drobilla.net>
+// SPDX-License-Identifier: ISC
+
+#ifndef JALV_BUFFERS_H
+#define JALV_BUFFERS_H
+
+#include "attributes.h"
+#include "process.h"
+
+#include <stdint.h>
+
+// Audio buffers for backends that don't use an audio system
+JALV_BEGIN_DECLS
+
+#ifndef JALV_DEFAULT_BLOCK_LENGTH
+#  define JALV_DEFAULT_BLOCK_LENGTH 4096
+#endif
+
+/**
+   Allocate an array of zeroed audio buffers.
+
+   @param n_buffers Number of buffers, one for each channel.
+   @param nframes Length of each buffer in frames.
+   @return An array of `n_buffers` buffers followed by null, or null on error.
+*/
+float**
+jalv_buffers_new(uint32_t n_buffers, uint32_t nframes);
+
+/// Free buffers allocated with jalv_buffers_new()
+void
+jalv_buffers_free(float** bufs, uint32_t n_buffers);
+
+/**
+   Connect a port to a control value or audio buffer.
+
+   Control ports are connected to their value in the process, and audio and
+   CV ports are connected to the buffer for their channel, which is their
+   position among the ports of the same flow.  Other ports are left alone.
+
+   @param proc Process thread state.
+   @param port_index Index of the port to connect.
+   @param in_bufs Buffers for audio and CV inputs.
+   @param out_bufs Buffers for audio and CV outputs.
+*/
+void
+jalv_buffers_connect_port(JalvProcess* proc,
+                          uint32_t     port_index,
+                          float**      in_bufs,
+                          float**      out_bufs);
+
+JALV_END_DECLS
+
+#endif // JALV_BUFFERS_H
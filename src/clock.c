@@ -0,0 +1,54 @@
+// Copyright 2026 David Robillard <d@drobilla.net>
+// SPDX-License-Identifier: ISC
+
+#include "clock.h"
+
+#include "jalv_config.h"
+
+#ifdef _WIN32
+#  include <windows.h>
+#elif USE_CLOCK_GETTIME
+#  include <time.h>
+#endif
+
+#include <stdint.h>
+
+uint64_t
+jalv_clock_now(void)
+{
+#ifdef _WIN32
+  LARGE_INTEGER count;
+  LARGE_INTEGER frequency;
+  QueryPerformanceCounter(&count);
+  QueryPerformanceFrequency(&frequency);
+  return (uint64_t)((double)count.QuadPart * 1000000000.0 /
+                    (double)frequency.QuadPart);
+#elif USE_CLOCK_GETTIME
+  struct timespec ts = {0, 0};
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((uint64_t)ts.tv_sec * 1000000000U) + (uint64_t)ts.tv_nsec;
+#else
+  return 0U;
+#endif
+}
+
+void
+jalv_clock_sleep_until(const uint64_t time)
+{
+  const uint64_t now = jalv_clock_now();
+  if (time <= now) {
+    return;
+  }
+
+  const uint64_t delay = time - now;
+
+#ifdef _WIN32
+  Sleep((DWORD)(delay / 1000000U));
+#elif USE_CLOCK_GETTIME
+  const struct timespec ts = {(time_t)(delay / 1000000000U),
+                              (long)(delay % 1000000000U)};
+  nanosleep(&ts, NULL);
+#else
+  (void)delay;
+#endif
+}
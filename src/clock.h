@@ -0,0 +1,35 @@
+// Copyright 2026 David Robillard <d@drobilla.net>
+// SPDX-License-Identifier: ISC
+
+#ifndef JALV_CLOCK_H
+#define JALV_CLOCK_H
+
+#include "attributes.h"
+
+#include <zix/attributes.h>
+
+#include <stdint.h>
+
+// Monotonic system clock for timing and pacing
+JALV_BEGIN_DECLS
+
+/**
+   Return the current time of a monotonic clock in nanoseconds.
+
+   The epoch is arbitrary, so this is only meaningful for measuring intervals.
+   If no suitable clock is available, this always returns zero.
+*/
+ZIX_REALTIME uint64_t
+jalv_clock_now(void);
+
+/**
+   Sleep until the monotonic clock reaches a given time.
+
+   @param time Time in nanoseconds, in the same epoch as jalv_clock_now().
+*/
+void
+jalv_clock_sleep_until(uint64_t time);
+
+JALV_END_DECLS
+
+#endif // JALV_CLOCK_H
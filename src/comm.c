@@ -1,4 +1,4 @@
-// Copyright 2007-2024 David Robillard <d@drobilla.net>
+// Copyright 2007-2026 David Robillard <d@drobilla.net>
 // SPDX-License-Identifier: ISC
 
 #include "comm.h"
@@ -33,8 +33,6 @@ jalv_write_event(ZixRing* const    target,
                  const LV2_URID    type,
                  const void* const body)
 {
-  // TODO: Be more discriminate about what to send
-
   typedef struct {
     JalvMessageHeader message;
     JalvEventTransfer event;
@@ -45,21 +43,3 @@ jalv_write_event(ZixRing* const    target,
 
   return jalv_write_split_message(target, &header, sizeof(header), body, size);
 }
-
-ZIX_REALTIME ZixStatus
-jalv_write_control(ZixRing* const target,
-                   const uint32_t port_index,
-                   const float    value)
-{
-  typedef struct {
-    JalvMessageHeader message;
-    JalvControlChange control;
-  } Message;
-
-  const Message msg = {{CONTROL_PORT_CHANGE, sizeof(JalvControlChange)},
-                       {port_index, value}};
-
-  return zix_ring_write(target, &msg, sizeof(msg)) == sizeof(msg)
-           ? ZIX_STATUS_SUCCESS
-           : ZIX_STATUS_ERROR;
-}
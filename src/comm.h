@@ -1,10 +1,11 @@
-// Copyright 2007-2025 David Robillard <d@drobilla.net>
+// Copyright 2007-2026 David Robillard <d@drobilla.net>
 // SPDX-License-Identifier: ISC
 
 #ifndef JALV_COMM_H
 #define JALV_COMM_H
 
 #include "attributes.h"
+#include "process.h"
 #include "types.h"
 
 #include <lv2/atom/atom.h>
@@ -20,12 +21,14 @@ JALV_BEGIN_DECLS
 
 /// Type of an internal message in a communication ring
 typedef enum {
-  NO_MESSAGE,          ///< Sentinel type for uninitialized messages
-  CONTROL_PORT_CHANGE, ///< Value change for a control port (float)
-  EVENT_TRANSFER,      ///< Event transfer for a sequence port (atom)
-  LATENCY_CHANGE,      ///< Change to plugin latency
-  STATE_REQUEST,       ///< Request for a plugin state update (no payload)
-  RUN_STATE_CHANGE,    ///< Request to pause or resume running
+  NO_MESSAGE,       ///< Sentinel type for uninitialized messages
+  EVENT_TRANSFER,   ///< Event transfer for a sequence port (atom)
+  LATENCY_CHANGE,   ///< Change to plugin latency
+  STATE_REQUEST,    ///< Request for a plugin state update (no payload)
+  RUN_STATE_CHANGE, ///< Request to pause or resume running
+  LOAD_REPORT,      ///< Summary of processing load (JalvLoadReport)
+  SHADOW_START,     ///< Start fading in a shadow instance (JalvShadowStart)
+  TIMED_CHANGE,     ///< Change a control at a specific time (JalvTimedChange)
 } JalvMessageType;
 
 /**
@@ -34,22 +37,17 @@ typedef enum {
    This is the general header for any type of message in a communication ring.
    The type determines how the message must be handled by the receiver.  This
    header is followed immediately by `size` bytes of data in the ring.
+
+   Control port values aren't sent as messages, but through a JalvMailbox,
+   since only the latest value of each port matters.  The exception is changes
+   that must happen at a specific time, which are sent as TIMED_CHANGE
+   messages with a JalvTimedChange payload.
 */
 typedef struct {
   JalvMessageType type; ///< Type of this message
   uint32_t        size; ///< Size of payload following this header in bytes
 } JalvMessageHeader;
 
-/**
-   The payload of a CONTROL_PORT_CHANGE message.
-
-   This message has a fixed size, this struct defines the entire payload.
-*/
-typedef struct {
-  uint32_t port_index; ///< Control port index
-  float    value;      ///< Control value
-} JalvControlChange;
-
 /**
    The start of the payload of an EVENT_TRANSFER message.
 
@@ -79,6 +77,15 @@ typedef struct {
   JalvRunState state; ///< Run state to change to
 } JalvRunStateChange;
 
+/**
+   The payload of a SHADOW_START message.
+
+   This message has a fixed size, this struct defines the entire payload.
+*/
+typedef struct {
+  JalvShadow* shadow; ///< Shadow instance to fade in
+} JalvShadowStart;
+
 /**
    Write a message in two parts to a ring.
 
@@ -118,20 +125,6 @@ jalv_write_event(ZixRing*    target,
                  LV2_URID    type,
                  const void* body);
 
-/**
-   Write a control port change using the default (0) protocol.
-
-   This is used to transfer control port value changes between the plugin and
-   UI.
-
-   @param target Communication ring (jalv->plugin_to_ui or jalv->ui_to_plugin).
-   @param port_index Index of the port this change is for.
-   @param value New control port value.
-   @return 0 on success, non-zero on failure (overflow).
-*/
-ZIX_REALTIME ZixStatus
-jalv_write_control(ZixRing* target, uint32_t port_index, float value);
-
 JALV_END_DECLS
 
 #endif // JALV_COMM_H
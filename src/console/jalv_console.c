@@ -4,20 +4,26 @@
 #include "parse_command.h"
 
 #include "../any_value.h"
+#include "../backend.h"
 #include "../control.h"
+#include "../dumper.h"
 #include "../frontend.h"
 #include "../jalv.h"
 #include "../jalv_config.h"
+#include "../load.h"
 #include "../options.h"
+#include "../preset_cache.h"
 #include "../state.h"
 #include "../string_utils.h"
 #include "../types.h"
+#include "../wakeup.h"
 
 #include <lilv/lilv.h>
 #include <lv2/atom/forge.h>
 #include <lv2/ui/ui.h>
 #include <zix/attributes.h>
 #include <zix/sem.h>
+#include <zix/status.h>
 
 #if USE_SUIL
 #  include <suil/suil.h>
@@ -38,16 +44,21 @@
 #include <ctype.h>
 #include <inttypes.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/types.h>
 
 #define CONSOLE_REFRESH_RATE 15
+#define WAKEUP_TIMEOUT_MS 1000
 
 typedef struct {
   int status;     ///< Status code (non-zero on error)
   int n_controls; ///< Number of control values given
+  int n_links;    ///< Number of links given
+  int n_tempos;   ///< Number of tempo changes given
+  int n_filters;  ///< Number of dump filters given
   int a;          ///< Argument index
 } OptionsState;
 
@@ -55,23 +66,46 @@ static int
 print_usage(const char* name, bool error)
 {
   FILE* const os = error ? stderr : stdout;
-  fprintf(os, "Usage: %s [OPTION...] PLUGIN_STATE\n", name);
+  fprintf(os, "Usage: %s [OPTION...] PLUGIN_STATE...\n", name);
   fprintf(os,
           "Run an LV2 plugin as a Jack application.\n"
-          "PLUGIN_STATE can be a plugin/preset URI, or a path.\n\n"
+          "PLUGIN_STATE can be a plugin/preset URI, or a path.\n"
+          "Several plugins share one client, with ports prefixed by name.\n\n"
+          "  -a FRAMES   Split blocks at timed controls, at least FRAMES long\n"
+          "  -B FILE     Plugin index file for loading only needed bundles\n"
           "  -b BYTES    Buffer size for plugin <=> UI communication\n"
-          "  -c SYM=VAL  Set control value (like \"vol=1.4\")\n"
+          "  -C          Cache presets incrementally for fast switching\n"
+          "  -c SYM=VAL  Set control value (like \"vol=1.4\" or \"vol=1@64\")\n"
+          "  -D FILE     Capture plugin <=> UI communication to a file\n"
           "  -d          Dump plugin <=> UI communication\n"
+          "  -E FILE     Write MIDI output to a file when rendering\n"
+          "  -e TEMPO    Internal tempo (like \"120\" or \"96000:90,3/4\")\n"
+          "  -F          Process as fast as possible without a clock\n"
+          "  -f FILTER   Only dump a port symbol or type URI\n"
           "  -h          Display this help and exit\n"
+          "  -I FILE     Read audio input from a file when rendering\n"
           "  -i          Ignore keyboard input, run non-interactively\n"
+          "  -L OUT=IN   Feed output to input (like \"1/out=2/in\")\n"
           "  -l FRAMES   Length of an audio block\n"
+          "  -M FILE     Read MIDI input from a file when rendering\n"
           "  -n NAME     JACK client name\n"
+          "  -O FILE     Write audio output to a file when rendering\n"
+          "  -P THREADS  Threads to run several plugins on in parallel\n"
           "  -p          Print control output changes to stdout\n"
+          "  -R RATE     Sample rate when rendering\n"
           "  -s          Show plugin UI if possible\n"
+          "  -T SECONDS  Time to run after the end of input\n"
           "  -t          Print debug trace messages\n"
           "  -U URI      Load the UI with the given URI\n"
+          "  -u SECONDS  Time to run the dummy backend before exiting\n"
           "  -V          Display version information and exit\n"
-          "  -x          Exit if the requested JACK client name is taken\n");
+          "  -W FILE     Record plugin <=> UI messages to a file\n"
+          "  -w THREADS  Worker threads (plugin work must be thread-safe)\n"
+          "  -X          Restore state into a new instance and crossfade\n"
+          "  -x          Exit if the requested JACK client name is taken\n"
+          "  -Y FILE     Print a file captured with -D as Turtle and exit\n"
+          "  -y FILE     Replay UI messages recorded with -W\n"
+          "  -z SECONDS  Stop running the plugin after SECONDS of silence\n");
   return error ? 1 : JALV_EARLY_EXIT_STATUS;
 }
 
@@ -172,21 +206,60 @@ parse_int_argument(OptionsState* const state,
   return (uint32_t)value;
 }
 
+static double
+parse_double_argument(OptionsState* const state,
+                      const int           argc,
+                      char** const        argv,
+                      const char          opt,
+                      const double        lowest,
+                      const double        highest)
+{
+  const char* const string = parse_argument(state, argc, argv, opt);
+  if (state->status) {
+    return 0.0;
+  }
+
+  const double value = strtod(string, NULL);
+  if (value < lowest || value > highest) {
+    state->status = 1;
+    fprintf(stderr, "%s: option value out of range -- '%c'\n", argv[0], opt);
+  }
+
+  return value;
+}
+
+static int
+print_capture(OptionsState* const state, const int argc, char** const argv)
+{
+  const char* const path = parse_argument(state, argc, argv, 'Y');
+  if (state->status) {
+    return state->status;
+  }
+
+  const ZixStatus st = jalv_dump_convert(path, stdout);
+  if (st) {
+    fprintf(stderr, "%s: %s: %s\n", argv[0], path, zix_strerror(st));
+    return 1;
+  }
+
+  return JALV_EARLY_EXIT_STATUS;
+}
+
 static void
-add_control_argument(OptionsState* const state,
-                     JalvOptions* const  opts,
-                     const char* const   cmd,
-                     char* const         arg)
-{
-  char** new_controls =
-    (char**)realloc(opts->controls, (state->n_controls + 2) * sizeof(char*));
-  if (!new_controls) {
+add_list_argument(OptionsState* const state,
+                  char*** const       list,
+                  int* const          n,
+                  const char* const   cmd,
+                  char* const         arg)
+{
+  char** new_list = (char**)realloc(*list, (*n + 2) * sizeof(char*));
+  if (!new_list) {
     fprintf(stderr, "%s: Out of memory\n", cmd);
     state->status = 12;
   } else {
-    opts->controls                      = new_controls;
-    opts->controls[state->n_controls++] = arg;
-    opts->controls[state->n_controls]   = NULL;
+    *list           = new_list;
+    (*list)[(*n)++] = arg;
+    (*list)[*n]     = NULL;
   }
 }
 
@@ -214,13 +287,44 @@ parse_option(OptionsState* const state,
       parse_int_argument(state, argc, argv, 'b', 2U, 2147483648U);
   } else if (opt[1] == 'l') {
     opts->block_length = parse_int_argument(state, argc, argv, 'l', 1U, 65536U);
+  } else if (opt[1] == 'a') {
+    opts->split_length = parse_int_argument(state, argc, argv, 'a', 1U, 65536U);
   } else if (opt[1] == 'c') {
-    add_control_argument(
-      state, opts, cmd, parse_argument(state, argc, argv, 'c'));
+    add_list_argument(state,
+                      &opts->controls,
+                      &state->n_controls,
+                      cmd,
+                      parse_argument(state, argc, argv, 'c'));
+  } else if (opt[1] == 'L') {
+    add_list_argument(state,
+                      &opts->links,
+                      &state->n_links,
+                      cmd,
+                      parse_argument(state, argc, argv, 'L'));
+  } else if (opt[1] == 'e') {
+    add_list_argument(state,
+                      &opts->tempos,
+                      &state->n_tempos,
+                      cmd,
+                      parse_argument(state, argc, argv, 'e'));
   } else if (opt[1] == 'i') {
     opts->non_interactive = true;
   } else if (opt[1] == 'd') {
     opts->dump = true;
+  } else if (opt[1] == 'D') {
+    opts->dump_file = parse_argument(state, argc, argv, 'D');
+  } else if (opt[1] == 'f') {
+    add_list_argument(state,
+                      &opts->dump_filters,
+                      &state->n_filters,
+                      cmd,
+                      parse_argument(state, argc, argv, 'f'));
+  } else if (opt[1] == 'W') {
+    opts->traffic_log = parse_argument(state, argc, argv, 'W');
+  } else if (opt[1] == 'y') {
+    opts->replay_log = parse_argument(state, argc, argv, 'y');
+  } else if (opt[1] == 'Y') {
+    state->status = print_capture(state, argc, argv);
   } else if (opt[1] == 't') {
     opts->trace = true;
   } else if (opt[1] == 'n') {
@@ -228,6 +332,36 @@ parse_option(OptionsState* const state,
     opts->name = jalv_strdup(parse_argument(state, argc, argv, 'n'));
   } else if (opt[1] == 'x') {
     opts->name_exact = 1;
+  } else if (opt[1] == 'X') {
+    opts->shadow_restore = true;
+  } else if (opt[1] == 'C') {
+    opts->preset_cache = true;
+  } else if (opt[1] == 'B') {
+    opts->plugin_index = parse_argument(state, argc, argv, 'B');
+  } else if (opt[1] == 'I') {
+    opts->audio_input = parse_argument(state, argc, argv, 'I');
+  } else if (opt[1] == 'O') {
+    opts->audio_output = parse_argument(state, argc, argv, 'O');
+  } else if (opt[1] == 'M') {
+    opts->midi_input = parse_argument(state, argc, argv, 'M');
+  } else if (opt[1] == 'E') {
+    opts->midi_output = parse_argument(state, argc, argv, 'E');
+  } else if (opt[1] == 'R') {
+    opts->sample_rate = parse_int_argument(state, argc, argv, 'R', 1U, 768000U);
+  } else if (opt[1] == 'F') {
+    opts->free_running = true;
+  } else if (opt[1] == 'P') {
+    opts->graph_threads = parse_int_argument(state, argc, argv, 'P', 1U, 64U);
+  } else if (opt[1] == 'w') {
+    opts->worker_threads = parse_int_argument(state, argc, argv, 'w', 1U, 64U);
+  } else if (opt[1] == 'T') {
+    opts->tail = parse_double_argument(state, argc, argv, 'T', 0.0, 86400.0);
+  } else if (opt[1] == 'u') {
+    opts->duration =
+      parse_double_argument(state, argc, argv, 'u', 0.0, 86400.0);
+  } else if (opt[1] == 'z') {
+    opts->sleep_tail =
+      parse_double_argument(state, argc, argv, 'z', 0.0, 3600.0);
   } else {
     fprintf(stderr, "%s: unknown option -- '%c'\n", cmd, opt[1]);
     state->status = print_usage(argv[0], true);
@@ -242,7 +376,7 @@ jalv_frontend_init(Jalv* const jalv)
   const int    argc = jalv->args.argc;
   char** const argv = jalv->args.argv;
 
-  OptionsState state = {0, 0, 1};
+  OptionsState state = {0, 0, 0, 0, 0, 1};
 
   for (; state.a < argc && argv[state.a][0] == '-'; ++state.a) {
     const int r = parse_option(&state, &jalv->opts, argc, argv);
@@ -276,6 +410,55 @@ print_controls(const Jalv* const jalv, const bool writable, const bool readable)
   fflush(stdout);
 }
 
+static double
+load_percent(const uint32_t load)
+{
+  return load * 100.0 / JALV_LOAD_FULL;
+}
+
+static void
+print_load(const JalvLoadReport* const load)
+{
+  if (!load->stages[JALV_STAGE_CYCLE].max) {
+    return; // No cycles measured yet
+  }
+
+  printf("# %-12s %7s %7s %7s\n", "stage", "p50%", "p99%", "max%");
+  for (uint32_t i = 0U; i < JALV_N_STAGES; ++i) {
+    const JalvLoadStats* const stats = &load->stages[i];
+    printf("# %-12s %7.2f %7.2f %7.2f\n",
+           jalv_stage_name((JalvStage)i),
+           load_percent(stats->p50),
+           load_percent(stats->p99),
+           load_percent(stats->max));
+  }
+
+  printf("# xruns: %u", load->n_xruns);
+  if (load->n_xruns) {
+    const uint32_t* const loads = load->xrun_cycle;
+    printf(" (last at %.2f%%, plugin %.2f%%, host %.2f%%)",
+           load_percent(loads[JALV_STAGE_CYCLE]),
+           load_percent(jalv_load_plugin(loads)),
+           load_percent(jalv_load_host(loads)));
+  }
+
+  printf("\n# control updates: %u sent, %u unchanged\n",
+         load->n_updates,
+         load->n_suppressed);
+
+  const JalvRingStats* const to_ui     = &load->to_ui;
+  const JalvRingStats* const to_plugin = &load->to_plugin;
+  printf("# comm buffers: peak %u/%u bytes to UI (%u dropped), "
+         "%u/%u bytes to plugin (%u dropped)\n",
+         to_ui->peak,
+         to_ui->size,
+         to_ui->n_dropped,
+         to_plugin->peak,
+         to_plugin->size,
+         to_plugin->n_dropped);
+  fflush(stdout);
+}
+
 static int
 print_preset(Jalv*           ZIX_UNUSED(jalv),
              const LilvNode* node,
@@ -286,6 +469,19 @@ print_preset(Jalv*           ZIX_UNUSED(jalv),
   return 0;
 }
 
+static void
+print_preset_cache(const JalvPresetCache* const cache)
+{
+  JalvPresetCacheStats stats = {0U, 0U, 0U, 0U, 0U};
+  jalv_preset_cache_stats(cache, &stats);
+  printf("Cached %u/%u presets in %.3f ms, %u hits, %u misses\n",
+         stats.n_loaded,
+         stats.n_presets,
+         (double)stats.load_ns / 1000000.0,
+         stats.n_hits,
+         stats.n_misses);
+}
+
 static int
 set_control_from_string(Jalv* const                 jalv,
                         Control* const              control,
@@ -398,7 +594,7 @@ handle_command(Jalv* const            jalv,
             "Commands:\n"
             "  help              Display this help message\n"
             "  controls          Print settable control values\n"
-            "  monitors          Print output control values\n"
+            "  monitors          Print output control values and load\n"
             "  presets           Print available presets\n"
             "  preset URI        Set preset\n"
             "  quit              Quit this program\n"
@@ -407,14 +603,22 @@ handle_command(Jalv* const            jalv,
     return COMMAND_SUCCESS;
 
   case COMMAND_PRESETS:
-    jalv_unload_presets(jalv);
-    jalv_load_presets(jalv, print_preset, NULL);
+    if (jalv->preset_cache) {
+      jalv_load_presets(jalv, print_preset, NULL);
+      print_preset_cache(jalv->preset_cache);
+    } else {
+      jalv_unload_presets(jalv);
+      jalv_load_presets(jalv, print_preset, NULL);
+    }
     return COMMAND_SUCCESS;
 
   case COMMAND_PRESET_URI: {
     LilvNode* preset = lilv_new_uri(jalv->world, args.name);
     if (preset) {
-      lilv_world_load_resource(jalv->world, preset);
+      if (!jalv->preset_cache ||
+          !jalv_preset_cache_is_loaded(jalv->preset_cache, preset)) {
+        lilv_world_load_resource(jalv->world, preset);
+      }
       if (jalv_apply_preset(jalv, preset)) {
         fprintf(stderr, "error: unknown preset <%s>\n", args.name);
       }
@@ -430,6 +634,7 @@ handle_command(Jalv* const            jalv,
 
   case COMMAND_MONITORS:
     print_controls(jalv, false, true);
+    print_load(&jalv->load);
     return COMMAND_SUCCESS;
 
   case COMMAND_QUIT:
@@ -544,16 +749,227 @@ print_prompt(FILE* const out)
   fflush(out);
 }
 
+/// Set up a guest for each plugin after the first to share its audio client
+static int
+add_guests(Jalv* const jalv)
+{
+  if (jalv->opts.plugin_index) {
+    fprintf(stderr, "warning: Not using plugin index for several plugins\n");
+    jalv->opts.plugin_index = NULL;
+  }
+
+  if (jalv->opts.dump_file || jalv->opts.traffic_log ||
+      jalv->opts.replay_log) {
+    fprintf(stderr, "warning: Only capturing or replaying the first plugin\n");
+  }
+
+  Jalv* last = jalv;
+  for (int i = 1; i < jalv->args.argc; ++i) {
+    Jalv* const guest = (Jalv*)calloc(1, sizeof(Jalv));
+    if (!guest || !(guest->backend = jalv_backend_allocate())) {
+      free(guest);
+      return 1;
+    }
+
+    // Guests get the same options, except for those specific to one plugin
+    guest->args.argc        = 1;
+    guest->args.argv        = &jalv->args.argv[i];
+    guest->opts             = jalv->opts;
+    guest->opts.name        = NULL;
+    guest->opts.controls    = NULL;
+    guest->opts.links       = NULL;
+    guest->opts.dump_file   = NULL;
+    guest->opts.traffic_log = NULL;
+    guest->opts.replay_log  = NULL;
+    guest->opts.show_ui     = false;
+    guest->opts.ui_uri      = NULL;
+    guest->host             = jalv;
+    last->next              = guest;
+    last                    = guest;
+  }
+
+  return 0;
+}
+
+/// Return the plugin with a port like "2/in" in a link, and set its index
+static Jalv*
+find_link_port(Jalv* const       jalv,
+               const char* const str,
+               const size_t      len,
+               uint32_t* const   index)
+{
+  char*               end = NULL;
+  const unsigned long n   = strtoul(str, &end, 10);
+  if (*end != '/' || end >= str + len) {
+    return NULL;
+  }
+
+  Jalv* j = jalv;
+  for (unsigned long i = 1U; j && i < n; ++i) {
+    j = j->next;
+  }
+
+  char* const symbol = (char*)calloc(len, 1U);
+  if (!symbol) {
+    return NULL;
+  }
+
+  memcpy(symbol, end + 1, (size_t)(str + len - end - 1));
+
+  const JalvPort* const port = (j && n) ? jalv_port_by_symbol(j, symbol) : NULL;
+
+  free(symbol);
+  if (port) {
+    *index = port->index;
+  }
+
+  return port ? j : NULL;
+}
+
+/// Link the plugins as given on the command line and prepare to run them
+static int
+link_guests(Jalv* const jalv)
+{
+  for (char** l = jalv->opts.links; l && *l; ++l) {
+    const char* const sep        = strchr(*l, '=');
+    uint32_t          from_index = 0U;
+    uint32_t          to_index   = 0U;
+
+    Jalv* const from =
+      sep ? find_link_port(jalv, *l, (size_t)(sep - *l), &from_index) : NULL;
+    Jalv* const to =
+      from ? find_link_port(jalv, sep + 1, strlen(sep + 1), &to_index) : NULL;
+
+    if (!to ||
+        jalv_backend_link(from->backend, from_index, to->backend, to_index)) {
+      fprintf(stderr, "error: failed to link \"%s\"\n", *l);
+      return 1;
+    }
+  }
+
+  const uint32_t n_threads = jalv->opts.graph_threads;
+  if (jalv_backend_prepare_graph(jalv->backend, n_threads ? n_threads : 1U)) {
+    fprintf(stderr, "error: failed to prepare plugin graph (is it cyclic?)\n");
+    return 1;
+  }
+
+  return 0;
+}
+
+#if USE_POLL
+
+/// Allocate a poll set of every plugin's UI wakeup, or return null
+static struct pollfd*
+new_wakeup_fds(const Jalv* const jalv, nfds_t* const n_fds)
+{
+  *n_fds = 0U;
+  for (const Jalv* j = jalv; j; j = j->next) {
+    if (jalv_wakeup_fd(&j->process.ui_wakeup) < 0) {
+      return NULL;
+    }
+
+    ++*n_fds;
+  }
+
+  struct pollfd* const fds =
+    (struct pollfd*)calloc(*n_fds, sizeof(struct pollfd));
+
+  if (fds) {
+    nfds_t i = 0U;
+    for (const Jalv* j = jalv; j; j = j->next, ++i) {
+      fds[i].fd     = jalv_wakeup_fd(&j->process.ui_wakeup);
+      fds[i].events = POLLIN;
+    }
+  }
+
+  return fds;
+}
+
+#endif
+
+static void
+update_guests(Jalv* const jalv)
+{
+  for (Jalv* j = jalv; j; j = j->next) {
+    jalv_update(j);
+  }
+}
+
+/// Run several plugins without a prompt until interrupted
+static void
+run_guests(Jalv* const jalv)
+{
+  bool woken = false;
+
+#if USE_POLL
+  // Sleep until any plugin has something to update if possible
+  nfds_t               n_fds = 0U;
+  struct pollfd* const fds   = new_wakeup_fds(jalv, &n_fds);
+  if (fds) {
+    woken = true;
+    for (;;) {
+      poll(fds, n_fds, WAKEUP_TIMEOUT_MS);
+      if (!zix_sem_try_wait(&jalv->done)) {
+        break;
+      }
+
+      update_guests(jalv);
+    }
+
+    free(fds);
+  }
+#endif
+
+  // Otherwise, update at a fixed rate
+  const uint32_t period_ns = 1000000000U / CONSOLE_REFRESH_RATE;
+  while (!woken && zix_sem_timed_wait(&jalv->done, 0U, period_ns)) {
+    update_guests(jalv);
+  }
+
+  // Report the processing load of each plugin
+  for (const Jalv* j = jalv; j; j = j->next) {
+    printf("# %s\n", j->instance_name);
+    print_load(&j->load);
+  }
+}
+
 int
 jalv_frontend_run(Jalv* jalv)
 {
+  if (jalv->args.argc > 1 && add_guests(jalv)) {
+    return 1;
+  }
+
   if (jalv_open(jalv, jalv->args.argv[0])) {
     return 1;
   }
 
+  for (Jalv* guest = jalv->next; guest; guest = guest->next) {
+    if (jalv_open(guest, guest->args.argv[0])) {
+      return 1;
+    }
+  }
+
+  if (jalv->next && link_guests(jalv)) {
+    return 1;
+  }
+
+  if (!jalv->next && jalv->opts.links) {
+    fprintf(stderr, "warning: Ignoring links with only one plugin\n");
+  }
+
   fprintf(stderr, "\n");
+  for (Jalv* guest = jalv->next; guest; guest = guest->next) {
+    jalv_activate(guest);
+  }
+
   jalv_activate(jalv);
 
+  if (jalv->next) {
+    run_guests(jalv);
+    return 0;
+  }
+
   if (!run_custom_ui(jalv) && !jalv->opts.non_interactive) {
     print_prompt(stdout);
 
@@ -563,11 +979,18 @@ jalv_frontend_run(Jalv* jalv)
     char   line[1024] = {0};
     while (st != COMMAND_QUIT && zix_sem_try_wait(&jalv->done)) {
 #if USE_POLL
-      struct pollfd fds[1] = {{STDIN_FILENO, POLLIN, 0}};
-      const int     rc     = poll(fds, 1, 1000 / CONSOLE_REFRESH_RATE);
+      // Wait for input, or until the plugin has something to update
+      const int wakeup_fd = jalv_wakeup_fd(&jalv->process.ui_wakeup);
+      const int timeout =
+        wakeup_fd >= 0 ? WAKEUP_TIMEOUT_MS : 1000 / CONSOLE_REFRESH_RATE;
+
+      struct pollfd fds[2] = {{STDIN_FILENO, POLLIN, 0},
+                              {wakeup_fd, POLLIN, 0}};
+
+      const int rc = poll(fds, 2, timeout);
       if (rc < 0) {
         st = COMMAND_QUIT;
-      } else if (rc == 1) {
+      } else if (fds[0].revents & POLLIN) {
         const ssize_t n = read(STDIN_FILENO, line + len, 1);
         if (n == 1) {
           if (line[len] == '\n') {
@@ -601,7 +1024,20 @@ jalv_frontend_run(Jalv* jalv)
 int
 jalv_frontend_close(Jalv* jalv)
 {
+  // Stop the shared audio client before closing any of its plugins
   jalv_deactivate(jalv);
+
+  Jalv* guest = jalv->next;
+  while (guest) {
+    Jalv* const next = guest->next;
+    jalv_deactivate(guest);
+    jalv_close(guest);
+    jalv_backend_free(guest->backend);
+    free(guest);
+    guest = next;
+  }
+
+  jalv->next = NULL;
   jalv_close(jalv);
   return 0;
 }
@@ -5,6 +5,7 @@
 
 #include "nodes.h"
 #include "string_utils.h"
+#include "symap.h"
 
 #include <lilv/lilv.h>
 #include <lv2/atom/atom.h>
@@ -201,45 +202,241 @@ free_control(Control* const control)
   free(control);
 }
 
+/// Grow an index so it has at least a given size, zeroing new elements
+static bool
+grow_index(Control*** const index,
+           uint32_t* const  size,
+           const uint32_t   min_size)
+{
+  if (min_size <= *size) {
+    return true;
+  }
+
+  uint32_t new_size = *size ? *size : 16U;
+  while (new_size < min_size) {
+    new_size *= 2U;
+  }
+
+  Control** const new_index =
+    (Control**)realloc(*index, new_size * sizeof(Control*));
+  if (!new_index) {
+    return false;
+  }
+
+  memset(new_index + *size, 0, (new_size - *size) * sizeof(Control*));
+  *index = new_index;
+  *size  = new_size;
+  return true;
+}
+
 void
 add_control(Controls* controls, Control* control)
 {
-  Control** const new_controls = (Control**)realloc(
-    controls->controls, (controls->n_controls + 1) * sizeof(Control*));
+  const size_t n_controls = controls->n_controls + 1U;
+
+  // Allocate space in the arrays and indexes for the new control
+  Control** const new_controls =
+    (Control**)realloc(controls->controls, n_controls * sizeof(Control*));
+  if (!new_controls) {
+    return;
+  }
+
+  controls->controls = new_controls;
+
+  Control** const new_by_symbol =
+    (Control**)realloc(controls->by_symbol, n_controls * sizeof(Control*));
+  if (!new_by_symbol) {
+    return;
+  }
+
+  controls->by_symbol = new_by_symbol;
+
+  if ((!controls->symbols && !(controls->symbols = symap_new())) ||
+      (control->type == PORT &&
+       !grow_index(
+         &controls->by_port, &controls->n_ports, control->id.index + 1U)) ||
+      (control->type == PROPERTY &&
+       !grow_index(&controls->by_property,
+                   &controls->n_properties,
+                   control->id.property + 1U))) {
+    return;
+  }
+
+  // Index the control, keeping the first if there are duplicates
+  if (control->type == PORT && !controls->by_port[control->id.index]) {
+    controls->by_port[control->id.index] = control;
+  } else if (control->type == PROPERTY &&
+             !controls->by_property[control->id.property]) {
+    controls->by_property[control->id.property] = control;
+  }
 
-  if (new_controls) {
-    controls->controls                         = new_controls;
-    controls->controls[controls->n_controls++] = control;
+  if (control->symbol) {
+    const char* const symbol = lilv_node_as_string(control->symbol);
+    if (!symap_try_map(controls->symbols, symbol)) {
+      const uint32_t id = symap_map(controls->symbols, symbol);
+      if (id) {
+        controls->by_symbol[id - 1U] = control;
+      }
+    }
   }
+
+  controls->controls[controls->n_controls++] = control;
 }
 
-Control*
-get_named_control(const Controls* controls, const char* symbol)
+void
+free_controls(Controls* const controls)
 {
   for (size_t i = 0; i < controls->n_controls; ++i) {
-    if (!strcmp(lilv_node_as_string(controls->controls[i]->symbol), symbol)) {
-      return controls->controls[i];
-    }
+    free_control(controls->controls[i]);
   }
-  return NULL;
+
+  free(controls->by_property);
+  free(controls->by_port);
+  free(controls->by_symbol);
+  symap_free(controls->symbols);
+  free(controls->controls);
+  memset(controls, 0, sizeof(Controls));
+}
+
+Control*
+get_named_control(const Controls* controls, const char* symbol)
+{
+  const uint32_t id =
+    controls->symbols ? symap_try_map(controls->symbols, symbol) : 0U;
+
+  return id ? controls->by_symbol[id - 1U] : NULL;
 }
 
 Control*
 get_port_control(const Controls* controls, uint32_t port_index)
 {
-  return port_index < controls->n_controls ? controls->controls[port_index]
-                                           : NULL;
+  return port_index < controls->n_ports ? controls->by_port[port_index] : NULL;
 }
 
 Control*
 get_property_control(const Controls* controls, LV2_URID property)
 {
-  for (size_t i = 0; i < controls->n_controls; ++i) {
-    if (controls->controls[i]->type == PROPERTY &&
-        controls->controls[i]->id.property == property) {
-      return controls->controls[i];
+  return property < controls->n_properties ? controls->by_property[property]
+                                           : NULL;
+}
+
+#ifdef CONTROL_STANDALONE
+
+#  include <stdio.h>
+#  include <time.h>
+
+static double
+control_elapsed(const clock_t start)
+{
+  return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+/// Find a control by symbol with a linear search, like before indexing
+static const Control*
+control_scan(const Controls* const controls, const char* const symbol)
+{
+  for (size_t i = 0U; i < controls->n_controls; ++i) {
+    const Control* const control = controls->controls[i];
+    if (!strcmp(lilv_node_as_string(control->symbol), symbol)) {
+      return control;
     }
   }
 
   return NULL;
 }
+
+static int
+control_bench(LilvWorld* const world, const uint32_t n_ports)
+{
+  Controls controls   = {0U, NULL, NULL, NULL, NULL, NULL, 0U, 0U};
+  char     symbol[64] = {'\0'};
+
+  // Add a port control for every other port, and a property for each
+  for (uint32_t i = 0U; i < n_ports; ++i) {
+    Control* const control = (Control*)calloc(1U, sizeof(Control));
+    if (!control) {
+      free_controls(&controls);
+      return fprintf(stderr, "error: Failed to allocate control\n");
+    }
+
+    snprintf(symbol, sizeof(symbol), "control_%u", i);
+    control->type   = (i % 2U) ? PROPERTY : PORT;
+    control->symbol = lilv_new_string(world, symbol);
+    if (control->type == PORT) {
+      control->id.index = 2U * i + 1U;
+    } else {
+      control->id.property = i + 1U;
+    }
+
+    add_control(&controls, control);
+  }
+
+  if (controls.n_controls != n_ports) {
+    free_controls(&controls);
+    return fprintf(stderr, "error: Failed to add controls\n");
+  }
+
+  // Look up every control by symbol, as restoring state does
+  clock_t start = clock();
+  for (uint32_t i = 0U; i < n_ports; ++i) {
+    snprintf(symbol, sizeof(symbol), "control_%u", i);
+    if (get_named_control(&controls, symbol) != controls.controls[i]) {
+      free_controls(&controls);
+      return fprintf(stderr, "error: Failed to find control %u\n", i);
+    }
+  }
+
+  const double symbol_time = control_elapsed(start);
+
+  // Do the same with a linear search for comparison
+  start = clock();
+  for (uint32_t i = 0U; i < n_ports; ++i) {
+    snprintf(symbol, sizeof(symbol), "control_%u", i);
+    if (control_scan(&controls, symbol) != controls.controls[i]) {
+      free_controls(&controls);
+      return fprintf(stderr, "error: Failed to scan for control %u\n", i);
+    }
+  }
+
+  const double scan_time = control_elapsed(start);
+
+  // Look up every control by port index or property
+  start = clock();
+  for (uint32_t i = 0U; i < n_ports; ++i) {
+    const Control* const control = controls.controls[i];
+    const Control* const found =
+      (control->type == PORT)
+        ? get_port_control(&controls, control->id.index)
+        : get_property_control(&controls, control->id.property);
+
+    if (found != control || get_port_control(&controls, 2U * i)) {
+      free_controls(&controls);
+      return fprintf(stderr, "error: Failed to find control %u by ID\n", i);
+    }
+  }
+
+  const double id_time = control_elapsed(start);
+
+  fprintf(stderr,
+          "Found %u controls by symbol in %.6f s (%.6f s scanning), "
+          "by ID in %.6f s\n",
+          n_ports,
+          symbol_time,
+          scan_time,
+          id_time);
+
+  free_controls(&controls);
+  return 0;
+}
+
+int
+main(void)
+{
+  LilvWorld* const world = lilv_world_new();
+  const int        st    = control_bench(world, 4096U);
+
+  lilv_world_free(world);
+  return st;
+}
+
+#endif // CONTROL_STANDALONE
@@ -1,4 +1,4 @@
-// Copyright 2007-2025 David Robillard <d@drobilla.net>
+// Copyright 2007-2026 David Robillard <d@drobilla.net>
 // SPDX-License-Identifier: ISC
 
 #ifndef JALV_CONTROL_H
@@ -7,6 +7,7 @@
 #include "any_value.h"
 #include "attributes.h"
 #include "nodes.h"
+#include "symap.h"
 
 #include <lilv/lilv.h>
 #include <lv2/atom/forge.h>
@@ -58,10 +59,21 @@ typedef struct {
   bool        is_hidden;      ///< Hidden from UI
 } Control;
 
-/// Set of plugin controls
+/**
+   Set of plugin controls.
+
+   Controls are indexed by symbol, port index, and property, so that lookups
+   take constant time regardless of how many controls the plugin has.
+*/
 typedef struct {
-  size_t    n_controls;
-  Control** controls;
+  size_t    n_controls;   ///< Number of controls
+  Control** controls;     ///< Array of all controls in order of addition
+  Symap*    symbols;      ///< Control symbols, mapped to IDs for by_symbol
+  Control** by_symbol;    ///< Controls indexed by symbol ID minus one
+  Control** by_port;      ///< Port controls indexed by port index
+  Control** by_property;  ///< Property controls indexed by property URID
+  uint32_t  n_ports;      ///< Size of by_port
+  uint32_t  n_properties; ///< Size of by_property
 } Controls;
 
 /// Create a new control for a control port
@@ -89,6 +101,10 @@ free_control(Control* control);
 void
 add_control(Controls* controls, Control* control);
 
+/// Free all the controls in a set and its indexes
+void
+free_controls(Controls* controls);
+
 /// Return a pointer to the control with the given symbol, or null
 Control*
 get_named_control(const Controls* controls, const char* symbol);
@@ -0,0 +1,376 @@
+// Copyright 2026 David Robillard <d@drobilla.net>
+// SPDX-License-Identifier: ISC
+
+#include "backend.h"
+
+#include "atomic.h"
+#include "buffers.h"
+#include "clock.h"
+#include "log.h"
+#include "lv2_evbuf.h"
+#include "options.h"
+#include "process.h"
+#include "settings.h"
+#include "traffic.h"
+#include "types.h"
+#include "urids.h"
+#include "wakeup.h"
+
+#include <lv2/urid/urid.h>
+#include <zix/attributes.h>
+#include <zix/sem.h>
+#include <zix/thread.h>
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/// Sample rate used if no explicit rate is given
+#define DUMMY_DEFAULT_SAMPLE_RATE 48000.0f
+
+/// Timing statistics for process cycles
+typedef struct {
+  uint64_t n_cycles; ///< Number of cycles run
+  uint64_t total_ns; ///< Total time spent processing
+  uint64_t min_ns;   ///< Shortest cycle time
+  uint64_t max_ns;   ///< Longest cycle time
+  uint64_t n_late;   ///< Number of cycles that missed their deadline
+} CycleStats;
+
+struct JalvBackendImpl {
+  const JalvLog* log;          ///< Log for reporting statistics
+  JalvProcess*   process;      ///< Process thread state
+  ZixSem*        done;         ///< Finished semaphore
+  ZixThread      thread;       ///< Process thread
+  float**        in_bufs;      ///< Buffers for audio inputs (silence)
+  float**        out_bufs;     ///< Buffers for audio outputs (discarded)
+  uint32_t       n_audio_in;   ///< Number of audio inputs
+  uint32_t       n_audio_out;  ///< Number of audio outputs
+  uint32_t       block_length; ///< Frames processed per cycle
+  float          sample_rate;  ///< Sample rate in Hz
+  uint64_t       period_ns;    ///< Duration of one cycle in nanoseconds
+  uint64_t       length;       ///< Frames to process, or zero to run forever
+  uint64_t       frame;        ///< Current position in frames
+  CycleStats     stats;        ///< Cycle timing statistics
+  bool           free_running; ///< Run as fast as possible without pacing
+  bool           launched;     ///< Process thread is running
+  uint32_t       exit;         ///< Process thread exit requested (atomic)
+};
+
+static void
+process_silent(JalvBackend* const backend, const uint32_t nframes)
+{
+  for (uint32_t i = 0U; i < backend->n_audio_out; ++i) {
+    memset(backend->out_bufs[i], 0, nframes * sizeof(float));
+  }
+
+  jalv_bypass(backend->process, nframes);
+}
+
+static void
+process_cycle(JalvBackend* const backend, const uint32_t nframes)
+{
+  JalvProcess* const proc = backend->process;
+
+  jalv_process_begin_cycle(proc);
+  jalv_process_run_timeline(proc, nframes);
+  jalv_process_end_stage(proc, JALV_STAGE_TRANSPORT);
+
+  // Prepare ports
+  const JalvPortLists* const lists = &proc->port_lists;
+  for (uint32_t i = 0U; i < lists->event_outputs.n_indices; ++i) {
+    const uint32_t p = lists->event_outputs.indices[i];
+    lv2_evbuf_reset(proc->ports[p].evbuf, false);
+  }
+
+  // Run plugin for this cycle
+  const JalvProcessStatus pst = jalv_run(proc, nframes);
+
+  // Finish ports
+  for (uint32_t i = 0U; i < lists->event_inputs.n_indices; ++i) {
+    const uint32_t p = lists->event_inputs.indices[i];
+    lv2_evbuf_reset(proc->ports[p].evbuf, true);
+  }
+
+  for (uint32_t e = 0U; e < lists->event_outputs.n_indices; ++e) {
+    const uint32_t p = lists->event_outputs.indices[e];
+    for (LV2_Evbuf_Iterator i = lv2_evbuf_begin(proc->ports[p].evbuf);
+         lv2_evbuf_is_valid(i);
+         i = lv2_evbuf_next(i)) {
+      // Get event from LV2 buffer
+      uint32_t frames    = 0U;
+      uint32_t subframes = 0U;
+      LV2_URID type      = 0U;
+      uint32_t size      = 0U;
+      void*    body      = NULL;
+      lv2_evbuf_get(i, &frames, &subframes, &type, &size, &body);
+
+      // Forward event to UI
+      jalv_process_send_event(proc, p, size, type, body);
+    }
+  }
+
+  if (pst == JALV_PROCESS_SEND_UPDATES) {
+    for (uint32_t i = 0U; i < lists->control_outputs.n_indices; ++i) {
+      jalv_process_send_control(proc, lists->control_outputs.indices[i]);
+    }
+  }
+
+  jalv_process_end_cycle(proc, nframes, pst == JALV_PROCESS_SEND_UPDATES);
+}
+
+static void
+update_stats(CycleStats* const stats, const uint64_t elapsed, const bool late)
+{
+  if (!stats->n_cycles || elapsed < stats->min_ns) {
+    stats->min_ns = elapsed;
+  }
+
+  if (elapsed > stats->max_ns) {
+    stats->max_ns = elapsed;
+  }
+
+  stats->total_ns += elapsed;
+  stats->n_late += late;
+  ++stats->n_cycles;
+}
+
+static ZixThreadResult ZIX_THREAD_FUNC
+process_func(void* const data)
+{
+  JalvBackend* const backend  = (JalvBackend*)data;
+  JalvProcess* const proc     = backend->process;
+  const uint32_t     nframes  = backend->block_length;
+  uint64_t           deadline = jalv_clock_now() + backend->period_ns;
+
+  while (!jalv_atomic_load(&backend->exit) &&
+         (!backend->length || backend->frame < backend->length)) {
+    const uint64_t start = jalv_clock_now();
+
+    // Process a cycle, emitting silence if execution is paused
+    const bool paused = proc->run_state == JALV_PAUSED;
+    if (paused) {
+      process_silent(backend, nframes);
+    } else {
+      process_cycle(backend, nframes);
+    }
+
+    const uint64_t end = jalv_clock_now();
+    if (!paused) {
+      const bool late = !backend->free_running && end > deadline;
+      update_stats(&backend->stats, end - start, late);
+      if (late) {
+        jalv_process_xrun(proc);
+      }
+    }
+
+    backend->frame += nframes;
+
+    // Wait for the next cycle, dropping missed deadlines like a real device
+    if (paused || !backend->free_running) {
+      if (end > deadline) {
+        deadline = end;
+      }
+
+      jalv_clock_sleep_until(deadline);
+      deadline += backend->period_ns;
+    }
+  }
+
+  if (!jalv_atomic_load(&backend->exit)) {
+    zix_sem_post(backend->done);
+    jalv_wakeup_signal(&backend->process->ui_wakeup);
+  }
+
+  return ZIX_THREAD_RESULT;
+}
+
+static void
+log_stats(const JalvBackend* const backend)
+{
+  const CycleStats* const stats = &backend->stats;
+  if (!stats->n_cycles) {
+    return;
+  }
+
+  const double period_us = (double)backend->period_ns / 1000.0;
+  const double mean_us =
+    (double)stats->total_ns / (double)stats->n_cycles / 1000.0;
+  const double min_us = (double)stats->min_ns / 1000.0;
+  const double max_us = (double)stats->max_ns / 1000.0;
+
+  jalv_log(backend->log,
+           JALV_LOG_INFO,
+           "Cycles: %" PRIu64 " of %u frames (%.1f us), %" PRIu64 " late",
+           stats->n_cycles,
+           backend->block_length,
+           period_us,
+           stats->n_late);
+  jalv_log(backend->log,
+           JALV_LOG_INFO,
+           "Cycle time: %.1f us min (%.1f%%), %.1f us mean (%.1f%%), "
+           "%.1f us max (%.1f%%)",
+           min_us,
+           100.0 * min_us / period_us,
+           mean_us,
+           100.0 * mean_us / period_us,
+           max_us,
+           100.0 * max_us / period_us);
+}
+
+JalvBackend*
+jalv_backend_allocate(void)
+{
+  return (JalvBackend*)calloc(1, sizeof(JalvBackend));
+}
+
+void
+jalv_backend_free(JalvBackend* const backend)
+{
+  free(backend);
+}
+
+int
+jalv_backend_share(JalvBackend* const ZIX_UNUSED(backend),
+                   JalvBackend* const ZIX_UNUSED(host),
+                   const char* const  ZIX_UNUSED(name))
+{
+  return 1;
+}
+
+int
+jalv_backend_link(JalvBackend* const ZIX_UNUSED(from),
+                  const uint32_t     ZIX_UNUSED(from_index),
+                  JalvBackend* const ZIX_UNUSED(to),
+                  const uint32_t     ZIX_UNUSED(to_index))
+{
+  return 1;
+}
+
+int
+jalv_backend_prepare_graph(JalvBackend* const ZIX_UNUSED(backend),
+                           const uint32_t     ZIX_UNUSED(n_threads))
+{
+  return 1;
+}
+
+int
+jalv_backend_open(JalvBackend* const       backend,
+                  const JalvLog* const     log,
+                  const JalvURIDs* const   ZIX_UNUSED(urids),
+                  JalvSettings* const      settings,
+                  JalvProcess* const       proc,
+                  ZixSem* const            done,
+                  const JalvOptions* const opts)
+{
+  backend->log          = log;
+  backend->process      = proc;
+  backend->done         = done;
+  backend->free_running = opts->free_running;
+
+  // Count audio ports
+  for (uint32_t i = 0U; i < proc->num_ports; ++i) {
+    const JalvProcessPort* const port = &proc->ports[i];
+    if (port->type == TYPE_AUDIO || port->type == TYPE_CV) {
+      if (port->flow == FLOW_INPUT) {
+        ++backend->n_audio_in;
+      } else if (port->flow == FLOW_OUTPUT) {
+        ++backend->n_audio_out;
+      }
+    }
+  }
+
+  // Set audio parameters
+  settings->sample_rate      = opts->sample_rate > 0.0
+                                 ? (float)opts->sample_rate
+                                 : DUMMY_DEFAULT_SAMPLE_RATE;
+  settings->max_block_length = settings->max_block_length
+                                 ? settings->max_block_length
+                                 : JALV_DEFAULT_BLOCK_LENGTH;
+  settings->min_block_length = settings->max_block_length;
+  settings->midi_buf_size    = 4096U;
+  settings->offline          = backend->free_running;
+
+  backend->block_length = settings->max_block_length;
+  backend->sample_rate  = settings->sample_rate;
+  backend->period_ns =
+    (uint64_t)(1000000000.0 * backend->block_length / backend->sample_rate);
+  backend->length = opts->duration > 0.0
+                      ? (uint64_t)(opts->duration * backend->sample_rate)
+                      : 0U;
+
+  // Stop after replaying every message, then the duration (quickly if unpaced)
+  if (proc->replay) {
+    backend->length += jalv_replay_end(proc->replay);
+  }
+
+  // Allocate audio buffers which are connected but never read or written
+  const uint32_t nframes = backend->block_length;
+  backend->in_bufs       = jalv_buffers_new(backend->n_audio_in, nframes);
+  backend->out_bufs      = jalv_buffers_new(backend->n_audio_out, nframes);
+  if (!backend->in_bufs || !backend->out_bufs) {
+    jalv_log(log, JALV_LOG_ERR, "Failed to allocate audio buffers");
+    return 1;
+  }
+
+  jalv_log(log,
+           JALV_LOG_INFO,
+           "Dummy clock: %s",
+           backend->free_running ? "free-running" : "paced");
+  return 0;
+}
+
+void
+jalv_backend_close(JalvBackend* const backend)
+{
+  if (backend) {
+    jalv_buffers_free(backend->in_bufs, backend->n_audio_in);
+    jalv_buffers_free(backend->out_bufs, backend->n_audio_out);
+    backend->in_bufs  = NULL;
+    backend->out_bufs = NULL;
+  }
+}
+
+void
+jalv_backend_activate(JalvBackend* const backend)
+{
+  if (backend->launched) {
+    return;
+  }
+
+  jalv_atomic_store(&backend->exit, 0U);
+  if (zix_thread_create(&backend->thread, 1048576U, process_func, backend)) {
+    jalv_log(backend->log, JALV_LOG_ERR, "Failed to launch process thread");
+    return;
+  }
+
+  backend->launched = true;
+}
+
+void
+jalv_backend_deactivate(JalvBackend* const backend)
+{
+  if (!backend->launched) {
+    return;
+  }
+
+  jalv_atomic_store(&backend->exit, 1U);
+  zix_thread_join(backend->thread);
+  backend->launched = false;
+  log_stats(backend);
+}
+
+void
+jalv_backend_activate_port(JalvBackend* const backend,
+                           JalvProcess* const proc,
+                           const uint32_t     port_index)
+{
+  jalv_buffers_connect_port(
+    proc, port_index, backend->in_bufs, backend->out_bufs);
+}
+
+void
+jalv_backend_recompute_latencies(JalvBackend* const ZIX_UNUSED(backend))
+{}
@@ -1,50 +1,307 @@
-// Copyright 2012-2024 David Robillard <d@drobilla.net>
+// Copyright 2012-2026 David Robillard <d@drobilla.net>
 // SPDX-License-Identifier: ISC
 
 #include "dumper.h"
 
+#include "atomic.h"
+#include "clock.h"
+#include "comm.h"
 #include "log.h"
+#include "string_utils.h"
 
 #include <lilv/lilv.h>
 #include <lv2/atom/atom.h>
+#include <lv2/atom/util.h>
 #include <lv2/patch/patch.h>
 #include <lv2/time/time.h>
 #include <lv2/urid/urid.h>
 #include <serd/serd.h>
 #include <sratom/sratom.h>
+#include <zix/ring.h>
+#include <zix/sem.h>
+#include <zix/status.h>
+#include <zix/thread.h>
 
+#include <errno.h>
+#include <stdbool.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+/// Size of the ring of atoms waiting to be written in bytes
+#define DUMP_RING_SIZE (1U << 20U)
+
+/// Magic bytes at the start of a capture file
+#define CAPTURE_MAGIC "jalvdump"
+
+/// Size of the magic bytes at the start of a capture file
+#define CAPTURE_MAGIC_SIZE 8U
+
+/// Kind of a record in a capture file
+typedef enum {
+  CAPTURE_URI     = 1U, ///< A URID (uint32_t) then a null-terminated URI
+  CAPTURE_ATOM    = 2U, ///< A DumpHeader then the atom body
+  CAPTURE_DROPPED = 3U, ///< Number of atoms dropped here (uint32_t)
+} CaptureKind;
+
+/// Header of a record in a capture file, followed by `size` bytes and padding
+typedef struct {
+  uint32_t kind; ///< CaptureKind
+  uint32_t size; ///< Size of the record body in bytes, excluding padding
+} CaptureHeader;
+
+/// Header of a dumped atom in the ring and capture files, followed by the body
+typedef struct {
+  uint64_t time;       ///< Time since the dumper was created in nanoseconds
+  uint32_t port_index; ///< Index of the port the atom was sent to or from
+  uint32_t direction;  ///< JalvDumpDirection
+  LV2_Atom atom;       ///< Atom header
+} DumpHeader;
 
 struct JalvDumperImpl {
-  LV2_URID_Unmap* unmap;
-  SerdEnv*        env;
-  Sratom*         sratom;
+  LV2_URID_Unmap* unmap;          ///< URID unmap for Turtle and capture URIs
+  SerdEnv*        env;            ///< Environment with prefixes for Turtle
+  Sratom*         sratom;         ///< Atom to Turtle writer
+  ZixRing*        ring;           ///< Atoms waiting to be written
+  ZixSem          sem;            ///< Posted when an atom is dumped or to exit
+  ZixThread       thread;         ///< Thread that writes dumped atoms
+  void*           body;           ///< Buffer for atom bodies in the thread
+  FILE*           capture;        ///< Binary capture file, or null
+  bool            text;           ///< Write atoms as Turtle to stdout
+  uint64_t        start;          ///< Time when the dumper was created
+  uint32_t*       ports;          ///< Indices of ports to dump
+  uint32_t        n_ports;        ///< Number of ports, or zero for all
+  LV2_URID*       types;          ///< Types of atoms to dump
+  uint32_t        n_types;        ///< Number of types, or zero for all
+  uint32_t        n_uris;         ///< Number of URIs written to capture file
+  uint32_t        n_dropped;      ///< Atoms dropped because the ring was full
+  uint32_t        n_dropped_seen; ///< Value of n_dropped last reported
+  uint32_t        exit;           ///< Non-zero when the thread should exit
 };
 
+/// URID map and unmap for reading a capture file
+typedef struct {
+  char**   uris;   ///< URIs indexed by URID - 1, with null gaps
+  uint32_t n_uris; ///< Highest URID
+} CaptureMap;
+
+static SerdEnv*
+new_env(void)
+{
+  SerdEnv* const env = serd_env_new(NULL);
+  if (env) {
+    serd_env_set_prefix_from_strings(
+      env, (const uint8_t*)"patch", (const uint8_t*)LV2_PATCH_PREFIX);
+    serd_env_set_prefix_from_strings(
+      env, (const uint8_t*)"time", (const uint8_t*)LV2_TIME_PREFIX);
+    serd_env_set_prefix_from_strings(
+      env, (const uint8_t*)"xsd", (const uint8_t*)LILV_NS_XSD);
+  }
+
+  return env;
+}
+
+static void
+print_atom(FILE* const             stream,
+           Sratom* const           sratom,
+           LV2_URID_Unmap* const   unmap,
+           const DumpHeader* const header,
+           const void* const       body)
+{
+  const bool to_ui = header->direction == JALV_DUMP_PLUGIN_TO_UI;
+  char* const str  = sratom_to_turtle(sratom,
+                                     unmap,
+                                     "jalv:",
+                                     NULL,
+                                     NULL,
+                                     header->atom.type,
+                                     header->atom.size,
+                                     body);
+
+  jalv_ansi_start(stream, to_ui ? 35 : 36);
+  fprintf(stream,
+          "\n# %s port %u at %.6f s (%u bytes):\n%s\n",
+          to_ui ? "Plugin => UI" : "UI => Plugin",
+          header->port_index,
+          (double)header->time / 1000000000.0,
+          header->atom.size,
+          str ? str : "");
+  jalv_ansi_reset(stream);
+  free(str);
+}
+
+/// Write a record to the capture file, closing it on error
+static void
+capture_record(JalvDumper* const dumper,
+               const CaptureKind kind,
+               const void* const head,
+               const uint32_t    head_size,
+               const void* const body,
+               const uint32_t    body_size)
+{
+  static const uint8_t zeros[8] = {0U, 0U, 0U, 0U, 0U, 0U, 0U, 0U};
+  if (!dumper->capture) {
+    return;
+  }
+
+  FILE* const         file    = dumper->capture;
+  const uint32_t      size    = head_size + body_size;
+  const uint32_t      padding = lv2_atom_pad_size(size) - size;
+  const CaptureHeader header  = {(uint32_t)kind, size};
+
+  if (fwrite(&header, sizeof(header), 1U, file) != 1U ||
+      fwrite(head, 1U, head_size, file) != head_size ||
+      (body_size && fwrite(body, 1U, body_size, file) != body_size) ||
+      (padding && fwrite(zeros, 1U, padding, file) != padding)) {
+    fprintf(stderr, "error: Failed to write capture (%s)\n", strerror(errno));
+    fclose(file);
+    dumper->capture = NULL;
+  }
+}
+
+/// Write any URIs mapped since the last call to the capture file
+static void
+capture_uris(JalvDumper* const dumper)
+{
+  const LV2_URID_Unmap* const unmap = dumper->unmap;
+
+  const char* uri = NULL;
+  while (dumper->capture &&
+         (uri = unmap->unmap(unmap->handle, dumper->n_uris + 1U))) {
+    const uint32_t id = ++dumper->n_uris;
+    capture_record(
+      dumper, CAPTURE_URI, &id, sizeof(id), uri, (uint32_t)strlen(uri) + 1U);
+  }
+}
+
+/// Write all atoms in the ring and report any that were dropped
+static void
+dump_drain(JalvDumper* const dumper)
+{
+  DumpHeader header = {0U, 0U, 0U, {0U, 0U}};
+  while (zix_ring_read(dumper->ring, &header, sizeof(header)) ==
+         sizeof(header)) {
+    const uint32_t size = header.atom.size;
+    if (zix_ring_read(dumper->ring, dumper->body, size) != size) {
+      break; // Corrupt ring, which should never happen
+    }
+
+    if (dumper->text) {
+      print_atom(stdout, dumper->sratom, dumper->unmap, &header, dumper->body);
+    }
+
+    if (dumper->capture) {
+      capture_uris(dumper);
+      capture_record(
+        dumper, CAPTURE_ATOM, &header, sizeof(header), dumper->body, size);
+    }
+  }
+
+  const uint32_t n_dropped = jalv_atomic_load(&dumper->n_dropped);
+  if (n_dropped != dumper->n_dropped_seen) {
+    const uint32_t count = n_dropped - dumper->n_dropped_seen;
+    if (dumper->text) {
+      printf("\n# Dropped %u atoms (dump ring full)\n", count);
+    }
+
+    capture_record(dumper, CAPTURE_DROPPED, &count, sizeof(count), NULL, 0U);
+
+    dumper->n_dropped_seen = n_dropped;
+  }
+
+  if (dumper->text) {
+    fflush(stdout);
+  }
+
+  if (dumper->capture) {
+    fflush(dumper->capture);
+  }
+}
+
+static ZixThreadResult ZIX_THREAD_FUNC
+dump_func(void* const data)
+{
+  JalvDumper* const dumper = (JalvDumper*)data;
+
+  bool exit = false;
+  while (!exit) {
+    zix_sem_wait(&dumper->sem);
+    exit = jalv_atomic_load(&dumper->exit);
+    dump_drain(dumper);
+  }
+
+  return ZIX_THREAD_RESULT;
+}
+
+/// Free everything in a dumper except the thread
+static void
+free_resources(JalvDumper* const dumper)
+{
+  if (dumper->capture) {
+    fclose(dumper->capture);
+  }
+
+  free(dumper->types);
+  free(dumper->ports);
+  free(dumper->body);
+  zix_ring_free(dumper->ring);
+  sratom_free(dumper->sratom);
+  serd_env_free(dumper->env);
+  free(dumper);
+}
+
+/// Open a capture file and write the file header
+static FILE*
+open_capture(const char* const path)
+{
+  FILE* const file = fopen(path, "wb");
+  if (!file) {
+    fprintf(stderr, "error: Failed to open %s (%s)\n", path, strerror(errno));
+    return NULL;
+  }
+
+  if (fwrite(CAPTURE_MAGIC, 1U, CAPTURE_MAGIC_SIZE, file) !=
+      CAPTURE_MAGIC_SIZE) {
+    fprintf(stderr, "error: Failed to write %s (%s)\n", path, strerror(errno));
+    fclose(file);
+    return NULL;
+  }
+
+  return file;
+}
+
 JalvDumper*
-jalv_dumper_new(LV2_URID_Map* const map, LV2_URID_Unmap* const unmap)
+jalv_dumper_new(LV2_URID_Map* const   map,
+                LV2_URID_Unmap* const unmap,
+                const bool            text,
+                const char* const     capture_path)
 {
   JalvDumper* const dumper = (JalvDumper*)calloc(1, sizeof(JalvDumper));
-  SerdEnv* const    env    = serd_env_new(NULL);
-  Sratom* const     sratom = sratom_new(map);
-  if (!dumper || !env || !sratom) {
-    jalv_dumper_free(dumper);
+  if (!dumper) {
     return NULL;
   }
 
-  serd_env_set_prefix_from_strings(
-    env, (const uint8_t*)"patch", (const uint8_t*)LV2_PATCH_PREFIX);
-  serd_env_set_prefix_from_strings(
-    env, (const uint8_t*)"time", (const uint8_t*)LV2_TIME_PREFIX);
-  serd_env_set_prefix_from_strings(
-    env, (const uint8_t*)"xsd", (const uint8_t*)LILV_NS_XSD);
+  dumper->unmap = unmap;
+  dumper->text  = text;
+  dumper->start = jalv_clock_now();
+  if (!(dumper->env = new_env()) || !(dumper->sratom = sratom_new(map)) ||
+      !(dumper->ring = zix_ring_new(NULL, DUMP_RING_SIZE)) ||
+      !(dumper->body = malloc(DUMP_RING_SIZE)) ||
+      (capture_path && !(dumper->capture = open_capture(capture_path)))) {
+    free_resources(dumper);
+    return NULL;
+  }
 
-  sratom_set_env(sratom, env);
+  sratom_set_env(dumper->sratom, dumper->env);
+
+  zix_sem_init(&dumper->sem, 0U);
+  if (zix_thread_create(&dumper->thread, 262144U, dump_func, dumper)) {
+    zix_sem_destroy(&dumper->sem);
+    free_resources(dumper);
+    return NULL;
+  }
 
-  dumper->env    = env;
-  dumper->sratom = sratom;
-  dumper->unmap  = unmap;
   return dumper;
 }
 
@@ -52,32 +309,233 @@ void
 jalv_dumper_free(JalvDumper* const dumper)
 {
   if (dumper) {
-    sratom_free(dumper->sratom);
-    serd_env_free(dumper->env);
-    free(dumper);
+    jalv_atomic_store(&dumper->exit, 1U);
+    zix_sem_post(&dumper->sem);
+    zix_thread_join(dumper->thread);
+    zix_sem_destroy(&dumper->sem);
+    free_resources(dumper);
+  }
+}
+
+static int
+append_id(uint32_t** const array, uint32_t* const n, const uint32_t id)
+{
+  uint32_t* const ids = (uint32_t*)realloc(*array, (*n + 1U) * sizeof(id));
+  if (!ids) {
+    return 1;
   }
+
+  ids[(*n)++] = id;
+  *array      = ids;
+  return 0;
+}
+
+static bool
+contains_id(const uint32_t* const array, const uint32_t n, const uint32_t id)
+{
+  for (uint32_t i = 0U; i < n; ++i) {
+    if (array[i] == id) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+int
+jalv_dumper_filter_port(JalvDumper* const dumper, const uint32_t port_index)
+{
+  return append_id(&dumper->ports, &dumper->n_ports, port_index);
+}
+
+int
+jalv_dumper_filter_type(JalvDumper* const dumper, const LV2_URID type)
+{
+  return append_id(&dumper->types, &dumper->n_types, type);
 }
 
 void
-jalv_dump_atom(JalvDumper* const     dumper,
-               FILE* const           stream,
-               const char* const     label,
-               const LV2_Atom* const atom,
-               const int             color)
+jalv_dump_atom(JalvDumper* const       dumper,
+               const JalvDumpDirection direction,
+               const uint32_t          port_index,
+               const LV2_Atom* const   atom)
 {
-  if (dumper) {
-    char* const str = sratom_to_turtle(dumper->sratom,
-                                       dumper->unmap,
-                                       "jalv:",
-                                       NULL,
-                                       NULL,
-                                       atom->type,
-                                       atom->size,
-                                       LV2_ATOM_BODY_CONST(atom));
-
-    jalv_ansi_start(stream, color);
-    fprintf(stream, "\n# %s (%u bytes):\n%s\n", label, atom->size, str);
-    jalv_ansi_reset(stream);
-    free(str);
+  if (!dumper ||
+      (dumper->n_ports &&
+       !contains_id(dumper->ports, dumper->n_ports, port_index)) ||
+      (dumper->n_types &&
+       !contains_id(dumper->types, dumper->n_types, atom->type))) {
+    return;
+  }
+
+  const DumpHeader header = {
+    jalv_clock_now() - dumper->start, port_index, (uint32_t)direction, *atom};
+
+  if (jalv_write_split_message(
+        dumper->ring, &header, sizeof(header), atom + 1U, atom->size)) {
+    jalv_atomic_store(&dumper->n_dropped, dumper->n_dropped + 1U);
+    return;
+  }
+
+  zix_sem_post(&dumper->sem);
+}
+
+static LV2_URID
+capture_map_uri(LV2_URID_Map_Handle handle, const char* const uri)
+{
+  CaptureMap* const map = (CaptureMap*)handle;
+  for (uint32_t i = 0U; i < map->n_uris; ++i) {
+    if (map->uris[i] && !strcmp(map->uris[i], uri)) {
+      return i + 1U;
+    }
+  }
+
+  // Map URIs that weren't used when capturing to new URIDs
+  char** const uris =
+    (char**)realloc(map->uris, (map->n_uris + 1U) * sizeof(char*));
+  if (!uris) {
+    return 0U;
   }
+
+  map->uris                = uris;
+  map->uris[map->n_uris++] = jalv_strdup(uri);
+  return map->n_uris;
+}
+
+static const char*
+capture_unmap_uri(LV2_URID_Unmap_Handle handle, const LV2_URID urid)
+{
+  const CaptureMap* const map = (const CaptureMap*)handle;
+
+  return (urid && urid <= map->n_uris) ? map->uris[urid - 1U] : NULL;
+}
+
+/// Set the URI of a URID read from a capture file
+static ZixStatus
+capture_map_set(CaptureMap* const map, const LV2_URID id, const char* const uri)
+{
+  if (id > map->n_uris) {
+    char** const uris = (char**)realloc(map->uris, id * sizeof(char*));
+    if (!uris) {
+      return ZIX_STATUS_NO_MEM;
+    }
+
+    memset(uris + map->n_uris, 0, (id - map->n_uris) * sizeof(char*));
+    map->uris   = uris;
+    map->n_uris = id;
+  }
+
+  free(map->uris[id - 1U]);
+  map->uris[id - 1U] = jalv_strdup(uri);
+  return map->uris[id - 1U] ? ZIX_STATUS_SUCCESS : ZIX_STATUS_NO_MEM;
+}
+
+/// Handle a record read from a capture file
+static ZixStatus
+convert_record(FILE* const                stream,
+               CaptureMap* const          map,
+               LV2_URID_Map* const        lv2_map,
+               LV2_URID_Unmap* const      lv2_unmap,
+               Sratom** const             sratom,
+               SerdEnv* const             env,
+               const CaptureHeader* const record,
+               const void* const          body)
+{
+  if (record->kind == CAPTURE_URI) {
+    const char* const uri = (const char*)body + sizeof(uint32_t);
+    uint32_t          id  = 0U;
+    memcpy(&id, body, sizeof(id));
+    return (record->size <= sizeof(id) || !id ||
+            uri[record->size - sizeof(id) - 1U])
+             ? ZIX_STATUS_BAD_ARG
+             : capture_map_set(map, id, uri);
+  }
+
+  if (record->kind == CAPTURE_ATOM) {
+    const DumpHeader* const header = (const DumpHeader*)body;
+    if (record->size < sizeof(DumpHeader) ||
+        header->atom.size > record->size - sizeof(DumpHeader)) {
+      return ZIX_STATUS_BAD_ARG;
+    }
+
+    // Create the writer when every URI it maps has been read
+    if (!*sratom) {
+      if (!(*sratom = sratom_new(lv2_map))) {
+        return ZIX_STATUS_NO_MEM;
+      }
+
+      sratom_set_env(*sratom, env);
+    }
+
+    print_atom(stream, *sratom, lv2_unmap, header, header + 1U);
+  } else if (record->kind == CAPTURE_DROPPED &&
+             record->size == sizeof(uint32_t)) {
+    uint32_t count = 0U;
+    memcpy(&count, body, sizeof(count));
+    fprintf(stream, "\n# Dropped %u atoms (dump ring full)\n", count);
+  }
+
+  return ZIX_STATUS_SUCCESS;
+}
+
+ZixStatus
+jalv_dump_convert(const char* const path, FILE* const stream)
+{
+  FILE* const file = fopen(path, "rb");
+  if (!file) {
+    return ZIX_STATUS_NOT_FOUND;
+  }
+
+  char      magic[CAPTURE_MAGIC_SIZE];
+  ZixStatus st = ZIX_STATUS_SUCCESS;
+  if (fread(magic, 1U, sizeof(magic), file) != sizeof(magic) ||
+      memcmp(magic, CAPTURE_MAGIC, sizeof(magic))) {
+    fclose(file);
+    return ZIX_STATUS_BAD_ARG;
+  }
+
+  CaptureMap     map       = {NULL, 0U};
+  LV2_URID_Map   lv2_map   = {&map, capture_map_uri};
+  LV2_URID_Unmap lv2_unmap = {&map, capture_unmap_uri};
+  SerdEnv* const env       = new_env();
+  Sratom*        sratom    = NULL;
+  uint64_t*      buf       = NULL;
+  uint32_t       buf_size  = 0U;
+  CaptureHeader  record    = {0U, 0U};
+  if (!env) {
+    st = ZIX_STATUS_NO_MEM;
+  }
+
+  // Read records until the end, which may be cut off if jalv didn't exit
+  while (!st && fread(&record, sizeof(record), 1U, file) == 1U) {
+    const uint32_t padded = lv2_atom_pad_size(record.size);
+    if (padded > buf_size) {
+      uint64_t* const new_buf = (uint64_t*)realloc(buf, padded);
+      if (!new_buf) {
+        st = ZIX_STATUS_NO_MEM;
+        break;
+      }
+
+      buf      = new_buf;
+      buf_size = padded;
+    }
+
+    if (fread(buf, 1U, padded, file) != padded) {
+      break;
+    }
+
+    st = convert_record(
+      stream, &map, &lv2_map, &lv2_unmap, &sratom, env, &record, buf);
+  }
+
+  for (uint32_t i = 0U; i < map.n_uris; ++i) {
+    free(map.uris[i]);
+  }
+
+  free(map.uris);
+  free(buf);
+  sratom_free(sratom);
+  serd_env_free(env);
+  fclose(file);
+  return st;
 }
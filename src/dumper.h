@@ -1,4 +1,4 @@
-// Copyright 2012-2024 David Robillard <d@drobilla.net>
+// Copyright 2012-2026 David Robillard <d@drobilla.net>
 // SPDX-License-Identifier: ISC
 
 #ifndef JALV_DUMPER_H
@@ -8,30 +8,98 @@
 
 #include <lv2/atom/atom.h>
 #include <lv2/urid/urid.h>
+#include <zix/status.h>
 
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 
 // LV2 atom dumper
 JALV_BEGIN_DECLS
 
-/// Dumper for writing atoms as Turtle for debugging
+/// Direction of a dumped atom between the plugin and UI
+typedef enum {
+  JALV_DUMP_UI_TO_PLUGIN, ///< Sent from the UI to a plugin input
+  JALV_DUMP_PLUGIN_TO_UI, ///< Sent from a plugin output to the UI
+} JalvDumpDirection;
+
+/**
+   Dumper for writing atoms as Turtle for debugging.
+
+   Dumping an atom only copies it into a ring, a background thread does the
+   (slow) work of writing it, so dumping doesn't hold up communication.  Atoms
+   can be written as Turtle to stdout, and/or to a binary capture file that can
+   be converted to Turtle later with jalv_dump_convert().
+
+   A capture file starts with the 8 bytes "jalvdump", followed by records which
+   each start with a 32-bit kind and size, and are padded to 64 bits.  Records
+   are either a URI with its URID, an atom with the time, port index, and
+   direction, or a count of dropped atoms.  URIs are written before any atom
+   that might use them, so a file can be converted even if it was truncated.
+   All numbers are in the native byte order.
+*/
 typedef struct JalvDumperImpl JalvDumper;
 
-/// Allocate, configure, and return a new atom dumper
+/**
+   Allocate, configure, and return a new atom dumper.
+
+   @param map URID map, used to write atoms as Turtle.
+   @param unmap URID unmap, used to write atoms and URIs in capture files.
+   @param text Write atoms as Turtle to stdout.
+   @param capture_path Path of a binary capture file to write, or null.
+   @return A new dumper with a running thread, or null on error.
+*/
 JalvDumper*
-jalv_dumper_new(LV2_URID_Map* map, LV2_URID_Unmap* unmap);
+jalv_dumper_new(LV2_URID_Map*   map,
+                LV2_URID_Unmap* unmap,
+                bool            text,
+                const char*     capture_path);
 
-/// Free memory allocated by jalv_init_dumper()
+/// Free memory allocated by jalv_dumper_new() after writing everything dumped
 void
 jalv_dumper_free(JalvDumper* dumper);
 
-/// Dump an atom to stdout
+/**
+   Only dump atoms for the given port (and any others added).
+
+   This must be called before dumping starts.
+
+   @return Zero on success, or non-zero if allocation failed.
+*/
+int
+jalv_dumper_filter_port(JalvDumper* dumper, uint32_t port_index);
+
+/**
+   Only dump atoms with the given type (and any others added).
+
+   This must be called before dumping starts.
+
+   @return Zero on success, or non-zero if allocation failed.
+*/
+int
+jalv_dumper_filter_type(JalvDumper* dumper, LV2_URID type);
+
+/**
+   Dump an atom sent between the plugin and UI.
+
+   This doesn't block, atoms are counted and dropped if the dumper falls too
+   far behind.  Only one thread may dump atoms at a time.
+*/
 void
-jalv_dump_atom(JalvDumper*     dumper,
-               FILE*           stream,
-               const char*     label,
-               const LV2_Atom* atom,
-               int             color);
+jalv_dump_atom(JalvDumper*       dumper,
+               JalvDumpDirection direction,
+               uint32_t          port_index,
+               const LV2_Atom*   atom);
+
+/**
+   Convert a binary capture file to Turtle.
+
+   @param path Path of a capture file written by a dumper.
+   @param stream Stream to write Turtle to.
+   @return Zero on success, or an error if the file couldn't be read.
+*/
+ZixStatus
+jalv_dump_convert(const char* path, FILE* stream);
 
 JALV_END_DECLS
 
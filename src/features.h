@@ -1,4 +1,4 @@
-// Copyright 2018-2024 David Robillard <d@drobilla.net>
+// Copyright 2018-2026 David Robillard <d@drobilla.net>
 // SPDX-License-Identifier: ISC
 
 #ifndef JALV_FEATURES_H
@@ -29,6 +29,8 @@ typedef struct {
   LV2_Feature                make_path_feature;
   LV2_Worker_Schedule        sched;
   LV2_Feature                sched_feature;
+  LV2_Worker_Schedule        shadow_sched;
+  LV2_Feature                shadow_sched_feature;
   LV2_Worker_Schedule        ssched;
   LV2_Feature                state_sched_feature;
   LV2_Log_Log                llog;
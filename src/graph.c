@@ -0,0 +1,421 @@
+// Copyright 2026 David Robillard <d@drobilla.net>
+// SPDX-License-Identifier: ISC
+
+#include "graph.h"
+
+#include "atomic.h"
+
+#include <zix/attributes.h>
+#include <zix/sem.h>
+#include <zix/status.h>
+#include <zix/thread.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#define NO_NODE UINT32_MAX ///< Sentinel for no node
+
+/// Plugins run in helper threads, so give them a typical stack size
+#define HELPER_STACK_SIZE (8U << 20U)
+
+/**
+   A work-stealing deque of nodes that are ready to run.
+
+   This is a Chase-Lev deque with a fixed capacity, which is enough since
+   every node is pushed at most once per cycle.  The owner pushes and takes
+   nodes at the bottom, and other threads steal them from the top.  Indices
+   only ever increase (wrapping around), so a thief with stale indices can't
+   succeed in stealing from a later cycle.
+*/
+typedef struct {
+  uint32_t* nodes;  ///< Ring of node indices
+  uint32_t  mask;   ///< Mask for ring indices (capacity minus one)
+  uint32_t  top;    ///< Index of the oldest node, where others steal
+  uint32_t  bottom; ///< Index after the newest node, where the owner works
+} Deque;
+
+/// A thread that runs nodes, the first is the audio thread
+typedef struct {
+  JalvGraph* graph;  ///< Graph this thread belongs to
+  ZixThread  thread; ///< Thread handle (helpers only)
+  ZixSem     wake;   ///< Posted to start a cycle (helpers only)
+  Deque      deque;  ///< Nodes that are ready to run
+} GraphThread;
+
+struct JalvGraphImpl {
+  JalvGraphRunFunc  run;        ///< Function to run a node
+  JalvGraphInitFunc init;       ///< Function to set up helper threads
+  void*             handle;     ///< Opaque pointer passed to callbacks
+  uint32_t*         edges;      ///< Edges as pairs of node indices
+  uint32_t*         n_preds;    ///< Number of dependencies of each node
+  uint32_t*         pending;    ///< Unfinished dependencies this cycle
+  uint32_t*         succ_start; ///< Start of successors of each node in succs
+  uint32_t*         succs;      ///< Successors of every node, by node
+  uint32_t*         order;      ///< Nodes in topological order, roots first
+  GraphThread*      threads;    ///< Audio thread followed by helper threads
+  uint32_t          n_nodes;    ///< Number of nodes
+  uint32_t          n_edges;    ///< Number of edges
+  uint32_t          n_roots;    ///< Number of nodes with no dependencies
+  uint32_t          n_threads;  ///< Number of threads including audio thread
+  uint32_t          remaining;  ///< Number of nodes to finish this cycle
+  uint32_t          nframes;    ///< Length of the current cycle
+  uint32_t          exit;       ///< Non-zero if helper threads must exit
+};
+
+/// Push a node onto the bottom of a deque (owner only)
+ZIX_REALTIME static void
+deque_push(Deque* const deque, const uint32_t node)
+{
+  const uint32_t b = deque->bottom;
+
+  jalv_atomic_store(&deque->nodes[b & deque->mask], node);
+  jalv_atomic_store(&deque->bottom, b + 1U);
+}
+
+/// Take the newest node from the bottom of a deque (owner only)
+ZIX_REALTIME static uint32_t
+deque_take(Deque* const deque)
+{
+  const uint32_t b = deque->bottom - 1U;
+  jalv_atomic_store(&deque->bottom, b);
+  jalv_atomic_fence();
+
+  const uint32_t t = jalv_atomic_load(&deque->top);
+  if ((int32_t)(b - t) < 0) {
+    jalv_atomic_store(&deque->bottom, t); // Empty
+    return NO_NODE;
+  }
+
+  uint32_t node = jalv_atomic_load(&deque->nodes[b & deque->mask]);
+  if (b == t) {
+    // Last node, so race with thieves for it
+    if (!jalv_atomic_compare_exchange(&deque->top, t, t + 1U)) {
+      node = NO_NODE;
+    }
+
+    jalv_atomic_store(&deque->bottom, t + 1U);
+  }
+
+  return node;
+}
+
+/// Steal the oldest node from the top of a deque (any thread)
+ZIX_REALTIME static uint32_t
+deque_steal(Deque* const deque)
+{
+  const uint32_t t = jalv_atomic_load(&deque->top);
+  jalv_atomic_fence();
+
+  const uint32_t b = jalv_atomic_load(&deque->bottom);
+  if ((int32_t)(b - t) <= 0) {
+    return NO_NODE;
+  }
+
+  const uint32_t node = jalv_atomic_load(&deque->nodes[t & deque->mask]);
+  return jalv_atomic_compare_exchange(&deque->top, t, t + 1U) ? node : NO_NODE;
+}
+
+/// Run a node, then queue any successors that it was the last dependency of
+ZIX_REALTIME static void
+run_node(JalvGraph* const graph, GraphThread* const self, const uint32_t node)
+{
+  graph->run(graph->handle, node, graph->nframes);
+
+  const uint32_t end = graph->succ_start[node + 1U];
+  for (uint32_t i = graph->succ_start[node]; i < end; ++i) {
+    const uint32_t succ = graph->succs[i];
+    if (!jalv_atomic_decrement(&graph->pending[succ])) {
+      deque_push(&self->deque, succ);
+    }
+  }
+
+  jalv_atomic_decrement(&graph->remaining);
+}
+
+/// Run nodes, stealing from other threads if necessary, until the cycle ends
+ZIX_REALTIME static void
+work(JalvGraph* const graph, GraphThread* const self)
+{
+  const uint32_t n_threads = graph->n_threads;
+  const uint32_t index     = (uint32_t)(self - graph->threads);
+
+  while (jalv_atomic_load(&graph->remaining)) {
+    uint32_t node = deque_take(&self->deque);
+    for (uint32_t i = 1U; node == NO_NODE && i < n_threads; ++i) {
+      node = deque_steal(&graph->threads[(index + i) % n_threads].deque);
+    }
+
+    if (node != NO_NODE) {
+      run_node(graph, self, node);
+    }
+  }
+}
+
+static ZixThreadResult ZIX_THREAD_FUNC
+helper_func(void* const data)
+{
+  GraphThread* const thread = (GraphThread*)data;
+  JalvGraph* const   graph  = thread->graph;
+
+  if (graph->init) {
+    graph->init(graph->handle);
+  }
+
+  while (!zix_sem_wait(&thread->wake) && !jalv_atomic_load(&graph->exit)) {
+    work(graph, thread);
+  }
+
+  return ZIX_THREAD_RESULT;
+}
+
+JalvGraph*
+jalv_graph_new(const uint32_t         n_nodes,
+               const JalvGraphRunFunc run,
+               void* const            handle)
+{
+  JalvGraph* const graph = (JalvGraph*)calloc(1, sizeof(JalvGraph));
+  if (!graph) {
+    return NULL;
+  }
+
+  graph->run        = run;
+  graph->handle     = handle;
+  graph->n_nodes    = n_nodes;
+  graph->n_preds    = (uint32_t*)calloc(n_nodes + 1U, sizeof(uint32_t));
+  graph->pending    = (uint32_t*)calloc(n_nodes + 1U, sizeof(uint32_t));
+  graph->succ_start = (uint32_t*)calloc(n_nodes + 1U, sizeof(uint32_t));
+  graph->order      = (uint32_t*)calloc(n_nodes + 1U, sizeof(uint32_t));
+  if (!graph->n_preds || !graph->pending || !graph->succ_start ||
+      !graph->order) {
+    jalv_graph_free(graph);
+    return NULL;
+  }
+
+  return graph;
+}
+
+void
+jalv_graph_free(JalvGraph* const graph)
+{
+  if (graph) {
+    jalv_graph_exit(graph);
+    free(graph->order);
+    free(graph->succs);
+    free(graph->succ_start);
+    free(graph->pending);
+    free(graph->n_preds);
+    free(graph->edges);
+    free(graph);
+  }
+}
+
+ZixStatus
+jalv_graph_add_edge(JalvGraph* const graph,
+                    const uint32_t   from,
+                    const uint32_t   to)
+{
+  if (from >= graph->n_nodes || to >= graph->n_nodes) {
+    return ZIX_STATUS_BAD_ARG;
+  }
+
+  uint32_t* const new_edges = (uint32_t*)realloc(
+    graph->edges, (graph->n_edges + 1U) * 2U * sizeof(uint32_t));
+  if (!new_edges) {
+    return ZIX_STATUS_NO_MEM;
+  }
+
+  const uint32_t e = graph->n_edges++ * 2U;
+
+  graph->edges         = new_edges;
+  graph->edges[e]      = from;
+  graph->edges[e + 1U] = to;
+  return ZIX_STATUS_SUCCESS;
+}
+
+ZixStatus
+jalv_graph_prepare(JalvGraph* const graph)
+{
+  const uint32_t n_nodes = graph->n_nodes;
+  const uint32_t n_edges = graph->n_edges;
+
+  free(graph->succs);
+  if (!(graph->succs = (uint32_t*)calloc(n_edges + 1U, sizeof(uint32_t)))) {
+    return ZIX_STATUS_NO_MEM;
+  }
+
+  // Count the dependencies and successors of each node
+  for (uint32_t i = 0U; i <= n_nodes; ++i) {
+    graph->n_preds[i]    = 0U;
+    graph->succ_start[i] = 0U;
+  }
+
+  for (uint32_t e = 0U; e < n_edges; ++e) {
+    ++graph->succ_start[graph->edges[e * 2U] + 1U];
+    ++graph->n_preds[graph->edges[e * 2U + 1U]];
+  }
+
+  // Lay out successors contiguously by node, using pending as a cursor
+  for (uint32_t i = 0U; i < n_nodes; ++i) {
+    graph->succ_start[i + 1U] += graph->succ_start[i];
+    graph->pending[i] = graph->succ_start[i];
+  }
+
+  for (uint32_t e = 0U; e < n_edges; ++e) {
+    const uint32_t from                  = graph->edges[e * 2U];
+    graph->succs[graph->pending[from]++] = graph->edges[e * 2U + 1U];
+  }
+
+  // Sort topologically, starting with every node that has no dependencies
+  uint32_t n_sorted = 0U;
+  for (uint32_t i = 0U; i < n_nodes; ++i) {
+    graph->pending[i] = graph->n_preds[i];
+    if (!graph->n_preds[i]) {
+      graph->order[n_sorted++] = i;
+    }
+  }
+
+  graph->n_roots = n_sorted;
+  for (uint32_t i = 0U; i < n_sorted; ++i) {
+    const uint32_t node = graph->order[i];
+    const uint32_t end  = graph->succ_start[node + 1U];
+    for (uint32_t s = graph->succ_start[node]; s < end; ++s) {
+      if (!--graph->pending[graph->succs[s]]) {
+        graph->order[n_sorted++] = graph->succs[s];
+      }
+    }
+  }
+
+  // Any nodes that were never ready are part of a cycle
+  return n_sorted == n_nodes ? ZIX_STATUS_SUCCESS : ZIX_STATUS_BAD_ARG;
+}
+
+/// Stop the first `n_helpers` helper threads of a launched graph
+static void
+stop_helpers(JalvGraph* const graph, const uint32_t n_helpers)
+{
+  jalv_atomic_store(&graph->exit, 1U);
+  for (uint32_t i = 1U; i <= n_helpers; ++i) {
+    zix_sem_post(&graph->threads[i].wake);
+  }
+
+  for (uint32_t i = 1U; i <= n_helpers; ++i) {
+    zix_thread_join(graph->threads[i].thread);
+    zix_sem_destroy(&graph->threads[i].wake);
+  }
+}
+
+/// Free the threads of a graph whose helpers are stopped
+static void
+free_threads(JalvGraph* const graph, const uint32_t n_threads)
+{
+  for (uint32_t i = 0U; i < n_threads; ++i) {
+    free(graph->threads[i].deque.nodes);
+  }
+
+  free(graph->threads);
+  graph->threads   = NULL;
+  graph->n_threads = 0U;
+}
+
+ZixStatus
+jalv_graph_launch(JalvGraph* const        graph,
+                  const uint32_t          n_threads,
+                  const JalvGraphInitFunc init)
+{
+  if (graph->threads || n_threads <= 1U || graph->n_nodes <= 1U) {
+    return ZIX_STATUS_SUCCESS; // Already launched or no use for helpers
+  }
+
+  // Size the deque rings to the next power of two that fits every node
+  uint32_t capacity = 1U;
+  while (capacity < graph->n_nodes) {
+    capacity <<= 1U;
+  }
+
+  const uint32_t n = n_threads < graph->n_nodes ? n_threads : graph->n_nodes;
+  if (!(graph->threads = (GraphThread*)calloc(n, sizeof(GraphThread)))) {
+    return ZIX_STATUS_NO_MEM;
+  }
+
+  for (uint32_t i = 0U; i < n; ++i) {
+    GraphThread* const thread = &graph->threads[i];
+    thread->graph             = graph;
+    thread->deque.mask        = capacity - 1U;
+    thread->deque.nodes       = (uint32_t*)calloc(capacity, sizeof(uint32_t));
+    if (!thread->deque.nodes) {
+      free_threads(graph, n);
+      return ZIX_STATUS_NO_MEM;
+    }
+  }
+
+  graph->init = init;
+  graph->exit = 0U;
+
+  // Launch helpers (the first thread is the audio thread that calls run)
+  ZixStatus st        = ZIX_STATUS_SUCCESS;
+  uint32_t  n_helpers = 0U;
+  for (; n_helpers + 1U < n; ++n_helpers) {
+    GraphThread* const thread = &graph->threads[n_helpers + 1U];
+    if ((st = zix_sem_init(&thread->wake, 0U))) {
+      break;
+    }
+
+    if ((st = zix_thread_create(
+           &thread->thread, HELPER_STACK_SIZE, helper_func, thread))) {
+      zix_sem_destroy(&thread->wake);
+      break;
+    }
+  }
+
+  if (st) {
+    stop_helpers(graph, n_helpers); // Stop threads launched before failure
+    free_threads(graph, n);
+    return st;
+  }
+
+  graph->n_threads = n;
+  return st;
+}
+
+void
+jalv_graph_exit(JalvGraph* const graph)
+{
+  if (graph->threads) {
+    stop_helpers(graph, graph->n_threads - 1U);
+    free_threads(graph, graph->n_threads);
+  }
+}
+
+ZIX_REALTIME void
+jalv_graph_run(JalvGraph* const graph, const uint32_t nframes)
+{
+  if (graph->n_threads <= 1U) {
+    // Run every node in order in this thread
+    for (uint32_t i = 0U; i < graph->n_nodes; ++i) {
+      graph->run(graph->handle, graph->order[i], nframes);
+    }
+    return;
+  }
+
+  // Reset dependency counts and queue the nodes that have none
+  graph->nframes = nframes;
+  for (uint32_t i = 0U; i < graph->n_nodes; ++i) {
+    jalv_atomic_store(&graph->pending[i], graph->n_preds[i]);
+  }
+
+  jalv_atomic_store(&graph->remaining, graph->n_nodes);
+
+  GraphThread* const self = &graph->threads[0];
+  for (uint32_t i = graph->n_roots; i-- > 0U;) {
+    deque_push(&self->deque, graph->order[i]);
+  }
+
+  // Wake the helpers and work alongside them until every node is finished
+  for (uint32_t i = 1U; i < graph->n_threads; ++i) {
+    zix_sem_post(&graph->threads[i].wake);
+  }
+
+  work(graph, self);
+}
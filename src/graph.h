@@ -0,0 +1,93 @@
+// Copyright 2026 David Robillard <d@drobilla.net>
+// SPDX-License-Identifier: ISC
+
+#ifndef JALV_GRAPH_H
+#define JALV_GRAPH_H
+
+#include "attributes.h"
+
+#include <zix/attributes.h>
+#include <zix/status.h>
+
+#include <stdint.h>
+
+// Parallel scheduler for a graph of nodes run every cycle
+JALV_BEGIN_DECLS
+
+/**
+   A directed acyclic graph of nodes that are run once every cycle.
+
+   Each node is only run after all the nodes it depends on have finished.
+   Nodes that don't depend on each other can run concurrently on a pool of
+   helper threads, which take work from each other as necessary, so the
+   cycle finishes as soon as the critical path allows.  Without helpers, the
+   nodes are simply run in a precomputed topological order.
+
+   The graph is built up front in the main thread, then run in the audio
+   thread, which takes part in the work and returns once every node is done.
+*/
+typedef struct JalvGraphImpl JalvGraph;
+
+/// Function to run a node for a cycle (called in the audio or a helper thread)
+typedef void (*JalvGraphRunFunc)(void* handle, uint32_t node, uint32_t nframes);
+
+/// Function called at the start of every helper thread
+typedef void (*JalvGraphInitFunc)(void* handle);
+
+/**
+   Allocate a new graph with no edges.
+
+   @param n_nodes Number of nodes, which are identified by index.
+   @param run Function called to run a node.
+   @param handle Opaque pointer passed to callbacks.
+   @return A newly allocated graph, or null on error.
+*/
+JalvGraph*
+jalv_graph_new(uint32_t n_nodes, JalvGraphRunFunc run, void* handle);
+
+/**
+   Free a graph allocated with jalv_graph_new().
+
+   Calls jalv_graph_exit() to terminate helper threads if necessary.
+*/
+void
+jalv_graph_free(JalvGraph* graph);
+
+/// Add an edge so that the node `from` is run before the node `to`
+ZixStatus
+jalv_graph_add_edge(JalvGraph* graph, uint32_t from, uint32_t to);
+
+/**
+   Compute the order to run the nodes in.
+
+   This must be called after all edges are added, and before running.
+
+   @return Zero on success, or #ZIX_STATUS_BAD_ARG if the edges form a cycle.
+*/
+ZixStatus
+jalv_graph_prepare(JalvGraph* graph);
+
+/**
+   Launch helper threads to run independent nodes concurrently.
+
+   @param graph A prepared graph.
+   @param n_threads Total number of threads to run nodes in, including the
+   audio thread that calls jalv_graph_run().
+   @param init Function called at the start of every helper thread, for
+   example to give it realtime priority, or null.
+   @return Zero on success, or a non-zero error code if launching failed.
+*/
+ZixStatus
+jalv_graph_launch(JalvGraph* graph, uint32_t n_threads, JalvGraphInitFunc init);
+
+/// Terminate the helper threads if necessary and wait for them to exit
+void
+jalv_graph_exit(JalvGraph* graph);
+
+/// Run every node of a prepared graph once, in the audio thread
+ZIX_REALTIME void
+jalv_graph_run(JalvGraph* graph, uint32_t nframes);
+
+JALV_END_DECLS
+
+#endif // JALV_GRAPH_H
@@ -13,10 +13,12 @@
 #include "../control.h"
 #include "../frontend.h"
 #include "../jalv.h"
+#include "../jalv_config.h"
 #include "../log.h"
 #include "../options.h"
 #include "../query.h"
 #include "../types.h"
+#include "../wakeup.h"
 
 #include <lilv/lilv.h>
 #include <lv2/core/lv2.h>
@@ -34,6 +36,10 @@
 #include <gobject/gclosure.h>
 #include <gtk/gtk.h>
 
+#if USE_PIPE
+#  include <glib-unix.h>
+#endif
+
 #include <float.h>
 #include <math.h>
 #include <stdarg.h>
@@ -55,6 +61,20 @@ setup_options(GApplication* const app, JalvOptions* const opts)
   g_set_application_name("Jalv");
 
   const GOptionEntry entries[] = {
+    {"split-length",
+     'a',
+     0,
+     G_OPTION_ARG_INT,
+     &opts->split_length,
+     "Split blocks at timed controls, at least FRAMES long",
+     "FRAMES"},
+    {"plugin-index",
+     'B',
+     0,
+     G_OPTION_ARG_FILENAME,
+     &opts->plugin_index,
+     "Plugin index file for loading only needed bundles",
+     "FILE"},
     {"buffer-size",
      'b',
      0,
@@ -62,13 +82,27 @@ setup_options(GApplication* const app, JalvOptions* const opts)
      &opts->ring_size,
      "Buffer size for plugin <=> UI communication",
      "SIZE"},
+    {"cache-presets",
+     'C',
+     0,
+     G_OPTION_ARG_NONE,
+     &opts->preset_cache,
+     "Cache presets incrementally for fast switching",
+     NULL},
     {"control",
      'c',
      0,
      G_OPTION_ARG_STRING_ARRAY,
      &opts->controls,
-     "Set control value (e.g. \"vol=1.4\")",
+     "Set control value (e.g. \"vol=1.4\" or \"vol=1@64\")",
      "SETTING"},
+    {"dump-file",
+     'D',
+     0,
+     G_OPTION_ARG_FILENAME,
+     &opts->dump_file,
+     "Capture plugin <=> UI communication to a file",
+     "FILE"},
     {"dump",
      'd',
      0,
@@ -76,6 +110,13 @@ setup_options(GApplication* const app, JalvOptions* const opts)
      &opts->dump,
      "Dump plugin <=> UI communication",
      NULL},
+    {"dump-filter",
+     'f',
+     0,
+     G_OPTION_ARG_STRING_ARRAY,
+     &opts->dump_filters,
+     "Only dump a port symbol or type URI",
+     "FILTER"},
     {"generic-ui",
      'g',
      0,
@@ -146,6 +187,27 @@ setup_options(GApplication* const app, JalvOptions* const opts)
      &opts->ui_uri,
      "Load the UI with the given URI",
      "URI"},
+    {"worker-threads",
+     'w',
+     0,
+     G_OPTION_ARG_INT,
+     &opts->worker_threads,
+     "Worker threads (plugin work must be thread-safe)",
+     "THREADS"},
+    {"traffic-log",
+     'W',
+     0,
+     G_OPTION_ARG_FILENAME,
+     &opts->traffic_log,
+     "Record plugin <=> UI messages to a file",
+     "FILE"},
+    {"crossfade-restore",
+     'X',
+     0,
+     G_OPTION_ARG_NONE,
+     &opts->shadow_restore,
+     "Restore state into a new instance and crossfade",
+     NULL},
     {"exact-jack-name",
      'x',
      0,
@@ -153,6 +215,20 @@ setup_options(GApplication* const app, JalvOptions* const opts)
      &opts->name_exact,
      "Exit if the requested JACK client name is taken",
      NULL},
+    {"replay",
+     'y',
+     0,
+     G_OPTION_ARG_FILENAME,
+     &opts->replay_log,
+     "Replay UI messages recorded with -W",
+     "FILE"},
+    {"sleep",
+     'z',
+     0,
+     G_OPTION_ARG_DOUBLE,
+     &opts->sleep_tail,
+     "Stop running the plugin after SECONDS of silence",
+     "SECONDS"},
     {G_OPTION_REMAINING,
      '\0',
      0,
@@ -383,6 +459,20 @@ jalv_frontend_scale_factor(const Jalv* ZIX_UNUSED(jalv))
   return (float)gdk_monitor_get_scale_factor(monitor);
 }
 
+#if USE_PIPE
+
+static gboolean
+on_ui_wakeup(const gint fd, const GIOCondition condition, void* const data)
+{
+  (void)fd;
+  (void)condition;
+
+  jalv_update((Jalv*)data);
+  return TRUE;
+}
+
+#endif
+
 static void
 on_application_startup(GtkApplication* const application, void* const data)
 {
@@ -394,9 +484,19 @@ on_application_startup(GtkApplication* const application, void* const data)
   gtk_window_set_default_icon_name("jalv");
 
   if (!jalv_open(jalv, app->load_arg)) {
+    app->opened = true;
+
+#if USE_PIPE
+    // Update only when woken by the process thread if possible
+    const int wakeup_fd = jalv_wakeup_fd(&jalv->process.ui_wakeup);
+    if (wakeup_fd >= 0) {
+      app->timer_id = g_unix_fd_add(wakeup_fd, G_IO_IN, on_ui_wakeup, jalv);
+      return;
+    }
+#endif
+
     const float update_interval_ms = 1000.0f / jalv->settings.ui_update_hz;
 
-    app->opened   = true;
     app->timer_id = g_timeout_add(
       (unsigned)update_interval_ms, (GSourceFunc)jalv_update, jalv);
   }
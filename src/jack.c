@@ -1,28 +1,34 @@
-// Copyright 2007-2025 David Robillard <d@drobilla.net>
+// Copyright 2007-2026 David Robillard <d@drobilla.net>
 // SPDX-License-Identifier: ISC
 
 #include "backend.h"
 
-#include "comm.h"
+#include "graph.h"
 #include "jack_impl.h"
 #include "jalv_config.h"
 #include "log.h"
 #include "lv2_evbuf.h"
+#include "macros.h"
+#include "mailbox.h"
+#include "options.h"
 #include "process.h"
 #include "process_setup.h"
 #include "settings.h"
 #include "string_utils.h"
 #include "types.h"
 #include "urids.h"
+#include "wakeup.h"
 
 #include <lilv/lilv.h>
 #include <lv2/atom/atom.h>
 #include <lv2/atom/forge.h>
 #include <lv2/urid/urid.h>
 #include <zix/sem.h>
+#include <zix/status.h>
 
 #include <jack/jack.h>
 #include <jack/midiport.h>
+#include <jack/thread.h>
 #include <jack/transport.h>
 #include <jack/types.h>
 
@@ -31,7 +37,10 @@
 #  include <stdio.h>
 #endif
 
-#include <assert.h>
+#ifndef _WIN32
+#  include <pthread.h>
+#endif
+
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdlib.h>
@@ -44,24 +53,20 @@
 #endif
 
 typedef struct {
-  jack_position_t        pos;
-  jack_transport_state_t state;
-  uint64_t               pos_buf[64];
-  bool                   changed;
+  const LV2_Atom* pos;     ///< Position to send to the plugin, or null
+  bool            has_bbt; ///< True if pos includes BBT information
 } TransportData;
 
-/// Maximum supported latency in frames (at most 2^24 so all integers work)
-static const float max_latency = 16777216.0f;
-
-/// Jack buffer size callback
-static int
-buffer_size_cb(const jack_nframes_t nframes, void* const data)
+/// Update the settings of a backend for a new buffer size
+static void
+update_buffer_size(JalvBackend* const backend, const jack_nframes_t nframes)
 {
-  JalvBackend* const  backend  = (JalvBackend*)data;
   JalvSettings* const settings = backend->settings;
   JalvProcess* const  proc     = backend->process;
 
-  settings->min_block_length = settings->max_block_length = nframes;
+  settings->max_block_length = nframes;
+  settings->min_block_length =
+    settings->split_length ? MIN(settings->split_length, nframes) : nframes;
 #if USE_JACK_PORT_TYPE_GET_BUFFER_SIZE
   settings->midi_buf_size =
     jack_port_type_get_buffer_size(backend->client, JACK_DEFAULT_MIDI_TYPE);
@@ -69,246 +74,348 @@ buffer_size_cb(const jack_nframes_t nframes, void* const data)
   if (proc->run_state == JALV_RUNNING) {
     jalv_process_activate(proc, backend->urids, proc->instance, settings);
   }
+}
+
+/// Jack buffer size callback
+static int
+buffer_size_cb(const jack_nframes_t nframes, void* const data)
+{
+  for (JalvBackend* b = (JalvBackend*)data; b; b = b->next) {
+    update_buffer_size(b, nframes);
+  }
   return 0;
 }
 
-/// Jack shutdown callback
-static void
-shutdown_cb(void* const data)
+/// Jack xrun callback
+static int
+xrun_cb(void* const data)
 {
-  JalvBackend* const backend = (JalvBackend*)data;
-  zix_sem_post(backend->done);
+  for (JalvBackend* b = (JalvBackend*)data; b; b = b->next) {
+    jalv_process_xrun(b->process);
+  }
+  return 0;
 }
 
+/// Jack shutdown callback
 static void
-forge_position(LV2_Atom_Forge* const        forge,
-               const JalvURIDs* const       urids,
-               const jack_transport_state_t state,
-               const jack_position_t        pos)
+shutdown_cb(void* const data)
 {
-  LV2_Atom_Forge_Frame frame;
-  lv2_atom_forge_object(forge, &frame, 0, urids->time_Position);
-  lv2_atom_forge_key(forge, urids->time_frame);
-  lv2_atom_forge_long(forge, pos.frame);
-  lv2_atom_forge_key(forge, urids->time_speed);
-  lv2_atom_forge_float(forge, (state == JackTransportRolling) ? 1.0 : 0.0);
-  if ((pos.valid & JackPositionBBT)) {
-    lv2_atom_forge_key(forge, urids->time_barBeat);
-    lv2_atom_forge_float(forge, pos.beat - 1 + (pos.tick / pos.ticks_per_beat));
-    lv2_atom_forge_key(forge, urids->time_bar);
-    lv2_atom_forge_long(forge, pos.bar - 1);
-    lv2_atom_forge_key(forge, urids->time_beatUnit);
-    lv2_atom_forge_int(forge, pos.beat_type);
-    lv2_atom_forge_key(forge, urids->time_beatsPerBar);
-    lv2_atom_forge_float(forge, pos.beats_per_bar);
-    lv2_atom_forge_key(forge, urids->time_beatsPerMinute);
-    lv2_atom_forge_float(forge, pos.beats_per_minute);
-  }
-  lv2_atom_forge_pop(forge, &frame);
+  for (JalvBackend* b = (JalvBackend*)data; b; b = b->next) {
+    zix_sem_post(b->done);
+    jalv_wakeup_signal(&b->process->ui_wakeup);
+  }
 }
 
 static int
 process_silent(JalvProcess* const proc, const jack_nframes_t nframes)
 {
-  for (uint32_t p = 0U; p < proc->num_ports; ++p) {
+  const JalvPortLists* const lists = &proc->port_lists;
+  for (uint32_t i = 0U; i < lists->signals.n_indices; ++i) {
+    const uint32_t               p     = lists->signals.indices[i];
     const JalvProcessPort* const port  = &proc->ports[p];
-    jack_port_t* const           jport = (jack_port_t*)proc->ports[p].sys_port;
+    jack_port_t* const           jport = (jack_port_t*)port->sys_port;
     if (jport && port->flow == FLOW_OUTPUT) {
-      void* const buf = jack_port_get_buffer(jport, nframes);
-      if (port->type == TYPE_EVENT) {
-        jack_midi_clear_buffer(buf);
-      } else {
-        memset(buf, '\0', nframes * sizeof(float));
-      }
+      memset(jack_port_get_buffer(jport, nframes), 0, nframes * sizeof(float));
+    }
+  }
+
+  for (uint32_t i = 0U; i < lists->event_outputs.n_indices; ++i) {
+    const uint32_t     p     = lists->event_outputs.indices[i];
+    jack_port_t* const jport = (jack_port_t*)proc->ports[p].sys_port;
+    if (jport) {
+      jack_midi_clear_buffer(jack_port_get_buffer(jport, nframes));
     }
   }
 
   return jalv_bypass(proc, nframes);
 }
 
-static void
-process_transport(JalvPosition* const    transport,
-                  TransportData* const   data,
-                  LV2_Atom_Forge* const  forge,
-                  const JalvURIDs* const urids,
-                  jack_client_t* const   client,
-                  const jack_nframes_t   nframes)
+static TransportData
+process_transport(JalvPosition* const          transport,
+                  JalvTimePosition* const      cache,
+                  const jack_position_t* const pos,
+                  const jack_transport_state_t state,
+                  const jack_nframes_t         nframes)
 {
-  data->state   = jack_transport_query(client, &data->pos);
-  data->changed = false;
+  const bool rolling = state == JackTransportRolling;
+  const bool has_bbt = (pos->valid & JackPositionBBT);
 
-  // Get transport state and position
-  jack_position_t              pos     = {0U};
-  const jack_transport_state_t state   = jack_transport_query(client, &pos);
-  const bool                   rolling = state == JackTransportRolling;
-  const bool                   has_bbt = (pos.valid & JackPositionBBT);
+  // The frame changed if the transport didn't move as expected
+  const bool moved =
+    rolling != transport->rolling || pos->frame != transport->position;
 
-  // If transport state is not as expected, then something has changed
-  data->changed =
-    (rolling != transport->rolling || pos.frame != transport->position ||
-     (has_bbt && pos.beats_per_minute != transport->bpm));
+  // The BBT changed if the tempo or meter differs from what was last sent
+  const bool bbt_changed =
+    has_bbt != cache->has_bbt ||
+    (has_bbt && ((float)pos->beats_per_minute != *cache->bpm ||
+                 pos->beats_per_bar != *cache->beats_per_bar ||
+                 (int32_t)pos->beat_type != *cache->beat_unit));
 
   // Update transport state to expected values for next cycle
-  transport->position = rolling ? pos.frame + nframes : pos.frame;
-  transport->bpm      = has_bbt ? pos.beats_per_minute : transport->bpm;
+  transport->position = rolling ? pos->frame + nframes : pos->frame;
+  transport->bpm      = has_bbt ? pos->beats_per_minute : transport->bpm;
   transport->rolling  = rolling;
 
-  if (data->changed) {
-    // Build an LV2 position object to report change to plugin
-    lv2_atom_forge_set_buffer(
-      forge, (uint8_t*)data->pos_buf, sizeof(data->pos_buf));
-    forge_position(forge, urids, state, pos);
+  const TransportData none = {NULL, false};
+  if (!moved && !bbt_changed) {
+    return none;
+  }
+
+  // Patch the values of the position object to report the change to plugin
+  *cache->frame = pos->frame;
+  *cache->speed = rolling ? 1.0f : 0.0f;
+  if (has_bbt) {
+    *cache->bar_beat =
+      (float)(pos->beat - 1 + (pos->tick / pos->ticks_per_beat));
+    *cache->bar = pos->bar - 1;
+    if (bbt_changed) {
+      *cache->beat_unit     = (int32_t)pos->beat_type;
+      *cache->beats_per_bar = pos->beats_per_bar;
+      *cache->bpm           = (float)pos->beats_per_minute;
+    }
   }
+
+  cache->has_bbt          = has_bbt;
+  cache->object->atom.size = has_bbt ? cache->bbt_size : cache->frame_size;
+
+  const TransportData data = {&cache->object->atom, has_bbt};
+  return data;
 }
 
-// Prepare a port before running the plugin for a block
+// Connect signal ports to the buffers of their Jack ports for a block
 static void
-pre_process_port(JalvProcess* const         proc,
-                 const JalvURIDs* const     urids,
-                 const TransportData* const xport,
-                 JalvProcessPort* const     port,
-                 const uint32_t             index,
-                 const jack_nframes_t       nframes)
+connect_signal_ports(JalvProcess* const proc, const jack_nframes_t nframes)
 {
-  if (port->sys_port && (port->type == TYPE_AUDIO || port->type == TYPE_CV)) {
-    // Connect plugin port directly to Jack port buffer
-    lilv_instance_connect_port(
-      proc->instance, index, jack_port_get_buffer(port->sys_port, nframes));
-  } else if (port->type == TYPE_EVENT && port->flow == FLOW_INPUT) {
-    LV2_Evbuf_Iterator iter = lv2_evbuf_begin(port->evbuf);
-
-    if (port->supports_pos && xport->changed) {
-      // Write new transport position
-      LV2_Atom* const pos = (LV2_Atom*)xport->pos_buf;
-      lv2_evbuf_write(&iter, 0, 0, pos->type, pos->size, LV2_ATOM_BODY(pos));
+  const JalvPortList* const list = &proc->port_lists.signals;
+  for (uint32_t i = 0U; i < list->n_indices; ++i) {
+    const uint32_t               p    = list->indices[i];
+    const JalvProcessPort* const port = &proc->ports[p];
+    if (port->link_port) {
+      // Connect plugin port directly to the buffer of the linked output
+      jalv_process_connect_port(
+        proc, p, jack_port_get_buffer(port->link_port, nframes));
+    } else if (port->sys_port) {
+      // Connect plugin port directly to Jack port buffer
+      jalv_process_connect_port(
+        proc, p, jack_port_get_buffer(port->sys_port, nframes));
     }
+  }
+}
 
-    if (port->sys_port) {
-      // Write Jack MIDI input
-      void* buf = jack_port_get_buffer(port->sys_port, nframes);
-      for (uint32_t i = 0; i < jack_midi_get_event_count(buf); ++i) {
-        jack_midi_event_t ev;
-        jack_midi_event_get(&ev, buf, i);
-        lv2_evbuf_write(
-          &iter, ev.time, 0, urids->midi_MidiEvent, ev.size, ev.buffer);
-      }
+// Prepare an event input before running the plugin for a block
+static void
+pre_process_event_input(const JalvURIDs* const     urids,
+                        const TransportData* const xport,
+                        JalvProcessPort* const     port,
+                        const jack_nframes_t       nframes)
+{
+  LV2_Evbuf_Iterator iter = lv2_evbuf_begin(port->evbuf);
+
+  if (port->supports_pos && xport->pos) {
+    // Write new transport position
+    const LV2_Atom* const pos = xport->pos;
+    lv2_evbuf_write(&iter, 0, 0, pos->type, pos->size, LV2_ATOM_BODY(pos));
+  }
+
+  if (port->sys_port) {
+    // Write Jack MIDI input
+    void* buf = jack_port_get_buffer(port->sys_port, nframes);
+    for (uint32_t i = 0; i < jack_midi_get_event_count(buf); ++i) {
+      jack_midi_event_t ev;
+      jack_midi_event_get(&ev, buf, i);
+      lv2_evbuf_write(
+        &iter, ev.time, 0, urids->midi_MidiEvent, ev.size, ev.buffer);
     }
-  } else if (port->type == TYPE_EVENT) {
-    // Clear event output for plugin to write to
-    lv2_evbuf_reset(port->evbuf, false);
-  } else if (port->is_bpm && xport->changed &&
-             (xport->pos.valid & JackPositionBBT)) {
-    // Set BPM control port to new tempo and notify the UI
-    proc->controls_buf[index] = proc->transport.bpm;
-    jalv_write_control(proc->plugin_to_ui, index, proc->transport.bpm);
   }
 }
 
-// Process port output after running the plugin for a block
+// Prepare ports before running the plugin for a block
 static void
-post_process_output_port(JalvProcess* const     proc,
-                         const JalvURIDs* const urids,
-                         JalvProcessPort* const port,
-                         const uint32_t         index,
-                         const jack_nframes_t   nframes,
-                         const bool             send_updates)
+pre_process_ports(JalvProcess* const         proc,
+                  const JalvURIDs* const     urids,
+                  const TransportData* const xport,
+                  const jack_nframes_t       nframes)
 {
-  assert(port->flow == FLOW_OUTPUT);
-
-  if (port->type == TYPE_CONTROL && port->reports_latency) {
-    // Get the latency in frames from the control output truncated to integer
-    const float    value = proc->controls_buf[index];
-    const uint32_t frames =
-      (value >= 0.0f && value <= max_latency) ? (uint32_t)value : 0U;
-
-    if (proc->plugin_latency != frames) {
-      // Update the cached value and notify the UI if the latency changed
-      proc->plugin_latency = frames;
-
-      const JalvLatencyChange body   = {frames};
-      const JalvMessageHeader header = {LATENCY_CHANGE, sizeof(body)};
-      jalv_write_split_message(
-        proc->plugin_to_ui, &header, sizeof(header), &body, sizeof(body));
+  const JalvPortLists* const lists = &proc->port_lists;
+
+  connect_signal_ports(proc, nframes);
+
+  for (uint32_t i = 0U; i < lists->event_inputs.n_indices; ++i) {
+    const uint32_t p = lists->event_inputs.indices[i];
+    pre_process_event_input(urids, xport, &proc->ports[p], nframes);
+  }
+
+  for (uint32_t i = 0U; i < lists->event_outputs.n_indices; ++i) {
+    // Clear event output for plugin to write to
+    const uint32_t p = lists->event_outputs.indices[i];
+    lv2_evbuf_reset(proc->ports[p].evbuf, false);
+  }
+
+  if (xport->pos && xport->has_bbt) {
+    // Set BPM control ports to new tempo and notify the UI
+    const float bpm = proc->transport.bpm;
+    for (uint32_t i = 0U; i < lists->bpm_inputs.n_indices; ++i) {
+      const uint32_t p      = lists->bpm_inputs.indices[i];
+      proc->controls_buf[p] = bpm;
+      jalv_mailbox_write(proc->plugin_controls, p, bpm);
     }
-  } else if (port->type == TYPE_EVENT) {
-    void* buf = NULL;
-    if (port->sys_port) {
-      buf = jack_port_get_buffer(port->sys_port, nframes);
-      jack_midi_clear_buffer(buf);
+  }
+}
+
+// Process an event output after running the plugin for a block
+static void
+post_process_event_output(JalvProcess* const     proc,
+                          const JalvURIDs* const urids,
+                          JalvProcessPort* const port,
+                          const uint32_t         index,
+                          const jack_nframes_t   nframes)
+{
+  void* buf = NULL;
+  if (port->sys_port) {
+    buf = jack_port_get_buffer(port->sys_port, nframes);
+    jack_midi_clear_buffer(buf);
+  }
+
+  for (LV2_Evbuf_Iterator i = lv2_evbuf_begin(port->evbuf);
+       lv2_evbuf_is_valid(i);
+       i = lv2_evbuf_next(i)) {
+    // Get event from LV2 buffer
+    uint32_t frames    = 0;
+    uint32_t subframes = 0;
+    LV2_URID type      = 0;
+    uint32_t size      = 0;
+    void*    body      = NULL;
+    lv2_evbuf_get(i, &frames, &subframes, &type, &size, &body);
+
+    if (buf && type == urids->midi_MidiEvent) {
+      // Write MIDI event to Jack output
+      jack_midi_event_write(buf, frames, body, size);
     }
 
-    for (LV2_Evbuf_Iterator i = lv2_evbuf_begin(port->evbuf);
-         lv2_evbuf_is_valid(i);
-         i = lv2_evbuf_next(i)) {
-      // Get event from LV2 buffer
-      uint32_t frames    = 0;
-      uint32_t subframes = 0;
-      LV2_URID type      = 0;
-      uint32_t size      = 0;
-      void*    body      = NULL;
-      lv2_evbuf_get(i, &frames, &subframes, &type, &size, &body);
-
-      if (buf && type == urids->midi_MidiEvent) {
-        // Write MIDI event to Jack output
-        jack_midi_event_write(buf, frames, body, size);
-      }
+    // Forward event to UI
+    jalv_process_send_event(proc, index, size, type, body);
+  }
+}
+
+// Finish ports after running the plugin for a block
+static void
+post_process_ports(JalvProcess* const     proc,
+                   const JalvURIDs* const urids,
+                   const jack_nframes_t   nframes,
+                   const bool             send_updates)
+{
+  const JalvPortLists* const lists = &proc->port_lists;
+
+  for (uint32_t i = 0U; i < lists->event_inputs.n_indices; ++i) {
+    const uint32_t p = lists->event_inputs.indices[i];
+    lv2_evbuf_reset(proc->ports[p].evbuf, true);
+  }
+
+  for (uint32_t i = 0U; i < lists->event_outputs.n_indices; ++i) {
+    const uint32_t p = lists->event_outputs.indices[i];
+    post_process_event_output(proc, urids, &proc->ports[p], p, nframes);
+  }
 
-      // Forward event to UI
-      jalv_write_event(proc->plugin_to_ui, index, size, type, body);
+  if (lists->latency != UINT32_MAX) {
+    jalv_process_update_latency(proc, lists->latency);
+  }
+
+  if (send_updates) {
+    for (uint32_t i = 0U; i < lists->control_outputs.n_indices; ++i) {
+      jalv_process_send_control(proc, lists->control_outputs.indices[i]);
     }
-  } else if (send_updates && port->type == TYPE_CONTROL) {
-    jalv_write_control(proc->plugin_to_ui, index, proc->controls_buf[index]);
   }
 }
 
-/// Jack process callback
+/// Process a cycle for the plugin of one backend
 static REALTIME int
-process_cb(const jack_nframes_t nframes, void* const data)
+process_instance(JalvBackend* const backend, const jack_nframes_t nframes)
 {
-  JalvBackend* const     backend = (JalvBackend*)data;
-  const JalvURIDs* const urids   = backend->urids;
-  JalvProcess* const     proc    = backend->process;
-  TransportData          xport   = {{0U}, JackTransportStopped, {0U}, false};
+  const JalvURIDs* const   urids = backend->urids;
+  JalvProcess* const       proc  = backend->process;
+  const JalvBackend* const host  = backend->host ? backend->host : backend;
 
   // If execution is paused, emit silence and return
   if (proc->run_state == JALV_PAUSED) {
     return process_silent(proc, nframes);
   }
 
-  // Process and update transport data
-  process_transport(
-    &proc->transport, &xport, &proc->forge, urids, backend->client, nframes);
+  jalv_process_begin_cycle(proc);
 
-  // Prepare ports
-  for (uint32_t p = 0; p < proc->num_ports; ++p) {
-    pre_process_port(proc, urids, &xport, &proc->ports[p], p, nframes);
+  // Process and update transport data from the query for the whole client
+  const TransportData xport = process_transport(&proc->transport,
+                                                &backend->position,
+                                                &host->transport_pos,
+                                                host->transport_state,
+                                                nframes);
+  jalv_process_end_stage(proc, JALV_STAGE_TRANSPORT);
+
+  // Prepare ports, run plugin for this cycle, and finish ports
+  pre_process_ports(proc, urids, &xport, nframes);
+  const JalvProcessStatus pst          = jalv_run(proc, nframes);
+  const bool              send_updates = pst == JALV_PROCESS_SEND_UPDATES;
+  post_process_ports(proc, urids, nframes, send_updates);
+
+  jalv_process_end_cycle(proc, nframes, send_updates);
+  return 0;
+}
+
+/// Run the plugin of one graph node
+static REALTIME void
+run_node(void* const data, const uint32_t node, const uint32_t nframes)
+{
+  const JalvBackend* const host = (const JalvBackend*)data;
+
+  process_instance(host->nodes[node], nframes);
+}
+
+/// Give a graph helper thread the same priority as the Jack process thread
+static void
+init_graph_thread(void* const data)
+{
+#ifndef _WIN32
+  jack_client_t* const client = ((const JalvBackend*)data)->client;
+  if (jack_is_realtime(client)) {
+    jack_acquire_real_time_scheduling(pthread_self(),
+                                      jack_client_real_time_priority(client));
   }
+#else
+  (void)data;
+#endif
+}
 
-  // Run plugin for this cycle
-  const JalvProcessStatus pst = jalv_run(proc, nframes);
+/// Jack process callback
+static REALTIME int
+process_cb(const jack_nframes_t nframes, void* const data)
+{
+  JalvBackend* const backend = (JalvBackend*)data;
 
-  // Finish ports
-  for (uint32_t p = 0; p < proc->num_ports; ++p) {
-    JalvProcessPort* const port = &proc->ports[p];
-    if (port->flow == FLOW_INPUT && port->type == TYPE_EVENT) {
-      lv2_evbuf_reset(port->evbuf, true);
-    } else if (port->flow == FLOW_OUTPUT && port->type == TYPE_EVENT) {
-      post_process_output_port(
-        proc, urids, port, p, nframes, pst == JALV_PROCESS_SEND_UPDATES);
-    }
+  // Query the transport once for every plugin that shares the client
+  backend->transport_state =
+    jack_transport_query(backend->client, &backend->transport_pos);
+
+  if (backend->graph) {
+    jalv_graph_run(backend->graph, nframes);
+    return 0;
   }
 
-  return 0;
+  // Process every plugin that shares the client in turn
+  int rc = 0;
+  for (JalvBackend* b = (JalvBackend*)data; b; b = b->next) {
+    const int st = process_instance(b, nframes);
+    rc           = rc ? rc : st;
+  }
+  return rc;
 }
 
-/// Jack latency callback
+/// Update the latencies of the ports of one backend
 static void
-latency_cb(const jack_latency_callback_mode_t mode, void* const data)
+update_latency(const JalvBackend* const           backend,
+               const jack_latency_callback_mode_t mode)
 {
   // Calculate latency assuming all ports depend on each other
 
-  const JalvBackend* const backend = (JalvBackend*)data;
-  const JalvProcess* const proc    = backend->process;
+  const JalvProcess* const proc = backend->process;
   const PortFlow           flow =
     ((mode == JackCaptureLatency) ? FLOW_INPUT : FLOW_OUTPUT);
 
@@ -347,6 +454,15 @@ latency_cb(const jack_latency_callback_mode_t mode, void* const data)
   }
 }
 
+/// Jack latency callback
+static void
+latency_cb(const jack_latency_callback_mode_t mode, void* const data)
+{
+  for (const JalvBackend* b = (const JalvBackend*)data; b; b = b->next) {
+    update_latency(b, mode);
+  }
+}
+
 static jack_client_t*
 create_client(const char* const name, const bool exact_name)
 {
@@ -375,27 +491,49 @@ jalv_backend_allocate(void)
 void
 jalv_backend_free(JalvBackend* const backend)
 {
+  if (backend) {
+    jalv_graph_free(backend->graph);
+    free(backend->nodes);
+    free(backend->links);
+    free(backend->prefix);
+  }
+
   free(backend);
 }
 
 int
-jalv_backend_open(JalvBackend* const     backend,
-                  const JalvLog* const   log,
-                  const JalvURIDs* const urids,
-                  JalvSettings* const    settings,
-                  JalvProcess* const     process,
-                  ZixSem* const          done,
-                  const char* const      name,
-                  const bool             exact_name)
+jalv_backend_share(JalvBackend* const backend,
+                   JalvBackend* const host,
+                   const char* const  name)
+{
+  free(backend->prefix);
+  backend->host   = host;
+  backend->prefix = name ? jalv_strdup(name) : NULL;
+  return 0;
+}
+
+int
+jalv_backend_open(JalvBackend* const       backend,
+                  const JalvLog* const     log,
+                  const JalvURIDs* const   urids,
+                  JalvSettings* const      settings,
+                  JalvProcess* const       process,
+                  ZixSem* const            done,
+                  const JalvOptions* const opts)
 {
+  JalvBackend* const   host   = backend->host;
   jack_client_t* const client =
-    backend->client ? backend->client : create_client(name, exact_name);
+    host              ? host->client
+    : backend->client ? backend->client
+                      : create_client(opts->name, opts->name_exact);
 
   if (!client) {
     return 1;
   }
 
-  jalv_log(log, JALV_LOG_INFO, "JACK name: %s", jack_get_client_name(client));
+  if (!host) {
+    jalv_log(log, JALV_LOG_INFO, "JACK name: %s", jack_get_client_name(client));
+  }
 
   // Set audio engine properties
   settings->sample_rate      = (float)jack_get_sample_rate(client);
@@ -407,26 +545,129 @@ jalv_backend_open(JalvBackend* const     backend,
     jack_port_type_get_buffer_size(client, JACK_DEFAULT_MIDI_TYPE);
 #endif
 
+  backend->urids              = urids;
+  backend->settings           = settings;
+  backend->process            = process;
+  backend->done               = done;
+  backend->client             = client;
+  backend->is_internal_client = false;
+
+  jalv_time_position_init(&backend->position, &process->forge, urids);
+
+  if (host) {
+    // Append to the backends that the host's callbacks run
+    JalvBackend* last = host;
+    while (last->next) {
+      last = last->next;
+    }
+
+    last->next    = backend;
+    backend->node = last->node + 1U;
+    return 0;
+  }
+
   // Set JACK callbacks
   void* const arg = (void*)backend;
   jack_set_process_callback(client, &process_cb, arg);
   jack_set_buffer_size_callback(client, &buffer_size_cb, arg);
+  jack_set_xrun_callback(client, &xrun_cb, arg);
   jack_on_shutdown(client, &shutdown_cb, arg);
   jack_set_latency_callback(client, &latency_cb, arg);
+  return 0;
+}
 
-  backend->urids              = urids;
-  backend->settings           = settings;
-  backend->process            = process;
-  backend->done               = done;
-  backend->client             = client;
-  backend->is_internal_client = false;
+int
+jalv_backend_link(JalvBackend* const from,
+                  const uint32_t     from_index,
+                  JalvBackend* const to,
+                  const uint32_t     to_index)
+{
+  JalvBackend* const host = from->host ? from->host : from;
+  if ((to->host ? to->host : to) != host || host->graph ||
+      from_index >= from->process->num_ports ||
+      to_index >= to->process->num_ports) {
+    return 1;
+  }
+
+  const JalvProcessPort* const from_port = &from->process->ports[from_index];
+  JalvProcessPort* const       to_port   = &to->process->ports[to_index];
+  if (from_port->flow != FLOW_OUTPUT || to_port->flow != FLOW_INPUT ||
+      !from_port->sys_port || from_port->type != to_port->type ||
+      (to_port->type != TYPE_AUDIO && to_port->type != TYPE_CV) ||
+      to_port->link_port) {
+    return 1;
+  }
+
+  uint32_t* const new_links = (uint32_t*)realloc(
+    host->links, (host->n_links + 1U) * 2U * sizeof(uint32_t));
+  if (!new_links) {
+    return 1;
+  }
+
+  const uint32_t l = host->n_links++ * 2U;
+
+  host->links         = new_links;
+  host->links[l]      = from->node;
+  host->links[l + 1U] = to->node;
+  to_port->link_port  = from_port->sys_port;
+
+  // The input only reads the linked output, so drop its own Jack port
+  if (to_port->sys_port) {
+    jack_port_unregister(to->client, (jack_port_t*)to_port->sys_port);
+    to_port->sys_port = NULL;
+  }
+
+  return 0;
+}
+
+int
+jalv_backend_prepare_graph(JalvBackend* const backend,
+                           const uint32_t     n_threads)
+{
+  if (backend->host || backend->graph) {
+    return 1;
+  }
+
+  uint32_t n_nodes = 0U;
+  for (JalvBackend* b = backend; b; b = b->next) {
+    ++n_nodes;
+  }
+
+  JalvGraph* const    graph = jalv_graph_new(n_nodes, run_node, backend);
+  JalvBackend** const nodes =
+    (JalvBackend**)calloc(n_nodes, sizeof(JalvBackend*));
+
+  ZixStatus st = (graph && nodes) ? ZIX_STATUS_SUCCESS : ZIX_STATUS_NO_MEM;
+  for (JalvBackend* b = backend; !st && b; b = b->next) {
+    nodes[b->node] = b;
+  }
+
+  for (uint32_t i = 0U; !st && i < backend->n_links; ++i) {
+    st = jalv_graph_add_edge(
+      graph, backend->links[i * 2U], backend->links[i * 2U + 1U]);
+  }
+
+  if (st || (st = jalv_graph_prepare(graph)) ||
+      (st = jalv_graph_launch(graph, n_threads, init_graph_thread))) {
+    jalv_graph_free(graph);
+    free(nodes);
+    return 1;
+  }
+
+  backend->graph = graph;
+  backend->nodes = nodes;
   return 0;
 }
 
 void
 jalv_backend_close(JalvBackend* const backend)
 {
-  if (backend && backend->client && !backend->is_internal_client) {
+  if (backend && backend->graph) {
+    jalv_graph_exit(backend->graph);
+  }
+
+  if (backend && backend->client && !backend->host &&
+      !backend->is_internal_client) {
     jack_client_close(backend->client);
   }
 }
@@ -434,17 +675,48 @@ jalv_backend_close(JalvBackend* const backend)
 void
 jalv_backend_activate(JalvBackend* const backend)
 {
-  jack_activate(backend->client);
+  if (!backend->host) {
+    jack_activate(backend->client);
+  }
 }
 
 void
 jalv_backend_deactivate(JalvBackend* const backend)
 {
-  if (!backend->is_internal_client && backend->client) {
+  if (!backend->is_internal_client && !backend->host && backend->client) {
     jack_deactivate(backend->client);
   }
 }
 
+/// Register a Jack port, prefixed with the backend's name if it's shared
+static jack_port_t*
+register_port(const JalvBackend* const backend,
+              const char* const        symbol,
+              const char* const        type,
+              const unsigned long      flags)
+{
+  if (!backend->prefix) {
+    return jack_port_register(backend->client, symbol, type, flags, 0);
+  }
+
+  const size_t prefix_len = strlen(backend->prefix);
+  const size_t symbol_len = strlen(symbol);
+  char* const  name       = (char*)malloc(prefix_len + symbol_len + 2U);
+  if (!name) {
+    return NULL;
+  }
+
+  memcpy(name, backend->prefix, prefix_len);
+  name[prefix_len] = '/';
+  memcpy(name + prefix_len + 1U, symbol, symbol_len + 1U);
+
+  jack_port_t* const port =
+    jack_port_register(backend->client, name, type, flags, 0);
+
+  free(name);
+  return port;
+}
+
 void
 jalv_backend_activate_port(JalvBackend* const backend,
                            JalvProcess* const proc,
@@ -472,13 +744,13 @@ jalv_backend_activate_port(JalvBackend* const backend,
       proc->instance, port_index, &proc->controls_buf[port_index]);
     break;
   case TYPE_AUDIO:
-    port->sys_port = jack_port_register(
-      client, port->symbol, JACK_DEFAULT_AUDIO_TYPE, jack_flags, 0);
+    port->sys_port = register_port(
+      backend, port->symbol, JACK_DEFAULT_AUDIO_TYPE, jack_flags);
     break;
 #if USE_JACK_METADATA
   case TYPE_CV:
-    port->sys_port = jack_port_register(
-      client, port->symbol, JACK_DEFAULT_AUDIO_TYPE, jack_flags, 0);
+    port->sys_port = register_port(
+      backend, port->symbol, JACK_DEFAULT_AUDIO_TYPE, jack_flags);
     if (port->sys_port) {
       jack_set_property(client,
                         jack_port_uuid(port->sys_port),
@@ -490,8 +762,8 @@ jalv_backend_activate_port(JalvBackend* const backend,
 #endif
   case TYPE_EVENT:
     if (port->supports_midi) {
-      port->sys_port = jack_port_register(
-        client, port->symbol, JACK_DEFAULT_MIDI_TYPE, jack_flags, 0);
+      port->sys_port = register_port(
+        backend, port->symbol, JACK_DEFAULT_MIDI_TYPE, jack_flags);
     }
     break;
   }
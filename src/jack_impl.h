@@ -1,29 +1,43 @@
-// Copyright 2007-2024 David Robillard <d@drobilla.net>
+// Copyright 2007-2026 David Robillard <d@drobilla.net>
 // SPDX-License-Identifier: ISC
 
 #ifndef JALV_JACK_IMPL_H
 #define JALV_JACK_IMPL_H
 
 #include "attributes.h"
+#include "graph.h"
 #include "process.h"
 #include "settings.h"
+#include "time_position.h"
 #include "urids.h"
 
 #include <jack/types.h>
 #include <zix/sem.h>
 
 #include <stdbool.h>
+#include <stdint.h>
 
 // Definition of Jack backend structure (private to implementation)
 JALV_BEGIN_DECLS
 
 struct JalvBackendImpl {
-  const JalvURIDs* urids;              ///< Application vocabulary
-  JalvSettings*    settings;           ///< Run settings
-  JalvProcess*     process;            ///< Process thread state
-  ZixSem*          done;               ///< Shutdown semaphore
-  jack_client_t*   client;             ///< Jack client
-  bool             is_internal_client; ///< Running inside jackd
+  const JalvURIDs*       urids;              ///< Application vocabulary
+  JalvSettings*          settings;           ///< Run settings
+  JalvProcess*           process;            ///< Process thread state
+  ZixSem*                done;               ///< Shutdown semaphore
+  jack_client_t*         client;             ///< Jack client
+  JalvBackend*           host;               ///< Backend that owns client
+  JalvBackend*           next;               ///< Next backend sharing client
+  char*                  prefix;             ///< Port name prefix, or null
+  JalvGraph*             graph;              ///< Graph of plugins, or null
+  JalvBackend**          nodes;              ///< Backends by graph node
+  uint32_t*              links;              ///< Pairs of linked graph nodes
+  uint32_t               n_links;            ///< Number of links
+  uint32_t               node;               ///< Index of graph node
+  JalvTimePosition       position;           ///< Position sent to plugin
+  jack_position_t        transport_pos;      ///< Client position this cycle
+  jack_transport_state_t transport_state;    ///< Client state this cycle
+  bool                   is_internal_client; ///< Running inside jackd
 };
 
 JALV_END_DECLS
@@ -4,27 +4,37 @@
 #include "jalv.h"
 
 #include "any_value.h"
+#include "atomic.h"
 #include "backend.h"
+#include "clock.h"
 #include "comm.h"
 #include "control.h"
 #include "dumper.h"
 #include "features.h"
 #include "frontend.h"
 #include "jalv_config.h"
+#include "load.h"
 #include "log.h"
+#include "mailbox.h"
 #include "macros.h"
 #include "mapper.h"
 #include "nodes.h"
 #include "options.h"
 #include "patch.h"
+#include "plugin_index.h"
 #include "port.h"
+#include "preset_cache.h"
 #include "process.h"
 #include "process_setup.h"
 #include "settings.h"
 #include "state.h"
 #include "string_utils.h"
+#include "symap.h"
+#include "timeline.h"
+#include "traffic.h"
 #include "types.h"
 #include "urids.h"
+#include "wakeup.h"
 #include "worker.h"
 
 #include <lilv/lilv.h>
@@ -53,6 +63,8 @@
 #endif
 
 #include <assert.h>
+#include <inttypes.h>
+#include <math.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -69,6 +81,15 @@
 */
 #define N_BUFFER_CYCLES 16
 
+/// Space for records in a traffic log, which is allocated up front
+#define TRAFFIC_LOG_SIZE (64U << 20U)
+
+/// Largest size that communication rings are automatically grown to
+#define MAX_RING_SIZE (1U << 30U)
+
+/// Maximum time to spend parsing presets into the cache in one update
+#define PRESET_CACHE_BUDGET_NS 4000000U
+
 /// These features have no data
 static const LV2_Feature static_features[] = {
   {LV2_STATE__loadDefaultState, NULL},
@@ -121,6 +142,14 @@ create_port(Jalv* jalv, uint32_t port_index)
   port->type = pport->type;
   port->flow = pport->flow;
 
+  // Index the port by symbol, keeping the first if there are duplicates
+  if (!symap_try_map(jalv->port_symbols, pport->symbol)) {
+    const uint32_t id = symap_map(jalv->port_symbols, pport->symbol);
+    if (id) {
+      jalv->symbol_ports[id - 1U] = port_index;
+    }
+  }
+
   if (lilv_port_is_a(
         jalv->plugin, port->lilv_port, jalv->nodes.lv2_ControlPort)) {
     add_control(&jalv->controls,
@@ -169,6 +198,30 @@ jalv_create_ports(Jalv* jalv)
   lilv_plugin_get_port_ranges_float(
     jalv->plugin, NULL, NULL, jalv->process.controls_buf);
 
+  // Allocate control values sent to UI, initially NaN so all are sent first
+  jalv->process.sent_controls = (float*)calloc(n_ports, sizeof(float));
+  if (!jalv->process.sent_controls) {
+    return 1;
+  }
+
+  for (uint32_t i = 0U; i < n_ports; ++i) {
+    jalv->process.sent_controls[i] = NAN;
+  }
+
+  // Allocate mailboxes for control values in both directions
+  jalv->process.ui_controls     = jalv_mailbox_new(n_ports);
+  jalv->process.plugin_controls = jalv_mailbox_new(n_ports);
+  if (!jalv->process.ui_controls || !jalv->process.plugin_controls) {
+    return 1;
+  }
+
+  // Allocate index for finding ports by symbol
+  jalv->port_symbols = symap_new();
+  jalv->symbol_ports = (uint32_t*)calloc(n_ports + 1U, sizeof(uint32_t));
+  if (!jalv->port_symbols || !jalv->symbol_ports) {
+    return 1;
+  }
+
   for (uint32_t i = 0; i < jalv->num_ports; ++i) {
     if (create_port(jalv, i)) {
       return 1;
@@ -178,26 +231,14 @@ jalv_create_ports(Jalv* jalv)
   return 0;
 }
 
-/**
-   Get a port structure by symbol.
-
-   TODO: Build an index to make this faster, currently O(n) which may be
-   a problem when restoring the state of plugins with many ports.
-*/
+/// Get a port structure by symbol
 JalvPort*
 jalv_port_by_symbol(Jalv* jalv, const char* sym)
 {
-  for (uint32_t i = 0; i < jalv->num_ports; ++i) {
-    JalvPort* const port = &jalv->ports[i];
-    const LilvNode* port_sym =
-      lilv_port_get_symbol(jalv->plugin, port->lilv_port);
-
-    if (!strcmp(lilv_node_as_string(port_sym), sym)) {
-      return port;
-    }
-  }
+  const uint32_t id =
+    jalv->port_symbols ? symap_try_map(jalv->port_symbols, sym) : 0U;
 
-  return NULL;
+  return id ? &jalv->ports[jalv->symbol_ports[id - 1U]] : NULL;
 }
 
 static void
@@ -221,15 +262,12 @@ jalv_create_controls(Jalv* jalv, bool writable)
         lilv_world_ask(
           world, lilv_plugin_get_uri(plugin), patch_writable, property)) {
       // Find existing writable control
-      for (size_t i = 0; i < jalv->controls.n_controls; ++i) {
-        if (lilv_node_equals(jalv->controls.controls[i]->node, property)) {
-          record              = jalv->controls.controls[i];
-          record->is_readable = true;
-          break;
-        }
-      }
+      record = get_property_control(
+        &jalv->controls,
+        jalv_mapper_map_uri(jalv->mapper, lilv_node_as_uri(property)));
 
       if (record) {
+        record->is_readable = true;
         continue;
       }
     }
@@ -302,7 +340,7 @@ jalv_send_to_plugin(void* const       jalv_handle,
       st = ZIX_STATUS_BAD_ARG;
     } else {
       const float value = *(const float*)buffer;
-      st = jalv_write_control(proc->ui_to_plugin, port_index, value);
+      jalv_mailbox_write(proc->ui_controls, port_index, value);
     }
 
   } else if (protocol == jalv->urids.atom_eventTransfer) {
@@ -316,9 +354,12 @@ jalv_send_to_plugin(void* const       jalv_handle,
         (sizeof(LV2_Atom) + atom->size != buffer_size)) {
       st = ZIX_STATUS_BAD_ARG;
     } else {
-      jalv_dump_atom(jalv->dumper, stdout, "UI => Plugin", atom, 36);
+      jalv_dump_atom(jalv->dumper, JALV_DUMP_UI_TO_PLUGIN, port_index, atom);
       st = jalv_write_event(
         proc->ui_to_plugin, port_index, atom->size, atom->type, atom + 1U);
+      if (st) {
+        jalv_atomic_increment(&proc->to_plugin_stats.n_dropped);
+      }
     }
 
   } else {
@@ -350,7 +391,7 @@ jalv_set_control(Jalv* const       jalv,
   }
 
   if (control->type == PORT && type == jalv->forge.Float) {
-    jalv_write_control(jalv->process.ui_to_plugin,
+    jalv_mailbox_write(jalv->process.ui_controls,
                        control->id.index,
                        any_value_number(&control->value, &jalv->forge));
   }
@@ -377,6 +418,31 @@ jalv_set_control(Jalv* const       jalv,
   return st;
 }
 
+int
+jalv_schedule_control(Jalv* const          jalv,
+                      const Control* const control,
+                      const uint64_t       frame,
+                      const float          value)
+{
+  if (control->type != PORT) {
+    return ZIX_STATUS_BAD_ARG;
+  }
+
+  const JalvTimedChange   change = {frame, control->id.index, value};
+  const JalvMessageHeader header = {TIMED_CHANGE, sizeof(change)};
+
+  const ZixStatus st = jalv_write_split_message(jalv->process.ui_to_plugin,
+                                                &header,
+                                                sizeof(header),
+                                                &change,
+                                                sizeof(change));
+  if (st) {
+    jalv_atomic_increment(&jalv->process.to_plugin_stats.n_dropped);
+  }
+
+  return st;
+}
+
 #if USE_SUIL
 static uint32_t
 jalv_ui_port_index(void* const controller, const char* symbol)
@@ -388,6 +454,127 @@ jalv_ui_port_index(void* const controller, const char* symbol)
 }
 #endif
 
+/// Return which events from an output port a custom UI has subscribed to
+static uint32_t
+ui_port_subscription(const Jalv* const      jalv,
+                     const LilvNodes* const notifications,
+                     const uint32_t         index,
+                     LV2_URID* const        types)
+{
+  LilvWorld* const       world  = jalv->world;
+  const JalvNodes* const nodes  = &jalv->nodes;
+  const LilvNode* const  symbol = lilv_port_get_symbol(
+    jalv->plugin, jalv->ports[index].lilv_port);
+
+  uint32_t flags   = 0U;
+  uint32_t n_types = 0U;
+  LILV_FOREACH (nodes, n, notifications) {
+    const LilvNode* const note = lilv_nodes_get(notifications, n);
+
+    LilvNode* const note_symbol =
+      lilv_world_get(world, note, nodes->lv2_symbol, NULL);
+    LilvNode* const note_index =
+      lilv_world_get(world, note, nodes->ui_portIndex, NULL);
+    LilvNode* const note_type =
+      lilv_world_get(world, note, nodes->ui_notifyType, NULL);
+
+    if (lilv_node_equals(note_symbol, symbol) ||
+        (lilv_node_is_int(note_index) &&
+         lilv_node_as_int(note_index) == (int)index)) {
+      // Send only the given type, or everything if there are too many
+      if (lilv_node_equals(note_type, nodes->atom_Object) ||
+          lilv_node_equals(note_type, nodes->atom_Blank)) {
+        flags |= JALV_FORWARD_OBJECTS;
+      } else if (lilv_node_is_uri(note_type) &&
+                 n_types < JALV_MAX_NOTIFY_TYPES) {
+        types[n_types++] =
+          jalv_mapper_map_uri(jalv->mapper, lilv_node_as_uri(note_type));
+        flags |= JALV_FORWARD_TYPES;
+      } else {
+        flags |= JALV_FORWARD_ALL;
+      }
+    }
+
+    lilv_node_free(note_type);
+    lilv_node_free(note_index);
+    lilv_node_free(note_symbol);
+  }
+
+  return flags;
+}
+
+/// Restrict dumping to the ports and types given as options
+static int
+set_dump_filters(Jalv* const jalv)
+{
+  for (char** f = jalv->opts.dump_filters; f && *f; ++f) {
+    // Symbols can't contain colons, so anything with one is a type URI
+    if (strchr(*f, ':')) {
+      const LV2_URID type = jalv_mapper_map_uri(jalv->mapper, *f);
+      if (jalv_dumper_filter_type(jalv->dumper, type)) {
+        return 1;
+      }
+    } else {
+      // Filter anyway, so a plugin without the port dumps nothing
+      const JalvPort* const port  = jalv_port_by_symbol(jalv, *f);
+      const uint32_t        index = port ? port->index : UINT32_MAX;
+      if (!port) {
+        jalv_log(&jalv->log, JALV_LOG_WARNING, "No port \"%s\" to dump", *f);
+      }
+
+      if (jalv_dumper_filter_port(jalv->dumper, index)) {
+        return 1;
+      }
+    }
+  }
+
+  return 0;
+}
+
+/// Set which events from output ports are sent to the UI
+static void
+update_event_forwarding(Jalv* const jalv)
+{
+  // Dump everything, or send objects for parameters unless there's no prompt
+  const uint32_t base = jalv->dumper                 ? JALV_FORWARD_ALL
+                        : !jalv->opts.non_interactive ? JALV_FORWARD_OBJECTS
+                                                      : 0U;
+
+  // Send what a custom UI subscribed to, or everything if it didn't say
+  bool       custom_ui     = false;
+  LilvNodes* notifications = NULL;
+#if USE_SUIL
+  if (jalv->ui_instance) {
+    const LilvNode* const ui_node = lilv_ui_get_uri(jalv->ui);
+
+    lilv_world_load_resource(jalv->world, ui_node);
+    custom_ui     = true;
+    notifications = lilv_world_find_nodes(
+      jalv->world, ui_node, jalv->nodes.ui_portNotification, NULL);
+  }
+#endif
+
+  const bool subscribed = notifications && lilv_nodes_size(notifications);
+  for (uint32_t i = 0U; i < jalv->num_ports; ++i) {
+    JalvProcessPort* const port = &jalv->process.ports[i];
+    if (port->type == TYPE_EVENT && port->flow == FLOW_OUTPUT) {
+      LV2_URID types[JALV_MAX_NOTIFY_TYPES] = {0U};
+
+      uint32_t forward = custom_ui ? JALV_FORWARD_ALL : base;
+      if (subscribed) {
+        forward = base | ui_port_subscription(jalv, notifications, i, types);
+      }
+
+      // Stop sending typed events while the types are changed
+      jalv_atomic_store(&port->forward, forward & ~JALV_FORWARD_TYPES);
+      memcpy(port->notify_types, types, sizeof(types));
+      jalv_atomic_store(&port->forward, forward);
+    }
+  }
+
+  lilv_nodes_free(notifications);
+}
+
 void
 jalv_instantiate_ui(Jalv* jalv, const char* native_ui_type, void* parent)
 {
@@ -436,6 +623,7 @@ jalv_instantiate_ui(Jalv* jalv, const char* native_ui_type, void* parent)
 
   lilv_free(binary_path);
   lilv_free(bundle_path);
+  update_event_forwarding(jalv);
 #else
   (void)jalv;
   (void)native_ui_type;
@@ -533,6 +721,57 @@ update_error(Jalv* const jalv, const char* const message)
   return 1;
 }
 
+static void
+report_load(Jalv* const jalv, const JalvLoadReport* const report)
+{
+  const uint32_t n_old_xruns = jalv->load.n_xruns;
+  const uint32_t n_new_xruns = report->n_xruns >= n_old_xruns
+                                 ? report->n_xruns - n_old_xruns
+                                 : report->n_xruns; // Reactivated
+
+  jalv->load = *report;
+  if (n_new_xruns) {
+    const uint32_t* const loads = report->xrun_cycle;
+    jalv_log(&jalv->log,
+             JALV_LOG_WARNING,
+             "%u xrun(s), worst recent cycle %.1f%% (plugin %.1f%%, host "
+             "%.1f%%)",
+             n_new_xruns,
+             loads[JALV_STAGE_CYCLE] * 100.0 / JALV_LOAD_FULL,
+             jalv_load_plugin(loads) * 100.0 / JALV_LOAD_FULL,
+             jalv_load_host(loads) * 100.0 / JALV_LOAD_FULL);
+  }
+}
+
+/// Parse presets for a limited time and report when the cache is full
+static void
+update_preset_cache(Jalv* const jalv)
+{
+  JalvPresetCache* const cache = jalv->preset_cache;
+  if (!jalv_preset_cache_fill(cache,
+                              jalv_clock_now() + PRESET_CACHE_BUDGET_NS)) {
+    return;
+  }
+
+  JalvPresetCacheStats stats = {0U, 0U, 0U, 0U, 0U};
+  jalv_preset_cache_stats(cache, &stats);
+  if (stats.n_loaded == stats.n_presets) {
+    jalv_log(&jalv->log,
+             JALV_LOG_INFO,
+             "Cached %u presets in %.3f ms",
+             stats.n_presets,
+             (double)stats.load_ns / 1000000.0);
+  } else {
+    jalv_wakeup_signal(&jalv->process.ui_wakeup); // Continue next update
+  }
+}
+
+static void
+ui_control_event(void* const handle, const uint32_t index, const float value)
+{
+  ui_port_event((Jalv*)handle, index, sizeof(float), 0, &value);
+}
+
 int
 jalv_update(Jalv* jalv)
 {
@@ -548,6 +787,9 @@ jalv_update(Jalv* jalv)
 
   jalv->updating = true;
 
+  // Clear wakeup first so that anything sent from now on wakes us again
+  jalv_wakeup_clear(&jalv->process.ui_wakeup);
+
   // Emit UI events
   ZixRing* const    ring   = jalv->process.plugin_to_ui;
   JalvMessageHeader header = {NO_MESSAGE, 0U};
@@ -564,12 +806,10 @@ jalv_update(Jalv* jalv)
       return update_error(jalv, "Failed to read message from process ring\n");
     }
 
-    if (header.type == CONTROL_PORT_CHANGE) {
-      const JalvControlChange* const msg = (const JalvControlChange*)body;
-      ui_port_event(jalv, msg->port_index, sizeof(float), 0, &msg->value);
-    } else if (header.type == EVENT_TRANSFER) {
+    if (header.type == EVENT_TRANSFER) {
       const JalvEventTransfer* const msg = (const JalvEventTransfer*)body;
-      jalv_dump_atom(jalv->dumper, stdout, "Plugin => UI", &msg->atom, 35);
+      jalv_dump_atom(
+        jalv->dumper, JALV_DUMP_PLUGIN_TO_UI, msg->port_index, &msg->atom);
       ui_port_event(jalv,
                     msg->port_index,
                     sizeof(LV2_Atom) + msg->atom.size,
@@ -577,11 +817,21 @@ jalv_update(Jalv* jalv)
                     &msg->atom);
     } else if (header.type == LATENCY_CHANGE) {
       jalv_backend_recompute_latencies(jalv->backend);
+    } else if (header.type == LOAD_REPORT) {
+      report_load(jalv, (const JalvLoadReport*)body);
     } else {
       return update_error(jalv, "Unknown message type in process ring\n");
     }
   }
 
+  // Emit the latest value of every control that changed since last update
+  jalv_mailbox_read(jalv->process.plugin_controls, ui_control_event, jalv);
+
+  // Parse a few more presets if the cache isn't full yet
+  if (jalv->preset_cache) {
+    update_preset_cache(jalv);
+  }
+
   jalv->updating = false;
   return 1;
 }
@@ -589,9 +839,11 @@ jalv_update(Jalv* jalv)
 static bool
 jalv_apply_control_arg(Jalv* jalv, const char* s)
 {
-  char  sym[256] = {'\0'};
-  float val      = 0.0f;
-  if (sscanf(s, "%240[^=]=%f", sym, &val) != 2) {
+  char      sym[256] = {'\0'};
+  float     val      = 0.0f;
+  uint64_t  frame    = 0U;
+  const int n_fields = sscanf(s, "%240[^=]=%f@%" SCNu64, sym, &val, &frame);
+  if (n_fields < 2) {
     jalv_log(&jalv->log, JALV_LOG_WARNING, "Ignoring invalid value `%s'", s);
     return false;
   }
@@ -605,6 +857,20 @@ jalv_apply_control_arg(Jalv* jalv, const char* s)
     return false;
   }
 
+  if (n_fields == 3) {
+    if (jalv_schedule_control(jalv, control, frame, val)) {
+      jalv_log(&jalv->log,
+               JALV_LOG_WARNING,
+               "Failed to schedule value for `%s'",
+               sym);
+      return false;
+    }
+
+    jalv_log(
+      &jalv->log, JALV_LOG_INFO, "%s = %f at frame %" PRIu64, sym, val, frame);
+    return true;
+  }
+
   jalv_set_control(jalv, control, sizeof(float), jalv->urids.atom_Float, &val);
   jalv_log(&jalv->log, JALV_LOG_INFO, "%s = %f", sym, val);
 
@@ -722,6 +988,12 @@ jalv_init_features(Jalv* const jalv)
   init_feature(
     &jalv->features.sched_feature, LV2_WORKER__schedule, &jalv->features.sched);
 
+  // worker:schedule (normal, for a shadow instance during state restore)
+  jalv->features.shadow_sched.schedule_work = jalv_worker_schedule;
+  init_feature(&jalv->features.shadow_sched_feature,
+               LV2_WORKER__schedule,
+               &jalv->features.shadow_sched);
+
   // worker:schedule (state)
   jalv->features.ssched.schedule_work = jalv_worker_schedule;
   init_feature(&jalv->features.state_sched_feature,
@@ -783,6 +1055,57 @@ jalv_init_ui_settings(Jalv* const jalv)
            settings->ui_scale_factor);
 }
 
+/// Load the world, using the plugin index to load as little as possible
+static LilvWorld*
+load_world(Jalv* const jalv, const char* const load_arg)
+{
+  LilvWorld* const world = lilv_world_new();
+  lilv_world_set_option(world, LILV_OPTION_OBJECT_INDEX, NULL);
+
+  // Only plugin and preset URIs can be found in the index
+  const char* const index_path = jalv->opts.plugin_index;
+  if (!index_path || !load_arg ||
+      !serd_uri_string_has_scheme((const uint8_t*)load_arg)) {
+    lilv_world_load_all(world);
+    return world;
+  }
+
+  // Try to load only the bundles needed for the plugin
+  const uint64_t  start = jalv_clock_now();
+  const ZixStatus st    = jalv_plugin_index_load(world, index_path, load_arg);
+  if (!st) {
+    jalv_log(&jalv->log,
+             JALV_LOG_INFO,
+             "Loaded plugin from index in %.3f ms",
+             (double)(jalv_clock_now() - start) / 1000000.0);
+    return world;
+  }
+
+  // Fall back to loading everything
+  lilv_world_load_all(world);
+
+  // Rebuild the index if it's stale, or if it's missing an existing URI
+  bool rebuild = st != ZIX_STATUS_NOT_FOUND && st != ZIX_STATUS_NOT_SUPPORTED;
+  if (st == ZIX_STATUS_NOT_FOUND) {
+    LilvNode* const uri = lilv_new_uri(world, load_arg);
+    rebuild             = lilv_world_ask(world, uri, NULL, NULL);
+    lilv_node_free(uri);
+  }
+
+  if (rebuild) {
+    const ZixStatus wst = jalv_plugin_index_save(world, index_path);
+    if (wst) {
+      jalv_log(&jalv->log,
+               JALV_LOG_WARNING,
+               "Failed to write plugin index \"%s\" (%s)",
+               index_path,
+               zix_strerror(wst));
+    }
+  }
+
+  return world;
+}
+
 /// Find the initial state and set jalv->plugin
 static LilvState*
 open_plugin_state(Jalv* const         jalv,
@@ -868,6 +1191,61 @@ jalv_init(Jalv* const jalv, const int argc, char** const argv)
 #endif
 }
 
+/// Return true if a plugin requires blocks of a fixed or power of 2 length
+static bool
+requires_block_length(const LilvPlugin* const plugin)
+{
+  LilvNodes* const features = lilv_plugin_get_required_features(plugin);
+  bool             requires = false;
+  LILV_FOREACH (nodes, f, features) {
+    const char* const uri = lilv_node_as_uri(lilv_nodes_get(features, f));
+    if (!strcmp(uri, LV2_BUF_SIZE__fixedBlockLength) ||
+        !strcmp(uri, LV2_BUF_SIZE__powerOf2BlockLength)) {
+      requires = true;
+    }
+  }
+
+  lilv_nodes_free(features);
+  return requires;
+}
+
+/// Return true if an earlier instance in the client of `jalv` has a name
+static bool
+instance_name_is_taken(const Jalv* const jalv, const char* const name)
+{
+  for (const Jalv* j = jalv->host ? jalv->host : jalv; j != jalv; j = j->next) {
+    if (j->instance_name && !strcmp(j->instance_name, name)) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+/// Return a name for a plugin that's unique among those sharing a client
+static char*
+make_instance_name(const Jalv* const jalv)
+{
+  const char* const base = lilv_node_as_string(jalv->plugin_name);
+  const size_t      len  = strlen(base);
+  char* const       name = (char*)calloc(1, len + 12U);
+  if (!name) {
+    return NULL;
+  }
+
+  // Avoid colons, which separate the client and port parts of Jack names
+  for (size_t i = 0U; i < len; ++i) {
+    name[i] = base[i] == ':' ? '_' : base[i];
+  }
+
+  // Add a number if an earlier instance has the same name
+  for (unsigned n = 2U; instance_name_is_taken(jalv, name); ++n) {
+    snprintf(name + len, 12U, " %u", n);
+  }
+
+  return name;
+}
+
 static bool
 is_pow2(const uint32_t i)
 {
@@ -880,26 +1258,31 @@ jalv_open(Jalv* const jalv, const char* const load_arg)
   JalvSettings* const settings = &jalv->settings;
 
   settings->max_block_length = jalv->opts.block_length;
+  settings->split_length     = jalv->opts.split_length;
   settings->midi_buf_size    = 1024U;
   settings->ring_size        = jalv->opts.ring_size;
   settings->ui_update_hz     = jalv->opts.update_rate;
   settings->ui_scale_factor  = jalv->opts.scale_factor;
 
-  // Load the LV2 world
-  LilvWorld* const world = lilv_world_new();
-  lilv_world_set_option(world, LILV_OPTION_OBJECT_INDEX, NULL);
-  lilv_world_load_all(world);
+  // Load the LV2 world, or share the host's along with its URI mapper
+  Jalv* const      host  = jalv->host;
+  LilvWorld* const world = host ? host->world : load_world(jalv, load_arg);
 
   jalv->world       = world;
-  jalv->mapper      = jalv_mapper_new();
+  jalv->mapper      = host ? host->mapper : jalv_mapper_new();
   jalv->log.urids   = &jalv->urids;
   jalv->log.tracing = jalv->opts.trace;
 
   // Set up atom dumping for debugging if enabled
   LV2_URID_Map* const   urid_map   = jalv_mapper_urid_map(jalv->mapper);
   LV2_URID_Unmap* const urid_unmap = jalv_mapper_urid_unmap(jalv->mapper);
-  if (jalv->opts.dump) {
-    jalv->dumper = jalv_dumper_new(urid_map, urid_unmap);
+  if (jalv->opts.dump || jalv->opts.dump_file) {
+    jalv->dumper = jalv_dumper_new(
+      urid_map, urid_unmap, jalv->opts.dump, jalv->opts.dump_file);
+    if (!jalv->dumper) {
+      jalv_log(&jalv->log, JALV_LOG_ERR, "Failed to set up atom dumping");
+      return -12;
+    }
   }
 
   zix_sem_init(&jalv->work_lock, 1);
@@ -926,6 +1309,27 @@ jalv_open(Jalv* const jalv, const char* const load_arg)
     jalv->opts.name = jalv_strdup(lilv_node_as_string(jalv->plugin_name));
   }
 
+  // Give each plugin that shares an audio client a unique name
+  if (host || jalv->next) {
+    jalv->instance_name = make_instance_name(jalv);
+    if (jalv_backend_share(jalv->backend,
+                           host ? host->backend : NULL,
+                           jalv->instance_name)) {
+      jalv_log(&jalv->log,
+               JALV_LOG_ERR,
+               "Audio system can't run several plugins in one client");
+      return -6;
+    }
+  }
+
+  // Only split blocks at timed changes if the plugin can handle it
+  if (settings->split_length && requires_block_length(jalv->plugin)) {
+    jalv_log(&jalv->log,
+             JALV_LOG_WARNING,
+             "Plugin requires a fixed block length, not splitting blocks");
+    settings->split_length = 0U;
+  }
+
   // Check for thread-safe state restore() method
   jalv->safe_restore =
     lilv_plugin_has_feature(jalv->plugin, jalv->nodes.state_threadSafeRestore);
@@ -942,14 +1346,34 @@ jalv_open(Jalv* const jalv, const char* const load_arg)
   jalv_process_init(
     &jalv->process, &jalv->urids, jalv->mapper, jalv->opts.trace);
 
-  // Create workers if necessary
-  if (lilv_plugin_has_extension_data(jalv->plugin,
-                                     jalv->nodes.work_interface)) {
-    jalv->process.worker        = jalv_worker_new(&jalv->work_lock, true);
-    jalv->features.sched.handle = jalv->process.worker;
-    if (jalv->safe_restore) {
-      jalv->process.state_worker   = jalv_worker_new(&jalv->work_lock, false);
-      jalv->features.ssched.handle = jalv->process.state_worker;
+  // Log plugin messages from the process thread through a shared ring
+  jalv->log.ring    = host ? host->log.ring : jalv_log_ring_new();
+  jalv->process.log = &jalv->log;
+
+  // Record and/or replay messages between the plugin and UI
+  const char* const traffic_log = jalv->opts.traffic_log;
+  const char* const replay_log  = jalv->opts.replay_log;
+  if (traffic_log) {
+    jalv->process.traffic = jalv_traffic_new(
+      traffic_log, TRAFFIC_LOG_SIZE, jalv_mapper_urid_unmap(jalv->mapper));
+    if (!jalv->process.traffic) {
+      jalv_log(&jalv->log,
+               JALV_LOG_ERR,
+               "Failed to create traffic log \"%s\"",
+               traffic_log);
+      return -13;
+    }
+  }
+
+  if (replay_log) {
+    jalv->process.replay =
+      jalv_replay_new(replay_log, jalv_mapper_urid_map(jalv->mapper));
+    if (!jalv->process.replay) {
+      jalv_log(&jalv->log,
+               JALV_LOG_ERR,
+               "Failed to load traffic log \"%s\"",
+               replay_log);
+      return -13;
     }
   }
 
@@ -958,6 +1382,12 @@ jalv_open(Jalv* const jalv, const char* const load_arg)
     return -10;
   }
 
+  if (jalv->dumper && set_dump_filters(jalv)) {
+    return -12;
+  }
+
+  update_event_forwarding(jalv);
+
   // Open backend (to set the sample rate, among other things)
   if (jalv_backend_open(jalv->backend,
                         &jalv->log,
@@ -965,12 +1395,39 @@ jalv_open(Jalv* const jalv, const char* const load_arg)
                         &jalv->settings,
                         &jalv->process,
                         &jalv->done,
-                        jalv->opts.name,
-                        jalv->opts.name_exact)) {
+                        &jalv->opts)) {
     jalv_log(&jalv->log, JALV_LOG_ERR, "Failed to connect to audio system");
     return -6;
   }
 
+  // Allow shorter blocks when splitting cycles at timed changes
+  if (settings->split_length) {
+    settings->min_block_length =
+      MIN(settings->split_length, settings->max_block_length);
+  }
+
+  // Set up the internal transport now that the sample rate is known
+  for (char** t = jalv->opts.tempos; t && *t; ++t) {
+    if (jalv_timeline_parse_tempo(&jalv->process.timeline, *t)) {
+      jalv_log(&jalv->log, JALV_LOG_ERR, "Invalid tempo \"%s\"", *t);
+      return -11;
+    }
+  }
+
+  if (jalv_timeline_prepare(&jalv->process.timeline,
+                            &jalv->process.forge,
+                            &jalv->urids,
+                            settings->sample_rate)) {
+    jalv_log(&jalv->log, JALV_LOG_ERR, "Failed to prepare tempo map");
+    return -11;
+  }
+
+  // Convert the silence tail to frames now that the sample rate is known
+  if (jalv->opts.sleep_tail > 0.0) {
+    const double frames = jalv->opts.sleep_tail * settings->sample_rate;
+    settings->sleep_length = frames < 1.0 ? 1U : (uint32_t)frames;
+  }
+
   jalv_log(
     &jalv->log, JALV_LOG_INFO, "Sample rate: %.0f Hz", settings->sample_rate);
   jalv_log(&jalv->log,
@@ -989,6 +1446,28 @@ jalv_open(Jalv* const jalv, const char* const load_arg)
   jalv_init_ui_settings(jalv);
   jalv_init_lv2_options(&jalv->features, &jalv->urids, settings);
 
+  // Create workers if necessary (which only need threads when running live)
+  if (lilv_plugin_has_extension_data(jalv->plugin,
+                                     jalv->nodes.work_interface)) {
+    const uint32_t n_threads =
+      settings->offline ? 0U : MAX(1U, jalv->opts.worker_threads);
+    if (n_threads > 1U) {
+      jalv_log(&jalv->log,
+               JALV_LOG_WARNING,
+               "Using %u worker threads, plugin work must be thread-safe",
+               n_threads);
+    }
+
+    jalv->process.worker =
+      jalv_worker_new(&jalv->work_lock, n_threads, settings->ring_size);
+    jalv->features.sched.handle = jalv->process.worker;
+    if (jalv->safe_restore) {
+      jalv->process.state_worker =
+        jalv_worker_new(&jalv->work_lock, 0U, settings->ring_size);
+      jalv->features.ssched.handle = jalv->process.state_worker;
+    }
+  }
+
   // Create Plugin => UI communication buffers
   jalv->ui_msg_size = MAX(jalv->ui_msg_size, settings->midi_buf_size);
   jalv->ui_msg      = zix_aligned_alloc(NULL, 8U, jalv->ui_msg_size);
@@ -1018,7 +1497,7 @@ jalv_open(Jalv* const jalv, const char* const load_arg)
     jalv->feature_list[n_features++] = &jalv->features.fixed_block_feature;
   }
 
-  if (is_pow2(settings->min_block_length) &&
+  if (!settings->split_length && is_pow2(settings->min_block_length) &&
       is_pow2(settings->max_block_length)) {
     jalv->feature_list[n_features++] = &jalv->features.pow2_block_feature;
   }
@@ -1077,6 +1556,14 @@ jalv_open(Jalv* const jalv, const char* const load_arg)
     jalv_backend_activate_port(jalv->backend, &jalv->process, i);
   }
 
+  // Set up preset cache to be filled during updates
+  if (jalv->opts.preset_cache) {
+    jalv->preset_cache = jalv_preset_cache_new(jalv->world,
+                                               urid_map,
+                                               jalv->plugin,
+                                               jalv->nodes.pset_Preset);
+  }
+
   return 0;
 }
 
@@ -1095,6 +1582,76 @@ jalv_activate(Jalv* const jalv)
   return 0;
 }
 
+static void
+report_worker_stats(Jalv* const jalv)
+{
+  JalvWorkerStats stats = {0U, 0U, 0U, 0U, 0U};
+  jalv_worker_stats(jalv->process.worker, &stats);
+  if (stats.n_requests) {
+    jalv_log(&jalv->log,
+             JALV_LOG_INFO,
+             "Worker: %u requests, max queue depth %u, "
+             "latency mean %.3f ms max %.3f ms, %u dropped",
+             stats.n_requests,
+             stats.max_depth,
+             (double)stats.total_ns / stats.n_requests / 1000000.0,
+             (double)stats.max_ns / 1000000.0,
+             stats.n_dropped);
+  }
+}
+
+/// Return a ring size with room for twice the peak usage of a ring
+static uint32_t
+suggested_ring_size(const JalvRingStats* const stats)
+{
+  // A message that didn't fit may have needed more than the whole ring
+  const uint64_t need = stats->n_dropped ? (uint64_t)stats->size + 1U
+                                         : (uint64_t)stats->peak;
+
+  uint32_t size = 4096U;
+  while (size < need * 2U && size < MAX_RING_SIZE) {
+    size *= 2U;
+  }
+
+  return size;
+}
+
+/// Log communication ring usage, and suggest a size if they were too small
+static void
+report_ring_stats(Jalv* const jalv)
+{
+  JalvProcess* const  proc      = &jalv->process;
+  const JalvRingStats to_ui     = proc->to_ui_stats;
+  const JalvRingStats to_plugin = {
+    proc->to_plugin_stats.size,
+    proc->to_plugin_stats.peak,
+    jalv_atomic_load(&proc->to_plugin_stats.n_dropped)};
+
+  const uint32_t n_dropped = to_ui.n_dropped + to_plugin.n_dropped;
+
+  if (to_ui.peak || to_plugin.peak) {
+    jalv_log(&jalv->log,
+             JALV_LOG_INFO,
+             "Comm buffers: peak %u/%u bytes to UI, %u/%u bytes to plugin, "
+             "%u dropped",
+             to_ui.peak,
+             to_ui.size,
+             to_plugin.peak,
+             to_plugin.size,
+             n_dropped);
+  }
+
+  const uint32_t current = MAX(jalv->settings.ring_size, to_ui.size + 1U);
+  const uint32_t size =
+    MAX(suggested_ring_size(&to_ui), suggested_ring_size(&to_plugin));
+  if (size > current) {
+    jalv_log(&jalv->log,
+             n_dropped ? JALV_LOG_WARNING : JALV_LOG_INFO,
+             "Comm buffers too small, rerun with -b %u",
+             size);
+  }
+}
+
 int
 jalv_deactivate(Jalv* const jalv)
 {
@@ -1106,8 +1663,10 @@ jalv_deactivate(Jalv* const jalv)
   }
   if (jalv->process.worker) {
     jalv_worker_exit(jalv->process.worker);
+    report_worker_stats(jalv);
   }
 
+  report_ring_stats(jalv);
   jalv->process.run_state = JALV_PAUSED;
   return 0;
 }
@@ -1130,28 +1689,46 @@ jalv_close(Jalv* const jalv)
     lilv_instance_free(jalv->process.instance);
   }
 
+  // Write any remaining messages from the process thread
+  if (!jalv->host) {
+    jalv_log_ring_free(jalv->log.ring);
+  }
+
+  jalv->log.ring = NULL;
+
   // Clean up
   lilv_state_free(jalv->preset);
+  jalv_preset_cache_free(jalv->preset_cache);
   lilv_node_free(jalv->plugin_name);
+  free(jalv->symbol_ports);
+  symap_free(jalv->port_symbols);
   free(jalv->ports);
+  const uint32_t n_dropped =
+    jalv->process.traffic ? jalv_traffic_n_dropped(jalv->process.traffic) : 0U;
+  if (n_dropped) {
+    jalv_log(&jalv->log,
+             JALV_LOG_WARNING,
+             "Traffic log full, dropped %u messages",
+             n_dropped);
+  }
   jalv_process_cleanup(&jalv->process);
   free(jalv->process.ports);
   zix_aligned_free(NULL, jalv->ui_msg);
+  free(jalv->process.sent_controls);
   free(jalv->process.controls_buf);
   jalv_free_nodes(&jalv->nodes);
 #if USE_SUIL
   suil_host_free(jalv->ui_host);
 #endif
 
-  for (unsigned i = 0; i < jalv->controls.n_controls; ++i) {
-    free_control(jalv->controls.controls[i]);
-  }
-  free(jalv->controls.controls);
+  free_controls(&jalv->controls);
 
   jalv_dumper_free(jalv->dumper);
   lilv_uis_free(jalv->uis);
-  jalv_mapper_free(jalv->mapper);
-  lilv_world_free(jalv->world);
+  if (!jalv->host) {
+    jalv_mapper_free(jalv->mapper);
+    lilv_world_free(jalv->world);
+  }
 
   zix_sem_destroy(&jalv->done);
 
@@ -1170,8 +1747,15 @@ jalv_close(Jalv* const jalv)
   zix_free(NULL, jalv->temp_dir);
   free(jalv->feature_list);
 
+  free(jalv->instance_name);
   free(jalv->opts.name);
   free(jalv->opts.controls);
+  free(jalv->opts.links);
+  if (!jalv->host) {
+    // Shared with guests
+    free(jalv->opts.tempos);
+    free(jalv->opts.dump_filters);
+  }
 
   return 0;
 }
@@ -1,4 +1,4 @@
-// Copyright 2007-2025 David Robillard <d@drobilla.net>
+// Copyright 2007-2026 David Robillard <d@drobilla.net>
 // SPDX-License-Identifier: ISC
 
 #ifndef JALV_JALV_H
@@ -9,13 +9,16 @@
 #include "dumper.h"
 #include "features.h"
 #include "jalv_config.h"
+#include "load.h"
 #include "log.h"
 #include "mapper.h"
 #include "nodes.h"
 #include "options.h"
 #include "port.h"
+#include "preset_cache.h"
 #include "process.h"
 #include "settings.h"
+#include "symap.h"
 #include "types.h"
 #include "urids.h"
 
@@ -65,13 +68,20 @@ struct JalvImpl {
   SuilHost*     ui_host;     ///< Plugin UI host support
   SuilInstance* ui_instance; ///< Plugin UI instance (shared library)
 #endif
-  void*               app;          ///< Opaque application pointer
-  JalvPort*           ports;        ///< Port array of size num_ports
-  Controls            controls;     ///< Available plugin controls
-  size_t              ui_msg_size;  ///< Maximum size of a single message
-  uint32_t            num_ports;    ///< Total number of ports on the plugin
-  bool                safe_restore; ///< Plugin restore() is thread-safe
-  bool                updating;     ///< True if the UI is being updated
+  void*               app;           ///< Opaque application pointer
+  Jalv*               host;          ///< Owner of shared audio client, or null
+  Jalv*               next;          ///< Next instance in shared audio client
+  char*               instance_name; ///< Name in shared client, or null
+  JalvPort*           ports;         ///< Port array of size num_ports
+  Symap*              port_symbols;  ///< Port symbols mapped to IDs
+  uint32_t*           symbol_ports;  ///< Port indices by symbol ID minus one
+  Controls            controls;      ///< Available plugin controls
+  JalvPresetCache*    preset_cache;  ///< Preloaded presets, or null
+  JalvLoadReport      load;          ///< Latest processing load report
+  size_t              ui_msg_size;   ///< Maximum size of a single message
+  uint32_t            num_ports;     ///< Total number of ports on the plugin
+  bool                safe_restore;  ///< Plugin restore() is thread-safe
+  bool                updating;      ///< True if the UI is being updated
   JalvFeatures        features;
   const LV2_Feature** feature_list;
 };
@@ -108,6 +118,24 @@ jalv_set_control(Jalv*       jalv,
                  LV2_URID    type,
                  const void* body);
 
+/**
+   Schedule a change of a control port value at a specific time.
+
+   The change is applied at the given frame, counting from when processing
+   started.  If blocks are split (see JalvSettings::split_length), this may be
+   in the middle of a cycle, otherwise the change is applied at the start of
+   the cycle that contains it.  Changes for times that have already passed are
+   applied at the start of the next cycle.
+
+   @return Zero on success, or non-zero if the control isn't a port or the
+   communication ring is full.
+*/
+int
+jalv_schedule_control(Jalv*          jalv,
+                      const Control* control,
+                      uint64_t       frame,
+                      float          value);
+
 /// Update port values in the UI and/or request state from the plugin
 void
 jalv_refresh_ui(Jalv* jalv);
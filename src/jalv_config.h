@@ -51,6 +51,15 @@
 #    endif
 #  endif
 
+// POSIX.1-2001: clock_gettime()
+#  ifndef HAVE_CLOCK_GETTIME
+#    if defined(_POSIX_VERSION) && _POSIX_VERSION >= 200112L
+#      define HAVE_CLOCK_GETTIME 1
+#    else
+#      define HAVE_CLOCK_GETTIME 0
+#    endif
+#  endif
+
 // POSIX.1-2001: fileno()
 #  ifndef HAVE_FILENO
 #    if defined(_POSIX_VERSION) && _POSIX_VERSION >= 200112L
@@ -69,6 +78,33 @@
 #    endif
 #  endif
 
+// POSIX.1-2001: mlock()
+#  ifndef HAVE_MLOCK
+#    if defined(_POSIX_VERSION) && _POSIX_VERSION >= 200112L
+#      define HAVE_MLOCK 1
+#    else
+#      define HAVE_MLOCK 0
+#    endif
+#  endif
+
+// POSIX.1-2001: mmap()
+#  ifndef HAVE_MMAP
+#    if defined(_POSIX_VERSION) && _POSIX_VERSION >= 200112L
+#      define HAVE_MMAP 1
+#    else
+#      define HAVE_MMAP 0
+#    endif
+#  endif
+
+// POSIX.1-1988: pipe()
+#  ifndef HAVE_PIPE
+#    if defined(_POSIX_VERSION) && _POSIX_VERSION >= 198808L
+#      define HAVE_PIPE 1
+#    else
+#      define HAVE_PIPE 0
+#    endif
+#  endif
+
 // POSIX.1-2001: poll()
 #  ifndef HAVE_POLL
 #    if defined(_POSIX_VERSION) && _POSIX_VERSION >= 200112L
@@ -96,6 +132,15 @@
 #    endif
 #  endif
 
+// POSIX.1-1988: stat()
+#  ifndef HAVE_STAT
+#    if defined(_POSIX_VERSION) && _POSIX_VERSION >= 198808L
+#      define HAVE_STAT 1
+#    else
+#      define HAVE_STAT 0
+#    endif
+#  endif
+
 // Suil
 #  ifndef HAVE_SUIL
 #    ifdef __has_include
@@ -145,6 +190,12 @@
 #  define USE_ACCESS 0
 #endif
 
+#if HAVE_CLOCK_GETTIME
+#  define USE_CLOCK_GETTIME 1
+#else
+#  define USE_CLOCK_GETTIME 0
+#endif
+
 #if HAVE_FILENO
 #  define USE_FILENO 1
 #else
@@ -157,6 +208,24 @@
 #  define USE_ISATTY 0
 #endif
 
+#if HAVE_MLOCK
+#  define USE_MLOCK 1
+#else
+#  define USE_MLOCK 0
+#endif
+
+#if HAVE_MMAP
+#  define USE_MMAP 1
+#else
+#  define USE_MMAP 0
+#endif
+
+#if HAVE_PIPE
+#  define USE_PIPE 1
+#else
+#  define USE_PIPE 0
+#endif
+
 #if HAVE_POLL
 #  define USE_POLL 1
 #else
@@ -175,6 +244,12 @@
 #  define USE_SIGACTION 0
 #endif
 
+#if HAVE_STAT
+#  define USE_STAT 1
+#else
+#  define USE_STAT 0
+#endif
+
 #if HAVE_SUIL
 #  define USE_SUIL 1
 #else
@@ -0,0 +1,104 @@
+// Copyright 2026 David Robillard <d@drobilla.net>
+// SPDX-License-Identifier: ISC
+
+#include "load.h"
+
+#include <stdint.h>
+
+const char*
+jalv_stage_name(const JalvStage stage)
+{
+  switch (stage) {
+  case JALV_STAGE_TRANSPORT:
+    return "transport";
+  case JALV_STAGE_PRE_PROCESS:
+    return "pre-process";
+  case JALV_STAGE_RUN:
+    return "run";
+  case JALV_STAGE_WORKER:
+    return "worker";
+  case JALV_STAGE_POST_PROCESS:
+    return "post-process";
+  case JALV_STAGE_CYCLE:
+    return "cycle";
+  }
+
+  return "unknown";
+}
+
+/// Return the index of the bin for a value, with 4 bins per octave
+static uint32_t
+bin_index(const uint32_t value)
+{
+  if (value < 4U) {
+    return value;
+  }
+
+  // Find the most significant bit
+  uint32_t msb = 0U;
+  for (uint32_t shift = 16U; shift; shift >>= 1U) {
+    if (value >> (msb + shift)) {
+      msb += shift;
+    }
+  }
+
+  // Use the two bits below it to select one of four bins in that octave
+  const uint32_t sub = (value >> (msb - 2U)) & 3U;
+  return ((msb - 1U) * 4U) + sub;
+}
+
+/// Return the largest value that falls into a bin
+static uint32_t
+bin_upper_bound(const uint32_t index)
+{
+  if (index < 4U) {
+    return index;
+  }
+
+  const uint32_t msb   = (index / 4U) + 1U;
+  const uint32_t sub   = index % 4U;
+  const uint64_t lower = (uint64_t)(4U + sub) << (msb - 2U);
+  const uint64_t upper = lower + (1ULL << (msb - 2U)) - 1U;
+  return upper > UINT32_MAX ? UINT32_MAX : (uint32_t)upper;
+}
+
+void
+jalv_histogram_record(JalvHistogram* const histogram, const uint32_t value)
+{
+  ++histogram->counts[bin_index(value)];
+  ++histogram->total;
+  if (value > histogram->max) {
+    histogram->max = value;
+  }
+}
+
+uint32_t
+jalv_histogram_percentile(const JalvHistogram* const histogram,
+                          const uint32_t             percent)
+{
+  const uint64_t rank = ((uint64_t)histogram->total * percent + 99U) / 100U;
+
+  uint64_t count = 0U;
+  for (uint32_t i = 0U; i < JALV_LOAD_N_BINS; ++i) {
+    count += histogram->counts[i];
+    if (count && count >= rank) {
+      const uint32_t upper = bin_upper_bound(i);
+      return upper < histogram->max ? upper : histogram->max;
+    }
+  }
+
+  return histogram->max;
+}
+
+uint32_t
+jalv_load_plugin(const uint32_t* const loads)
+{
+  return loads[JALV_STAGE_RUN] + loads[JALV_STAGE_WORKER];
+}
+
+uint32_t
+jalv_load_host(const uint32_t* const loads)
+{
+  return loads[JALV_STAGE_TRANSPORT] + loads[JALV_STAGE_PRE_PROCESS] +
+         loads[JALV_STAGE_POST_PROCESS];
+}
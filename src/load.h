@@ -0,0 +1,115 @@
+// Copyright 2026 David Robillard <d@drobilla.net>
+// SPDX-License-Identifier: ISC
+
+#ifndef JALV_LOAD_H
+#define JALV_LOAD_H
+
+#include "attributes.h"
+
+#include <zix/attributes.h>
+
+#include <stdint.h>
+
+// Measurement of processing load in the process thread
+JALV_BEGIN_DECLS
+
+/// Number of bins in a load histogram (4 per octave)
+#define JALV_LOAD_N_BINS 128U
+
+/// Load value for an entire period (parts per million)
+#define JALV_LOAD_FULL 1000000U
+
+/// A stage of a process cycle that is timed separately
+typedef enum {
+  JALV_STAGE_TRANSPORT,    ///< Querying the transport from the backend
+  JALV_STAGE_PRE_PROCESS,  ///< Preparing ports and applying UI messages
+  JALV_STAGE_RUN,          ///< Running the plugin
+  JALV_STAGE_WORKER,       ///< Emitting worker responses to the plugin
+  JALV_STAGE_POST_PROCESS, ///< Writing outputs and forwarding events
+  JALV_STAGE_CYCLE,        ///< Entire cycle
+} JalvStage;
+
+/// Number of stages in JalvStage
+#define JALV_N_STAGES 6U
+
+/**
+   A log-scale histogram of load values.
+
+   Values are in parts per million of the cycle period, so 1000000 is a cycle
+   that took exactly as long as the audio it processed.  The histogram is only
+   written by the process thread, and is published to other threads as a
+   summary in a JalvLoadReport.
+*/
+typedef struct {
+  uint32_t counts[JALV_LOAD_N_BINS]; ///< Number of values in each bin
+  uint32_t total;                    ///< Total number of values
+  uint32_t max;                      ///< Largest value
+} JalvHistogram;
+
+/// Summary of the load for a stage, as parts per million of the period
+typedef struct {
+  uint32_t p50; ///< Median (upper bound of bin)
+  uint32_t p99; ///< 99th percentile (upper bound of bin)
+  uint32_t max; ///< Maximum
+} JalvLoadStats;
+
+/// Usage of a ring for messages between the process thread and the UI
+typedef struct {
+  uint32_t size;      ///< Capacity of the ring in bytes
+  uint32_t peak;      ///< Most bytes ever waiting to be read
+  uint32_t n_dropped; ///< Messages dropped because the ring was full
+} JalvRingStats;
+
+/// Summary of processing load sent from the process thread to the UI
+typedef struct {
+  JalvLoadStats stages[JALV_N_STAGES];     ///< Statistics for each stage
+  uint32_t      n_xruns;                   ///< Total number of xruns
+  uint32_t      xrun_cycle[JALV_N_STAGES]; ///< Stage loads before last xrun
+  uint32_t      n_updates;                 ///< Control output updates sent
+  uint32_t      n_suppressed;              ///< Unchanged control outputs
+  JalvRingStats to_ui;                     ///< Process to UI ring usage
+  JalvRingStats to_plugin;                 ///< UI to process ring usage
+} JalvLoadReport;
+
+/// Process thread state for measuring load
+typedef struct {
+  JalvHistogram histograms[JALV_N_STAGES]; ///< Histogram for each stage
+  uint64_t      cycle[JALV_N_STAGES];      ///< Stage times in nanoseconds
+  uint32_t      last[JALV_N_STAGES];       ///< Stage loads in last cycle
+  uint32_t      xrun_cycle[JALV_N_STAGES]; ///< Stage loads before xrun
+  uint64_t      cycle_start;               ///< Start time of cycle
+  uint64_t      stage_start;               ///< Start time of stage
+  double        frames_per_ns;             ///< Sample rate in frames/ns
+  uint32_t      n_xruns;                   ///< Xruns from backend (atomic)
+  uint32_t      n_xruns_seen;              ///< Xruns attributed to cycles
+} JalvLoad;
+
+/// Return a short human-readable name for a stage
+ZIX_CONST_FUNC const char*
+jalv_stage_name(JalvStage stage);
+
+/// Add a value to a histogram
+ZIX_REALTIME void
+jalv_histogram_record(JalvHistogram* histogram, uint32_t value);
+
+/**
+   Return an upper bound for a percentile of the values in a histogram.
+
+   @param histogram Histogram to query.
+   @param percent Percentile from 0 to 100.
+   @return The upper bound of the bin that contains the percentile.
+*/
+ZIX_REALTIME uint32_t
+jalv_histogram_percentile(const JalvHistogram* histogram, uint32_t percent);
+
+/// Return the load of plugin code (running and worker responses)
+ZIX_PURE_FUNC uint32_t
+jalv_load_plugin(const uint32_t* loads);
+
+/// Return the load of host code (everything but plugin code)
+ZIX_PURE_FUNC uint32_t
+jalv_load_host(const uint32_t* loads);
+
+JALV_END_DECLS
+
+#endif // JALV_LOAD_H
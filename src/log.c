@@ -3,10 +3,23 @@
 
 #include "log.h"
 
+#include "atomic.h"
+#include "clock.h"
+#include "comm.h"
 #include "jalv_config.h"
 
 #include <lv2/log/log.h>
 #include <lv2/urid/urid.h>
+#include <zix/attributes.h>
+#include <zix/ring.h>
+#include <zix/sem.h>
+#include <zix/thread.h>
+
+#ifdef _WIN32
+#  include <windows.h>
+#else
+#  include <pthread.h>
+#endif
 
 #if USE_ISATTY
 #  include <unistd.h>
@@ -14,7 +27,41 @@
 
 #include <stdarg.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+
+/// Maximum length of a message from the process thread (longer is truncated)
+#define LOG_RING_MESSAGE_SIZE 512U
+
+/// Size of the ring for messages from the process thread in bytes
+#define LOG_RING_SIZE 32768U
+
+/// Maximum number of messages from the process thread per second
+#define LOG_RING_RATE 100U
+
+/// Level for plugin messages written verbatim without a prefix or newline
+#define LOG_RAW 0U
+
+/// Header of a message in a log ring, followed by the message text
+typedef struct {
+  uint32_t level; ///< JalvLogLevel, or LOG_RAW
+  uint32_t size;  ///< Length of text in bytes
+} LogRingHeader;
+
+struct JalvLogRingImpl {
+  ZixRing*  ring;           ///< Messages from the process thread
+  ZixSem    sem;            ///< Posted when a message is written or to exit
+  ZixThread thread;         ///< Thread that writes messages to stderr
+  uint64_t  window_start;   ///< Start time of the current rate limit window
+  uint32_t  window_count;   ///< Messages written in the current window
+  uint32_t  n_dropped;      ///< Messages dropped because the ring was full
+  uint32_t  n_limited;      ///< Messages dropped by the rate limiter
+  uint32_t  n_dropped_seen; ///< Value of n_dropped last reported
+  uint32_t  n_limited_seen; ///< Value of n_limited last reported
+  uint32_t  writing;        ///< Non-zero while a thread writes a message
+  uint32_t  exit;           ///< Non-zero when the thread should exit
+};
 
 JALV_LOG_FUNC(2, 0) static int
 jalv_vlog(const JalvLogLevel level, const char* const fmt, va_list ap)
@@ -47,6 +94,174 @@ jalv_vlog(const JalvLogLevel level, const char* const fmt, va_list ap)
   return st;
 }
 
+JALV_LOG_FUNC(2, 3) static int
+jalv_elog(const JalvLogLevel level, const char* const fmt, ...)
+{
+  va_list args;
+  va_start(args, fmt);
+  const int ret = jalv_vlog(level, fmt, args);
+  va_end(args);
+  return ret;
+}
+
+/// Return a value that identifies the calling thread
+ZIX_REALTIME static uintptr_t
+current_thread(void)
+{
+#ifdef _WIN32
+  return (uintptr_t)GetCurrentThreadId();
+#else
+  return (uintptr_t)pthread_self();
+#endif
+}
+
+JALV_LOG_FUNC(3, 0) ZIX_REALTIME static int
+log_ring_vprintf(JalvLogRing* const ring,
+                 const uint32_t     level,
+                 const char* const  fmt,
+                 va_list            ap)
+{
+  // Drop the message if another plugin thread is writing, rather than wait
+  if (jalv_atomic_exchange(&ring->writing, 1U)) {
+    jalv_atomic_increment(&ring->n_dropped);
+    return 0;
+  }
+
+  // Drop messages over the rate limit in the current window of a second
+  const uint64_t now = jalv_clock_now();
+  if (now - ring->window_start >= 1000000000U) {
+    ring->window_start = now;
+    ring->window_count = 0U;
+  }
+
+  int len = 0;
+  if (ring->window_count >= LOG_RING_RATE) {
+    jalv_atomic_increment(&ring->n_limited);
+  } else {
+    ++ring->window_count;
+
+    // Format the message into a local buffer, truncating it if necessary
+    char text[LOG_RING_MESSAGE_SIZE];
+    len = vsnprintf(text, sizeof(text), fmt, ap);
+    if (len >= 0) {
+      const uint32_t size = (uint32_t)len < sizeof(text)
+                              ? (uint32_t)len
+                              : (uint32_t)sizeof(text) - 1U;
+
+      // Write the message to the ring and wake up the log thread
+      const LogRingHeader header = {level, size};
+      if (jalv_write_split_message(
+            ring->ring, &header, sizeof(header), text, size)) {
+        jalv_atomic_increment(&ring->n_dropped);
+        len = 0;
+      } else {
+        zix_sem_post(&ring->sem);
+      }
+    }
+  }
+
+  jalv_atomic_store(&ring->writing, 0U);
+  return len;
+}
+
+/// Write all messages in a log ring and report any that were dropped
+static void
+log_ring_drain(JalvLogRing* const ring)
+{
+  char          text[LOG_RING_MESSAGE_SIZE];
+  LogRingHeader header = {LOG_RAW, 0U};
+  while (zix_ring_read(ring->ring, &header, sizeof(header)) == sizeof(header)) {
+    if (zix_ring_read(ring->ring, text, header.size) != header.size) {
+      break; // Corrupt ring, which should never happen
+    }
+
+    text[header.size] = '\0';
+    if (header.level == LOG_RAW) {
+      fputs(text, stderr);
+    } else {
+      jalv_elog((JalvLogLevel)header.level, "%s", text);
+    }
+  }
+
+  const uint32_t n_dropped = jalv_atomic_load(&ring->n_dropped);
+  if (n_dropped != ring->n_dropped_seen) {
+    jalv_elog(JALV_LOG_WARNING,
+              "Dropped %u plugin log messages (ring full or busy)",
+              n_dropped - ring->n_dropped_seen);
+    ring->n_dropped_seen = n_dropped;
+  }
+
+  const uint32_t n_limited = jalv_atomic_load(&ring->n_limited);
+  if (n_limited != ring->n_limited_seen) {
+    jalv_elog(JALV_LOG_WARNING,
+              "Dropped %u plugin log messages (over %u per second)",
+              n_limited - ring->n_limited_seen,
+              LOG_RING_RATE);
+    ring->n_limited_seen = n_limited;
+  }
+}
+
+static ZixThreadResult ZIX_THREAD_FUNC
+log_ring_func(void* const data)
+{
+  JalvLogRing* const ring = (JalvLogRing*)data;
+
+  bool exit = false;
+  while (!exit) {
+    zix_sem_wait(&ring->sem);
+    exit = jalv_atomic_load(&ring->exit);
+    log_ring_drain(ring);
+  }
+
+  return ZIX_THREAD_RESULT;
+}
+
+JalvLogRing*
+jalv_log_ring_new(void)
+{
+  JalvLogRing* const ring = (JalvLogRing*)calloc(1U, sizeof(JalvLogRing));
+  if (!ring) {
+    return NULL;
+  }
+
+  if (!(ring->ring = zix_ring_new(NULL, LOG_RING_SIZE))) {
+    free(ring);
+    return NULL;
+  }
+
+  zix_ring_mlock(ring->ring);
+  zix_sem_init(&ring->sem, 0U);
+  if (zix_thread_create(&ring->thread, 65536U, log_ring_func, ring)) {
+    zix_sem_destroy(&ring->sem);
+    zix_ring_free(ring->ring);
+    free(ring);
+    return NULL;
+  }
+
+  return ring;
+}
+
+void
+jalv_log_ring_free(JalvLogRing* const ring)
+{
+  if (ring) {
+    jalv_atomic_store(&ring->exit, 1U);
+    zix_sem_post(&ring->sem);
+    zix_thread_join(ring->thread);
+    zix_sem_destroy(&ring->sem);
+    zix_ring_free(ring->ring);
+    free(ring);
+  }
+}
+
+ZIX_REALTIME void
+jalv_log_set_thread(JalvLog* const log)
+{
+  if (log && log->ring) {
+    jalv_atomic_store_uintptr(&log->rt_thread, current_thread());
+  }
+}
+
 int
 jalv_log(const JalvLog* const log,
          const JalvLogLevel   level,
@@ -68,19 +283,27 @@ jalv_vprintf(LV2_Log_Handle handle, LV2_URID type, const char* fmt, va_list ap)
 {
   JalvLog* const log = (JalvLog*)handle;
 
+  uint32_t level = LOG_RAW;
   if (type == log->urids->log_Trace) {
-    return log->tracing ? jalv_vlog(JALV_LOG_DEBUG, fmt, ap) : 0;
-  }
+    if (!log->tracing) {
+      return 0;
+    }
 
-  if (type == log->urids->log_Error) {
-    return jalv_vlog(JALV_LOG_ERR, fmt, ap);
+    level = JALV_LOG_DEBUG;
+  } else if (type == log->urids->log_Error) {
+    level = JALV_LOG_ERR;
+  } else if (type == log->urids->log_Warning) {
+    level = JALV_LOG_WARNING;
   }
 
-  if (type == log->urids->log_Warning) {
-    return jalv_vlog(JALV_LOG_WARNING, fmt, ap);
+  // Send messages from the thread that runs the plugin through the ring
+  JalvLogRing* const ring = log->ring;
+  if (ring && jalv_atomic_load_uintptr(&log->rt_thread) == current_thread()) {
+    return log_ring_vprintf(ring, level, fmt, ap);
   }
 
-  return vfprintf(stderr, fmt, ap);
+  return (level == LOG_RAW) ? vfprintf(stderr, fmt, ap)
+                            : jalv_vlog((JalvLogLevel)level, fmt, ap);
 }
 
 int
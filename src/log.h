@@ -9,9 +9,11 @@
 
 #include <lv2/log/log.h>
 #include <lv2/urid/urid.h>
+#include <zix/attributes.h>
 
 #include <stdarg.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 
 #ifdef __GNUC__
@@ -35,11 +37,26 @@ typedef JALV_LOG_FUNC(3, 0) int (*JalvLogSink)(void*        handle,
                                                const char*  fmt,
                                                va_list      args);
 
+/**
+   A ring of log messages from the process thread.
+
+   Plugins may log from their run() method, but writing to a stream there can
+   block and cause xruns.  So, messages logged from the thread that runs the
+   plugin are formatted into a preallocated ring instead, and written to
+   stderr by a background thread.  Messages are dropped (and counted) if the
+   ring is full, if the plugins log too many messages per second, or if
+   another thread is writing to the ring at the same time.  A single ring is
+   shared by all the plugins in a process.
+*/
+typedef struct JalvLogRingImpl JalvLogRing;
+
 typedef struct {
-  JalvURIDs*  urids;
-  JalvLogSink sink;
-  void*       sink_handle;
-  bool        tracing;
+  JalvURIDs*   urids;
+  JalvLogSink  sink;
+  void*        sink_handle;
+  JalvLogRing* ring;      ///< Ring for process thread messages, or null
+  uintptr_t    rt_thread; ///< Thread that runs the plugin
+  bool         tracing;
 } JalvLog;
 
 /// Print a log message to stderr with a GCC-like prefix and color
@@ -54,6 +71,27 @@ jalv_vprintf(LV2_Log_Handle handle, LV2_URID type, const char* fmt, va_list ap);
 JALV_LOG_FUNC(3, 4) int
 jalv_printf(LV2_Log_Handle handle, LV2_URID type, const char* fmt, ...);
 
+/**
+   Allocate a log ring and launch the thread that writes its messages.
+
+   @return A new log ring, or null on error.
+*/
+JalvLogRing*
+jalv_log_ring_new(void);
+
+/// Write any remaining messages, stop the log ring thread, and free the ring
+void
+jalv_log_ring_free(JalvLogRing* ring);
+
+/**
+   Send messages logged from the calling thread through the ring of a log.
+
+   This is called in the process thread every time it runs the plugin, since
+   with several threads, the thread that runs the plugin can change.
+*/
+ZIX_REALTIME void
+jalv_log_set_thread(JalvLog* log);
+
 /// Write an ANSI escape sequence to set the foreground color
 bool
 jalv_ansi_start(FILE* stream, int color);
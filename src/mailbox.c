@@ -0,0 +1,106 @@
+// Copyright 2026 David Robillard <d@drobilla.net>
+// SPDX-License-Identifier: ISC
+
+#include "mailbox.h"
+
+#include "atomic.h"
+
+#include <zix/attributes.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct JalvMailboxImpl {
+  uint32_t* values;  ///< Latest value of each port (float bits)
+  uint32_t* dirty;   ///< Bitset of ports written since the last read
+  uint32_t  n_ports; ///< Number of ports
+  uint32_t  n_words; ///< Number of words in dirty
+};
+
+JalvMailbox*
+jalv_mailbox_new(const uint32_t n_ports)
+{
+  JalvMailbox* const mailbox = (JalvMailbox*)calloc(1, sizeof(JalvMailbox));
+  if (mailbox) {
+    mailbox->n_ports = n_ports;
+    mailbox->n_words = (n_ports + 31U) / 32U;
+    mailbox->values  = (uint32_t*)calloc(n_ports + 1U, sizeof(uint32_t));
+    mailbox->dirty =
+      (uint32_t*)calloc(mailbox->n_words + 1U, sizeof(uint32_t));
+
+    if (!mailbox->values || !mailbox->dirty) {
+      jalv_mailbox_free(mailbox);
+      return NULL;
+    }
+  }
+
+  return mailbox;
+}
+
+void
+jalv_mailbox_free(JalvMailbox* const mailbox)
+{
+  if (mailbox) {
+    free(mailbox->dirty);
+    free(mailbox->values);
+    free(mailbox);
+  }
+}
+
+ZIX_REALTIME void
+jalv_mailbox_write(JalvMailbox* const mailbox,
+                   const uint32_t     index,
+                   const float        value)
+{
+  if (index < mailbox->n_ports) {
+    uint32_t bits = 0U;
+    memcpy(&bits, &value, sizeof(bits));
+
+    jalv_atomic_store(&mailbox->values[index], bits);
+    jalv_atomic_or(&mailbox->dirty[index / 32U], 1U << (index % 32U));
+  }
+}
+
+ZIX_REALTIME uint32_t
+jalv_mailbox_read(JalvMailbox* const    mailbox,
+                  const JalvMailboxSink sink,
+                  void* const           handle)
+{
+  uint32_t n_changes = 0U;
+
+  for (uint32_t w = 0U; w < mailbox->n_words; ++w) {
+    if (!jalv_atomic_load(&mailbox->dirty[w])) {
+      continue; // Skip clean words without writing to them
+    }
+
+    // Take all dirty bits, so later writes mark the port dirty again
+    uint32_t dirty = jalv_atomic_exchange(&mailbox->dirty[w], 0U);
+    for (uint32_t b = 0U; dirty; ++b, dirty >>= 1U) {
+      if (dirty & 1U) {
+        const uint32_t index = (w * 32U) + b;
+        const uint32_t bits  = jalv_atomic_load(&mailbox->values[index]);
+
+        float value = 0.0f;
+        memcpy(&value, &bits, sizeof(value));
+        sink(handle, index, value);
+        ++n_changes;
+      }
+    }
+  }
+
+  return n_changes;
+}
+
+ZIX_REALTIME bool
+jalv_mailbox_has_changes(const JalvMailbox* const mailbox)
+{
+  for (uint32_t w = 0U; w < mailbox->n_words; ++w) {
+    if (jalv_atomic_load(&mailbox->dirty[w])) {
+      return true;
+    }
+  }
+
+  return false;
+}
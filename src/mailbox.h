@@ -0,0 +1,62 @@
+// Copyright 2026 David Robillard <d@drobilla.net>
+// SPDX-License-Identifier: ISC
+
+#ifndef JALV_MAILBOX_H
+#define JALV_MAILBOX_H
+
+#include "attributes.h"
+
+#include <zix/attributes.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Coalescing control value transfer between threads
+JALV_BEGIN_DECLS
+
+/**
+   A mailbox of the latest value for each control port.
+
+   Writing a value replaces any previous value for that port that hasn't been
+   read yet, and marks the port as dirty.  Reading visits only dirty ports, so
+   each port is updated at most once per read regardless of how many times it
+   was written.  Unlike a ring, a mailbox can't overflow, and its size depends
+   only on the number of ports.
+
+   Any number of threads may write, but only one may read.
+*/
+typedef struct JalvMailboxImpl JalvMailbox;
+
+/// Function called for each changed port when reading a mailbox
+typedef void (*JalvMailboxSink)(void* handle, uint32_t index, float value);
+
+/// Allocate a new mailbox for `n_ports` ports
+JalvMailbox*
+jalv_mailbox_new(uint32_t n_ports);
+
+/// Free a mailbox
+void
+jalv_mailbox_free(JalvMailbox* mailbox);
+
+/// Write the latest value for a port
+ZIX_REALTIME void
+jalv_mailbox_write(JalvMailbox* mailbox, uint32_t index, float value);
+
+/**
+   Read all values written since the last read.
+
+   @param mailbox Mailbox to read from.
+   @param sink Function called with the latest value of each changed port.
+   @param handle Opaque pointer passed to `sink`.
+   @return The number of changed ports.
+*/
+ZIX_REALTIME uint32_t
+jalv_mailbox_read(JalvMailbox* mailbox, JalvMailboxSink sink, void* handle);
+
+/// Return true if any value has been written since the last read
+ZIX_REALTIME bool
+jalv_mailbox_has_changes(const JalvMailbox* mailbox);
+
+JALV_END_DECLS
+
+#endif // JALV_MAILBOX_H
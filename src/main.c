@@ -1,4 +1,4 @@
-// Copyright 2007-2025 David Robillard <d@drobilla.net>
+// Copyright 2007-2026 David Robillard <d@drobilla.net>
 // SPDX-License-Identifier: ISC
 
 #include "backend.h"
@@ -6,26 +6,30 @@
 #include "jalv.h"
 #include "jalv_config.h"
 #include "types.h"
+#include "wakeup.h"
 
 #include <zix/sem.h>
 
 #include <signal.h>
 #include <stdlib.h>
 
-static ZixSem* exit_sem = NULL;
+static ZixSem*     exit_sem    = NULL;
+static JalvWakeup* exit_wakeup = NULL;
 
 static void
 signal_handler(const int sig)
 {
   if (exit_sem && (sig == SIGINT || sig == SIGTERM)) {
     zix_sem_post(exit_sem);
+    jalv_wakeup_signal(exit_wakeup);
   }
 }
 
 static void
 setup_signals(Jalv* const jalv)
 {
-  exit_sem = &jalv->done;
+  exit_sem    = &jalv->done;
+  exit_wakeup = &jalv->process.ui_wakeup;
 
 #if !defined(_WIN32) && USE_SIGACTION
   struct sigaction action;
@@ -1,4 +1,4 @@
-// Copyright 2012-2024 David Robillard <d@drobilla.net>
+// Copyright 2012-2026 David Robillard <d@drobilla.net>
 // SPDX-License-Identifier: ISC
 
 #include "mapper.h"
@@ -12,10 +12,10 @@
 #include <stdlib.h>
 
 struct JalvMapperImpl {
-  Symap*         symap;
-  ZixSem         lock;
-  LV2_URID_Map   map;
-  LV2_URID_Unmap unmap;
+  Symap*         symap; ///< Symbol map
+  ZixSem         lock;  ///< Lock for mapping (unmapping is lock-free)
+  LV2_URID_Map   map;   ///< LV2 URID map feature
+  LV2_URID_Unmap unmap; ///< LV2 URID unmap feature
 };
 
 static LV2_URID
@@ -33,13 +33,9 @@ map_uri(LV2_URID_Map_Handle handle, const char* const uri)
 static const char*
 unmap_uri(LV2_URID_Unmap_Handle handle, const LV2_URID urid)
 {
-  JalvMapper* const mapper = (JalvMapper*)handle;
-  zix_sem_wait(&mapper->lock);
+  const JalvMapper* const mapper = (const JalvMapper*)handle;
 
-  const char* const uri = symap_unmap(mapper->symap, urid);
-
-  zix_sem_post(&mapper->lock);
-  return uri;
+  return symap_unmap(mapper->symap, urid);
 }
 
 JalvMapper*
@@ -82,7 +78,7 @@ jalv_mapper_urid_unmap(JalvMapper* const mapper)
 LV2_URID
 jalv_mapper_map_uri(JalvMapper* const mapper, const char* const sym)
 {
-  return symap_map(mapper->symap, sym);
+  return map_uri(mapper, sym);
 }
 
 const char*
@@ -1,4 +1,4 @@
-// Copyright 2012-2024 David Robillard <d@drobilla.net>
+// Copyright 2012-2026 David Robillard <d@drobilla.net>
 // SPDX-License-Identifier: ISC
 
 #ifndef JALV_MAPPER_H
@@ -7,7 +7,6 @@
 #include "attributes.h"
 
 #include <lv2/urid/urid.h>
-#include <zix/attributes.h>
 
 // URI to URID mapping and unmapping
 JALV_BEGIN_DECLS
@@ -36,7 +35,7 @@ LV2_URID
 jalv_mapper_map_uri(JalvMapper* mapper, const char* sym);
 
 /// Unmap a URID back to a URI string if possible, or return NULL
-ZIX_PURE_FUNC const char*
+const char*
 jalv_mapper_unmap_uri(const JalvMapper* mapper, LV2_URID id);
 
 JALV_END_DECLS
@@ -0,0 +1,524 @@
+// Copyright 2026 David Robillard <d@drobilla.net>
+// SPDX-License-Identifier: ISC
+
+#include "midi_file.h"
+
+#include <zix/status.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/// Resolution of written files in ticks per quarter note
+#define MIDI_FILE_TICKS_PER_QUARTER 960U
+
+/// Default and written tempo in microseconds per quarter note (120 BPM)
+#define MIDI_FILE_USEC_PER_QUARTER 500000U
+
+/// An event parsed from a file, before conversion to frames
+typedef struct {
+  uint64_t tick;   ///< Time in ticks from the start of the file
+  uint32_t seq;    ///< Order of event in file, for stable sorting
+  uint32_t tempo;  ///< Tempo in microseconds per quarter, or zero
+  uint32_t offset; ///< Offset of message in data buffer
+  uint32_t size;   ///< Size of message in bytes
+} SmfEvent;
+
+/// A growable byte buffer
+typedef struct {
+  uint8_t* bytes;    ///< Buffer contents
+  size_t   size;     ///< Size of contents in bytes
+  size_t   capacity; ///< Allocated size of buffer in bytes
+} ByteBuffer;
+
+struct JalvMidiFileImpl {
+  FILE*          fd;        ///< File handle for writing
+  float          rate;      ///< Sample rate in Hz
+  JalvMidiEvent* events;    ///< Events read from file, in time order
+  size_t         n_events;  ///< Number of events read from file
+  size_t         next;      ///< Index of the next event to read
+  ByteBuffer     data;      ///< Message data or written track
+  uint64_t       last_tick; ///< Time of the last written event in ticks
+};
+
+static ZixStatus
+buffer_append(ByteBuffer* const buf, const void* const data, const size_t size)
+{
+  if (buf->size + size > buf->capacity) {
+    size_t new_capacity = buf->capacity ? buf->capacity : 256U;
+    while (new_capacity < buf->size + size) {
+      new_capacity *= 2U;
+    }
+
+    uint8_t* const new_bytes = (uint8_t*)realloc(buf->bytes, new_capacity);
+    if (!new_bytes) {
+      return ZIX_STATUS_NO_MEM;
+    }
+
+    buf->bytes    = new_bytes;
+    buf->capacity = new_capacity;
+  }
+
+  memcpy(buf->bytes + buf->size, data, size);
+  buf->size += size;
+  return ZIX_STATUS_SUCCESS;
+}
+
+static ZixStatus
+buffer_append_vlq(ByteBuffer* const buf, const uint32_t value)
+{
+  uint8_t bytes[5] = {0U};
+  size_t  n        = 0U;
+  for (uint32_t v = value; n == 0U || v; v >>= 7U) {
+    bytes[4U - n] = (uint8_t)((v & 0x7FU) | (n ? 0x80U : 0U));
+    ++n;
+  }
+
+  return buffer_append(buf, bytes + 5U - n, n);
+}
+
+static uint16_t
+get_u16(const uint8_t* const bytes)
+{
+  return (uint16_t)((bytes[0] << 8U) | bytes[1]);
+}
+
+static uint32_t
+get_u32(const uint8_t* const bytes)
+{
+  return ((uint32_t)bytes[0] << 24U) | ((uint32_t)bytes[1] << 16U) |
+         ((uint32_t)bytes[2] << 8U) | (uint32_t)bytes[3];
+}
+
+static void
+put_u32(uint8_t* const bytes, const uint32_t value)
+{
+  bytes[0] = (uint8_t)((value >> 24U) & 0xFFU);
+  bytes[1] = (uint8_t)((value >> 16U) & 0xFFU);
+  bytes[2] = (uint8_t)((value >> 8U) & 0xFFU);
+  bytes[3] = (uint8_t)(value & 0xFFU);
+}
+
+static const uint8_t*
+read_vlq(const uint8_t* p, const uint8_t* const end, uint32_t* const value)
+{
+  uint32_t v = 0U;
+  for (unsigned i = 0U; i < 4U && p < end; ++i) {
+    const uint8_t byte = *p++;
+    v                  = (v << 7U) | (byte & 0x7FU);
+    if (!(byte & 0x80U)) {
+      *value = v;
+      return p;
+    }
+  }
+
+  return NULL;
+}
+
+static uint32_t
+channel_message_data_size(const uint8_t status)
+{
+  const uint8_t type = status & 0xF0U;
+  return (type == 0xC0U || type == 0xD0U) ? 1U : 2U;
+}
+
+static int
+event_compare(const void* const a, const void* const b)
+{
+  const SmfEvent* const ea = (const SmfEvent*)a;
+  const SmfEvent* const eb = (const SmfEvent*)b;
+
+  return (ea->tick < eb->tick)   ? -1
+         : (ea->tick > eb->tick) ? 1
+         : (ea->seq < eb->seq)   ? -1
+         : (ea->seq > eb->seq)   ? 1
+                                 : 0;
+}
+
+typedef struct {
+  SmfEvent*  events;   ///< Parsed events
+  size_t     n_events; ///< Number of parsed events
+  size_t     capacity; ///< Allocated size of events in elements
+  ByteBuffer data;     ///< Message data
+} Parser;
+
+static ZixStatus
+parser_add(Parser* const        parser,
+           const uint64_t       tick,
+           const uint32_t       tempo,
+           const uint8_t        status,
+           const uint8_t* const body,
+           const uint32_t       body_size)
+{
+  if (parser->n_events == parser->capacity) {
+    const size_t new_capacity = parser->capacity ? parser->capacity * 2U : 64U;
+    SmfEvent* const new_events =
+      (SmfEvent*)realloc(parser->events, new_capacity * sizeof(SmfEvent));
+    if (!new_events) {
+      return ZIX_STATUS_NO_MEM;
+    }
+
+    parser->events   = new_events;
+    parser->capacity = new_capacity;
+  }
+
+  SmfEvent* const ev = &parser->events[parser->n_events];
+  ev->tick           = tick;
+  ev->seq            = (uint32_t)parser->n_events;
+  ev->tempo          = tempo;
+  ev->offset         = (uint32_t)parser->data.size;
+  ev->size           = tempo ? 0U : (1U + body_size);
+  ++parser->n_events;
+
+  ZixStatus st = ZIX_STATUS_SUCCESS;
+  if (!tempo && !(st = buffer_append(&parser->data, &status, 1U))) {
+    st = buffer_append(&parser->data, body, body_size);
+  }
+
+  return st;
+}
+
+static ZixStatus
+parse_track(Parser* const parser, const uint8_t* p, const uint8_t* const end)
+{
+  ZixStatus st      = ZIX_STATUS_SUCCESS;
+  uint64_t  tick    = 0U;
+  uint8_t   running = 0U;
+  while (!st && p < end) {
+    uint32_t delta = 0U;
+    if (!(p = read_vlq(p, end, &delta)) || p >= end) {
+      return ZIX_STATUS_BAD_ARG;
+    }
+
+    tick += delta;
+
+    const uint8_t status = *p;
+    uint32_t      size   = 0U;
+    if (status == 0xFFU) {
+      // Meta event, only tempo and end of track are relevant
+      const uint8_t type = (end - p >= 2) ? p[1] : 0U;
+      if (end - p < 2 || !(p = read_vlq(p + 2, end, &size)) ||
+          (size_t)(end - p) < size) {
+        return ZIX_STATUS_BAD_ARG;
+      }
+
+      if (type == 0x2FU) {
+        break;
+      }
+
+      if (type == 0x51U && size == 3U) {
+        const uint32_t tempo = ((uint32_t)p[0] << 16U) |
+                               ((uint32_t)p[1] << 8U) | (uint32_t)p[2];
+        st = tempo ? parser_add(parser, tick, tempo, 0U, NULL, 0U) : st;
+      }
+
+      running = 0U;
+      p += size;
+
+    } else if (status == 0xF0U || status == 0xF7U) {
+      // System exclusive message or escaped data (which is ignored)
+      if (!(p = read_vlq(p + 1, end, &size)) || (size_t)(end - p) < size) {
+        return ZIX_STATUS_BAD_ARG;
+      }
+
+      if (status == 0xF0U) {
+        st = parser_add(parser, tick, 0U, status, p, size);
+      }
+
+      running = 0U;
+      p += size;
+
+    } else {
+      // Channel message, possibly using running status
+      if (status >= 0xF0U) {
+        return ZIX_STATUS_BAD_ARG;
+      }
+
+      if (status & 0x80U) {
+        running = status;
+        ++p;
+      } else if (!running) {
+        return ZIX_STATUS_BAD_ARG;
+      }
+
+      size = channel_message_data_size(running);
+      if ((size_t)(end - p) < size) {
+        return ZIX_STATUS_BAD_ARG;
+      }
+
+      st = parser_add(parser, tick, 0U, running, p, size);
+      p += size;
+    }
+  }
+
+  return st;
+}
+
+static ZixStatus
+parse_file(Parser* const        parser,
+           const uint8_t* const bytes,
+           const size_t         size,
+           uint16_t* const      division)
+{
+  if (size < 14U || memcmp(bytes, "MThd", 4) || get_u32(bytes + 4) < 6U) {
+    return ZIX_STATUS_BAD_ARG;
+  }
+
+  *division = get_u16(bytes + 12);
+  if (!*division) {
+    return ZIX_STATUS_BAD_ARG;
+  }
+
+  const uint32_t header_size = get_u32(bytes + 4);
+  if (header_size > size - 8U) {
+    return ZIX_STATUS_BAD_ARG;
+  }
+
+  ZixStatus      st  = ZIX_STATUS_SUCCESS;
+  const uint8_t* p   = bytes + 8U + header_size;
+  const uint8_t* end = bytes + size;
+  while (!st && end - p >= 8) {
+    const uint32_t chunk_size = get_u32(p + 4);
+    if ((size_t)(end - p - 8) < chunk_size) {
+      return ZIX_STATUS_BAD_ARG;
+    }
+
+    if (!memcmp(p, "MTrk", 4)) {
+      st = parse_track(parser, p + 8, p + 8 + chunk_size);
+    }
+
+    p += 8U + chunk_size;
+  }
+
+  return st;
+}
+
+static ZixStatus
+load_events(JalvMidiFile* const file, Parser* const parser, uint16_t division)
+{
+  if (!parser->n_events) {
+    return ZIX_STATUS_SUCCESS;
+  }
+
+  qsort(parser->events, parser->n_events, sizeof(SmfEvent), event_compare);
+
+  file->events =
+    (JalvMidiEvent*)calloc(parser->n_events, sizeof(JalvMidiEvent));
+  if (!file->events) {
+    return ZIX_STATUS_NO_MEM;
+  }
+
+  // Determine the fixed duration of a tick for SMPTE time divisions
+  double smpte_tick_seconds = 0.0;
+  if (division & 0x8000U) {
+    const int    fps  = -(int)(int8_t)(uint8_t)(division >> 8U);
+    const double rate = (fps == 29) ? (30000.0 / 1001.0) : (double)fps;
+    const unsigned ticks_per_frame = division & 0xFFU;
+    if (fps <= 0 || !ticks_per_frame) {
+      return ZIX_STATUS_BAD_ARG;
+    }
+
+    smpte_tick_seconds = 1.0 / (rate * ticks_per_frame);
+  }
+
+  // Convert event times to frames by walking the tempo map
+  uint64_t tempo_tick    = 0U;
+  double   tempo_seconds = 0.0;
+  double   tick_seconds  = MIDI_FILE_USEC_PER_QUARTER / (1000000.0 * division);
+  if (smpte_tick_seconds > 0.0) {
+    tick_seconds = smpte_tick_seconds;
+  }
+
+  for (size_t i = 0U; i < parser->n_events; ++i) {
+    const SmfEvent* const ev = &parser->events[i];
+    const double          seconds =
+      tempo_seconds + (double)(ev->tick - tempo_tick) * tick_seconds;
+
+    if (ev->tempo) {
+      if (smpte_tick_seconds <= 0.0) {
+        tempo_tick    = ev->tick;
+        tempo_seconds = seconds;
+        tick_seconds  = ev->tempo / (1000000.0 * division);
+      }
+    } else {
+      JalvMidiEvent* const out = &file->events[file->n_events++];
+      out->frame               = (uint64_t)(seconds * file->rate + 0.5);
+      out->size                = ev->size;
+      out->data                = parser->data.bytes + ev->offset;
+    }
+  }
+
+  // Take ownership of message data referenced by the loaded events
+  file->data         = parser->data;
+  parser->data.bytes = NULL;
+  return ZIX_STATUS_SUCCESS;
+}
+
+JalvMidiFile*
+jalv_midi_file_open_read(const char* const path, const float rate)
+{
+  FILE* const fd = fopen(path, "rb");
+  if (!fd) {
+    return NULL;
+  }
+
+  // Load the entire file into memory
+  uint8_t* bytes = NULL;
+  long     size  = 0;
+  if (!fseek(fd, 0L, SEEK_END) && (size = ftell(fd)) > 0 &&
+      !fseek(fd, 0L, SEEK_SET) && (bytes = (uint8_t*)malloc((size_t)size)) &&
+      fread(bytes, 1, (size_t)size, fd) != (size_t)size) {
+    free(bytes);
+    bytes = NULL;
+  }
+
+  fclose(fd);
+  if (!bytes) {
+    return NULL;
+  }
+
+  JalvMidiFile* file     = (JalvMidiFile*)calloc(1, sizeof(JalvMidiFile));
+  Parser        parser   = {NULL, 0U, 0U, {NULL, 0U, 0U}};
+  uint16_t      division = 0U;
+  if (file) {
+    file->rate = rate;
+    if (parse_file(&parser, bytes, (size_t)size, &division) ||
+        load_events(file, &parser, division)) {
+      jalv_midi_file_close(file);
+      file = NULL;
+    }
+  }
+
+  free(parser.data.bytes);
+  free(parser.events);
+  free(bytes);
+  return file;
+}
+
+JalvMidiFile*
+jalv_midi_file_open_write(const char* const path, const float rate)
+{
+  JalvMidiFile* const file = (JalvMidiFile*)calloc(1, sizeof(JalvMidiFile));
+  if (file) {
+    if (!(file->fd = fopen(path, "wb"))) {
+      free(file);
+      return NULL;
+    }
+
+    file->rate = rate;
+  }
+
+  return file;
+}
+
+static ZixStatus
+write_file(JalvMidiFile* const file)
+{
+  static const uint8_t tempo[] = {0x00U,
+                                  0xFFU,
+                                  0x51U,
+                                  0x03U,
+                                  (MIDI_FILE_USEC_PER_QUARTER >> 16U) & 0xFFU,
+                                  (MIDI_FILE_USEC_PER_QUARTER >> 8U) & 0xFFU,
+                                  MIDI_FILE_USEC_PER_QUARTER & 0xFFU};
+
+  static const uint8_t end_of_track[] = {0x00U, 0xFFU, 0x2FU, 0x00U};
+
+  const size_t track_size =
+    sizeof(tempo) + file->data.size + sizeof(end_of_track);
+
+  uint8_t header[22] = {'M', 'T', 'h', 'd', 0U, 0U, 0U, 6U, 0U, 0U, 0U, 1U};
+  header[12]         = (MIDI_FILE_TICKS_PER_QUARTER >> 8U) & 0xFFU;
+  header[13]         = MIDI_FILE_TICKS_PER_QUARTER & 0xFFU;
+  memcpy(header + 14, "MTrk", 4);
+  put_u32(header + 18, (uint32_t)track_size);
+
+  return (fwrite(header, 1, sizeof(header), file->fd) != sizeof(header) ||
+          fwrite(tempo, 1, sizeof(tempo), file->fd) != sizeof(tempo) ||
+          (file->data.size && fwrite(file->data.bytes,
+                                     1,
+                                     file->data.size,
+                                     file->fd) != file->data.size) ||
+          fwrite(end_of_track, 1, sizeof(end_of_track), file->fd) !=
+            sizeof(end_of_track))
+           ? ZIX_STATUS_ERROR
+           : ZIX_STATUS_SUCCESS;
+}
+
+ZixStatus
+jalv_midi_file_close(JalvMidiFile* const file)
+{
+  if (!file) {
+    return ZIX_STATUS_SUCCESS;
+  }
+
+  ZixStatus st = ZIX_STATUS_SUCCESS;
+  if (file->fd) {
+    st = write_file(file);
+    if (fclose(file->fd)) {
+      st = ZIX_STATUS_ERROR;
+    }
+  }
+
+  free(file->data.bytes);
+  free(file->events);
+  free(file);
+  return st;
+}
+
+uint64_t
+jalv_midi_file_length(const JalvMidiFile* const file)
+{
+  return file->n_events ? file->events[file->n_events - 1U].frame : 0U;
+}
+
+const JalvMidiEvent*
+jalv_midi_file_next(JalvMidiFile* const file, const uint64_t end)
+{
+  if (file->next < file->n_events && file->events[file->next].frame < end) {
+    return &file->events[file->next++];
+  }
+
+  return NULL;
+}
+
+ZixStatus
+jalv_midi_file_write(JalvMidiFile* const  file,
+                     const uint64_t       frame,
+                     const uint32_t       size,
+                     const uint8_t* const data)
+{
+  if (!file->fd || !size) {
+    return ZIX_STATUS_BAD_ARG;
+  }
+
+  const double ticks_per_frame = (MIDI_FILE_TICKS_PER_QUARTER * 1000000.0) /
+                                 (MIDI_FILE_USEC_PER_QUARTER * file->rate);
+
+  uint64_t tick = (uint64_t)((double)frame * ticks_per_frame + 0.5);
+  if (tick < file->last_tick) {
+    tick = file->last_tick;
+  }
+
+  const uint64_t delta = tick - file->last_tick;
+  if (delta > 0x0FFFFFFFU) {
+    return ZIX_STATUS_BAD_ARG;
+  }
+
+  ZixStatus st = buffer_append_vlq(&file->data, (uint32_t)delta);
+  if (!st && data[0] == 0xF0U) {
+    // System exclusive, written as status, length, and the remaining bytes
+    if (!(st = buffer_append(&file->data, data, 1U)) &&
+        !(st = buffer_append_vlq(&file->data, size - 1U))) {
+      st = buffer_append(&file->data, data + 1U, size - 1U);
+    }
+  } else if (!st) {
+    st = buffer_append(&file->data, data, size);
+  }
+
+  file->last_tick = tick;
+  return st;
+}
@@ -0,0 +1,92 @@
+// Copyright 2026 David Robillard <d@drobilla.net>
+// SPDX-License-Identifier: ISC
+
+#ifndef JALV_MIDI_FILE_H
+#define JALV_MIDI_FILE_H
+
+#include "attributes.h"
+
+#include <zix/attributes.h>
+#include <zix/status.h>
+
+#include <stdint.h>
+
+// Minimal Standard MIDI File reading and writing for offline rendering
+JALV_BEGIN_DECLS
+
+/**
+   A Standard MIDI File opened for either reading or writing.
+
+   When reading, all tracks are merged into a single sequence of events with
+   times converted to audio frames using the file's tempo map.  Files are
+   always written as a single track (format 0) at a fixed tempo.
+*/
+typedef struct JalvMidiFileImpl JalvMidiFile;
+
+/// A MIDI event read from a file
+typedef struct {
+  uint64_t       frame; ///< Time in audio frames from the start of the file
+  uint32_t       size;  ///< Size of message in bytes
+  const uint8_t* data;  ///< Complete MIDI message, including status byte
+} JalvMidiEvent;
+
+/**
+   Open and load a MIDI file for reading.
+
+   @param path Path to a Standard MIDI File.
+   @param rate Sample rate used to convert event times to frames.
+   @return A newly opened file, or null on error.
+*/
+ZIX_MALLOC_FUNC JalvMidiFile*
+jalv_midi_file_open_read(const char* path, float rate);
+
+/**
+   Open a MIDI file for writing, truncating it if it already exists.
+
+   @param path Path to a Standard MIDI File.
+   @param rate Sample rate used to convert event frames to times.
+   @return A newly opened file, or null on error.
+*/
+ZIX_MALLOC_FUNC JalvMidiFile*
+jalv_midi_file_open_write(const char* path, float rate);
+
+/**
+   Finish writing and close a file.
+
+   For written files, this writes the accumulated track to disk.
+*/
+ZixStatus
+jalv_midi_file_close(JalvMidiFile* file);
+
+/// Return the time of the last event in a file read from disk, in frames
+ZIX_PURE_FUNC uint64_t
+jalv_midi_file_length(const JalvMidiFile* file);
+
+/**
+   Read the next event in a file if it is before a given time.
+
+   @param file File opened with jalv_midi_file_open_read().
+   @param end Time in frames that the returned event must be before.
+   @return The next event, or null if there are no more events before `end`.
+*/
+const JalvMidiEvent*
+jalv_midi_file_next(JalvMidiFile* file, uint64_t end);
+
+/**
+   Append an event to a file.
+
+   @param file File opened with jalv_midi_file_open_write().
+   @param frame Time of event in frames, which must not be earlier than the
+   previously written event.
+   @param size Size of message in bytes.
+   @param data Complete MIDI message, including status byte.
+*/
+ZixStatus
+jalv_midi_file_write(JalvMidiFile*  file,
+                     uint64_t       frame,
+                     uint32_t       size,
+                     const uint8_t* data);
+
+JALV_END_DECLS
+
+#endif // JALV_MIDI_FILE_H
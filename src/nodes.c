@@ -24,8 +24,10 @@ jalv_init_nodes(LilvWorld* const world, JalvNodes* const nodes)
 #define MAP_NODE(uri) lilv_new_uri(world, (uri))
 
   nodes->atom_AtomPort           = MAP_NODE(LV2_ATOM__AtomPort);
+  nodes->atom_Blank              = MAP_NODE(LV2_ATOM__Blank);
   nodes->atom_Chunk              = MAP_NODE(LV2_ATOM__Chunk);
   nodes->atom_Float              = MAP_NODE(LV2_ATOM__Float);
+  nodes->atom_Object             = MAP_NODE(LV2_ATOM__Object);
   nodes->atom_Path               = MAP_NODE(LV2_ATOM__Path);
   nodes->atom_Sequence           = MAP_NODE(LV2_ATOM__Sequence);
   nodes->lv2_AudioPort           = MAP_NODE(LV2_CORE__AudioPort);
@@ -62,6 +64,9 @@ jalv_init_nodes(LilvWorld* const world, JalvNodes* const nodes)
   nodes->state_threadSafeRestore = MAP_NODE(LV2_STATE__threadSafeRestore);
   nodes->time_Position           = MAP_NODE(LV2_TIME__Position);
   nodes->time_beatsPerMinute     = MAP_NODE(LV2_TIME__beatsPerMinute);
+  nodes->ui_notifyType           = MAP_NODE(LV2_UI__notifyType);
+  nodes->ui_portIndex            = MAP_NODE(LV2_UI__portIndex);
+  nodes->ui_portNotification     = MAP_NODE(LV2_UI__portNotification);
   nodes->ui_showInterface        = MAP_NODE(LV2_UI__showInterface);
   nodes->work_interface          = MAP_NODE(LV2_WORKER__interface);
   nodes->work_schedule           = MAP_NODE(LV2_WORKER__schedule);
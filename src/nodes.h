@@ -13,8 +13,10 @@ JALV_BEGIN_DECLS
 
 typedef struct {
   LilvNode* atom_AtomPort;
+  LilvNode* atom_Blank;
   LilvNode* atom_Chunk;
   LilvNode* atom_Float;
+  LilvNode* atom_Object;
   LilvNode* atom_Path;
   LilvNode* atom_Sequence;
   LilvNode* lv2_AudioPort;
@@ -51,6 +53,9 @@ typedef struct {
   LilvNode* state_threadSafeRestore;
   LilvNode* time_Position;
   LilvNode* time_beatsPerMinute;
+  LilvNode* ui_notifyType;
+  LilvNode* ui_portIndex;
+  LilvNode* ui_portNotification;
   LilvNode* ui_showInterface;
   LilvNode* work_interface;
   LilvNode* work_schedule;
@@ -1,4 +1,4 @@
-// Copyright 2007-2022 David Robillard <d@drobilla.net>
+// Copyright 2007-2026 David Robillard <d@drobilla.net>
 // SPDX-License-Identifier: ISC
 
 #ifndef JALV_OPTIONS_H
@@ -15,11 +15,18 @@ typedef struct {
   char*    name;            ///< Client name
   int      name_exact;      ///< Exit if name is taken
   char**   controls;        ///< Control values
+  char**   links;           ///< Links between plugins like "1/out=2/in"
+  char**   tempos;          ///< Internal tempo changes like "96000:90,3/4"
   uint32_t ring_size;       ///< Plugin <=> UI communication buffer size
   uint32_t block_length;    ///< Audio block length in frames
+  uint32_t split_length;    ///< Minimum length of split blocks, or zero
   double   update_rate;     ///< UI update rate in Hz
   double   scale_factor;    ///< UI scale factor
   int      dump;            ///< Dump communication iff true
+  char*    dump_file;       ///< Binary file to capture communication to
+  char**   dump_filters;    ///< Port symbols or type URIs to dump
+  char*    traffic_log;     ///< File to record plugin <=> UI messages to
+  char*    replay_log;      ///< Traffic log to replay UI messages from
   int      trace;           ///< Print trace log iff true
   int      generic_ui;      ///< Use generic UI iff true
   int      show_hidden;     ///< Show controls for notOnGUI ports
@@ -28,6 +35,20 @@ typedef struct {
   int      print_controls;  ///< Print control changes to stdout
   int      non_interactive; ///< Do not listen for commands on stdin
   char*    ui_uri;          ///< URI of UI to load
+  char*    audio_input;     ///< Audio input file for offline rendering
+  char*    audio_output;    ///< Audio output file for offline rendering
+  char*    midi_input;      ///< MIDI input file for offline rendering
+  char*    midi_output;     ///< MIDI output file for offline rendering
+  double   sample_rate;     ///< Sample rate for offline rendering
+  double   tail;            ///< Seconds to render after input ends
+  double   duration;        ///< Seconds to run without input, or zero
+  double   sleep_tail;      ///< Seconds of silence before sleeping, or zero
+  int      free_running;    ///< Process as fast as possible without a clock
+  uint32_t worker_threads;  ///< Number of threads for thread-safe plugin work
+  uint32_t graph_threads;   ///< Number of threads to run several plugins on
+  int      shadow_restore;  ///< Restore state into a new instance and fade
+  int      preset_cache;    ///< Preload presets for fast switching
+  char*    plugin_index;    ///< Plugin index file for loading only needed data
 } JalvOptions;
 
 JALV_END_DECLS
@@ -0,0 +1,630 @@
+// Copyright 2026 David Robillard <d@drobilla.net>
+// SPDX-License-Identifier: ISC
+
+#include "plugin_index.h"
+
+#include "clock.h"
+#include "jalv_config.h"
+#include "symap.h"
+
+#include <lilv/lilv.h>
+#include <lv2/presets/presets.h>
+#include <zix/allocator.h>
+#include <zix/filesystem.h>
+#include <zix/path.h>
+#include <zix/status.h>
+
+#if USE_STAT
+#  include <sys/stat.h>
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+  The index is a text file with one record per line:
+
+  dir MTIME URI         A directory that contains bundles
+  bundle MTIME URI      A bundle, numbered from 1 in order of appearance
+  spec NUMBER           A bundle that defines specifications
+  plugin URI NUMBER...  The bundles that describe a plugin
+  preset URI NUMBER...  The bundles needed to load a preset
+  end                   The end of a complete index
+
+  Times are in seconds, for bundles it's the latest time of the bundle
+  directory itself and every file in it.
+*/
+
+#define INDEX_HEADER "jalv-plugin-index 1\n"
+#define INDEX_FOOTER "end\n"
+
+/// Maximum length of a line in an index file
+#define MAX_LINE_LENGTH 65536U
+
+/// Nodes used while writing an index
+typedef struct {
+  LilvNode* lv2_Specification;
+  LilvNode* pset_Preset;
+  LilvNode* rdf_type;
+  LilvNode* rdfs_seeAlso;
+} IndexNodes;
+
+/// A set of bundle numbers
+typedef struct {
+  uint32_t* numbers;  ///< Array of bundle numbers
+  uint32_t  size;     ///< Number of elements in numbers
+  uint32_t  capacity; ///< Allocated size of numbers
+} Bundles;
+
+/// State for writing an index file
+typedef struct {
+  FILE*  file;    ///< Output file
+  Symap* dirs;    ///< Directory URIs that have been written
+  Symap* bundles; ///< Bundle URIs that have been written, to their numbers
+  bool   error;   ///< True if an error has occurred
+} Writer;
+
+/// State for reading an index file
+typedef struct {
+  char**     uris;      ///< Bundle URIs indexed by number minus one
+  long long* mtimes;    ///< Bundle times indexed by number minus one
+  uint32_t   n_bundles; ///< Number of bundles read
+  uint32_t   capacity;  ///< Allocated size of uris and mtimes
+  Bundles    needed;    ///< Bundles needed to load the requested resource
+  bool       found;     ///< True if the requested resource has been found
+} Reader;
+
+/// Get the modification time of a path
+static bool
+path_mtime(const char* const path, long long* const mtime)
+{
+#if USE_STAT
+  struct stat st;
+  if (!stat(path, &st)) {
+    *mtime = (long long)st.st_mtime;
+    return true;
+  }
+#else
+  (void)path;
+  (void)mtime;
+#endif
+
+  return false;
+}
+
+/// Update the latest modification time with a file in a bundle
+static void
+visit_bundle_file(const char* const path,
+                  const char* const name,
+                  void* const       data)
+{
+  long long* const latest    = (long long*)data;
+  char* const      file_path = zix_path_join(NULL, path, name);
+  long long        mtime     = 0;
+  if (file_path && path_mtime(file_path, &mtime) && mtime > *latest) {
+    *latest = mtime;
+  }
+
+  zix_free(NULL, file_path);
+}
+
+/// Get the modification time of a directory URI, or of the newest file in it
+static bool
+uri_mtime(const char* const uri, const bool files, long long* const mtime)
+{
+  char* const path = lilv_file_uri_parse(uri, NULL);
+  const bool  ok   = path && path_mtime(path, mtime);
+  if (ok && files) {
+    zix_dir_for_each(path, mtime, visit_bundle_file);
+  }
+
+  lilv_free(path);
+  return ok;
+}
+
+/// Return the URI of the directory that contains a file or directory URI
+static char*
+parent_uri(const char* const uri)
+{
+  size_t len = strlen(uri);
+  if (len && uri[len - 1U] == '/') {
+    --len;
+  }
+
+  while (len && uri[len - 1U] != '/') {
+    --len;
+  }
+
+  char* const parent = len ? (char*)calloc(len + 1U, 1U) : NULL;
+  if (parent) {
+    memcpy(parent, uri, len);
+  }
+
+  return parent;
+}
+
+/// Return true if a directory URI is a bundle with a manifest
+static bool
+is_bundle(const char* const uri)
+{
+  char* const dir_path = lilv_file_uri_parse(uri, NULL);
+  char* const path =
+    dir_path ? zix_path_join(NULL, dir_path, "manifest.ttl") : NULL;
+
+  const bool result = path && zix_file_type(path) == ZIX_FILE_TYPE_REGULAR;
+
+  zix_free(NULL, path);
+  lilv_free(dir_path);
+  return result;
+}
+
+/// Return the URI of the bundle that contains a data file, or null
+static char*
+file_bundle_uri(const char* const file_uri)
+{
+  if (!file_uri || !!strncmp(file_uri, "file:", 5)) {
+    return NULL;
+  }
+
+  // Search upwards, since files may be in subdirectories of the bundle
+  char* dir = parent_uri(file_uri);
+  while (dir && !is_bundle(dir)) {
+    char* const parent = parent_uri(dir);
+    free(dir);
+    dir = parent;
+  }
+
+  return dir;
+}
+
+/// Add a number to a set of bundles if it isn't already present
+static bool
+bundles_add(Bundles* const bundles, const uint32_t number)
+{
+  for (uint32_t i = 0U; i < bundles->size; ++i) {
+    if (bundles->numbers[i] == number) {
+      return true;
+    }
+  }
+
+  if (bundles->size == bundles->capacity) {
+    const uint32_t  capacity = bundles->capacity ? bundles->capacity * 2U : 8U;
+    uint32_t* const numbers =
+      (uint32_t*)realloc(bundles->numbers, capacity * sizeof(uint32_t));
+    if (!numbers) {
+      return false;
+    }
+
+    bundles->numbers  = numbers;
+    bundles->capacity = capacity;
+  }
+
+  bundles->numbers[bundles->size++] = number;
+  return true;
+}
+
+/// Write a directory record if it hasn't been written already
+static void
+write_dir(Writer* const writer, const char* const dir_uri)
+{
+  long long mtime = 0;
+  if (dir_uri && !symap_try_map(writer->dirs, dir_uri)) {
+    if (!uri_mtime(dir_uri, false, &mtime) ||
+        !symap_map(writer->dirs, dir_uri)) {
+      writer->error = true;
+    } else {
+      fprintf(writer->file, "dir %lld %s\n", mtime, dir_uri);
+    }
+  }
+}
+
+/// Write a bundle record if necessary and add its number to a set
+static void
+write_bundle(Writer* const     writer,
+             Bundles* const    bundles,
+             const char* const bundle_uri)
+{
+  uint32_t number = symap_try_map(writer->bundles, bundle_uri);
+  if (!number) {
+    long long   mtime  = 0;
+    char* const parent = parent_uri(bundle_uri);
+
+    write_dir(writer, parent);
+    free(parent);
+
+    if (!uri_mtime(bundle_uri, true, &mtime) ||
+        !(number = symap_map(writer->bundles, bundle_uri))) {
+      writer->error = true;
+      return;
+    }
+
+    fprintf(writer->file, "bundle %lld %s\n", mtime, bundle_uri);
+  }
+
+  if (!bundles_add(bundles, number)) {
+    writer->error = true;
+  }
+}
+
+/// Add the bundles of all the rdfs:seeAlso files of a subject
+static void
+write_see_also_bundles(Writer* const           writer,
+                       Bundles* const          bundles,
+                       LilvWorld* const        world,
+                       const IndexNodes* const nodes,
+                       const LilvNode* const   subject)
+{
+  LilvNodes* const files =
+    lilv_world_find_nodes(world, subject, nodes->rdfs_seeAlso, NULL);
+
+  LILV_FOREACH (nodes, f, files) {
+    char* const bundle_uri =
+      file_bundle_uri(lilv_node_as_uri(lilv_nodes_get(files, f)));
+    if (bundle_uri) {
+      write_bundle(writer, bundles, bundle_uri);
+      free(bundle_uri);
+    }
+  }
+
+  lilv_nodes_free(files);
+}
+
+/// Write a record for a plugin or preset
+static void
+write_record(Writer* const         writer,
+             const char* const     kind,
+             const LilvNode* const uri,
+             const Bundles* const  bundles)
+{
+  fprintf(writer->file, "%s %s", kind, lilv_node_as_uri(uri));
+  for (uint32_t i = 0U; i < bundles->size; ++i) {
+    fprintf(writer->file, " %u", bundles->numbers[i]);
+  }
+  fprintf(writer->file, "\n");
+}
+
+/// Write records for the bundles that define specifications
+static void
+write_specs(Writer* const           writer,
+            LilvWorld* const        world,
+            const IndexNodes* const nodes)
+{
+  Bundles          bundles = {NULL, 0U, 0U};
+  LilvNodes* const specs   = lilv_world_find_nodes(
+    world, NULL, nodes->rdf_type, nodes->lv2_Specification);
+
+  LILV_FOREACH (nodes, s, specs) {
+    write_see_also_bundles(
+      writer, &bundles, world, nodes, lilv_nodes_get(specs, s));
+  }
+
+  for (uint32_t i = 0U; i < bundles.size; ++i) {
+    fprintf(writer->file, "spec %u\n", bundles.numbers[i]);
+  }
+
+  lilv_nodes_free(specs);
+  free(bundles.numbers);
+}
+
+/// Write records for a plugin and its presets
+static void
+write_plugin(Writer* const           writer,
+             LilvWorld* const        world,
+             const IndexNodes* const nodes,
+             const LilvPlugin* const plugin)
+{
+  Bundles bundles = {NULL, 0U, 0U};
+
+  // Add the plugin bundle and any others that describe the plugin
+  write_bundle(
+    writer, &bundles, lilv_node_as_uri(lilv_plugin_get_bundle_uri(plugin)));
+
+  const LilvNodes* const data_uris = lilv_plugin_get_data_uris(plugin);
+  LILV_FOREACH (nodes, d, data_uris) {
+    char* const bundle_uri =
+      file_bundle_uri(lilv_node_as_uri(lilv_nodes_get(data_uris, d)));
+    if (bundle_uri) {
+      write_bundle(writer, &bundles, bundle_uri);
+      free(bundle_uri);
+    }
+  }
+
+  // Add the bundles of presets, which are usually separate
+  LilvNodes* const presets =
+    lilv_plugin_get_related(plugin, nodes->pset_Preset);
+  LILV_FOREACH (nodes, p, presets) {
+    write_see_also_bundles(
+      writer, &bundles, world, nodes, lilv_nodes_get(presets, p));
+  }
+
+  // Write a record for the plugin and each of its presets
+  write_record(writer, "plugin", lilv_plugin_get_uri(plugin), &bundles);
+  LILV_FOREACH (nodes, p, presets) {
+    write_record(writer, "preset", lilv_nodes_get(presets, p), &bundles);
+  }
+
+  lilv_nodes_free(presets);
+  free(bundles.numbers);
+}
+
+ZixStatus
+jalv_plugin_index_save(LilvWorld* const world, const char* const path)
+{
+  if (!USE_STAT) {
+    return ZIX_STATUS_NOT_SUPPORTED;
+  }
+
+  // Write to a unique temporary file next to the index
+  const size_t temp_path_len = strlen(path) + 32U;
+  char* const  temp_path     = (char*)calloc(temp_path_len, 1U);
+  if (!temp_path) {
+    return ZIX_STATUS_NO_MEM;
+  }
+
+  snprintf(temp_path,
+           temp_path_len,
+           "%s.%llu",
+           path,
+           (unsigned long long)jalv_clock_now());
+
+  FILE* const file = fopen(temp_path, "w");
+  if (!file) {
+    free(temp_path);
+    return ZIX_STATUS_BAD_PERMS;
+  }
+
+  IndexNodes nodes = {
+    lilv_new_uri(world, LILV_NS_LV2 "Specification"),
+    lilv_new_uri(world, LV2_PRESETS__Preset),
+    lilv_new_uri(world, LILV_NS_RDF "type"),
+    lilv_new_uri(world, LILV_NS_RDFS "seeAlso"),
+  };
+
+  Writer writer = {file, symap_new(), symap_new(), false};
+  if (!writer.dirs || !writer.bundles) {
+    writer.error = true;
+  } else {
+    fputs(INDEX_HEADER, file);
+    write_specs(&writer, world, &nodes);
+
+    const LilvPlugins* const plugins = lilv_world_get_all_plugins(world);
+    LILV_FOREACH (plugins, p, plugins) {
+      write_plugin(&writer, world, &nodes, lilv_plugins_get(plugins, p));
+    }
+
+    fputs(INDEX_FOOTER, file);
+  }
+
+  writer.error = ferror(file) || writer.error;
+  writer.error = fclose(file) || writer.error;
+
+  // Replace any existing index with the new one
+  if (writer.error || rename(temp_path, path)) {
+    remove(temp_path);
+    writer.error = true;
+  }
+
+  symap_free(writer.bundles);
+  symap_free(writer.dirs);
+  lilv_node_free(nodes.rdfs_seeAlso);
+  lilv_node_free(nodes.rdf_type);
+  lilv_node_free(nodes.pset_Preset);
+  lilv_node_free(nodes.lv2_Specification);
+  free(temp_path);
+  return writer.error ? ZIX_STATUS_ERROR : ZIX_STATUS_SUCCESS;
+}
+
+/// Split the first space-separated field from the front of a string
+static char*
+next_field(char** const string)
+{
+  char* const field = *string;
+  char* const space = strchr(field, ' ');
+  if (space) {
+    *space  = '\0';
+    *string = space + 1;
+  } else {
+    *string = field + strlen(field);
+  }
+
+  return field;
+}
+
+/// Parse a decimal number field that must be followed by a space or the end
+static bool
+parse_number(char** const string, long long* const value)
+{
+  char* const field = next_field(string);
+  char*       end   = NULL;
+
+  *value = strtoll(field, &end, 10);
+  return *field && !*end;
+}
+
+/// Add a bundle number to the bundles that are needed
+static ZixStatus
+read_bundle_number(Reader* const reader, char** const string)
+{
+  long long number = 0;
+  if (!parse_number(string, &number) || number < 1 ||
+      number > (long long)reader->n_bundles) {
+    return ZIX_STATUS_BAD_ARG;
+  }
+
+  return bundles_add(&reader->needed, (uint32_t)number) ? ZIX_STATUS_SUCCESS
+                                                          : ZIX_STATUS_NO_MEM;
+}
+
+/// Read a bundle record
+static ZixStatus
+read_bundle(Reader* const reader, char** const string)
+{
+  long long mtime = 0;
+  if (!parse_number(string, &mtime) || !**string) {
+    return ZIX_STATUS_BAD_ARG;
+  }
+
+  if (reader->n_bundles == reader->capacity) {
+    const uint32_t capacity = reader->capacity ? reader->capacity * 2U : 64U;
+    char** const   uris =
+      (char**)realloc(reader->uris, capacity * sizeof(char*));
+    if (uris) {
+      reader->uris = uris;
+    }
+
+    long long* const mtimes =
+      (long long*)realloc(reader->mtimes, capacity * sizeof(long long));
+    if (mtimes) {
+      reader->mtimes = mtimes;
+    }
+
+    if (!uris || !mtimes) {
+      return ZIX_STATUS_NO_MEM;
+    }
+
+    reader->capacity = capacity;
+  }
+
+  const size_t uri_len = strlen(*string);
+  char* const  uri     = (char*)calloc(uri_len + 1U, 1U);
+  if (!uri) {
+    return ZIX_STATUS_NO_MEM;
+  }
+
+  memcpy(uri, *string, uri_len);
+  reader->uris[reader->n_bundles]   = uri;
+  reader->mtimes[reader->n_bundles] = mtime;
+  ++reader->n_bundles;
+  return ZIX_STATUS_SUCCESS;
+}
+
+/// Read a line and return the status of the index after it
+static ZixStatus
+read_line(Reader* const reader, char* line, const char* const uri)
+{
+  const char* const kind = next_field(&line);
+  long long         time = 0;
+  long long         now  = 0;
+  ZixStatus         st   = ZIX_STATUS_SUCCESS;
+
+  if (!strcmp(kind, "dir")) {
+    // Check the directory immediately, since bundles may have been added
+    if (!parse_number(&line, &time)) {
+      return ZIX_STATUS_BAD_ARG;
+    }
+
+    if (!uri_mtime(line, false, &now) || now != time) {
+      return ZIX_STATUS_REACHED_END;
+    }
+  } else if (!strcmp(kind, "bundle")) {
+    st = read_bundle(reader, &line);
+  } else if (!strcmp(kind, "spec")) {
+    st = read_bundle_number(reader, &line);
+  } else if (!strcmp(kind, "plugin") || !strcmp(kind, "preset")) {
+    if (!reader->found && !strcmp(next_field(&line), uri)) {
+      reader->found = true;
+      while (!st && *line) {
+        st = read_bundle_number(reader, &line);
+      }
+    }
+  } else {
+    st = ZIX_STATUS_BAD_ARG;
+  }
+
+  return st;
+}
+
+/// Read an index file and find the bundles needed for a URI
+static ZixStatus
+read_index(Reader* const reader, FILE* const file, const char* const uri)
+{
+  char* const line = (char*)calloc(MAX_LINE_LENGTH, 1U);
+  if (!line) {
+    return ZIX_STATUS_NO_MEM;
+  }
+
+  // Check header
+  if (!fgets(line, MAX_LINE_LENGTH, file) || !!strcmp(line, INDEX_HEADER)) {
+    free(line);
+    return ZIX_STATUS_REACHED_END;
+  }
+
+  // Read records until the end or an error
+  ZixStatus st = ZIX_STATUS_REACHED_END;
+  while (fgets(line, MAX_LINE_LENGTH, file)) {
+    const size_t len = strlen(line);
+    if (!len || line[len - 1U] != '\n') {
+      st = ZIX_STATUS_BAD_ARG;
+      break;
+    }
+
+    if (!strcmp(line, INDEX_FOOTER)) {
+      st = reader->found ? ZIX_STATUS_SUCCESS : ZIX_STATUS_NOT_FOUND;
+      break;
+    }
+
+    line[len - 1U] = '\0';
+    if ((st = read_line(reader, line, uri))) {
+      break;
+    }
+
+    st = ZIX_STATUS_REACHED_END;
+  }
+
+  free(line);
+  return st;
+}
+
+ZixStatus
+jalv_plugin_index_load(LilvWorld* const  world,
+                       const char* const path,
+                       const char* const uri)
+{
+  if (!USE_STAT) {
+    return ZIX_STATUS_NOT_SUPPORTED;
+  }
+
+  FILE* const file = fopen(path, "r");
+  if (!file) {
+    return ZIX_STATUS_REACHED_END;
+  }
+
+  Reader    reader = {NULL, NULL, 0U, 0U, {NULL, 0U, 0U}, false};
+  ZixStatus st     = read_index(&reader, file, uri);
+  fclose(file);
+
+  // Check that none of the needed bundles have changed
+  for (uint32_t i = 0U; !st && i < reader.needed.size; ++i) {
+    const uint32_t index = reader.needed.numbers[i] - 1U;
+    long long      mtime = 0;
+    if (!uri_mtime(reader.uris[index], true, &mtime) ||
+        mtime != reader.mtimes[index]) {
+      st = ZIX_STATUS_REACHED_END;
+    }
+  }
+
+  // Load only the needed bundles, then what lilv_world_load_all() does after
+  if (!st) {
+    for (uint32_t i = 0U; i < reader.needed.size; ++i) {
+      const uint32_t  index  = reader.needed.numbers[i] - 1U;
+      LilvNode* const bundle = lilv_new_uri(world, reader.uris[index]);
+      lilv_world_load_bundle(world, bundle);
+      lilv_node_free(bundle);
+    }
+
+    lilv_world_load_specifications(world);
+    lilv_world_load_plugin_classes(world);
+  }
+
+  for (uint32_t i = 0U; i < reader.n_bundles; ++i) {
+    free(reader.uris[i]);
+  }
+
+  free(reader.needed.numbers);
+  free(reader.mtimes);
+  free(reader.uris);
+  return st;
+}
@@ -0,0 +1,50 @@
+// Copyright 2026 David Robillard <d@drobilla.net>
+// SPDX-License-Identifier: ISC
+
+#ifndef JALV_PLUGIN_INDEX_H
+#define JALV_PLUGIN_INDEX_H
+
+#include "attributes.h"
+
+#include <lilv/lilv.h>
+#include <zix/status.h>
+
+// Persistent index of the bundles needed to load each plugin
+JALV_BEGIN_DECLS
+
+/**
+   Load only the bundles needed for a plugin or preset using an index file.
+
+   The index records, for every plugin and preset, the bundles that describe
+   it, along with the bundles that define specifications.  Every directory
+   that contains bundles, and every bundle that is needed, is checked against
+   the modification time recorded in the index, so that adding, removing, or
+   changing any of them makes the index stale.
+
+   Nothing is loaded into the world unless the index is up to date and
+   contains the given URI.
+
+   @param world World to load bundles into.
+   @param path Path of the index file.
+   @param uri URI of a plugin or preset to load the bundles for.
+   @return Zero on success, #ZIX_STATUS_NOT_FOUND if the URI isn't in the
+   index, #ZIX_STATUS_REACHED_END if the index is missing or stale, or
+   another error if the index is unreadable.
+*/
+ZixStatus
+jalv_plugin_index_load(LilvWorld* world, const char* path, const char* uri);
+
+/**
+   Write an index of every plugin in a world.
+
+   This must be called after lilv_world_load_all() so that the index is
+   complete.  The index is written to a temporary file which then replaces
+   any existing one, so processes that are reading it concurrently see either
+   the old or the new index.
+*/
+ZixStatus
+jalv_plugin_index_save(LilvWorld* world, const char* path);
+
+JALV_END_DECLS
+
+#endif // JALV_PLUGIN_INDEX_H
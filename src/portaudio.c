@@ -2,9 +2,9 @@
 // SPDX-License-Identifier: ISC
 
 #include "backend.h"
-#include "comm.h"
 #include "log.h"
 #include "lv2_evbuf.h"
+#include "options.h"
 #include "process.h"
 #include "settings.h"
 #include "types.h"
@@ -51,15 +51,23 @@ process_cb(const void*                     inputs,
            void*                           handle)
 {
   (void)time;
-  (void)flags;
 
   JalvProcess* const proc = (JalvProcess*)handle;
 
+  // Count any xrun reported for the previous cycle
+  if (flags & (paInputOverflow | paOutputUnderflow)) {
+    jalv_process_xrun(proc);
+  }
+
   // If execution is paused, emit silence and return
   if (proc->run_state == JALV_PAUSED) {
     return process_silent(proc, outputs, nframes);
   }
 
+  jalv_process_begin_cycle(proc);
+  jalv_process_run_timeline(proc, (uint32_t)nframes);
+  jalv_process_end_stage(proc, JALV_STAGE_TRANSPORT);
+
   // Prepare ports
   uint32_t in_index  = 0;
   uint32_t out_index = 0;
@@ -67,14 +75,13 @@ process_cb(const void*                     inputs,
     JalvProcessPort* const port = &proc->ports[i];
     if (port->type == TYPE_AUDIO) {
       if (port->flow == FLOW_INPUT) {
-        lilv_instance_connect_port(
-          proc->instance, i, ((float**)inputs)[in_index++]);
+        jalv_process_connect_port(proc, i, ((float**)inputs)[in_index++]);
       } else if (port->flow == FLOW_OUTPUT) {
-        lilv_instance_connect_port(
-          proc->instance, i, ((float**)outputs)[out_index++]);
+        jalv_process_connect_port(proc, i, ((float**)outputs)[out_index++]);
       }
-    } else if (port->type == TYPE_EVENT) {
-      lv2_evbuf_reset(port->evbuf, port->flow == FLOW_INPUT);
+    } else if (port->type == TYPE_EVENT && port->flow == FLOW_OUTPUT) {
+      // Clear event output (inputs were cleared after the last cycle)
+      lv2_evbuf_reset(port->evbuf, false);
     }
   }
 
@@ -99,14 +106,16 @@ process_cb(const void*                     inputs,
         lv2_evbuf_get(i, &frames, &subframes, &type, &size, &body);
 
         // Forward event to UI
-        jalv_write_event(proc->plugin_to_ui, p, size, type, body);
+        jalv_process_send_event(proc, p, size, type, body);
       }
     } else if (pst == JALV_PROCESS_SEND_UPDATES && port->flow == FLOW_OUTPUT &&
                port->type == TYPE_CONTROL) {
-      jalv_write_control(proc->plugin_to_ui, p, proc->controls_buf[p]);
+      jalv_process_send_control(proc, p);
     }
   }
 
+  jalv_process_end_cycle(
+    proc, (uint32_t)nframes, pst == JALV_PROCESS_SEND_UPDATES);
   return paContinue;
 }
 
@@ -131,14 +140,37 @@ jalv_backend_free(JalvBackend* const backend)
 }
 
 int
-jalv_backend_open(JalvBackend* const     backend,
-                  const JalvLog* const   log,
-                  const JalvURIDs* const ZIX_UNUSED(urids),
-                  JalvSettings* const    settings,
-                  JalvProcess* const     proc,
-                  ZixSem* const          ZIX_UNUSED(done),
-                  const char* const      ZIX_UNUSED(name),
-                  const bool             ZIX_UNUSED(exact_name))
+jalv_backend_share(JalvBackend* const ZIX_UNUSED(backend),
+                   JalvBackend* const ZIX_UNUSED(host),
+                   const char* const  ZIX_UNUSED(name))
+{
+  return 1;
+}
+
+int
+jalv_backend_link(JalvBackend* const ZIX_UNUSED(from),
+                  const uint32_t     ZIX_UNUSED(from_index),
+                  JalvBackend* const ZIX_UNUSED(to),
+                  const uint32_t     ZIX_UNUSED(to_index))
+{
+  return 1;
+}
+
+int
+jalv_backend_prepare_graph(JalvBackend* const ZIX_UNUSED(backend),
+                           const uint32_t     ZIX_UNUSED(n_threads))
+{
+  return 1;
+}
+
+int
+jalv_backend_open(JalvBackend* const       backend,
+                  const JalvLog* const     log,
+                  const JalvURIDs* const   ZIX_UNUSED(urids),
+                  JalvSettings* const      settings,
+                  JalvProcess* const       proc,
+                  ZixSem* const            ZIX_UNUSED(done),
+                  const JalvOptions* const ZIX_UNUSED(opts))
 {
   PaStreamParameters inputParameters;
   PaStreamParameters outputParameters;
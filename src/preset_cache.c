@@ -0,0 +1,176 @@
+// Copyright 2026 David Robillard <d@drobilla.net>
+// SPDX-License-Identifier: ISC
+
+#include "preset_cache.h"
+
+#include "clock.h"
+#include "symap.h"
+
+#include <lilv/lilv.h>
+#include <lv2/urid/urid.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+/// A preset in the cache
+typedef struct {
+  LilvNode*  uri;    ///< Preset URI
+  LilvState* state;  ///< Parsed state, or null if not loaded or taken
+  bool       loaded; ///< True if the preset data is loaded into the world
+} Entry;
+
+struct JalvPresetCacheImpl {
+  LilvWorld*    world;     ///< World to load preset data into
+  LV2_URID_Map* map;       ///< URID map for building states
+  Symap*        uris;      ///< Preset URI to entry index plus one
+  Entry*        entries;   ///< Entries indexed by URI ID minus one
+  uint32_t      n_entries; ///< Number of entries
+  uint32_t      next;      ///< Index of the next entry to load
+  uint32_t      n_loaded;  ///< Number of entries loaded so far
+  uint32_t      n_hits;    ///< Number of successful lookups
+  uint32_t      n_misses;  ///< Number of failed lookups
+  uint64_t      load_ns;   ///< Total time spent loading presets
+};
+
+JalvPresetCache*
+jalv_preset_cache_new(LilvWorld* const        world,
+                      LV2_URID_Map* const     map,
+                      const LilvPlugin* const plugin,
+                      const LilvNode* const   preset_class)
+{
+  JalvPresetCache* const cache =
+    (JalvPresetCache*)calloc(1, sizeof(JalvPresetCache));
+  if (!cache || !(cache->uris = symap_new())) {
+    free(cache);
+    return NULL;
+  }
+
+  cache->world = world;
+  cache->map   = map;
+
+  LilvNodes* const presets = lilv_plugin_get_related(plugin, preset_class);
+  const unsigned   n       = lilv_nodes_size(presets);
+  if (n && !(cache->entries = (Entry*)calloc(n, sizeof(Entry)))) {
+    lilv_nodes_free(presets);
+    jalv_preset_cache_free(cache);
+    return NULL;
+  }
+
+  LILV_FOREACH (nodes, i, presets) {
+    const LilvNode* const preset = lilv_nodes_get(presets, i);
+    const uint32_t id = symap_map(cache->uris, lilv_node_as_uri(preset));
+    if (id > cache->n_entries) {
+      cache->entries[cache->n_entries++].uri = lilv_node_duplicate(preset);
+    }
+  }
+
+  lilv_nodes_free(presets);
+  return cache;
+}
+
+void
+jalv_preset_cache_free(JalvPresetCache* const cache)
+{
+  if (cache) {
+    for (uint32_t i = 0U; i < cache->n_entries; ++i) {
+      lilv_state_free(cache->entries[i].state);
+      lilv_node_free(cache->entries[i].uri);
+    }
+
+    free(cache->entries);
+    symap_free(cache->uris);
+    free(cache);
+  }
+}
+
+uint32_t
+jalv_preset_cache_fill(JalvPresetCache* const cache, const uint64_t deadline)
+{
+  uint32_t n_parsed = 0U;
+  while (cache->next < cache->n_entries) {
+    Entry* const entry = &cache->entries[cache->next++];
+    if (!entry->loaded) {
+      const uint64_t start = jalv_clock_now();
+
+      lilv_world_load_resource(cache->world, entry->uri);
+      entry->state =
+        lilv_state_new_from_world(cache->world, cache->map, entry->uri);
+      entry->loaded = true;
+      ++cache->n_loaded;
+      ++n_parsed;
+
+      const uint64_t end = jalv_clock_now();
+      cache->load_ns += end - start;
+      if (end >= deadline) {
+        break;
+      }
+    }
+  }
+
+  return n_parsed;
+}
+
+/// Return the entry for a preset, or null if it isn't in the cache
+static Entry*
+find_entry(const JalvPresetCache* const cache, const LilvNode* const preset)
+{
+  const uint32_t id =
+    lilv_node_is_uri(preset)
+      ? symap_try_map(cache->uris, lilv_node_as_uri(preset))
+      : 0U;
+
+  return id ? &cache->entries[id - 1U] : NULL;
+}
+
+bool
+jalv_preset_cache_is_loaded(const JalvPresetCache* const cache,
+                            const LilvNode* const        preset)
+{
+  const Entry* const entry = find_entry(cache, preset);
+  return entry && entry->loaded;
+}
+
+LilvState*
+jalv_preset_cache_take(JalvPresetCache* const cache,
+                       const LilvNode* const  preset)
+{
+  Entry* const entry = find_entry(cache, preset);
+  if (!entry || !entry->state) {
+    ++cache->n_misses;
+    return NULL;
+  }
+
+  LilvState* const state = entry->state;
+  entry->state           = NULL;
+  ++cache->n_hits;
+  return state;
+}
+
+bool
+jalv_preset_cache_give(JalvPresetCache* const cache, LilvState* const state)
+{
+  Entry* const entry = find_entry(cache, lilv_state_get_uri(state));
+  if (!entry || entry->state) {
+    return false;
+  }
+
+  if (!entry->loaded) {
+    entry->loaded = true;
+    ++cache->n_loaded;
+  }
+
+  entry->state = state;
+  return true;
+}
+
+void
+jalv_preset_cache_stats(const JalvPresetCache* const cache,
+                        JalvPresetCacheStats* const  stats)
+{
+  stats->n_presets = cache->n_entries;
+  stats->n_loaded  = cache->n_loaded;
+  stats->n_hits    = cache->n_hits;
+  stats->n_misses  = cache->n_misses;
+  stats->load_ns   = cache->load_ns;
+}
@@ -0,0 +1,103 @@
+// Copyright 2026 David Robillard <d@drobilla.net>
+// SPDX-License-Identifier: ISC
+
+#ifndef JALV_PRESET_CACHE_H
+#define JALV_PRESET_CACHE_H
+
+#include "attributes.h"
+
+#include <lilv/lilv.h>
+#include <lv2/urid/urid.h>
+#include <zix/attributes.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Cache of parsed plugin presets for fast switching
+JALV_BEGIN_DECLS
+
+/**
+   A cache of the presets of a plugin, parsed ahead of time.
+
+   Parsing a preset requires loading its data into the world and building a
+   state from it, which can take a while for large presets.  This cache does
+   that once for every preset of a plugin, incrementally so it can be spread
+   over several UI updates, so that switching presets only costs the restore
+   itself.
+
+   A LilvWorld isn't thread-safe, so the cache must only be used in the main
+   thread like everything else that accesses it.
+*/
+typedef struct JalvPresetCacheImpl JalvPresetCache;
+
+/// Statistics about the use of a preset cache
+typedef struct {
+  uint32_t n_presets; ///< Number of presets of the plugin
+  uint32_t n_loaded;  ///< Number of presets parsed so far
+  uint32_t n_hits;    ///< Number of lookups that found a parsed preset
+  uint32_t n_misses;  ///< Number of lookups that found nothing
+  uint64_t load_ns;   ///< Total time spent parsing presets
+} JalvPresetCacheStats;
+
+/**
+   Create a cache for all the presets of a plugin.
+
+   This only collects the preset URIs, nothing is parsed until
+   jalv_preset_cache_fill() is called.
+*/
+JalvPresetCache*
+jalv_preset_cache_new(LilvWorld*        world,
+                      LV2_URID_Map*     map,
+                      const LilvPlugin* plugin,
+                      const LilvNode*   preset_class);
+
+/// Free a preset cache and all the states it contains
+void
+jalv_preset_cache_free(JalvPresetCache* cache);
+
+/**
+   Parse presets until all are loaded or a deadline has passed.
+
+   At least one preset is parsed if any remain, even if the deadline has
+   already passed.
+
+   @param cache Preset cache.
+   @param deadline Time to stop at, in the epoch of jalv_clock_now().
+   @return The number of presets parsed by this call.
+*/
+uint32_t
+jalv_preset_cache_fill(JalvPresetCache* cache, uint64_t deadline);
+
+/// Return true if the data of the given preset is loaded into the world
+ZIX_PURE_FUNC bool
+jalv_preset_cache_is_loaded(const JalvPresetCache* cache,
+                            const LilvNode*        preset);
+
+/**
+   Take the parsed state of a preset out of the cache.
+
+   The returned state is owned by the caller, and can be given back with
+   jalv_preset_cache_give() when it's no longer needed.
+
+   @return The state of the preset, or null if it isn't cached.
+*/
+LilvState*
+jalv_preset_cache_take(JalvPresetCache* cache, const LilvNode* preset);
+
+/**
+   Give a state that was taken from the cache back to it.
+
+   @return True if the state was put in the cache, otherwise the caller still
+   owns it.
+*/
+bool
+jalv_preset_cache_give(JalvPresetCache* cache, LilvState* state);
+
+/// Get statistics about the cache
+void
+jalv_preset_cache_stats(const JalvPresetCache* cache,
+                        JalvPresetCacheStats*  stats);
+
+JALV_END_DECLS
+
+#endif // JALV_PRESET_CACHE_H
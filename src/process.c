@@ -3,22 +3,43 @@
 
 #include "process.h"
 
+#include "atomic.h"
+#include "clock.h"
 #include "comm.h"
+#include "load.h"
+#include "log.h"
 #include "lv2_evbuf.h"
+#include "macros.h"
+#include "mailbox.h"
+#include "timeline.h"
+#include "traffic.h"
 #include "types.h"
+#include "wakeup.h"
 #include "worker.h"
 
 #include <lilv/lilv.h>
 #include <lv2/atom/atom.h>
+#include <lv2/atom/forge.h>
 #include <lv2/core/lv2.h>
+#include <lv2/urid/urid.h>
 #include <zix/attributes.h>
 #include <zix/ring.h>
 #include <zix/sem.h>
 #include <zix/warnings.h>
 
 #include <assert.h>
+#include <math.h>
+#include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <string.h>
+
+/// Peak level that outputs must stay under to be considered silent (-120 dB)
+static const float silence_threshold = 0.000001f;
+
+/// Maximum supported latency in frames (at most 2^24 so all integers work)
+static const float max_latency = 16777216.0f;
 
 static const char*
 jalv_process_strerror(const JalvProcessStatus pst)
@@ -30,12 +51,16 @@ jalv_process_strerror(const JalvProcessStatus pst)
     return "Send updates";
   case JALV_PROCESS_BAD_HEADER:
     return "Failed to read header from UI ring";
-  case JALV_PROCESS_BAD_CONTROL_VALUE:
-    return "Failed to read control value from UI ring";
   case JALV_PROCESS_BAD_EVENT:
     return "Failed to read event from UI ring";
   case JALV_PROCESS_BAD_STATE_CHANGE:
     return "Failed to read run state change from UI ring";
+  case JALV_PROCESS_BAD_SHADOW:
+    return "Failed to read shadow instance from UI ring";
+  case JALV_PROCESS_BAD_TIMED_CHANGE:
+    return "Failed to read timed control change from UI ring";
+  case JALV_PROCESS_TOO_MANY_CHANGES:
+    return "Too many pending timed control changes";
   case JALV_PROCESS_BAD_MESSAGE_TYPE:
     return "Unknown message type received from UI ring";
   }
@@ -43,81 +68,578 @@ jalv_process_strerror(const JalvProcessStatus pst)
   return "Unknown error";
 }
 
+ZIX_REALTIME static void
+set_control_input(void* const handle, const uint32_t index, const float value)
+{
+  JalvProcess* const proc = (JalvProcess*)handle;
+
+  assert(index < proc->num_ports);
+  proc->controls_buf[index] = value;
+  proc->silent_frames       = 0U;
+
+  // Record as a change at the start of the cycle, which is when it happens
+  if (proc->traffic) {
+    const JalvTimedChange change = {proc->frame, index, value};
+    jalv_traffic_record(proc->traffic,
+                        JALV_TRAFFIC_UI_TO_PLUGIN,
+                        TIMED_CHANGE,
+                        &change,
+                        sizeof(change),
+                        NULL,
+                        0U);
+  }
+}
+
+/// Add a timed change to the pending changes, after any at the same time
+ZIX_REALTIME static bool
+schedule_change(JalvProcess* const proc, const JalvTimedChange* const change)
+{
+  if (proc->n_changes == proc->max_changes) {
+    return false;
+  }
+
+  uint32_t i = proc->n_changes++;
+  for (; i > 0U && proc->changes[i - 1U].frame > change->frame; --i) {
+    proc->changes[i] = proc->changes[i - 1U];
+  }
+
+  proc->changes[i] = *change;
+  return true;
+}
+
+/// Apply every pending timed change up to and including a time
+ZIX_REALTIME static void
+apply_changes(JalvProcess* const proc, const uint64_t frame)
+{
+  uint32_t n = 0U;
+  while (n < proc->n_changes && proc->changes[n].frame <= frame) {
+    const JalvTimedChange* const change = &proc->changes[n++];
+
+    assert(change->port_index < proc->num_ports);
+    proc->controls_buf[change->port_index] = change->value;
+    jalv_mailbox_write(
+      proc->plugin_controls, change->port_index, change->value);
+  }
+
+  if (n) {
+    proc->silent_frames = 0U;
+    proc->n_changes -= n;
+    memmove(proc->changes,
+            proc->changes + n,
+            proc->n_changes * sizeof(JalvTimedChange));
+  }
+}
+
+/// Apply a message from the UI (or a replay) to the process
+ZIX_REALTIME static JalvProcessStatus
+apply_message(JalvProcess* const proc,
+              const uint32_t     type,
+              const uint32_t     size,
+              const void* const  body,
+              const uint32_t     nframes)
+{
+  jalv_traffic_record(
+    proc->traffic, JALV_TRAFFIC_UI_TO_PLUGIN, type, body, size, NULL, 0U);
+
+  if (type == EVENT_TRANSFER) {
+    const JalvEventTransfer* const msg = (const JalvEventTransfer*)body;
+    if (size < sizeof(JalvEventTransfer) ||
+        msg->atom.size > size - sizeof(JalvEventTransfer) ||
+        msg->port_index >= proc->num_ports ||
+        !proc->ports[msg->port_index].evbuf) {
+      return JALV_PROCESS_BAD_EVENT;
+    }
+
+    JalvProcessPort* const port = &proc->ports[msg->port_index];
+    LV2_Evbuf_Iterator     e    = lv2_evbuf_end(port->evbuf);
+    const LV2_Atom* const  atom = &msg->atom;
+    lv2_evbuf_write(
+      &e, nframes, 0U, atom->type, atom->size, LV2_ATOM_BODY_CONST(atom));
+
+  } else if (type == STATE_REQUEST) {
+    if (proc->control_in == UINT32_MAX) {
+      return JALV_PROCESS_BAD_EVENT;
+    }
+
+    JalvProcessPort* const port = &proc->ports[proc->control_in];
+    assert(port->type == TYPE_EVENT);
+    assert(port->flow == FLOW_INPUT);
+    assert(port->evbuf);
+
+    LV2_Evbuf_Iterator e = lv2_evbuf_end(port->evbuf);
+    lv2_evbuf_write(&e,
+                    nframes,
+                    0U,
+                    proc->get_msg.atom.type,
+                    proc->get_msg.atom.size,
+                    &proc->get_msg.body);
+
+  } else if (type == RUN_STATE_CHANGE) {
+    JalvRunStateChange msg = {JALV_RUNNING};
+    if (size != sizeof(msg)) {
+      return JALV_PROCESS_BAD_STATE_CHANGE;
+    }
+
+    memcpy(&msg, body, sizeof(msg));
+    proc->run_state = msg.state;
+    if (msg.state == JALV_PAUSED) {
+      zix_sem_post(&proc->paused);
+    }
+
+  } else if (type == SHADOW_START) {
+    JalvShadowStart msg = {NULL};
+    if (size != sizeof(msg)) {
+      return JALV_PROCESS_BAD_SHADOW;
+    }
+
+    memcpy(&msg, body, sizeof(msg));
+    proc->shadow = msg.shadow;
+
+  } else if (type == TIMED_CHANGE) {
+    JalvTimedChange msg = {0U, 0U, 0.0f};
+    if (size != sizeof(msg)) {
+      return JALV_PROCESS_BAD_TIMED_CHANGE;
+    }
+
+    memcpy(&msg, body, sizeof(msg));
+    if (msg.port_index >= proc->num_ports) {
+      return JALV_PROCESS_BAD_TIMED_CHANGE;
+    }
+
+    if (!schedule_change(proc, &msg)) {
+      return JALV_PROCESS_TOO_MANY_CHANGES;
+    }
+
+  } else {
+    return JALV_PROCESS_BAD_MESSAGE_TYPE;
+  }
+
+  return JALV_PROCESS_SUCCESS;
+}
+
+/// Update the peak usage of a ring after writing to or before reading from it
+ZIX_REALTIME static void
+update_ring_peak(JalvRingStats* const stats, const ZixRing* const ring)
+{
+  stats->peak = MAX(stats->peak, zix_ring_read_space(ring));
+}
+
 ZIX_REALTIME static JalvProcessStatus
 apply_ui_events(JalvProcess* const proc, const uint32_t nframes)
 {
+  // Apply the latest value of every control that changed since last cycle
+  jalv_mailbox_read(proc->ui_controls, set_control_input, proc);
+
   ZixRing* const    ring   = proc->ui_to_plugin;
   JalvMessageHeader header = {NO_MESSAGE, 0U};
   const size_t      space  = zix_ring_read_space(ring);
+  JalvProcessStatus pst    = JALV_PROCESS_SUCCESS;
+  update_ring_peak(&proc->to_plugin_stats, ring);
   for (size_t i = 0; i < space; i += sizeof(header) + header.size) {
     // Read message header (which includes the body size)
     if (zix_ring_read(ring, &header, sizeof(header)) != sizeof(header)) {
       return JALV_PROCESS_BAD_HEADER;
     }
 
-    if (header.type == CONTROL_PORT_CHANGE) {
-      assert(header.size == sizeof(JalvControlChange));
-      JalvControlChange msg = {0U, 0.0f};
-      if (zix_ring_read(ring, &msg, sizeof(msg)) != sizeof(msg)) {
-        return JALV_PROCESS_BAD_CONTROL_VALUE;
-      }
+    // Read message body
+    assert(header.size <= proc->process_msg_size);
+    void* const body = proc->process_msg;
+    if (zix_ring_read(ring, body, header.size) != header.size) {
+      return JALV_PROCESS_BAD_EVENT;
+    }
 
-      assert(msg.port_index < proc->num_ports);
-      proc->controls_buf[msg.port_index] = msg.value;
+    const JalvProcessStatus st =
+      apply_message(proc, header.type, header.size, body, nframes);
+
+    pst = pst ? pst : st;
+  }
+
+  // Apply any replayed messages that were originally received in this cycle
+  if (proc->replay) {
+    const uint64_t                 end    = proc->frame + nframes;
+    const JalvTrafficRecord*       record = NULL;
+    while ((record = jalv_replay_next(proc->replay, end))) {
+      const JalvProcessStatus st = apply_message(
+        proc, record->type, record->size, record + 1U, nframes);
+
+      pst = pst ? pst : st;
+    }
+  }
+
+  return pst;
+}
+
+ZIX_REALTIME static bool
+is_signal_port(const JalvProcessPort* const port)
+{
+  return port->type == TYPE_AUDIO || port->type == TYPE_CV;
+}
+
+/// Return the end of a split block that starts at an offset in the cycle
+ZIX_REALTIME static uint32_t
+split_end(const JalvProcess* const proc,
+          const uint32_t           start,
+          const uint32_t           nframes)
+{
+  if (proc->split_length && proc->n_changes) {
+    // Split at the next change, or as soon after it as the minimum allows
+    const uint64_t next = proc->changes[0].frame - proc->frame;
+    const uint64_t end  = MAX(next, (uint64_t)start + proc->split_length);
+    if (end + proc->split_length <= nframes) {
+      return (uint32_t)end;
+    }
+  }
+
+  return nframes;
+}
 
-    } else if (header.type == EVENT_TRANSFER) {
-      assert(header.size <= proc->process_msg_size);
-      void* const body = proc->process_msg;
-      if (zix_ring_read(ring, body, header.size) != header.size) {
-        return JALV_PROCESS_BAD_EVENT;
+/// Copy the input events in a split block to the split buffer of a port
+ZIX_REALTIME static void
+split_input_events(JalvProcessPort* const port,
+                   const uint32_t         start,
+                   const uint32_t         end)
+{
+  lv2_evbuf_reset(port->split_evbuf, true);
+
+  LV2_Evbuf_Iterator i = {port->evbuf, port->split_offset};
+  LV2_Evbuf_Iterator o = lv2_evbuf_begin(port->split_evbuf);
+  for (; lv2_evbuf_is_valid(i); i = lv2_evbuf_next(i)) {
+    uint32_t frames    = 0U;
+    uint32_t subframes = 0U;
+    uint32_t type      = 0U;
+    uint32_t size      = 0U;
+    void*    body      = NULL;
+    lv2_evbuf_get(i, &frames, &subframes, &type, &size, &body);
+    if (frames >= end) {
+      break;
+    }
+
+    frames = frames > start ? frames - start : 0U;
+    lv2_evbuf_write(&o, frames, subframes, type, size, body);
+  }
+
+  port->split_offset = i.offset;
+}
+
+/// Append the output events of a split block to the main buffer of a port
+ZIX_REALTIME static void
+merge_output_events(JalvProcessPort* const port, const uint32_t start)
+{
+  LV2_Evbuf_Iterator o = lv2_evbuf_end(port->evbuf);
+  for (LV2_Evbuf_Iterator i = lv2_evbuf_begin(port->split_evbuf);
+       lv2_evbuf_is_valid(i);
+       i = lv2_evbuf_next(i)) {
+    uint32_t frames    = 0U;
+    uint32_t subframes = 0U;
+    uint32_t type      = 0U;
+    uint32_t size      = 0U;
+    void*    body      = NULL;
+    lv2_evbuf_get(i, &frames, &subframes, &type, &size, &body);
+    lv2_evbuf_write(&o, start + frames, subframes, type, size, body);
+  }
+}
+
+/// Run the plugin for one block of a split cycle
+ZIX_REALTIME static void
+run_split_block(JalvProcess* const proc,
+                const uint32_t     start,
+                const uint32_t     end,
+                const uint32_t     nframes)
+{
+  // Connect ports to the part of each buffer for this block
+  for (uint32_t i = 0U; i < proc->num_ports; ++i) {
+    JalvProcessPort* const port = &proc->ports[i];
+    if (is_signal_port(port) && port->buf) {
+      float* const buf = (float*)port->buf + start;
+      lilv_instance_connect_port(proc->instance, i, buf);
+    } else if (port->type == TYPE_EVENT) {
+      if (port->flow == FLOW_INPUT) {
+        split_input_events(port, start, end < nframes ? end : UINT32_MAX);
+      } else {
+        lv2_evbuf_reset(port->split_evbuf, false);
       }
 
-      const JalvEventTransfer* const msg = (const JalvEventTransfer*)body;
-      assert(msg->port_index < proc->num_ports);
-      JalvProcessPort* const port = &proc->ports[msg->port_index];
-      LV2_Evbuf_Iterator     e    = lv2_evbuf_end(port->evbuf);
-      const LV2_Atom* const  atom = &msg->atom;
-      lv2_evbuf_write(
-        &e, nframes, 0U, atom->type, atom->size, LV2_ATOM_BODY_CONST(atom));
-
-    } else if (header.type == STATE_REQUEST) {
-      assert(proc->control_in != UINT32_MAX);
-      JalvProcessPort* const port = &proc->ports[proc->control_in];
-      assert(port->type == TYPE_EVENT);
-      assert(port->flow == FLOW_INPUT);
-      assert(port->evbuf);
-
-      LV2_Evbuf_Iterator e = lv2_evbuf_end(port->evbuf);
-      lv2_evbuf_write(&e,
-                      nframes,
-                      0U,
-                      proc->get_msg.atom.type,
-                      proc->get_msg.atom.size,
-                      &proc->get_msg.body);
-
-    } else if (header.type == RUN_STATE_CHANGE) {
-      assert(header.size == sizeof(JalvRunStateChange));
-      JalvRunStateChange msg = {JALV_RUNNING};
-      if (zix_ring_read(ring, &msg, sizeof(msg)) != sizeof(msg)) {
-        return JALV_PROCESS_BAD_STATE_CHANGE;
+      lilv_instance_connect_port(
+        proc->instance, i, lv2_evbuf_get_buffer(port->split_evbuf));
+    }
+  }
+
+  ZIX_DISABLE_EFFECT_WARNINGS // Assume realtime-safe plugin
+  lilv_instance_run(proc->instance, end - start);
+  ZIX_RESTORE_WARNINGS
+
+  // Collect output events with times relative to the start of the cycle
+  for (uint32_t i = 0U; i < proc->num_ports; ++i) {
+    JalvProcessPort* const port = &proc->ports[i];
+    if (port->type == TYPE_EVENT && port->flow == FLOW_OUTPUT) {
+      merge_output_events(port, start);
+    }
+  }
+}
+
+/// Run the plugin for a cycle in several blocks split at timed changes
+ZIX_REALTIME static void
+run_split(JalvProcess* const proc, uint32_t end, const uint32_t nframes)
+{
+  // Prepare to read inputs from the start and append to empty outputs
+  for (uint32_t i = 0U; i < proc->num_ports; ++i) {
+    JalvProcessPort* const port = &proc->ports[i];
+    if (port->type == TYPE_EVENT) {
+      assert(port->split_evbuf);
+      if (port->flow == FLOW_INPUT) {
+        port->split_offset = 0U;
+      } else {
+        lv2_evbuf_reset(port->evbuf, true);
       }
+    }
+  }
+
+  // Run each block, applying changes that are due between them
+  uint32_t start = 0U;
+  run_split_block(proc, start, end, nframes);
+  while (end < nframes) {
+    start = end;
+    apply_changes(proc, proc->frame + start);
+    end = split_end(proc, start, nframes);
+    run_split_block(proc, start, end, nframes);
+  }
+
+  // Connect ports to the buffers for the whole cycle again
+  for (uint32_t i = 0U; i < proc->num_ports; ++i) {
+    JalvProcessPort* const port = &proc->ports[i];
+    if (is_signal_port(port) && port->buf) {
+      lilv_instance_connect_port(proc->instance, i, port->buf);
+    } else if (port->type == TYPE_EVENT) {
+      lilv_instance_connect_port(
+        proc->instance, i, lv2_evbuf_get_buffer(port->evbuf));
+    }
+  }
+}
+
+ZIX_REALTIME static void
+run_shadow(JalvProcess* const proc, const uint32_t nframes)
+{
+  JalvShadow* const shadow = proc->shadow;
+
+  // Swap immediately if the block length has grown beyond the output buffers
+  if (nframes > shadow->block_length) {
+    shadow->position = shadow->length;
+    return;
+  }
 
-      proc->run_state = msg.state;
-      if (msg.state == JALV_PAUSED) {
-        zix_sem_post(&proc->paused);
+  // Connect inputs, which may have been reallocated, and clear event outputs
+  for (uint32_t i = 0U; i < proc->num_ports; ++i) {
+    JalvProcessPort* const port = &proc->ports[i];
+    if (port->flow == FLOW_INPUT && is_signal_port(port)) {
+      lilv_instance_connect_port(shadow->instance, i, port->buf);
+    } else if (port->flow == FLOW_INPUT && port->type == TYPE_EVENT) {
+      lilv_instance_connect_port(
+        shadow->instance, i, lv2_evbuf_get_buffer(port->evbuf));
+    } else if (shadow->events[i]) {
+      lv2_evbuf_reset(shadow->events[i], false);
+    }
+  }
+
+  ZIX_DISABLE_EFFECT_WARNINGS // Assume realtime-safe plugin
+  lilv_instance_run(shadow->instance, nframes);
+  ZIX_RESTORE_WARNINGS
+
+  // Mix the incoming instance's output into the output with a linear fade
+  const float step = 1.0f / (float)shadow->length;
+  for (uint32_t i = 0U; i < proc->num_ports; ++i) {
+    const JalvProcessPort* const port = &proc->ports[i];
+    float* const                 out  = (float*)port->buf;
+    const float* const           in   = shadow->outputs[i];
+    if (port->flow == FLOW_OUTPUT && is_signal_port(port) && out && in) {
+      for (uint32_t f = 0U; f < nframes; ++f) {
+        const uint32_t pos  = shadow->position + f;
+        const float    gain = pos < shadow->length ? (float)pos * step : 1.0f;
+
+        out[f] += gain * (in[f] - out[f]);
       }
+    }
+  }
 
-    } else {
-      return JALV_PROCESS_BAD_MESSAGE_TYPE;
+  shadow->position += nframes;
+}
+
+ZIX_REALTIME static void
+swap_shadow(JalvProcess* const proc)
+{
+  JalvShadow* const   shadow       = proc->shadow;
+  LilvInstance* const old_instance = proc->instance;
+  JalvWorker* const   old_worker   = proc->worker;
+
+  // Connect the incoming instance's outputs to the real buffers
+  for (uint32_t i = 0U; i < proc->num_ports; ++i) {
+    const JalvProcessPort* const port = &proc->ports[i];
+    if (is_signal_port(port)) {
+      lilv_instance_connect_port(shadow->instance, i, port->buf);
+    } else if (port->type == TYPE_EVENT) {
+      lilv_instance_connect_port(
+        shadow->instance, i, lv2_evbuf_get_buffer(port->evbuf));
     }
   }
 
-  return JALV_PROCESS_SUCCESS;
+  // Swap instances, so the shadow now holds the old ones
+  proc->instance   = shadow->instance;
+  proc->worker     = shadow->worker;
+  shadow->instance = old_instance;
+  shadow->worker   = old_worker;
+  proc->shadow     = NULL;
+
+  zix_sem_post(&proc->swapped);
+}
+
+ZIX_REALTIME void
+jalv_process_connect_port(JalvProcess* const proc,
+                          const uint32_t     port_index,
+                          void* const        buf)
+{
+  proc->ports[port_index].buf = buf;
+  lilv_instance_connect_port(proc->instance, port_index, buf);
+}
+
+/**
+   Return the largest magnitude in a signal as the bits of a float.
+
+   Non-negative floats are ordered like their bit patterns, so this works with
+   integer operations that vectorize well without relaxing float semantics.
+*/
+ZIX_REALTIME static uint32_t
+signal_peak_bits(const float* const buf, const uint32_t nframes)
+{
+  uint32_t peak = 0U;
+  for (uint32_t i = 0U; i < nframes; ++i) {
+    uint32_t bits = 0U;
+    memcpy(&bits, &buf[i], sizeof(bits));
+    bits &= 0x7FFFFFFFU;
+    peak = bits > peak ? bits : peak;
+  }
+
+  return peak;
+}
+
+/// Return true if the plugin has no input at all in this cycle
+ZIX_REALTIME static bool
+inputs_are_silent(const JalvProcess* const proc, const uint32_t nframes)
+{
+  if (proc->shadow ||
+      (proc->n_changes && proc->changes[0].frame < proc->frame + nframes) ||
+      jalv_worker_has_responses(proc->worker) ||
+      jalv_worker_has_responses(proc->state_worker)) {
+    return false;
+  }
+
+  const JalvPortLists* const lists = &proc->port_lists;
+  for (uint32_t i = 0U; i < lists->signals.n_indices; ++i) {
+    const JalvProcessPort* const port = &proc->ports[lists->signals.indices[i]];
+    if (port->flow == FLOW_INPUT && port->buf &&
+        signal_peak_bits((const float*)port->buf, nframes)) {
+      return false;
+    }
+  }
+
+  for (uint32_t i = 0U; i < lists->event_inputs.n_indices; ++i) {
+    const uint32_t p = lists->event_inputs.indices[i];
+    if (lv2_evbuf_get_size(proc->ports[p].evbuf)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/// Return true if the plugin output nothing audible in this cycle
+ZIX_REALTIME static bool
+outputs_are_silent(const JalvProcess* const proc, const uint32_t nframes)
+{
+  uint32_t threshold = 0U;
+  memcpy(&threshold, &silence_threshold, sizeof(threshold));
+
+  const JalvPortLists* const lists = &proc->port_lists;
+  for (uint32_t i = 0U; i < lists->signals.n_indices; ++i) {
+    const JalvProcessPort* const port = &proc->ports[lists->signals.indices[i]];
+    if (port->flow == FLOW_OUTPUT && port->buf &&
+        signal_peak_bits((const float*)port->buf, nframes) > threshold) {
+      return false;
+    }
+  }
+
+  for (uint32_t i = 0U; i < lists->event_outputs.n_indices; ++i) {
+    const uint32_t p = lists->event_outputs.indices[i];
+    if (lv2_evbuf_is_valid(lv2_evbuf_begin(proc->ports[p].evbuf))) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/// Write silence to every output instead of running the plugin
+ZIX_REALTIME static void
+silence_outputs(JalvProcess* const proc, const uint32_t nframes)
+{
+  const JalvPortLists* const lists = &proc->port_lists;
+  for (uint32_t i = 0U; i < lists->signals.n_indices; ++i) {
+    JalvProcessPort* const port = &proc->ports[lists->signals.indices[i]];
+    if (port->flow == FLOW_OUTPUT && port->buf) {
+      memset(port->buf, 0, nframes * sizeof(float));
+    }
+  }
+
+  for (uint32_t i = 0U; i < lists->event_outputs.n_indices; ++i) {
+    const uint32_t p = lists->event_outputs.indices[i];
+    lv2_evbuf_reset(proc->ports[p].evbuf, true);
+  }
+}
+
+/// Run the plugin and any shadow instance, and process worker replies
+ZIX_REALTIME static void
+run_plugin(JalvProcess* const proc, const uint32_t nframes)
+{
+  // Run plugin for this cycle, split at timed changes if necessary
+  const uint32_t end = split_end(proc, 0U, nframes);
+  if (end < nframes) {
+    run_split(proc, end, nframes);
+  } else {
+    ZIX_DISABLE_EFFECT_WARNINGS // Assume realtime-safe plugin
+    lilv_instance_run(proc->instance, nframes);
+    ZIX_RESTORE_WARNINGS
+  }
+
+  // Run any incoming shadow instance alongside to fade it in
+  JalvShadow* const shadow = proc->shadow;
+  if (shadow) {
+    run_shadow(proc, nframes);
+  }
+
+  jalv_process_end_stage(proc, JALV_STAGE_RUN);
+
+  // Process any worker replies and end the cycle
+  LV2_Handle handle = lilv_instance_get_handle(proc->instance);
+  jalv_worker_emit_responses(proc->state_worker, handle);
+  jalv_worker_emit_responses(proc->worker, handle);
+  jalv_worker_end_run(proc->worker);
+  if (shadow) {
+    handle = lilv_instance_get_handle(shadow->instance);
+    jalv_worker_emit_responses(shadow->worker, handle);
+    jalv_worker_end_run(shadow->worker);
+    if (shadow->position >= shadow->length) {
+      swap_shadow(proc);
+    }
+  }
+
+  jalv_process_end_stage(proc, JALV_STAGE_WORKER);
 }
 
 ZIX_REALTIME JalvProcessStatus
 jalv_run(JalvProcess* const proc, const uint32_t nframes)
 {
+  // Log plugin messages from this thread through the ring
+  jalv_log_set_thread(proc->log);
+  jalv_traffic_begin_cycle(proc->traffic, proc->frame);
+
   // Read and apply control change events from UI
   JalvProcessStatus pst = apply_ui_events(proc, nframes);
   if (pst && proc->trace) {
@@ -126,16 +648,33 @@ jalv_run(JalvProcess* const proc, const uint32_t nframes)
     ZIX_RESTORE_WARNINGS
   }
 
-  // Run plugin for this cycle
-  ZIX_DISABLE_EFFECT_WARNINGS // Assume realtime-safe plugin
-  lilv_instance_run(proc->instance, nframes);
-  ZIX_RESTORE_WARNINGS
+  // Apply any timed changes that are due at the start of this cycle
+  apply_changes(proc, proc->frame);
 
-  // Process any worker replies and end the cycle
-  LV2_Handle handle = lilv_instance_get_handle(proc->instance);
-  jalv_worker_emit_responses(proc->state_worker, handle);
-  jalv_worker_emit_responses(proc->worker, handle);
-  jalv_worker_end_run(proc->worker);
+  // Check for silent input if the plugin may sleep
+  const bool silent_in = proc->sleep_length && inputs_are_silent(proc, nframes);
+
+  jalv_process_end_stage(proc, JALV_STAGE_PRE_PROCESS);
+
+  if (silent_in && proc->silent_frames >= proc->sleep_length) {
+    // Silent for long enough that running the plugin would only make silence
+    silence_outputs(proc, nframes);
+  } else {
+    run_plugin(proc, nframes);
+
+    // Count how long the plugin has been silent, up to the sleep length
+    if (proc->sleep_length) {
+      if (!silent_in || !outputs_are_silent(proc, nframes)) {
+        proc->silent_frames = 0U;
+      } else if (proc->sleep_length - proc->silent_frames > nframes) {
+        proc->silent_frames += nframes;
+      } else {
+        proc->silent_frames = proc->sleep_length;
+      }
+    }
+  }
+
+  proc->frame += nframes;
 
   // Check if it's time to send updates to the UI
   if (proc->update_frames) {
@@ -149,10 +688,306 @@ jalv_run(JalvProcess* const proc, const uint32_t nframes)
   return pst;
 }
 
+/// Wake up the UI if anything was sent to it
+ZIX_REALTIME static void
+notify_ui(JalvProcess* const proc)
+{
+  if (zix_ring_read_space(proc->plugin_to_ui) ||
+      jalv_mailbox_has_changes(proc->plugin_controls)) {
+    jalv_wakeup_signal(&proc->ui_wakeup);
+  }
+}
+
 ZIX_REALTIME int
 jalv_bypass(JalvProcess* const proc, const uint32_t nframes)
 {
+  jalv_traffic_begin_cycle(proc->traffic, proc->frame);
+
   // Read and apply control change events from UI
   apply_ui_events(proc, nframes);
+  apply_changes(proc, proc->frame + nframes);
+  proc->frame += nframes;
+
+  // Swap in any shadow instance immediately since there's nothing to fade
+  if (proc->shadow) {
+    swap_shadow(proc);
+  }
+
+  jalv_process_end_stage(proc, JALV_STAGE_PRE_PROCESS);
+  notify_ui(proc);
   return 0;
 }
+
+ZIX_REALTIME void
+jalv_process_send_control(JalvProcess* const proc, const uint32_t index)
+{
+  const float value = proc->controls_buf[index];
+  const float last  = proc->sent_controls[index];
+
+  // Written so that a NaN (like the initial last value) is always a change
+  if (fabsf(value - last) <= proc->ports[index].epsilon) {
+    ++proc->n_suppressed;
+  } else {
+    proc->sent_controls[index] = value;
+    jalv_mailbox_write(proc->plugin_controls, index, value);
+    ++proc->n_updates;
+  }
+}
+
+/// Write a position from the internal transport to every input that wants it
+ZIX_REALTIME static void
+write_position(JalvProcess* const     proc,
+               const JalvTempo* const tempo,
+               const uint32_t         offset)
+{
+  JalvTimeline* const   timeline = &proc->timeline;
+  const LV2_Atom* const pos =
+    jalv_timeline_position(timeline, tempo, timeline->frame + offset);
+
+  const JalvPortList* const list = &proc->port_lists.event_inputs;
+  for (uint32_t i = 0U; i < list->n_indices; ++i) {
+    JalvProcessPort* const port = &proc->ports[list->indices[i]];
+    if (port->supports_pos) {
+      LV2_Evbuf_Iterator iter = lv2_evbuf_end(port->evbuf);
+      lv2_evbuf_write(
+        &iter, offset, 0U, pos->type, pos->size, LV2_ATOM_BODY_CONST(pos));
+    }
+  }
+}
+
+ZIX_REALTIME void
+jalv_process_run_timeline(JalvProcess* const proc, const uint32_t nframes)
+{
+  JalvTimeline* const timeline = &proc->timeline;
+  if (!timeline->n_tempos) {
+    return;
+  }
+
+  // Report the position at the start, or if the tempo changes right there
+  const uint64_t         start = timeline->frame;
+  const uint64_t         end   = start + nframes;
+  const JalvTempo* const tempo = jalv_timeline_tempo(timeline, start);
+  if (!timeline->located || tempo->frame == start) {
+    write_position(proc, tempo, 0U);
+  }
+
+  // Report the position wherever the tempo changes during the cycle
+  const JalvTempo* const last = timeline->tempos + timeline->n_tempos;
+  for (const JalvTempo* t = tempo + 1; t < last && t->frame < end; ++t) {
+    write_position(proc, t, (uint32_t)(t->frame - start));
+  }
+
+  // Set BPM control ports to the tempo at the start and notify the UI
+  if (!timeline->located || tempo->bpm != proc->transport.bpm) {
+    const JalvPortList* const list = &proc->port_lists.bpm_inputs;
+    for (uint32_t i = 0U; i < list->n_indices; ++i) {
+      const uint32_t p      = list->indices[i];
+      proc->controls_buf[p] = tempo->bpm;
+      jalv_mailbox_write(proc->plugin_controls, p, tempo->bpm);
+    }
+  }
+
+  proc->transport.position = (uint32_t)end;
+  proc->transport.bpm      = tempo->bpm;
+  proc->transport.rolling  = true;
+  timeline->frame          = end;
+  timeline->located        = true;
+}
+
+/// Return true if the UI subscribed to events of a type from a port
+ZIX_REALTIME static bool
+is_notify_type(const JalvProcessPort* const port, const LV2_URID type)
+{
+  for (uint32_t i = 0U; i < JALV_MAX_NOTIFY_TYPES; ++i) {
+    if (port->notify_types[i] == type) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+ZIX_REALTIME void
+jalv_process_send_event(JalvProcess* const proc,
+                        const uint32_t     index,
+                        const uint32_t     size,
+                        const LV2_URID     type,
+                        const void* const  body)
+{
+  const JalvProcessPort* const port    = &proc->ports[index];
+  const uint32_t               forward = jalv_atomic_load(&port->forward);
+  if ((forward & JALV_FORWARD_ALL) ||
+      ((forward & JALV_FORWARD_OBJECTS) &&
+       lv2_atom_forge_is_object_type(&proc->forge, type)) ||
+      ((forward & JALV_FORWARD_TYPES) && is_notify_type(port, type))) {
+    if (jalv_write_event(proc->plugin_to_ui, index, size, type, body)) {
+      ++proc->to_ui_stats.n_dropped;
+    } else {
+      const JalvEventTransfer head = {index, {size, type}};
+      jalv_traffic_record(proc->traffic,
+                          JALV_TRAFFIC_PLUGIN_TO_UI,
+                          EVENT_TRANSFER,
+                          &head,
+                          sizeof(head),
+                          body,
+                          size);
+    }
+
+    update_ring_peak(&proc->to_ui_stats, proc->plugin_to_ui);
+  }
+}
+
+/// Write a message with a fixed-size payload to the UI
+ZIX_REALTIME static void
+send_message(JalvProcess* const    proc,
+             const JalvMessageType type,
+             const void* const     body,
+             const uint32_t        size)
+{
+  const JalvMessageHeader header = {type, size};
+  if (jalv_write_split_message(
+        proc->plugin_to_ui, &header, sizeof(header), body, size)) {
+    ++proc->to_ui_stats.n_dropped;
+  } else {
+    jalv_traffic_record(
+      proc->traffic, JALV_TRAFFIC_PLUGIN_TO_UI, type, body, size, NULL, 0U);
+  }
+
+  update_ring_peak(&proc->to_ui_stats, proc->plugin_to_ui);
+}
+
+ZIX_REALTIME void
+jalv_process_update_latency(JalvProcess* const proc, const uint32_t index)
+{
+  // Get the latency in frames from the control output truncated to integer
+  const float    value = proc->controls_buf[index];
+  const uint32_t frames =
+    (value >= 0.0f && value <= max_latency) ? (uint32_t)value : 0U;
+
+  if (proc->plugin_latency != frames) {
+    // Update the cached value and notify the UI if the latency changed
+    proc->plugin_latency = frames;
+
+    const JalvLatencyChange body = {(float)frames};
+    send_message(proc, LATENCY_CHANGE, &body, sizeof(body));
+  }
+}
+
+ZIX_REALTIME void
+jalv_process_begin_cycle(JalvProcess* const proc)
+{
+  JalvLoad* const load = &proc->load;
+
+  load->cycle_start = jalv_clock_now();
+  load->stage_start = load->cycle_start;
+  for (uint32_t i = 0U; i < JALV_N_STAGES; ++i) {
+    load->cycle[i] = 0U;
+  }
+}
+
+ZIX_REALTIME void
+jalv_process_end_stage(JalvProcess* const proc, const JalvStage stage)
+{
+  JalvLoad* const load = &proc->load;
+  const uint64_t  now  = jalv_clock_now();
+
+  load->cycle[stage] += now - load->stage_start;
+  load->stage_start = now;
+}
+
+ZIX_REALTIME static uint32_t
+cycle_load(const JalvLoad* const load,
+           const uint64_t        ns,
+           const uint32_t        nframes)
+{
+  const double frames = (double)ns * load->frames_per_ns;
+  const double ppm    = frames * JALV_LOAD_FULL / nframes;
+
+  return ppm < (double)UINT32_MAX ? (uint32_t)ppm : UINT32_MAX;
+}
+
+ZIX_REALTIME static void
+send_load_report(JalvProcess* const proc)
+{
+  const JalvLoad* const load   = &proc->load;
+  JalvLoadReport        report = {{{0U, 0U, 0U}},
+                                  load->n_xruns_seen,
+                                  {0U},
+                                  proc->n_updates,
+                                  proc->n_suppressed,
+                                  proc->to_ui_stats,
+                                  {0U, 0U, 0U}};
+
+  // Drops from the UI are counted by other threads
+  report.to_plugin.size = proc->to_plugin_stats.size;
+  report.to_plugin.peak = proc->to_plugin_stats.peak;
+  report.to_plugin.n_dropped =
+    jalv_atomic_load(&proc->to_plugin_stats.n_dropped);
+
+  for (uint32_t i = 0U; i < JALV_N_STAGES; ++i) {
+    const JalvHistogram* const histogram = &load->histograms[i];
+
+    report.stages[i].p50 = jalv_histogram_percentile(histogram, 50U);
+    report.stages[i].p99 = jalv_histogram_percentile(histogram, 99U);
+    report.stages[i].max = histogram->max;
+    report.xrun_cycle[i] = load->xrun_cycle[i];
+  }
+
+  send_message(proc, LOAD_REPORT, &report, sizeof(report));
+}
+
+ZIX_REALTIME void
+jalv_process_end_cycle(JalvProcess* const proc,
+                       const uint32_t     nframes,
+                       const bool         send_report)
+{
+  if (!nframes) {
+    notify_ui(proc);
+    return;
+  }
+
+  JalvLoad* const load = &proc->load;
+  const uint64_t  now  = jalv_clock_now();
+
+  // Attribute any remaining time to post-processing
+  load->cycle[JALV_STAGE_POST_PROCESS] += now - load->stage_start;
+  load->cycle[JALV_STAGE_CYCLE] = now - load->cycle_start;
+
+  // Convert stage times to loads
+  uint32_t loads[JALV_N_STAGES] = {0U};
+  for (uint32_t i = 0U; i < JALV_N_STAGES; ++i) {
+    loads[i] = cycle_load(load, load->cycle[i], nframes);
+  }
+
+  // Blame the heavier of the previous and this cycle for any new xrun
+  const uint32_t n_xruns = jalv_atomic_load(&load->n_xruns);
+  if (n_xruns != load->n_xruns_seen) {
+    const uint32_t* const cause =
+      load->last[JALV_STAGE_CYCLE] > loads[JALV_STAGE_CYCLE] ? load->last
+                                                             : loads;
+
+    for (uint32_t i = 0U; i < JALV_N_STAGES; ++i) {
+      load->xrun_cycle[i] = cause[i];
+    }
+
+    load->n_xruns_seen = n_xruns;
+  }
+
+  // Record loads in histograms
+  for (uint32_t i = 0U; i < JALV_N_STAGES; ++i) {
+    jalv_histogram_record(&load->histograms[i], loads[i]);
+    load->last[i] = loads[i];
+  }
+
+  if (send_report) {
+    send_load_report(proc);
+  }
+
+  notify_ui(proc);
+}
+
+void
+jalv_process_xrun(JalvProcess* const proc)
+{
+  jalv_atomic_increment(&proc->load.n_xruns);
+}
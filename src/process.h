@@ -1,17 +1,24 @@
-// Copyright 2016-2025 David Robillard <d@drobilla.net>
+// Copyright 2016-2026 David Robillard <d@drobilla.net>
 // SPDX-License-Identifier: ISC
 
 #ifndef JALV_PROCESS_H
 #define JALV_PROCESS_H
 
 #include "attributes.h"
+#include "load.h"
+#include "log.h"
 #include "lv2_evbuf.h"
+#include "mailbox.h"
+#include "timeline.h"
+#include "traffic.h"
 #include "types.h"
+#include "wakeup.h"
 #include "worker.h"
 
 #include <lilv/lilv.h>
 #include <lv2/atom/atom.h>
 #include <lv2/atom/forge.h>
+#include <lv2/urid/urid.h>
 #include <zix/attributes.h>
 #include <zix/ring.h>
 #include <zix/sem.h>
@@ -27,28 +34,72 @@ typedef enum {
   JALV_PROCESS_SUCCESS,
   JALV_PROCESS_SEND_UPDATES,
   JALV_PROCESS_BAD_HEADER,
-  JALV_PROCESS_BAD_CONTROL_VALUE,
   JALV_PROCESS_BAD_EVENT,
   JALV_PROCESS_BAD_STATE_CHANGE,
+  JALV_PROCESS_BAD_SHADOW,
+  JALV_PROCESS_BAD_TIMED_CHANGE,
+  JALV_PROCESS_TOO_MANY_CHANGES,
   JALV_PROCESS_BAD_MESSAGE_TYPE,
 } JalvProcessStatus;
 
+/// Maximum number of event types a UI can subscribe to for a port
+#define JALV_MAX_NOTIFY_TYPES 4U
+
+/// Flags for which events from an output port are sent to the UI
+typedef enum {
+  JALV_FORWARD_OBJECTS = 1U << 0U, ///< Objects, like patch messages
+  JALV_FORWARD_ALL     = 1U << 1U, ///< All events
+  JALV_FORWARD_TYPES   = 1U << 2U, ///< Events with a type in notify_types
+} JalvForwardFlag;
+
 /// Port state used in the process thread
 typedef struct {
   PortType   type;            ///< Data type
   PortFlow   flow;            ///< Data flow direction
   void*      sys_port;        ///< For audio/MIDI ports, otherwise NULL
+  void*      link_port;       ///< System output port read by input, or NULL
   char*      symbol;          ///< Port symbol (stable/unique C-like identifier)
   char*      label;           ///< Human-readable label
   LV2_Evbuf* evbuf;           ///< Sequence port event buffer
+  LV2_Evbuf* split_evbuf;     ///< Event buffer for split blocks, or NULL
+  uint32_t   split_offset;    ///< Offset of next input event to split
+  void*      buf;             ///< Signal buffer connected to the instance
   uint32_t   buf_size;        ///< Custom buffer size, or 0
+  uint32_t   forward;         ///< Output events sent to UI (JalvForwardFlag)
+  float      epsilon;         ///< Smallest control output change sent to UI
   bool       reports_latency; ///< Whether control port reports latency
   bool       is_primary;      ///< True for main control/response channel
   bool       is_bpm;          ///< True if port is a BPM control port
   bool       supports_midi;   ///< Whether event port supports MIDI
   bool       supports_pos;    ///< Whether event port supports Position
+
+  /// Event types sent to the UI with JALV_FORWARD_TYPES, padded with zero
+  LV2_URID notify_types[JALV_MAX_NOTIFY_TYPES];
 } JalvProcessPort;
 
+/// Indices of ports that need the same work in every cycle
+typedef struct {
+  uint32_t* indices;   ///< Port indices, a slice of JalvPortLists::indices
+  uint32_t  n_indices; ///< Number of ports in the list
+} JalvPortList;
+
+/**
+   Ports grouped by the work they need in every cycle.
+
+   These are built when the process is activated, so that backends can visit
+   only the ports that need work in their process callback, without checking
+   the type and flow of every port of plugins with many controls.
+*/
+typedef struct {
+  uint32_t*    indices;         ///< Storage for every list
+  JalvPortList signals;         ///< Audio and CV ports
+  JalvPortList event_inputs;    ///< Event input ports
+  JalvPortList event_outputs;   ///< Event output ports
+  JalvPortList control_outputs; ///< Control outputs, except latency
+  JalvPortList bpm_inputs;      ///< Control inputs for the transport tempo
+  uint32_t     latency;         ///< Latency control output, or UINT32_MAX
+} JalvPortLists;
+
 /// Transport state used in the process thread
 typedef struct {
   uint32_t position; ///< Transport position in frames
@@ -56,6 +107,39 @@ typedef struct {
   bool     rolling;  ///< Transport speed (0=stop, 1=play)
 } JalvPosition;
 
+/**
+   A change of a control port value at a specific time.
+
+   Unlike changes sent through the mailbox, which are applied at the start of
+   the next cycle, these are applied at a specific frame, which may be in the
+   middle of a cycle or in a later one.
+*/
+typedef struct {
+  uint64_t frame;      ///< Time of change in frames since processing started
+  uint32_t port_index; ///< Control port index
+  float    value;      ///< New value of the port
+} JalvTimedChange;
+
+/**
+   A second plugin instance that replaces the current one.
+
+   This is used to restore state without interrupting processing.  The shadow
+   instance is prepared in another thread, then run alongside the current
+   instance while its output is faded in.  At the end of the fade, the process
+   thread swaps the instances (and their workers), so this then holds the old
+   ones to be freed.
+*/
+typedef struct {
+  LilvInstance* instance;     ///< Plugin instance
+  JalvWorker*   worker;       ///< Worker for the instance, or null
+  float**       outputs;      ///< Output buffer for each signal output port
+  LV2_Evbuf**   events;       ///< Discarded buffer for each event output port
+  uint32_t      n_ports;      ///< Number of entries in outputs and events
+  uint32_t      block_length; ///< Length of output buffers in frames
+  uint32_t      length;       ///< Crossfade length in frames
+  uint32_t      position;     ///< Position in crossfade in frames
+} JalvShadow;
+
 /**
    State accessed in the process thread.
 
@@ -67,22 +151,45 @@ typedef struct {
   LilvInstance*    instance;         ///< Plugin instance
   ZixRing*         ui_to_plugin;     ///< Messages from UI to plugin/process
   ZixRing*         plugin_to_ui;     ///< Messages from plugin/process to UI
+  JalvMailbox*     ui_controls;      ///< Latest control values from UI
+  JalvMailbox*     plugin_controls;  ///< Latest control values for UI
+  JalvWakeup       ui_wakeup;        ///< Signalled when there's UI news
+  JalvLog*         log;              ///< Log for plugin messages, or null
+  JalvTraffic*     traffic;          ///< Log of messages to and from the UI
+  JalvReplay*      replay;           ///< Messages from the UI to replay
   JalvWorker*      worker;           ///< Worker thread implementation
   JalvWorker*      state_worker;     ///< Synchronous worker for state restore
   JalvProcessPort* ports;            ///< Port array of size num_ports
+  JalvPortLists    port_lists;       ///< Ports grouped by per-cycle work
   LV2_Atom_Forge   forge;            ///< Atom forge
   LV2_Atom_Object  get_msg;          ///< General patch:Get message
   float*           controls_buf;     ///< Control port buffers array
+  float*           sent_controls;    ///< Control output values last sent to UI
   size_t           process_msg_size; ///< Maximum size of a single message
   void*            process_msg;      ///< Buffer for receiving messages
   ZixSem           paused;           ///< Paused signal from process thread
+  ZixSem           swapped;          ///< Shadow swapped signal
+  JalvShadow*      shadow;           ///< Instance being faded in, or null
+  JalvTimedChange* changes;          ///< Pending timed changes ordered by time
+  uint32_t         n_changes;        ///< Number of pending timed changes
+  uint32_t         max_changes;      ///< Capacity of changes
+  uint32_t         split_length;     ///< Minimum split block length, or zero
+  uint64_t         frame;            ///< Frames processed since start
+  uint32_t         sleep_length;     ///< Silent frames before sleeping, or 0
+  uint32_t         silent_frames;    ///< Frames of silence, up to sleep_length
   JalvRunState     run_state;        ///< Current run state
   uint32_t         control_in;       ///< Index of control input port
   uint32_t         num_ports;        ///< Total number of ports on the plugin
   uint32_t         pending_frames;   ///< Frames since last UI update sent
   uint32_t         update_frames;    ///< UI update period in frames, or zero
   uint32_t         plugin_latency;   ///< Latency reported by plugin (if any)
+  uint32_t         n_updates;        ///< Control output updates sent to UI
+  uint32_t         n_suppressed;     ///< Unchanged control outputs not sent
+  JalvRingStats    to_ui_stats;      ///< Usage of plugin_to_ui
+  JalvRingStats    to_plugin_stats;  ///< Usage of ui_to_plugin (atomic drops)
   JalvPosition     transport;        ///< Transport state
+  JalvTimeline     timeline;         ///< Transport for backends without one
+  JalvLoad         load;             ///< Processing load measurement
   bool             trace;            ///< Print debug trace messages
 } JalvProcess;
 
@@ -92,6 +199,15 @@ typedef struct {
    Applies any pending messages from the UI, runs the plugin instance, and
    processes any worker replies.
 
+   If splitting is enabled, the cycle is split into several shorter runs so
+   that timed control changes happen at the right frame.  Each run is at least
+   `split_length` frames long, so changes that are too close together or to
+   the end of the cycle are delayed until the next possible split.
+
+   If sleeping is enabled, and the plugin has had no input and produced only
+   silence for `sleep_length` frames, then the plugin isn't run at all and the
+   outputs are cleared instead, until there is input again.
+
    @param proc Process thread state.
    @param nframes Number of frames to process.
    @return Whether output value updates should be sent to the UI now.
@@ -103,7 +219,9 @@ jalv_run(JalvProcess* proc, uint32_t nframes);
    Bypass the plugin for a block of frames.
 
    This is like jalv_run(), but doesn't actually run the plugin and only does
-   the minimum necessary internal work for the cycle.
+   the minimum necessary internal work for the cycle.  With zero frames, this
+   only applies messages that are due, without advancing time, which is used
+   while processing is paused offline.
 
    @param proc Process thread state.
    @param nframes Number of frames to bypass.
@@ -112,6 +230,105 @@ jalv_run(JalvProcess* proc, uint32_t nframes);
 ZIX_REALTIME int
 jalv_bypass(JalvProcess* proc, uint32_t nframes);
 
+/**
+   Run the internal transport for a cycle.
+
+   This is used by backends without a transport of their own.  A position is
+   written to every event input that supports it at the start, and wherever
+   the tempo changes during the cycle, and BPM control inputs are set to the
+   tempo.  This must be called after event inputs are cleared, before any
+   other events are written to them.
+
+   @param proc Process thread state.
+   @param nframes Number of frames in the cycle.
+*/
+ZIX_REALTIME void
+jalv_process_run_timeline(JalvProcess* proc, uint32_t nframes);
+
+/**
+   Send the value of a control output to the UI if it has changed.
+
+   The value is only sent if it differs from the last value sent by more than
+   the port's epsilon, so settled meters and static outputs don't cause
+   constant updates.
+*/
+ZIX_REALTIME void
+jalv_process_send_control(JalvProcess* proc, uint32_t index);
+
+/**
+   Send an event from an output port to the UI if it's interested.
+
+   Events are only sent if the port's forwarding flags allow it, so events
+   aren't copied into the ring when nothing would use them.
+*/
+ZIX_REALTIME void
+jalv_process_send_event(JalvProcess* proc,
+                        uint32_t     index,
+                        uint32_t     size,
+                        LV2_URID     type,
+                        const void*  body);
+
+/**
+   Update the plugin latency from a control output after running a block.
+
+   If the latency reported by the plugin has changed, the cached value is
+   updated and a LATENCY_CHANGE message is sent to the UI.
+*/
+ZIX_REALTIME void
+jalv_process_update_latency(JalvProcess* proc, uint32_t index);
+
+/**
+   Connect a port of the plugin instance to a buffer.
+
+   Backends use this to connect signal ports, so that the buffer can also be
+   used by a shadow instance.
+*/
+ZIX_REALTIME void
+jalv_process_connect_port(JalvProcess* proc, uint32_t port_index, void* buf);
+
+/**
+   Start timing a process cycle.
+
+   This should be called by the backend at the very start of its process
+   callback, before any other work is done for the cycle.
+*/
+ZIX_REALTIME void
+jalv_process_begin_cycle(JalvProcess* proc);
+
+/**
+   Finish timing a stage of the current process cycle.
+
+   The time since the end of the previous stage (or the start of the cycle) is
+   attributed to the given stage.  Stages that are skipped in a cycle are
+   attributed no time.
+*/
+ZIX_REALTIME void
+jalv_process_end_stage(JalvProcess* proc, JalvStage stage);
+
+/**
+   Finish timing a process cycle.
+
+   The remaining time since the end of the last stage is attributed to
+   post-processing, and the load of every stage is recorded.  If `send_report`
+   is true, a LOAD_REPORT message is written to the UI.
+
+   @param proc Process thread state.
+   @param nframes Number of frames processed in the cycle.
+   @param send_report Whether to send a load report to the UI.
+*/
+ZIX_REALTIME void
+jalv_process_end_cycle(JalvProcess* proc, uint32_t nframes, bool send_report);
+
+/**
+   Note that an xrun occurred.
+
+   This may be called from any thread.  Backends generally report an xrun
+   after the cycle that caused it, so when the next cycle finishes, the loads
+   of whichever of the two cycles was heavier are saved as the likely cause.
+*/
+void
+jalv_process_xrun(JalvProcess* proc);
+
 JALV_END_DECLS
 
 #endif // JALV_PROCESS_H
@@ -5,6 +5,7 @@
 
 #include "jalv_config.h"
 #include "lv2_evbuf.h"
+#include "mailbox.h"
 #include "macros.h"
 #include "mapper.h"
 #include "nodes.h"
@@ -12,8 +13,11 @@
 #include "query.h"
 #include "settings.h"
 #include "string_utils.h"
+#include "timeline.h"
+#include "traffic.h"
 #include "types.h"
 #include "urids.h"
+#include "wakeup.h"
 #include "worker.h"
 
 #include <lilv/lilv.h>
@@ -26,9 +30,13 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
 #define MIN_MSG_SIZE 1024U
 
+/// Number of distinct steps in the range of a control output shown in UIs
+#define CONTROL_RESOLUTION 10000.0f
+
 int
 jalv_process_init(JalvProcess* const     proc,
                   const JalvURIDs* const urids,
@@ -43,9 +51,18 @@ jalv_process_init(JalvProcess* const     proc,
   proc->instance           = NULL;
   proc->ui_to_plugin       = NULL;
   proc->plugin_to_ui       = NULL;
+  proc->ui_controls        = NULL;
+  proc->plugin_controls    = NULL;
+  proc->log                = NULL;
+  proc->traffic            = NULL;
+  proc->replay             = NULL;
   proc->worker             = NULL;
   proc->state_worker       = NULL;
   proc->ports              = NULL;
+  memset(&proc->port_lists, 0, sizeof(proc->port_lists));
+  proc->port_lists.latency = UINT32_MAX;
+  proc->controls_buf       = NULL;
+  proc->sent_controls      = NULL;
   proc->process_msg_size   = 0U;
   proc->process_msg        = NULL;
   proc->run_state          = JALV_PAUSED;
@@ -56,9 +73,24 @@ jalv_process_init(JalvProcess* const     proc,
   proc->transport.position = 0U;
   proc->transport.bpm      = 120.0f;
   proc->transport.rolling  = false;
+  proc->shadow             = NULL;
+  proc->changes            = NULL;
+  proc->n_changes          = 0U;
+  proc->max_changes        = 0U;
+  proc->split_length       = 0U;
+  proc->n_updates          = 0U;
+  proc->n_suppressed       = 0U;
+  memset(&proc->to_ui_stats, 0, sizeof(proc->to_ui_stats));
+  memset(&proc->to_plugin_stats, 0, sizeof(proc->to_plugin_stats));
+  proc->frame              = 0U;
+  proc->sleep_length       = 0U;
+  proc->silent_frames      = 0U;
   proc->trace              = trace;
 
+  jalv_timeline_init(&proc->timeline);
   zix_sem_init(&proc->paused, 0);
+  zix_sem_init(&proc->swapped, 0);
+  jalv_wakeup_init(&proc->ui_wakeup); // Falls back to polling on failure
   lv2_atom_forge_init(&proc->forge, jalv_mapper_urid_map(mapper));
 
   return 0;
@@ -67,25 +99,103 @@ jalv_process_init(JalvProcess* const     proc,
 void
 jalv_process_cleanup(JalvProcess* const proc)
 {
+  jalv_timeline_cleanup(&proc->timeline);
+  jalv_traffic_free(proc->traffic);
+  jalv_replay_free(proc->replay);
+  jalv_wakeup_destroy(&proc->ui_wakeup);
+  zix_sem_destroy(&proc->swapped);
   zix_sem_destroy(&proc->paused);
   jalv_worker_free(proc->worker);
   jalv_worker_free(proc->state_worker);
   zix_ring_free(proc->ui_to_plugin);
   zix_ring_free(proc->plugin_to_ui);
+  jalv_mailbox_free(proc->ui_controls);
+  jalv_mailbox_free(proc->plugin_controls);
   zix_aligned_free(NULL, proc->process_msg);
+  free(proc->changes);
+  free(proc->port_lists.indices);
 
   for (uint32_t i = 0U; i < proc->num_ports; ++i) {
     jalv_process_port_cleanup(&proc->ports[i]);
   }
 }
 
+/// Return the list for a port that needs work every cycle, or null
+static JalvPortList*
+port_list(JalvPortLists* const lists, const JalvProcessPort* const port)
+{
+  switch (port->type) {
+  case TYPE_UNKNOWN:
+    break;
+  case TYPE_CONTROL:
+    if (port->flow == FLOW_OUTPUT && !port->reports_latency) {
+      return &lists->control_outputs;
+    }
+    return port->is_bpm ? &lists->bpm_inputs : NULL;
+  case TYPE_AUDIO:
+  case TYPE_CV:
+    return &lists->signals;
+  case TYPE_EVENT:
+    return port->flow == FLOW_INPUT ? &lists->event_inputs
+                                    : &lists->event_outputs;
+  }
+
+  return NULL;
+}
+
+/// Group the ports by the work they need in every cycle
+static void
+build_port_lists(JalvProcess* const proc)
+{
+  JalvPortLists* const lists = &proc->port_lists;
+  JalvPortList* const  all[] = {&lists->signals,
+                                &lists->event_inputs,
+                                &lists->event_outputs,
+                                &lists->control_outputs,
+                                &lists->bpm_inputs};
+
+  lists->indices = (uint32_t*)calloc(proc->num_ports + 1U, sizeof(uint32_t));
+  if (!lists->indices) {
+    return;
+  }
+
+  // Count the ports in each list and find the latency port
+  for (uint32_t i = 0U; i < proc->num_ports; ++i) {
+    const JalvProcessPort* const port = &proc->ports[i];
+    JalvPortList* const          list = port_list(lists, port);
+    if (list) {
+      ++list->n_indices;
+    } else if (port->reports_latency && lists->latency == UINT32_MAX) {
+      lists->latency = i;
+    }
+  }
+
+  // Give each list its slice of the storage
+  uint32_t offset = 0U;
+  for (size_t l = 0U; l < sizeof(all) / sizeof(all[0]); ++l) {
+    all[l]->indices = lists->indices + offset;
+    offset += all[l]->n_indices;
+    all[l]->n_indices = 0U;
+  }
+
+  // Fill the lists in index order
+  for (uint32_t i = 0U; i < proc->num_ports; ++i) {
+    JalvPortList* const list = port_list(lists, &proc->ports[i]);
+    if (list) {
+      list->indices[list->n_indices++] = i;
+    }
+  }
+}
+
 void
 jalv_process_activate(JalvProcess* const        proc,
                       const JalvURIDs* const    urids,
                       LilvInstance* const       instance,
                       const JalvSettings* const settings)
 {
-  proc->instance = instance;
+  proc->instance     = instance;
+  proc->split_length = settings->split_length;
+  proc->sleep_length = settings->sleep_length;
 
   size_t max_msg_size = MIN_MSG_SIZE;
   for (uint32_t i = 0U; i < proc->num_ports; ++i) {
@@ -104,20 +214,42 @@ jalv_process_activate(JalvProcess* const        proc,
       lilv_instance_connect_port(
         proc->instance, i, lv2_evbuf_get_buffer(port->evbuf));
 
+      // Allocate a buffer for the events in part of a split cycle
+      if (!settings->split_length) {
+        lv2_evbuf_free(port->split_evbuf);
+        port->split_evbuf = NULL;
+      } else if (!port->split_evbuf ||
+                 lv2_evbuf_get_capacity(port->split_evbuf) != size) {
+        lv2_evbuf_free(port->split_evbuf);
+        port->split_evbuf =
+          lv2_evbuf_new(size, urids->atom_Chunk, urids->atom_Sequence);
+      }
+
+      if (settings->split_length && !port->split_evbuf) {
+        proc->split_length = 0U;
+      }
+
       if (port->flow == FLOW_INPUT) {
         max_msg_size = MAX(max_msg_size, size);
       }
     }
   }
 
+  // Group ports for the process callback (ports never change once created)
+  if (!proc->port_lists.indices) {
+    build_port_lists(proc);
+  }
+
   // Allocate UI<=>process communication rings and receive buffer
   if (!proc->ui_to_plugin) {
     proc->ui_to_plugin = zix_ring_new(NULL, settings->ring_size);
     zix_ring_mlock(proc->ui_to_plugin);
+    proc->to_plugin_stats.size = zix_ring_capacity(proc->ui_to_plugin);
   }
   if (!proc->plugin_to_ui) {
     proc->plugin_to_ui = zix_ring_new(NULL, settings->ring_size);
     zix_ring_mlock(proc->plugin_to_ui);
+    proc->to_ui_stats.size = zix_ring_capacity(proc->plugin_to_ui);
   }
 
   // Allocate UI=>process message receive buffer
@@ -127,9 +259,20 @@ jalv_process_activate(JalvProcess* const        proc,
     proc->process_msg = zix_aligned_alloc(NULL, 8U, proc->process_msg_size);
   }
 
+  // Allocate space for timed control changes until they're due
+  if (!proc->changes) {
+    const size_t n    = settings->ring_size / sizeof(JalvTimedChange);
+    proc->changes     = (JalvTimedChange*)calloc(n, sizeof(JalvTimedChange));
+    proc->max_changes = proc->changes ? (uint32_t)n : 0U;
+  }
+
   proc->process_msg_size = max_msg_size;
   proc->update_frames =
     (uint32_t)(settings->sample_rate / settings->ui_update_hz);
+
+  // Reset load measurement for the new sample rate
+  memset(&proc->load, 0, sizeof(proc->load));
+  proc->load.frames_per_ns = settings->sample_rate / 1000000000.0;
 }
 
 void
@@ -138,10 +281,116 @@ jalv_process_deactivate(JalvProcess* const proc)
   zix_aligned_free(NULL, proc->process_msg);
   proc->process_msg = NULL;
 
+  free(proc->changes);
+  proc->changes     = NULL;
+  proc->n_changes   = 0U;
+  proc->max_changes = 0U;
+
   for (uint32_t i = 0U; i < proc->num_ports; ++i) {
     lv2_evbuf_free(proc->ports[i].evbuf);
+    lv2_evbuf_free(proc->ports[i].split_evbuf);
     lilv_instance_connect_port(proc->instance, i, NULL);
-    proc->ports[i].evbuf = NULL;
+    proc->ports[i].evbuf       = NULL;
+    proc->ports[i].split_evbuf = NULL;
+  }
+}
+
+static int
+shadow_connect_port(const JalvProcess* const proc,
+                    JalvShadow* const        shadow,
+                    const uint32_t           i)
+{
+  const JalvProcessPort* const port = &proc->ports[i];
+  void*                        buf  = NULL;
+  if (port->type == TYPE_CONTROL) {
+    buf = &proc->controls_buf[i];
+  } else if (port->type == TYPE_EVENT && port->flow == FLOW_OUTPUT) {
+    shadow->events[i] = lv2_evbuf_new(lv2_evbuf_get_capacity(port->evbuf),
+                                      proc->forge.Chunk,
+                                      proc->forge.Sequence);
+    if (!shadow->events[i]) {
+      return 1;
+    }
+
+    buf = lv2_evbuf_get_buffer(shadow->events[i]);
+  } else if (port->type == TYPE_EVENT) {
+    buf = lv2_evbuf_get_buffer(port->evbuf);
+  } else if (port->type == TYPE_AUDIO || port->type == TYPE_CV) {
+    if (port->flow == FLOW_OUTPUT) {
+      buf = shadow->outputs[i] =
+        (float*)calloc(shadow->block_length, sizeof(float));
+      if (!buf) {
+        return 1;
+      }
+    } else {
+      buf = port->buf;
+    }
+  }
+
+  lilv_instance_connect_port(shadow->instance, i, buf);
+  return 0;
+}
+
+JalvShadow*
+jalv_shadow_new(const JalvProcess* const proc,
+                LilvInstance* const      instance,
+                JalvWorker* const        worker,
+                const uint32_t           block_length,
+                const uint32_t           fade_length)
+{
+  JalvShadow* const shadow = (JalvShadow*)calloc(1, sizeof(JalvShadow));
+  if (!shadow) {
+    return NULL;
+  }
+
+  shadow->instance     = instance;
+  shadow->worker       = worker;
+  shadow->outputs      = (float**)calloc(proc->num_ports, sizeof(float*));
+  shadow->events       = (LV2_Evbuf**)calloc(proc->num_ports, sizeof(void*));
+  shadow->n_ports      = proc->num_ports;
+  shadow->block_length = MAX(1U, block_length);
+  shadow->length       = MAX(1U, fade_length);
+  if (!shadow->outputs || !shadow->events) {
+    shadow->instance = NULL;
+    shadow->worker   = NULL;
+    jalv_shadow_free(shadow);
+    return NULL;
+  }
+
+  // Connect to the same buffers as the current instance, except for outputs
+  for (uint32_t i = 0U; i < proc->num_ports; ++i) {
+    if (shadow_connect_port(proc, shadow, i)) {
+      shadow->instance = NULL;
+      shadow->worker   = NULL;
+      jalv_shadow_free(shadow);
+      return NULL;
+    }
+  }
+
+  return shadow;
+}
+
+void
+jalv_shadow_free(JalvShadow* const shadow)
+{
+  if (shadow) {
+    jalv_worker_free(shadow->worker);
+    if (shadow->instance) {
+      lilv_instance_deactivate(shadow->instance);
+      lilv_instance_free(shadow->instance);
+    }
+
+    for (uint32_t i = 0U; shadow->outputs && i < shadow->n_ports; ++i) {
+      free(shadow->outputs[i]);
+    }
+
+    for (uint32_t i = 0U; shadow->events && i < shadow->n_ports; ++i) {
+      lv2_evbuf_free(shadow->events[i]);
+    }
+
+    free(shadow->events);
+    free(shadow->outputs);
+    free(shadow);
   }
 }
 
@@ -170,6 +419,12 @@ set_port_types(JalvProcessPort* const  port,
   }
 }
 
+static bool
+is_number(const LilvNode* const node)
+{
+  return lilv_node_is_float(node) || lilv_node_is_int(node);
+}
+
 int
 jalv_process_port_init(JalvProcessPort* const  port,
                        const JalvNodes* const  nodes,
@@ -178,9 +433,12 @@ jalv_process_port_init(JalvProcessPort* const  port,
 {
   const LilvNode* const symbol = lilv_port_get_symbol(plugin, lilv_port);
 
-  port->sys_port = NULL;
-  port->evbuf    = NULL;
-  port->buf_size = 0U;
+  port->sys_port  = NULL;
+  port->link_port = NULL;
+  port->evbuf     = NULL;
+  port->buf       = NULL;
+  port->buf_size  = 0U;
+  port->epsilon   = 0.0f;
 
   // Set symbol and label
   LilvNode* const name = lilv_port_get_name(plugin, lilv_port);
@@ -225,6 +483,21 @@ jalv_process_port_init(JalvProcessPort* const  port,
                   jalv_port_has_designation(
                     nodes, plugin, lilv_port, nodes->time_beatsPerMinute));
 
+  // Ignore changes of linear control outputs too small to see in the UI
+  if (port->flow == FLOW_OUTPUT && port->type == TYPE_CONTROL &&
+      !lilv_port_has_property(plugin, lilv_port, nodes->pprops_logarithmic)) {
+    LilvNode* min = NULL;
+    LilvNode* max = NULL;
+    lilv_port_get_range(plugin, lilv_port, NULL, &min, &max);
+    if (is_number(min) && is_number(max)) {
+      const float range = lilv_node_as_float(max) - lilv_node_as_float(min);
+      port->epsilon     = range > 0.0f ? range / CONTROL_RESOLUTION : 0.0f;
+    }
+
+    lilv_node_free(max);
+    lilv_node_free(min);
+  }
+
   return 0;
 }
 
@@ -235,7 +508,194 @@ jalv_process_port_cleanup(JalvProcessPort* const port)
     if (port->evbuf) {
       lv2_evbuf_free(port->evbuf);
     }
+    lv2_evbuf_free(port->split_evbuf);
     free(port->label);
     free(port->symbol);
   }
 }
+
+#ifdef PROCESS_SETUP_STANDALONE
+
+#  include "clock.h"
+
+#  include <stdio.h>
+
+/// Sum the indices of ports that need work by checking every port's type
+static uint64_t
+process_scan_ports(const JalvProcess* const proc)
+{
+  uint64_t sum = 0U;
+  for (uint32_t i = 0U; i < proc->num_ports; ++i) {
+    const JalvProcessPort* const port = &proc->ports[i];
+    if (port->type == TYPE_AUDIO || port->type == TYPE_CV ||
+        port->type == TYPE_EVENT ||
+        (port->type == TYPE_CONTROL && port->flow == FLOW_OUTPUT)) {
+      sum += i;
+    }
+  }
+
+  return sum;
+}
+
+/// Sum the indices of ports that need work by visiting the port lists
+static uint64_t
+process_visit_ports(const JalvProcess* const proc)
+{
+  const JalvPortLists* const lists = &proc->port_lists;
+  const JalvPortList* const  all[] = {&lists->signals,
+                                      &lists->event_inputs,
+                                      &lists->event_outputs,
+                                      &lists->control_outputs};
+
+  uint64_t sum = 0U;
+  for (size_t l = 0U; l < sizeof(all) / sizeof(all[0]); ++l) {
+    for (uint32_t i = 0U; i < all[l]->n_indices; ++i) {
+      sum += all[l]->indices[i];
+    }
+  }
+
+  return sum;
+}
+
+typedef uint64_t (*ProcessVisitFunc)(const JalvProcess*);
+
+/// Return the time taken to visit ports for many cycles in nanoseconds
+static uint64_t
+process_time(volatile ProcessVisitFunc visit,
+             const JalvProcess* const  proc,
+             const uint32_t            n_cycles,
+             uint64_t* const           sum)
+{
+  // Call through a volatile pointer so the loop can't be optimized away
+  const uint64_t start = jalv_clock_now();
+  for (uint32_t c = 0U; c < n_cycles; ++c) {
+    *sum += visit(proc);
+  }
+
+  return jalv_clock_now() - start;
+}
+
+static int
+process_bench(const uint32_t n_ports, const uint32_t n_cycles)
+{
+  static JalvProcess proc;
+
+  proc.num_ports          = n_ports;
+  proc.port_lists.latency = UINT32_MAX;
+  proc.ports = (JalvProcessPort*)calloc(n_ports, sizeof(JalvProcessPort));
+  if (!proc.ports) {
+    return fprintf(stderr, "error: Failed to allocate ports\n");
+  }
+
+  // Make a plugin with a few signal and event ports, and many controls
+  for (uint32_t i = 0U; i < n_ports; ++i) {
+    JalvProcessPort* const port = &proc.ports[i];
+    if (i < 4U) {
+      port->type = TYPE_AUDIO;
+      port->flow = (i < 2U) ? FLOW_INPUT : FLOW_OUTPUT;
+    } else if (i < 6U) {
+      port->type = TYPE_EVENT;
+      port->flow = (i < 5U) ? FLOW_INPUT : FLOW_OUTPUT;
+    } else {
+      port->type = TYPE_CONTROL;
+      port->flow = (i < n_ports - 6U) ? FLOW_INPUT : FLOW_OUTPUT;
+    }
+  }
+
+  build_port_lists(&proc);
+  if (!proc.port_lists.indices ||
+      process_scan_ports(&proc) != process_visit_ports(&proc)) {
+    free(proc.port_lists.indices);
+    free(proc.ports);
+    return fprintf(stderr, "error: Port lists don't match ports\n");
+  }
+
+  // Visit the ports that need work in every cycle both ways
+  uint64_t       scan_sum  = 0U;
+  uint64_t       visit_sum = 0U;
+  const uint64_t scan_ns =
+    process_time(process_scan_ports, &proc, n_cycles, &scan_sum);
+  const uint64_t visit_ns =
+    process_time(process_visit_ports, &proc, n_cycles, &visit_sum);
+
+  fprintf(stderr,
+          "Visited %u ports in %.1f ns per cycle scanning, "
+          "%.1f ns with lists\n",
+          n_ports,
+          (double)scan_ns / n_cycles,
+          (double)visit_ns / n_cycles);
+
+  free(proc.port_lists.indices);
+  free(proc.ports);
+  return (scan_sum != visit_sum)
+           ? fprintf(stderr, "error: Visited different ports\n")
+           : 0;
+}
+
+/// Check that pausing doesn't move timed changes earlier, like in a render
+static int
+process_pause_test(void)
+{
+  static JalvProcess     proc;
+  static JalvProcessPort port;
+
+  float              control    = 0.0f;
+  JalvTimedChange    changes[1] = {{100U, 0U, 1.0f}};
+  ZixRing* const     ring       = zix_ring_new(NULL, 64U);
+  JalvMailbox* const mailbox    = jalv_mailbox_new(1U);
+  if (!ring || !mailbox) {
+    jalv_mailbox_free(mailbox);
+    zix_ring_free(ring);
+    return fprintf(stderr, "error: Failed to allocate rings\n");
+  }
+
+  port.type            = TYPE_CONTROL;
+  port.flow            = FLOW_INPUT;
+  proc.ports           = &port;
+  proc.num_ports       = 1U;
+  proc.controls_buf    = &control;
+  proc.changes         = changes;
+  proc.n_changes       = 1U;
+  proc.max_changes     = 1U;
+  proc.ui_to_plugin    = ring;
+  proc.plugin_to_ui    = ring;
+  proc.ui_controls     = mailbox;
+  proc.plugin_controls = mailbox;
+  jalv_wakeup_init(&proc.ui_wakeup);
+
+  // Stay paused for a while, as the render backend does while restoring
+  int st = 0;
+  for (uint32_t i = 0U; i < 16U; ++i) {
+    jalv_bypass(&proc, 0U);
+  }
+
+  if (proc.frame || proc.n_changes) {
+    st = fprintf(stderr, "error: Time advanced while paused\n");
+  }
+
+  // Render blocks of 64 frames, so the change should be in the second
+  jalv_bypass(&proc, 64U);
+  if (!st && (proc.n_changes != 1U || control != 0.0f)) {
+    st = fprintf(stderr, "error: Timed change applied early\n");
+  }
+
+  jalv_bypass(&proc, 64U);
+  if (!st && (proc.n_changes || control != 1.0f || proc.frame != 128U)) {
+    st = fprintf(stderr, "error: Timed change not applied on time\n");
+  }
+
+  jalv_wakeup_destroy(&proc.ui_wakeup);
+  jalv_mailbox_free(mailbox);
+  zix_ring_free(ring);
+  return st;
+}
+
+int
+main(void)
+{
+  const int st = process_pause_test();
+
+  return st ? st : process_bench(512U, 100000U);
+}
+
+#endif // PROCESS_SETUP_STANDALONE
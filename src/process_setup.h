@@ -1,4 +1,4 @@
-// Copyright 2016-2025 David Robillard <d@drobilla.net>
+// Copyright 2016-2026 David Robillard <d@drobilla.net>
 // SPDX-License-Identifier: ISC
 
 #ifndef JALV_PROCESS_SETUP_H
@@ -10,10 +10,12 @@
 #include "process.h"
 #include "settings.h"
 #include "urids.h"
+#include "worker.h"
 
 #include <lilv/lilv.h>
 
 #include <stdbool.h>
+#include <stdint.h>
 
 // Code for setting up the realtime process thread (but that isn't used in it)
 JALV_BEGIN_DECLS
@@ -61,6 +63,36 @@ jalv_process_activate(JalvProcess*        proc,
 void
 jalv_process_deactivate(JalvProcess* proc);
 
+/**
+   Allocate a shadow instance to replace the current one.
+
+   The instance is connected to the same buffers as the current instance,
+   except for signal outputs, which are connected to new buffers so they can be
+   faded in.
+
+   @param proc Process thread state.
+   @param instance New plugin instance, which is owned by the shadow.
+   @param worker Worker for the new instance, which is owned by the shadow.
+   @param block_length Maximum audio block length in frames.
+   @param fade_length Length of the crossfade in frames.
+   @return A newly allocated shadow, or null on error, in which case the caller
+   still owns the instance and worker.
+*/
+JalvShadow*
+jalv_shadow_new(const JalvProcess* proc,
+                LilvInstance*      instance,
+                JalvWorker*        worker,
+                uint32_t           block_length,
+                uint32_t           fade_length);
+
+/**
+   Free a shadow instance, including the instance and worker it holds.
+
+   After the process thread has swapped the instances, this frees the old ones.
+*/
+void
+jalv_shadow_free(JalvShadow* shadow);
+
 /**
    Initialize the process thread state for a port.
 
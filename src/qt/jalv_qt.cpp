@@ -1,18 +1,19 @@
-// Copyright 2007-2022 David Robillard <d@drobilla.net>
+// Copyright 2007-2026 David Robillard <d@drobilla.net>
 // SPDX-License-Identifier: ISC
 
 #include "jalv_qt.hpp"
 
 #include "../any_value.h"
-#include "../comm.h"
 #include "../control.h"
 #include "../frontend.h"
 #include "../jalv.h"
+#include "../mailbox.h"
 #include "../nodes.h"
 #include "../port.h"
 #include "../query.h"
 #include "../state.h"
 #include "../types.h"
+#include "../wakeup.h"
 
 #include <lilv/lilv.h>
 #include <suil/suil.h>
@@ -20,6 +21,7 @@
 #include <QAction>
 #include <QApplication>
 #include <QDial>
+#include <QEvent>
 #include <QFontMetrics>
 #include <QGroupBox>
 #include <QGuiApplication>
@@ -40,6 +42,7 @@
 #include <QScrollArea>
 #include <QSize>
 #include <QSizePolicy>
+#include <QSocketNotifier>
 #include <QString>
 #include <QStyle>
 #include <QTimer>
@@ -288,6 +291,29 @@ private:
   Jalv* _jalv;
 };
 
+class Waker : public QSocketNotifier
+{
+public:
+  explicit Waker(Jalv* jalv, int fd)
+    : QSocketNotifier(fd, QSocketNotifier::Read)
+    , _jalv(jalv)
+  {}
+
+protected:
+  bool event(QEvent* event) override
+  {
+    if (event->type() == QEvent::SockAct) {
+      jalv_update(_jalv);
+      return true;
+    }
+
+    return QSocketNotifier::event(event);
+  }
+
+private:
+  Jalv* _jalv;
+};
+
 int
 add_preset_to_menu(Jalv*           jalv,
                    const LilvNode* node,
@@ -500,7 +526,7 @@ Controller::dialChanged(int)
   const float value = getValue();
 
   _label->setText(getValueLabel(value));
-  jalv_write_control(_jalv->process.ui_to_plugin, _port->index, value);
+  jalv_mailbox_write(_jalv->process.ui_controls, _port->index, value);
 }
 
 namespace {
@@ -705,12 +731,20 @@ jalv_frontend_run(Jalv* jalv)
     win->resize(widget->width(), widget->height() + win->menuBar()->height());
   }
 
-  auto* const timer = new Timer(jalv);
-  timer->start((int)(1000.0f / jalv->settings.ui_update_hz));
+  // Update only when woken by the process thread if possible
+  QObject*  updater   = nullptr;
+  const int wakeup_fd = jalv_wakeup_fd(&jalv->process.ui_wakeup);
+  if (wakeup_fd >= 0) {
+    updater = new Waker(jalv, wakeup_fd);
+  } else {
+    auto* const timer = new Timer(jalv);
+    timer->start((int)(1000.0f / jalv->settings.ui_update_hz));
+    updater = timer;
+  }
 
   const int rc = app->exec();
 
-  delete timer;
+  delete updater;
   jalv_deactivate(jalv);
   jalv_close(jalv);
   return rc;
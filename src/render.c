@@ -0,0 +1,517 @@
+// Copyright 2026 David Robillard <d@drobilla.net>
+// SPDX-License-Identifier: ISC
+
+#include "backend.h"
+
+#include "atomic.h"
+#include "audio_file.h"
+#include "buffers.h"
+#include "log.h"
+#include "lv2_evbuf.h"
+#include "midi_file.h"
+#include "options.h"
+#include "process.h"
+#include "settings.h"
+#include "timeline.h"
+#include "types.h"
+#include "urids.h"
+#include "wakeup.h"
+
+#include <lilv/lilv.h>
+#include <lv2/urid/urid.h>
+#include <zix/attributes.h>
+#include <zix/sem.h>
+#include <zix/status.h>
+#include <zix/thread.h>
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/// Sample rate used if there is no input file or explicit rate
+#define RENDER_DEFAULT_SAMPLE_RATE 48000.0f
+
+struct JalvBackendImpl {
+  const JalvLog*   log;           ///< Log for reporting errors
+  const JalvURIDs* urids;         ///< Application vocabulary
+  JalvProcess*     process;       ///< Process thread state
+  ZixSem*          done;          ///< Finished semaphore
+  ZixSem           wake;          ///< Interrupts waiting while paused
+  ZixThread        thread;        ///< Rendering thread
+  JalvAudioFile*   audio_in;      ///< Audio input file, or null
+  JalvAudioFile*   audio_out;     ///< Audio output file, or null
+  JalvMidiFile*    midi_in;       ///< MIDI input file, or null
+  JalvMidiFile*    midi_out;      ///< MIDI output file, or null
+  float**          in_bufs;       ///< Buffers for audio inputs
+  float**          out_bufs;      ///< Buffers for audio outputs
+  const float**    out_ptrs;      ///< Offset output pointers for writing
+  uint32_t         n_audio_in;    ///< Number of audio inputs
+  uint32_t         n_audio_out;   ///< Number of audio outputs
+  uint32_t         midi_port;     ///< Index of MIDI input port, or UINT32_MAX
+  uint32_t         block_length;  ///< Frames rendered per cycle
+  uint64_t         frame;         ///< Current input position in frames
+  uint64_t         input_end;     ///< End of input, if known, in frames
+  uint64_t         tail;          ///< Frames to render after input ends
+  uint64_t         latency;       ///< Plugin latency compensation in frames
+  bool             latency_known; ///< Latency has been measured
+  bool             audio_done;    ///< Audio input is exhausted
+  bool             launched;      ///< Rendering thread is running
+  uint32_t         exit;          ///< Rendering thread exit requested (atomic)
+};
+
+static bool
+render_finished(const JalvBackend* const backend)
+{
+  return backend->audio_done && backend->latency_known &&
+         backend->frame >=
+           backend->input_end + backend->tail + backend->latency;
+}
+
+// Read inputs and prepare ports before running the plugin for a block
+static void
+pre_process(JalvBackend* const backend, const uint32_t nframes)
+{
+  JalvProcess* const proc = backend->process;
+
+  // Read audio input, noting where it ends if this is the last block
+  if (backend->audio_in && !backend->audio_done) {
+    const uint32_t n_read = jalv_audio_file_read(
+      backend->audio_in, backend->in_bufs, backend->n_audio_in, nframes);
+
+    if (n_read < nframes) {
+      const uint64_t end  = backend->frame + n_read;
+      backend->audio_done = true;
+      backend->input_end  = end > backend->input_end ? end : backend->input_end;
+    }
+  } else {
+    for (uint32_t i = 0U; i < backend->n_audio_in; ++i) {
+      memset(backend->in_bufs[i], 0, nframes * sizeof(float));
+    }
+  }
+
+  for (uint32_t p = 0U; p < proc->num_ports; ++p) {
+    JalvProcessPort* const port = &proc->ports[p];
+    if (port->type == TYPE_EVENT && port->flow == FLOW_OUTPUT) {
+      // Clear event output for plugin to write to
+      lv2_evbuf_reset(port->evbuf, false);
+    } else if (p == backend->midi_port) {
+      // Write MIDI input events for this block after any position
+      LV2_Evbuf_Iterator   iter = lv2_evbuf_end(port->evbuf);
+      const JalvMidiEvent* ev   = NULL;
+      while ((ev = jalv_midi_file_next(backend->midi_in,
+                                       backend->frame + nframes))) {
+        const uint32_t offset =
+          ev->frame > backend->frame ? (uint32_t)(ev->frame - backend->frame)
+                                     : 0U;
+
+        lv2_evbuf_write(&iter,
+                        offset,
+                        0,
+                        backend->urids->midi_MidiEvent,
+                        ev->size,
+                        ev->data);
+      }
+    }
+  }
+}
+
+// Return the output position of an event, compensated for plugin latency
+static uint64_t
+output_frame(const JalvBackend* const backend, const uint32_t offset)
+{
+  const uint64_t frame = backend->frame + offset;
+  return frame > backend->latency ? frame - backend->latency : 0U;
+}
+
+// Process port output and write outputs after running the plugin for a block
+static void
+post_process(JalvBackend* const backend,
+             const uint32_t     nframes,
+             const bool         send_updates)
+{
+  JalvProcess* const     proc  = backend->process;
+  const JalvURIDs* const urids = backend->urids;
+
+  for (uint32_t p = 0U; p < proc->num_ports; ++p) {
+    JalvProcessPort* const port = &proc->ports[p];
+    if (port->flow == FLOW_INPUT && port->type == TYPE_EVENT) {
+      lv2_evbuf_reset(port->evbuf, true);
+    } else if (port->flow == FLOW_OUTPUT && port->type == TYPE_CONTROL &&
+               port->reports_latency) {
+      jalv_process_update_latency(proc, p);
+    } else if (port->flow == FLOW_OUTPUT && port->type == TYPE_EVENT) {
+      for (LV2_Evbuf_Iterator i = lv2_evbuf_begin(port->evbuf);
+           lv2_evbuf_is_valid(i);
+           i = lv2_evbuf_next(i)) {
+        // Get event from LV2 buffer
+        uint32_t frames    = 0U;
+        uint32_t subframes = 0U;
+        LV2_URID type      = 0U;
+        uint32_t size      = 0U;
+        void*    body      = NULL;
+        lv2_evbuf_get(i, &frames, &subframes, &type, &size, &body);
+
+        if (backend->midi_out && type == urids->midi_MidiEvent) {
+          // Write MIDI event to output file
+          jalv_midi_file_write(backend->midi_out,
+                               output_frame(backend, frames),
+                               size,
+                               (const uint8_t*)body);
+        }
+
+        // Forward event to UI
+        jalv_process_send_event(proc, p, size, type, body);
+      }
+    } else if (send_updates && port->flow == FLOW_OUTPUT &&
+               port->type == TYPE_CONTROL) {
+      jalv_process_send_control(proc, p);
+    }
+  }
+
+  // Write the part of this block that is after the latency and before the end
+  if (backend->audio_out) {
+    const uint64_t start = backend->frame;
+    const uint64_t end =
+      backend->audio_done
+        ? (backend->input_end + backend->tail + backend->latency)
+        : (start + nframes);
+
+    const uint64_t lo = start > backend->latency ? start : backend->latency;
+    const uint64_t hi = (start + nframes < end) ? (start + nframes) : end;
+    if (lo < hi) {
+      for (uint32_t i = 0U; i < backend->n_audio_out; ++i) {
+        backend->out_ptrs[i] = backend->out_bufs[i] + (lo - start);
+      }
+
+      if (jalv_audio_file_write(
+            backend->audio_out, backend->out_ptrs, (uint32_t)(hi - lo))) {
+        jalv_log(backend->log, JALV_LOG_ERR, "Failed to write audio output");
+        jalv_atomic_store(&backend->exit, 1U);
+      }
+    }
+  }
+}
+
+// Run the plugin for no frames to get its latency before writing any output
+static void
+measure_latency(JalvBackend* const backend)
+{
+  JalvProcess* const proc = backend->process;
+
+  for (uint32_t p = 0U; p < proc->num_ports; ++p) {
+    JalvProcessPort* const port = &proc->ports[p];
+    if (port->type == TYPE_EVENT) {
+      lv2_evbuf_reset(port->evbuf, port->flow == FLOW_INPUT);
+    }
+  }
+
+  lilv_instance_run(proc->instance, 0U);
+  if (proc->port_lists.latency != UINT32_MAX) {
+    jalv_process_update_latency(proc, proc->port_lists.latency);
+  }
+
+  backend->latency       = proc->plugin_latency;
+  backend->latency_known = true;
+}
+
+static ZixThreadResult ZIX_THREAD_FUNC
+render_func(void* const data)
+{
+  JalvBackend* const backend = (JalvBackend*)data;
+  JalvProcess* const proc    = backend->process;
+
+  // Compensate every output, including the first block, for plugin latency
+  if (!backend->latency_known) {
+    measure_latency(backend);
+  }
+
+  while (!jalv_atomic_load(&backend->exit) && !render_finished(backend)) {
+    if (proc->run_state == JALV_PAUSED) {
+      // Apply messages without advancing time, and wait a moment
+      jalv_bypass(proc, 0U);
+      zix_sem_timed_wait(&backend->wake, 0U, 1000000U);
+      continue;
+    }
+
+    // End cycles at tempo changes, so positions come before any MIDI input
+    const uint32_t nframes =
+      jalv_timeline_block_length(&proc->timeline, backend->block_length);
+
+    jalv_process_begin_cycle(proc);
+    jalv_process_run_timeline(proc, nframes);
+    jalv_process_end_stage(proc, JALV_STAGE_TRANSPORT);
+    pre_process(backend, nframes);
+    jalv_process_end_stage(proc, JALV_STAGE_PRE_PROCESS);
+
+    const JalvProcessStatus pst  = jalv_run(proc, nframes);
+    const bool              send = pst == JALV_PROCESS_SEND_UPDATES;
+
+    post_process(backend, nframes, send);
+    jalv_process_end_cycle(proc, nframes, send);
+    backend->frame += nframes;
+  }
+
+  if (!jalv_atomic_load(&backend->exit)) {
+    jalv_log(backend->log,
+             JALV_LOG_INFO,
+             "Rendered %" PRIu64 " frames",
+             backend->input_end + backend->tail);
+  }
+
+  zix_sem_post(backend->done);
+  jalv_wakeup_signal(&backend->process->ui_wakeup);
+  return ZIX_THREAD_RESULT;
+}
+
+JalvBackend*
+jalv_backend_allocate(void)
+{
+  JalvBackend* const backend = (JalvBackend*)calloc(1, sizeof(JalvBackend));
+  if (backend) {
+    zix_sem_init(&backend->wake, 0U);
+  }
+
+  return backend;
+}
+
+void
+jalv_backend_free(JalvBackend* const backend)
+{
+  if (backend) {
+    zix_sem_destroy(&backend->wake);
+    free(backend);
+  }
+}
+
+static int
+open_files(JalvBackend* const       backend,
+           const JalvOptions* const opts,
+           const float              rate)
+{
+  const JalvLog* const log = backend->log;
+
+  if (opts->midi_input) {
+    if (backend->midi_port == UINT32_MAX) {
+      jalv_log(log, JALV_LOG_WARNING, "Plugin has no MIDI input");
+    } else if (!(backend->midi_in =
+                   jalv_midi_file_open_read(opts->midi_input, rate))) {
+      jalv_log(log, JALV_LOG_ERR, "Failed to read %s", opts->midi_input);
+      return 1;
+    } else {
+      backend->input_end = jalv_midi_file_length(backend->midi_in) + 1U;
+    }
+  }
+
+  if (opts->audio_output) {
+    if (!(backend->audio_out = jalv_audio_file_open_write(
+            opts->audio_output, backend->n_audio_out, rate))) {
+      jalv_log(log, JALV_LOG_ERR, "Failed to open %s", opts->audio_output);
+      return 1;
+    }
+  }
+
+  if (opts->midi_output) {
+    if (!(backend->midi_out =
+            jalv_midi_file_open_write(opts->midi_output, rate))) {
+      jalv_log(log, JALV_LOG_ERR, "Failed to open %s", opts->midi_output);
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+int
+jalv_backend_share(JalvBackend* const ZIX_UNUSED(backend),
+                   JalvBackend* const ZIX_UNUSED(host),
+                   const char* const  ZIX_UNUSED(name))
+{
+  return 1;
+}
+
+int
+jalv_backend_link(JalvBackend* const ZIX_UNUSED(from),
+                  const uint32_t     ZIX_UNUSED(from_index),
+                  JalvBackend* const ZIX_UNUSED(to),
+                  const uint32_t     ZIX_UNUSED(to_index))
+{
+  return 1;
+}
+
+int
+jalv_backend_prepare_graph(JalvBackend* const ZIX_UNUSED(backend),
+                           const uint32_t     ZIX_UNUSED(n_threads))
+{
+  return 1;
+}
+
+int
+jalv_backend_open(JalvBackend* const       backend,
+                  const JalvLog* const     log,
+                  const JalvURIDs* const   urids,
+                  JalvSettings* const      settings,
+                  JalvProcess* const       proc,
+                  ZixSem* const            done,
+                  const JalvOptions* const opts)
+{
+  backend->log       = log;
+  backend->urids     = urids;
+  backend->process   = proc;
+  backend->done      = done;
+  backend->midi_port = UINT32_MAX;
+
+  // Count audio ports and find the MIDI input
+  for (uint32_t i = 0U; i < proc->num_ports; ++i) {
+    const JalvProcessPort* const port = &proc->ports[i];
+    if (port->type == TYPE_AUDIO || port->type == TYPE_CV) {
+      if (port->flow == FLOW_INPUT) {
+        ++backend->n_audio_in;
+      } else if (port->flow == FLOW_OUTPUT) {
+        ++backend->n_audio_out;
+      }
+    } else if (port->type == TYPE_EVENT && port->flow == FLOW_INPUT &&
+               port->supports_midi && backend->midi_port == UINT32_MAX) {
+      backend->midi_port = i;
+    }
+  }
+
+  // Open audio input first, since it determines the default sample rate
+  float rate = opts->sample_rate > 0.0 ? (float)opts->sample_rate : 0.0f;
+  if (opts->audio_input) {
+    if (!(backend->audio_in = jalv_audio_file_open_read(
+            opts->audio_input,
+            backend->n_audio_in,
+            rate > 0.0f ? rate : RENDER_DEFAULT_SAMPLE_RATE))) {
+      jalv_log(log, JALV_LOG_ERR, "Failed to read %s", opts->audio_input);
+      return 1;
+    }
+
+    const float file_rate = jalv_audio_file_rate(backend->audio_in);
+    if (rate <= 0.0f) {
+      rate = file_rate;
+    } else if (rate != file_rate) {
+      jalv_log(log,
+               JALV_LOG_WARNING,
+               "Rendering %.0f Hz input at %.0f Hz",
+               file_rate,
+               rate);
+    }
+
+    if (jalv_audio_file_channels(backend->audio_in) != backend->n_audio_in) {
+      jalv_log(log,
+               JALV_LOG_WARNING,
+               "Input has %u channels, but plugin has %u audio inputs",
+               jalv_audio_file_channels(backend->audio_in),
+               backend->n_audio_in);
+    }
+  } else {
+    backend->audio_done = true;
+  }
+
+  if (rate <= 0.0f) {
+    rate = RENDER_DEFAULT_SAMPLE_RATE;
+  }
+
+  if (open_files(backend, opts, rate)) {
+    return 1;
+  }
+
+  // Set audio parameters
+  settings->sample_rate      = rate;
+  settings->min_block_length = 1U;
+  settings->max_block_length = settings->max_block_length
+                                 ? settings->max_block_length
+                                 : JALV_DEFAULT_BLOCK_LENGTH;
+  settings->midi_buf_size    = 32768U;
+  settings->offline          = true;
+
+  backend->block_length = settings->max_block_length;
+  backend->tail =
+    opts->tail > 0.0 ? (uint64_t)(opts->tail * rate + 0.5) : 0U;
+
+  // Allocate audio buffers
+  const uint32_t nframes = backend->block_length;
+  backend->in_bufs       = jalv_buffers_new(backend->n_audio_in, nframes);
+  backend->out_bufs      = jalv_buffers_new(backend->n_audio_out, nframes);
+  backend->out_ptrs =
+    (const float**)calloc(backend->n_audio_out + 1U, sizeof(const float*));
+
+  if (!backend->in_bufs || !backend->out_bufs || !backend->out_ptrs) {
+    jalv_log(log, JALV_LOG_ERR, "Failed to allocate audio buffers");
+    return 1;
+  }
+
+  return 0;
+}
+
+void
+jalv_backend_close(JalvBackend* const backend)
+{
+  if (backend) {
+    if (jalv_audio_file_close(backend->audio_out)) {
+      jalv_log(backend->log, JALV_LOG_ERR, "Failed to write audio output");
+    }
+
+    if (jalv_midi_file_close(backend->midi_out)) {
+      jalv_log(backend->log, JALV_LOG_ERR, "Failed to write MIDI output");
+    }
+
+    jalv_audio_file_close(backend->audio_in);
+    jalv_midi_file_close(backend->midi_in);
+    jalv_buffers_free(backend->in_bufs, backend->n_audio_in);
+    jalv_buffers_free(backend->out_bufs, backend->n_audio_out);
+    free(backend->out_ptrs);
+
+    backend->audio_in  = NULL;
+    backend->audio_out = NULL;
+    backend->midi_in   = NULL;
+    backend->midi_out  = NULL;
+    backend->in_bufs   = NULL;
+    backend->out_bufs  = NULL;
+    backend->out_ptrs  = NULL;
+  }
+}
+
+void
+jalv_backend_activate(JalvBackend* const backend)
+{
+  if (backend->launched) {
+    return;
+  }
+
+  jalv_atomic_store(&backend->exit, 0U);
+  if (zix_thread_create(&backend->thread, 1048576U, render_func, backend)) {
+    jalv_log(backend->log, JALV_LOG_ERR, "Failed to launch render thread");
+    return;
+  }
+
+  backend->launched = true;
+}
+
+void
+jalv_backend_deactivate(JalvBackend* const backend)
+{
+  if (!backend->launched) {
+    return;
+  }
+
+  jalv_atomic_store(&backend->exit, 1U);
+  zix_sem_post(&backend->wake);
+  zix_thread_join(backend->thread);
+  backend->launched = false;
+}
+
+void
+jalv_backend_activate_port(JalvBackend* const backend,
+                           JalvProcess* const proc,
+                           const uint32_t     port_index)
+{
+  jalv_buffers_connect_port(
+    proc, port_index, backend->in_bufs, backend->out_bufs);
+}
+
+void
+jalv_backend_recompute_latencies(JalvBackend* const ZIX_UNUSED(backend))
+{}
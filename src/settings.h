@@ -1,4 +1,4 @@
-// Copyright 2018-2024 David Robillard <d@drobilla.net>
+// Copyright 2018-2026 David Robillard <d@drobilla.net>
 // SPDX-License-Identifier: ISC
 
 #ifndef JALV_SETTINGS_H
@@ -6,6 +6,7 @@
 
 #include "attributes.h"
 
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 
@@ -17,10 +18,13 @@ typedef struct {
   float    sample_rate;      ///< Sample rate
   uint32_t min_block_length; ///< Minimum audio buffer length in frames
   uint32_t max_block_length; ///< Maximum audio buffer length in frames
+  uint32_t split_length;     ///< Minimum length of split blocks, or zero
+  uint32_t sleep_length;     ///< Silent frames before sleeping, or zero
   size_t   midi_buf_size;    ///< MIDI buffer size in bytes
   uint32_t ring_size;        ///< Communication ring size in bytes
   float    ui_update_hz;     ///< Frequency of UI updates
   float    ui_scale_factor;  ///< UI scale factor
+  bool     offline;          ///< Processing isn't driven by a realtime clock
 } JalvSettings;
 
 JALV_END_DECLS
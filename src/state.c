@@ -4,19 +4,30 @@
 #include "state.h"
 
 #include "any_value.h"
+#include "atomic.h"
+#include "clock.h"
 #include "comm.h"
 #include "control.h"
+#include "features.h"
 #include "jalv.h"
+#include "jalv_config.h"
 #include "log.h"
+#include "macros.h"
+#include "mailbox.h"
 #include "mapper.h"
 #include "port.h"
+#include "preset_cache.h"
 #include "process.h"
+#include "process_setup.h"
 #include "types.h"
+#include "worker.h"
 
 #include <lilv/lilv.h>
 #include <lv2/core/lv2.h>
+#include <lv2/instance-access/instance-access.h>
 #include <lv2/state/state.h>
 #include <lv2/urid/urid.h>
+#include <lv2/worker/worker.h>
 #include <zix/allocator.h>
 #include <zix/attributes.h>
 #include <zix/filesystem.h>
@@ -26,9 +37,12 @@
 #include <zix/status.h>
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdlib.h>
 
+#define SHADOW_FADE_SECONDS 0.02 ///< Crossfade time when swapping instances
+
 ZIX_MALLOC_FUNC char*
 jalv_make_path(LV2_State_Make_Path_Handle handle, const char* path)
 {
@@ -82,7 +96,11 @@ jalv_load_presets(Jalv* jalv, PresetSink sink, void* data)
     lilv_plugin_get_related(jalv->plugin, jalv->nodes.pset_Preset);
   LILV_FOREACH (nodes, i, presets) {
     const LilvNode* preset = lilv_nodes_get(presets, i);
-    lilv_world_load_resource(jalv->world, preset);
+    if (!jalv->preset_cache ||
+        !jalv_preset_cache_is_loaded(jalv->preset_cache, preset)) {
+      lilv_world_load_resource(jalv->world, preset);
+    }
+
     if (!sink) {
       continue;
     }
@@ -136,7 +154,7 @@ set_port_value(const char* port_symbol,
   }
 
   // Look up the control
-  Control* const control = get_named_control(&jalv->controls, port_symbol);
+  Control* const control = get_port_control(&jalv->controls, port->index);
   if (!control) {
     jalv_log(&jalv->log,
              JALV_LOG_WARNING,
@@ -159,13 +177,11 @@ set_port_value(const char* port_symbol,
       proc->controls_buf[port->index] = fvalue;
     } else {
       // Send value to plugin (as if from UI)
-      st = jalv_write_control(proc->ui_to_plugin, port->index, fvalue);
+      jalv_mailbox_write(proc->ui_controls, port->index, fvalue);
     }
 
     // Update UI (as if from plugin)
-    if (!st) {
-      st = jalv_write_control(proc->plugin_to_ui, port->index, fvalue);
-    }
+    jalv_mailbox_write(proc->plugin_controls, port->index, fvalue);
   } else {
     st = ZIX_STATUS_NOT_SUPPORTED;
   }
@@ -178,6 +194,169 @@ set_port_value(const char* port_symbol,
   }
 }
 
+/// Restore state into a plugin instance
+static void
+restore_instance(Jalv* const            jalv,
+                 const LilvState* const state,
+                 LilvInstance* const    instance)
+{
+  const LV2_Feature* state_features[9] = {
+    &jalv->features.map_feature,
+    &jalv->features.unmap_feature,
+    &jalv->features.make_path_feature,
+    &jalv->features.state_sched_feature,
+    &jalv->features.safe_restore_feature,
+    &jalv->features.log_feature,
+    &jalv->features.options_feature,
+    NULL,
+  };
+
+  lilv_state_restore(state, instance, set_port_value, jalv, 0, state_features);
+}
+
+/// Return true if the plugin UI may access the plugin instance directly
+static bool
+ui_has_instance_access(Jalv* const jalv)
+{
+  bool result = false;
+
+#if USE_SUIL
+  if (jalv->ui_instance) {
+    LilvWorld* const      world  = jalv->world;
+    const LilvNode* const ui_uri = lilv_ui_get_uri(jalv->ui);
+    LilvNode* const required = lilv_new_uri(world, LV2_CORE__requiredFeature);
+    LilvNode* const optional = lilv_new_uri(world, LV2_CORE__optionalFeature);
+    LilvNode* const access   = lilv_new_uri(world, LV2_INSTANCE_ACCESS_URI);
+
+    result = lilv_world_ask(world, ui_uri, required, access) ||
+             lilv_world_ask(world, ui_uri, optional, access);
+
+    lilv_node_free(access);
+    lilv_node_free(optional);
+    lilv_node_free(required);
+  }
+#else
+  (void)jalv;
+#endif
+
+  return result;
+}
+
+/// Instantiate the plugin using the given worker for scheduling work
+static LilvInstance*
+instantiate_shadow(Jalv* const jalv, JalvWorker* const worker)
+{
+  JalvFeatures* const features = &jalv->features;
+  JalvProcess* const  proc     = &jalv->process;
+
+  /* The current instance uses one of the two schedule features, and may keep
+     a pointer to it, so the new instance must use the other one. */
+  const bool                 use_main = features->sched.handle != proc->worker;
+  LV2_Worker_Schedule* const sched =
+    use_main ? &features->sched : &features->shadow_sched;
+  const LV2_Feature* const sched_feature =
+    use_main ? &features->sched_feature : &features->shadow_sched_feature;
+
+  // Copy the feature list, replacing the schedule feature
+  size_t n_features = 0U;
+  while (jalv->feature_list[n_features]) {
+    ++n_features;
+  }
+
+  const LV2_Feature** const feature_list =
+    (const LV2_Feature**)calloc(n_features + 1U, sizeof(LV2_Feature*));
+  if (!feature_list) {
+    return NULL;
+  }
+
+  for (size_t i = 0U; i < n_features; ++i) {
+    const LV2_Feature* const f = jalv->feature_list[i];
+    feature_list[i] = f == &features->sched_feature ? sched_feature : f;
+  }
+
+  sched->handle = worker;
+
+  LilvInstance* const instance = lilv_plugin_instantiate(
+    jalv->plugin, jalv->settings.sample_rate, feature_list);
+
+  free(feature_list);
+  return instance;
+}
+
+/**
+   Restore state into a new plugin instance, and fade to it while running.
+
+   @return Zero on success, or non-zero if the shadow instance couldn't be
+   prepared, in which case the current instance is unchanged.
+*/
+static int
+apply_shadow_state(Jalv* const jalv, const LilvState* const state)
+{
+  JalvProcess* const  proc     = &jalv->process;
+  JalvSettings* const settings = &jalv->settings;
+
+  // Create a worker like the current one for the new instance
+  JalvWorker* worker = NULL;
+  if (proc->worker) {
+    const uint32_t n_threads =
+      settings->offline ? 0U : MAX(1U, jalv->opts.worker_threads);
+
+    if (!(worker = jalv_worker_new(
+            &jalv->work_lock, n_threads, settings->ring_size))) {
+      return 1;
+    }
+  }
+
+  // Instantiate the plugin and attach the worker to it
+  LilvInstance* const instance = instantiate_shadow(jalv, worker);
+  if (!instance) {
+    jalv_worker_free(worker);
+    return 1;
+  }
+
+  const LV2_Worker_Interface* const worker_iface =
+    (const LV2_Worker_Interface*)lilv_instance_get_extension_data(
+      instance, LV2_WORKER__interface);
+
+  jalv_worker_attach(worker, worker_iface, instance->lv2_handle);
+
+  // Connect the new instance to the current buffers
+  const uint32_t fade_length =
+    (uint32_t)(settings->sample_rate * SHADOW_FADE_SECONDS);
+
+  JalvShadow* const shadow = jalv_shadow_new(
+    proc, instance, worker, settings->max_block_length, fade_length);
+  if (!shadow) {
+    lilv_instance_free(instance);
+    jalv_worker_free(worker);
+    return 1;
+  }
+
+  // Restore state into the new instance, which isn't running yet
+  restore_instance(jalv, state, instance);
+
+  // Start the new instance and send it to the process thread to be faded in
+  if (worker) {
+    jalv_worker_launch(worker);
+  }
+
+  lilv_instance_activate(instance);
+
+  const JalvMessageHeader header = {SHADOW_START, sizeof(JalvShadowStart)};
+  const JalvShadowStart   body   = {shadow};
+  if (jalv_write_split_message(
+        proc->ui_to_plugin, &header, sizeof(header), &body, sizeof(body))) {
+    jalv_atomic_increment(&proc->to_plugin_stats.n_dropped);
+    jalv_shadow_free(shadow);
+    return 1;
+  }
+
+  // Wait for the instances to be swapped, then free the old one
+  zix_sem_wait(&proc->swapped);
+  jalv_shadow_free(shadow);
+  return 0;
+}
+
 void
 jalv_apply_state(Jalv* jalv, const LilvState* state)
 {
@@ -188,8 +367,20 @@ jalv_apply_state(Jalv* jalv, const LilvState* state)
     JalvRunStateChange body;
   } PauseMessage;
 
-  const bool must_pause =
-    !jalv->safe_restore && proc->run_state == JALV_RUNNING;
+  bool must_pause = !jalv->safe_restore && proc->run_state == JALV_RUNNING;
+  bool restored   = false;
+  if (must_pause && jalv->opts.shadow_restore &&
+      !ui_has_instance_access(jalv)) {
+    // Restore into a new instance and fade to it, instead of pausing
+    restored   = !apply_shadow_state(jalv, state);
+    must_pause = !restored;
+    if (!restored) {
+      jalv_log(&jalv->log,
+               JALV_LOG_WARNING,
+               "Failed to prepare new instance, pausing to restore state");
+    }
+  }
+
   if (must_pause) {
     const PauseMessage pause_msg = {
       {RUN_STATE_CHANGE, sizeof(JalvRunStateChange)}, {JALV_PAUSED}};
@@ -198,19 +389,9 @@ jalv_apply_state(Jalv* jalv, const LilvState* state)
     zix_sem_wait(&proc->paused);
   }
 
-  const LV2_Feature* state_features[9] = {
-    &jalv->features.map_feature,
-    &jalv->features.unmap_feature,
-    &jalv->features.make_path_feature,
-    &jalv->features.state_sched_feature,
-    &jalv->features.safe_restore_feature,
-    &jalv->features.log_feature,
-    &jalv->features.options_feature,
-    NULL,
-  };
-
-  lilv_state_restore(
-    state, proc->instance, set_port_value, jalv, 0, state_features);
+  if (!restored) {
+    restore_instance(jalv, state, proc->instance);
+  }
 
   if (jalv->process.control_in != UINT32_MAX) {
     const JalvMessageHeader state_msg = {STATE_REQUEST, 0U};
@@ -224,14 +405,44 @@ jalv_apply_state(Jalv* jalv, const LilvState* state)
   }
 }
 
+/// Release the current preset, returning it to the cache if possible
+static void
+release_preset(Jalv* const jalv)
+{
+  if (jalv->preset &&
+      (!jalv->preset_cache ||
+       !jalv_preset_cache_give(jalv->preset_cache, jalv->preset))) {
+    lilv_state_free(jalv->preset);
+  }
+
+  jalv->preset = NULL;
+}
+
 int
 jalv_apply_preset(Jalv* jalv, const LilvNode* preset)
 {
-  lilv_state_free(jalv->preset);
-  jalv->preset = lilv_state_new_from_world(
-    jalv->world, jalv_mapper_urid_map(jalv->mapper), preset);
+  const uint64_t start = jalv_clock_now();
+
+  release_preset(jalv);
+  if (jalv->preset_cache) {
+    jalv->preset = jalv_preset_cache_take(jalv->preset_cache, preset);
+  }
+
+  const bool cached = !!jalv->preset;
+  if (!cached) {
+    jalv->preset = lilv_state_new_from_world(
+      jalv->world, jalv_mapper_urid_map(jalv->mapper), preset);
+  }
+
   if (jalv->preset) {
     jalv_apply_state(jalv, jalv->preset);
+    if (jalv->preset_cache) {
+      jalv_log(&jalv->log,
+               JALV_LOG_INFO,
+               "Applied %s preset in %.3f ms",
+               cached ? "cached" : "uncached",
+               (double)(jalv_clock_now() - start) / 1000000.0);
+    }
     return 0;
   }
   return -1;
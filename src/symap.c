@@ -1,172 +1,228 @@
-// Copyright 2011-2022 David Robillard <d@drobilla.net>
+// Copyright 2011-2026 David Robillard <d@drobilla.net>
 // SPDX-License-Identifier: ISC
 
 #include "symap.h"
 
+#include "atomic.h"
+
+#include <zix/digest.h>
+
 #include <assert.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
 /**
   @file symap.c Implementation of Symap, a basic symbol map (string interner).
 
-  This implementation is primitive, but has some desirable qualities: good
-  (O(lg(n)) lookup performance for already-mapped symbols, minimal space
-  overhead, extremely fast (O(1)) reverse mapping (ID to string), simple code,
-  no dependencies.
-
-  The tradeoff is that mapping new symbols may be quite slow.  In other words,
-  this implementation is ideal for use cases with a relatively limited set of
-  symbols, or where most symbols are mapped early.  It will not fare so well
-  with very dynamic sets of symbols.  For that, you're better off with a
-  tree-based implementation (and the associated space cost, especially if you
-  need reverse mapping).
+  Symbols are stored in an append-only array indexed by ID, which is split
+  into chunks that double in size so that existing symbols never move.  This
+  makes reverse mapping (ID to string) O(1) and safe to do without a lock
+  while another thread maps new symbols, since the new size is only published
+  after the symbol is written.
+
+  Forward mapping (string to ID) uses an open-addressed hash table of IDs with
+  linear probing, so both looking up and mapping new symbols are O(1) on
+  average.  The table stores the hash of each symbol alongside its ID, so
+  string comparisons are almost only done for the matching symbol.
 */
 
+/// Number of bits in the size of the first symbol chunk
+#define SYMAP_CHUNK_BITS 6U
+
+/// Maximum number of symbol chunks, enough for every 32-bit ID
+#define SYMAP_N_CHUNKS (33U - SYMAP_CHUNK_BITS)
+
+/// Initial number of bins in the hash table
+#define SYMAP_MIN_BINS 64U
+
+/// An entry in the hash table
+typedef struct {
+  uint32_t hash; ///< Hash of the symbol string
+  uint32_t id;   ///< Symbol ID, or zero for empty
+} SymapEntry;
+
 struct SymapImpl {
-  char**    symbols; ///< String array where symbols[i] is the symbol for ID i
-  uint32_t* index;   ///< ID array sorted by corresponding string in `symbols`
-  uint32_t  size;    ///< Number of symbols (length of both symbols and index)
-  uint32_t  pad;     ///< Unused padding
+  char**      chunks[SYMAP_N_CHUNKS]; ///< Symbol arrays of doubling size
+  SymapEntry* table;                  ///< Hash table of IDs
+  uint32_t    n_bins;                 ///< Size of table (a power of two)
+  uint32_t    size;                   ///< Number of symbols (largest ID)
 };
 
-Symap*
-symap_new(void)
+/// Return the chunk that contains the symbol for `id`, and its offset there
+static uint32_t
+symap_chunk(const uint32_t id, uint32_t* const offset)
 {
-  Symap* const map = (Symap*)calloc(1, sizeof(Symap));
-
-  if (map) {
-    map->symbols = NULL;
-    map->index   = NULL;
-    map->size    = 0U;
+  // Shift IDs up so that chunk i contains [2^(i+bits), 2^(i+1+bits))
+  const uint64_t n = (uint64_t)id - 1U + (1U << SYMAP_CHUNK_BITS);
+
+  // Find the most significant bit
+  uint32_t msb = 0U;
+  for (uint32_t shift = 32U; shift; shift >>= 1U) {
+    if (n >> (msb + shift)) {
+      msb += shift;
+    }
   }
 
-  return map;
+  *offset = (uint32_t)(n - (1ULL << msb));
+  return msb - SYMAP_CHUNK_BITS;
+}
+
+static char*
+symap_symbol(const Symap* const map, const uint32_t id)
+{
+  uint32_t       offset = 0U;
+  const uint32_t chunk  = symap_chunk(id, &offset);
+
+  return map->chunks[chunk][offset];
+}
+
+Symap*
+symap_new(void)
+{
+  return (Symap*)calloc(1, sizeof(Symap));
 }
 
 void
 symap_free(Symap* const map)
 {
   if (map) {
-    for (uint32_t i = 0U; i < map->size; ++i) {
-      free(map->symbols[i]);
+    for (uint32_t i = 1U; i <= map->size; ++i) {
+      free(symap_symbol(map, i));
+    }
+
+    for (uint32_t i = 0U; i < SYMAP_N_CHUNKS; ++i) {
+      free(map->chunks[i]);
     }
 
-    free(map->symbols);
-    free(map->index);
+    free(map->table);
     free(map);
   }
 }
 
 static char*
-symap_strdup(const char* const str)
+symap_strdup(const char* const str, const size_t len)
 {
-  const size_t len  = strlen(str);
-  char* const  copy = (char*)malloc(len + 1);
-  memcpy(copy, str, len + 1);
+  char* const copy = (char*)malloc(len + 1);
+  if (copy) {
+    memcpy(copy, str, len + 1);
+  }
+
   return copy;
 }
 
 /**
-   Return the index into map->index (not the ID) corresponding to `sym`,
-   or the index where a new entry for `sym` should be inserted.
+   Return the bin in the hash table for `sym`.
+
+   This is either the bin that contains the ID of `sym`, or the empty bin where
+   a new entry for `sym` should be inserted.  The table must not be empty.
 */
 static uint32_t
-symap_search(const Symap* const map, const char* const sym, bool* const exact)
+symap_search(const Symap* const map,
+             const char* const  sym,
+             const uint32_t     hash)
 {
-  *exact = false;
+  const uint32_t mask = map->n_bins - 1U;
 
-  if (map->size == 0) {
-    return 0; // Empty map, insert at 0
-  }
-
-  if (strcmp(map->symbols[map->index[map->size - 1] - 1], sym) < 0) {
-    return map->size; // Greater than last element, append
+  uint32_t i = hash & mask;
+  for (; map->table[i].id; i = (i + 1U) & mask) {
+    const SymapEntry* const entry = &map->table[i];
+    if (entry->hash == hash && !strcmp(symap_symbol(map, entry->id), sym)) {
+      break;
+    }
   }
 
-  uint32_t lower = 0;
-  uint32_t upper = map->size - 1;
-  uint32_t i     = upper;
-
-  while (upper >= lower) {
-    i = lower + ((upper - lower) / 2);
+  return i;
+}
 
-    const int cmp = strcmp(map->symbols[map->index[i] - 1], sym);
-    if (cmp == 0) {
-      *exact = true;
-      return i;
-    }
+/// Resize the hash table to `n_bins` and reinsert every entry
+static bool
+symap_rehash(Symap* const map, const uint32_t n_bins)
+{
+  SymapEntry* const table = (SymapEntry*)calloc(n_bins, sizeof(SymapEntry));
+  if (!table) {
+    return false;
+  }
 
-    if (cmp > 0) {
-      if (i == 0) {
-        break; // Avoid underflow
+  const uint32_t mask = n_bins - 1U;
+  for (uint32_t i = 0U; i < map->n_bins; ++i) {
+    const SymapEntry entry = map->table[i];
+    if (entry.id) {
+      uint32_t j = entry.hash & mask;
+      while (table[j].id) {
+        j = (j + 1U) & mask;
       }
-      upper = i - 1;
-    } else {
-      lower = ++i;
+
+      table[j] = entry;
     }
   }
 
-  assert(!*exact || strcmp(map->symbols[map->index[i] - 1], sym) > 0);
-  return i;
+  free(map->table);
+  map->table  = table;
+  map->n_bins = n_bins;
+  return true;
 }
 
 uint32_t
 symap_try_map(const Symap* const map, const char* const sym)
 {
-  bool           exact = false;
-  const uint32_t index = symap_search(map, sym, &exact);
-  if (exact) {
-    return map->index[index];
+  if (!map->n_bins) {
+    return 0;
   }
 
-  return 0;
+  const uint32_t hash = zix_digest32(0U, sym, strlen(sym));
+
+  return map->table[symap_search(map, sym, hash)].id;
 }
 
 uint32_t
 symap_map(Symap* const map, const char* sym)
 {
+  // Grow the hash table to keep the load factor at most 3/4
+  if ((uint64_t)(map->size + 1U) * 4U > (uint64_t)map->n_bins * 3U &&
+      !symap_rehash(map, map->n_bins ? map->n_bins * 2U : SYMAP_MIN_BINS)) {
+    return 0;
+  }
+
   // Search for existing symbol
-  bool           exact = false;
-  const uint32_t index = symap_search(map, sym, &exact);
-  if (exact) {
-    assert(!strcmp(map->symbols[map->index[index] - 1], sym));
-    return map->index[index];
+  const size_t   len   = strlen(sym);
+  const uint32_t hash  = zix_digest32(0U, sym, len);
+  const uint32_t index = symap_search(map, sym, hash);
+  if (map->table[index].id) {
+    assert(!strcmp(symap_symbol(map, map->table[index].id), sym));
+    return map->table[index].id;
   }
 
   // Claim a new highest ID
-  const uint32_t id = map->size + 1;
-
-  // Grow symbol array
-  char** new_symbols = (char**)realloc(map->symbols, id * sizeof(sym));
-  if (!new_symbols) {
+  const uint32_t id = map->size + 1U;
+  if (!id) {
     return 0;
   }
 
-  map->symbols = new_symbols;
-
-  // Grow index array
-  uint32_t* new_index = (uint32_t*)realloc(map->index, id * sizeof(index));
-  if (!new_index) {
-    return 0;
+  // Allocate a new chunk if this is the first ID in it
+  uint32_t       offset = 0U;
+  const uint32_t chunk  = symap_chunk(id, &offset);
+  if (!map->chunks[chunk]) {
+    const size_t chunk_size = (size_t)1U << (chunk + SYMAP_CHUNK_BITS);
+    if (!(map->chunks[chunk] = (char**)calloc(chunk_size, sizeof(char*)))) {
+      return 0;
+    }
   }
 
-  map->index = new_index;
-
   // Append new symbol to symbols array
-  map->size            = id;
-  map->symbols[id - 1] = symap_strdup(sym);
-
-  // Insert new index element into sorted index
-  map->index = new_index;
-  if (index < map->size - 1) {
-    memmove(map->index + index + 1,
-            map->index + index,
-            (map->size - index - 1) * sizeof(uint32_t));
+  char* const copy = symap_strdup(sym, len);
+  if (!copy) {
+    return 0;
   }
 
-  map->index[index] = id;
+  map->chunks[chunk][offset] = copy;
+
+  // Insert into the hash table and publish the new size to unmap
+  map->table[index].hash = hash;
+  map->table[index].id   = id;
+  jalv_atomic_store(&map->size, id);
 
   return id;
 }
@@ -178,8 +234,8 @@ symap_unmap(const Symap* const map, const uint32_t id)
     return NULL;
   }
 
-  if (id <= map->size) {
-    return map->symbols[id - 1];
+  if (id <= jalv_atomic_load(&map->size)) {
+    return symap_symbol(map, id);
   }
 
   return NULL;
@@ -188,14 +244,14 @@ symap_unmap(const Symap* const map, const uint32_t id)
 #ifdef SYMAP_STANDALONE
 
 #  include <stdio.h>
+#  include <time.h>
 
 static void
 symap_dump(const Symap* const map)
 {
   fprintf(stderr, "{\n");
-  for (uint32_t i = 0; i < map->size; ++i) {
-    fprintf(
-      stderr, "\t%u = %s\n", map->index[i], map->symbols[map->index[i] - 1]);
+  for (uint32_t i = 1U; i <= map->size; ++i) {
+    fprintf(stderr, "\t%u = %s\n", i, symap_unmap(map, i));
   }
   fprintf(stderr, "}\n");
 }
@@ -218,7 +274,7 @@ symap_test(Symap* const map)
       return fprintf(stderr, "error: Failed to insert ID\n");
     }
 
-    if (!!strcmp(map->symbols[id - 1], syms[i])) {
+    if (!!strcmp(symap_unmap(map, id), syms[i])) {
       return fprintf(stderr, "error: Corrupt symbol table\n");
     }
 
@@ -234,6 +290,67 @@ symap_test(Symap* const map)
 #  undef N_SYMS
 }
 
+static double
+symap_elapsed(const clock_t start)
+{
+  return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+static int
+symap_bench(const uint32_t n_syms)
+{
+  Symap* const map     = symap_new();
+  char         sym[64] = {'\0'};
+
+  // Map many new URIs, like a host with many plugins might
+  clock_t start = clock();
+  for (uint32_t i = 0U; i < n_syms; ++i) {
+    snprintf(sym, sizeof(sym), "http://example.org/ns/%u#property", i);
+    if (symap_map(map, sym) != i + 1U) {
+      symap_free(map);
+      return fprintf(stderr, "error: Failed to map new symbol %u\n", i);
+    }
+  }
+
+  const double map_time = symap_elapsed(start);
+
+  // Look up every URI again, like plugins do during instantiation
+  start = clock();
+  for (uint32_t i = 0U; i < n_syms; ++i) {
+    snprintf(sym, sizeof(sym), "http://example.org/ns/%u#property", i);
+    if (symap_try_map(map, sym) != i + 1U) {
+      symap_free(map);
+      return fprintf(stderr, "error: Failed to find symbol %u\n", i);
+    }
+  }
+
+  const double try_map_time = symap_elapsed(start);
+
+  // Unmap every ID and check the result
+  start = clock();
+  for (uint32_t i = 0U; i < n_syms; ++i) {
+    snprintf(sym, sizeof(sym), "http://example.org/ns/%u#property", i);
+    const char* const uri = symap_unmap(map, i + 1U);
+    if (!uri || strcmp(uri, sym)) {
+      symap_free(map);
+      return fprintf(stderr, "error: Failed to unmap ID %u\n", i + 1U);
+    }
+  }
+
+  const double unmap_time = symap_elapsed(start);
+
+  fprintf(stderr,
+          "Mapped %u new symbols in %.3f s, looked up in %.3f s, "
+          "unmapped in %.3f s\n",
+          n_syms,
+          map_time,
+          try_map_time,
+          unmap_time);
+
+  symap_free(map);
+  return 0;
+}
+
 int
 main(void)
 {
@@ -241,7 +358,7 @@ main(void)
   const int    st  = symap_test(map);
 
   symap_free(map);
-  return st;
+  return st ? st : symap_bench(100000U);
 }
 
 #endif // SYMAP_STANDALONE
@@ -1,4 +1,4 @@
-// Copyright 2011-2022 David Robillard <d@drobilla.net>
+// Copyright 2011-2026 David Robillard <d@drobilla.net>
 // SPDX-License-Identifier: ISC
 
 /**
@@ -6,6 +6,9 @@
 
    Particularly useful for implementing LV2 URI mapping.
 
+   Mapping must be synchronized by the caller, but unmapping is lock-free and
+   may be done concurrently with mapping in another thread.
+
    @see <a href="http://lv2plug.in/ns/ext/urid">LV2 URID</a>
 */
 
@@ -34,8 +37,12 @@ symap_try_map(const Symap* map, const char* sym);
 uint32_t
 symap_map(Symap* map, const char* sym);
 
-/// Unmap a symbol back to a string if possible, otherwise return NULL
-ZIX_PURE_FUNC const char*
+/**
+   Unmap a symbol back to a string if possible, otherwise return NULL.
+
+   This may be called while another thread is calling symap_map().
+*/
+const char*
 symap_unmap(const Symap* map, uint32_t id);
 
 #endif // SYMAP_H
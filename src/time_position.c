@@ -0,0 +1,66 @@
+// Copyright 2026 David Robillard <d@drobilla.net>
+// SPDX-License-Identifier: ISC
+
+#include "time_position.h"
+
+#include "urids.h"
+
+#include <lv2/atom/atom.h>
+#include <lv2/atom/forge.h>
+#include <lv2/atom/util.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+
+void
+jalv_time_position_init(JalvTimePosition* const     position,
+                        const LV2_Atom_Forge* const base_forge,
+                        const JalvURIDs* const      urids)
+{
+  LV2_Atom_Forge       forge = *base_forge;
+  LV2_Atom_Forge_Frame frame;
+  lv2_atom_forge_set_buffer(
+    &forge, (uint8_t*)position->buf, sizeof(position->buf));
+
+  lv2_atom_forge_object(&forge, &frame, 0, urids->time_Position);
+  lv2_atom_forge_key(&forge, urids->time_frame);
+  lv2_atom_forge_long(&forge, 0);
+  lv2_atom_forge_key(&forge, urids->time_speed);
+  lv2_atom_forge_float(&forge, 0.0f);
+  position->frame_size = (uint32_t)(forge.offset - sizeof(LV2_Atom));
+  lv2_atom_forge_key(&forge, urids->time_barBeat);
+  lv2_atom_forge_float(&forge, 0.0f);
+  lv2_atom_forge_key(&forge, urids->time_bar);
+  lv2_atom_forge_long(&forge, 0);
+  lv2_atom_forge_key(&forge, urids->time_beatUnit);
+  lv2_atom_forge_int(&forge, 0);
+  lv2_atom_forge_key(&forge, urids->time_beatsPerBar);
+  lv2_atom_forge_float(&forge, 0.0f);
+  lv2_atom_forge_key(&forge, urids->time_beatsPerMinute);
+  lv2_atom_forge_float(&forge, 0.0f);
+  lv2_atom_forge_pop(&forge, &frame);
+
+  position->object   = (LV2_Atom_Object*)position->buf;
+  position->bbt_size = position->object->atom.size;
+  position->has_bbt  = false;
+
+  // Point to the value of every property
+  LV2_ATOM_OBJECT_FOREACH (position->object, prop) {
+    void* const value = LV2_ATOM_BODY(&prop->value);
+    if (prop->key == urids->time_frame) {
+      position->frame = (int64_t*)value;
+    } else if (prop->key == urids->time_speed) {
+      position->speed = (float*)value;
+    } else if (prop->key == urids->time_barBeat) {
+      position->bar_beat = (float*)value;
+    } else if (prop->key == urids->time_bar) {
+      position->bar = (int64_t*)value;
+    } else if (prop->key == urids->time_beatUnit) {
+      position->beat_unit = (int32_t*)value;
+    } else if (prop->key == urids->time_beatsPerBar) {
+      position->beats_per_bar = (float*)value;
+    } else if (prop->key == urids->time_beatsPerMinute) {
+      position->bpm = (float*)value;
+    }
+  }
+}
@@ -0,0 +1,57 @@
+// Copyright 2026 David Robillard <d@drobilla.net>
+// SPDX-License-Identifier: ISC
+
+#ifndef JALV_TIME_POSITION_H
+#define JALV_TIME_POSITION_H
+
+#include "attributes.h"
+#include "urids.h"
+
+#include <lv2/atom/atom.h>
+#include <lv2/atom/forge.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Position objects for reporting transport changes to plugins
+JALV_BEGIN_DECLS
+
+/**
+   A time:Position object that is sent to plugins when the transport changes.
+
+   The object is built once with every property, and its values are patched in
+   place to report a change, which is only a few stores.  The frame and speed
+   come first, so without BBT information, the size of the object is reduced so
+   that it only includes them.  The values are the last ones sent, so they can
+   also be used to detect changes in the tempo or meter.
+*/
+typedef struct {
+  uint64_t         buf[32];       ///< Storage for the object
+  LV2_Atom_Object* object;        ///< Object in buf
+  uint32_t         bbt_size;      ///< Size of the object body with BBT
+  uint32_t         frame_size;    ///< Size of the object body without BBT
+  bool             has_bbt;       ///< Whether BBT was last sent
+  int64_t*         frame;         ///< Value of time:frame
+  float*           speed;         ///< Value of time:speed
+  float*           bar_beat;      ///< Value of time:barBeat
+  int64_t*         bar;           ///< Value of time:bar
+  int32_t*         beat_unit;     ///< Value of time:beatUnit
+  float*           beats_per_bar; ///< Value of time:beatsPerBar
+  float*           bpm;           ///< Value of time:beatsPerMinute
+} JalvTimePosition;
+
+/**
+   Build a position object with every property, ready to be patched.
+
+   @param position Position to initialize.
+   @param forge Forge to copy for writing the object.
+   @param urids Application vocabulary.
+*/
+void
+jalv_time_position_init(JalvTimePosition*     position,
+                        const LV2_Atom_Forge* forge,
+                        const JalvURIDs*      urids);
+
+JALV_END_DECLS
+
+#endif // JALV_TIME_POSITION_H
@@ -0,0 +1,247 @@
+// Copyright 2026 David Robillard <d@drobilla.net>
+// SPDX-License-Identifier: ISC
+
+#include "timeline.h"
+
+#include "time_position.h"
+#include "urids.h"
+
+#include <lv2/atom/atom.h>
+#include <lv2/atom/forge.h>
+#include <zix/attributes.h>
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/// Highest supported tempo in beats per minute
+#define MAX_BPM 1000.0
+
+void
+jalv_timeline_init(JalvTimeline* const timeline)
+{
+  timeline->tempos   = NULL;
+  timeline->n_tempos = 0U;
+  timeline->current  = 0U;
+  timeline->frame    = 0U;
+  timeline->located  = false;
+}
+
+void
+jalv_timeline_cleanup(JalvTimeline* const timeline)
+{
+  free(timeline->tempos);
+  jalv_timeline_init(timeline);
+}
+
+/// Return the index of the last tempo at or before a frame, or n_tempos
+static uint32_t
+find_tempo(const JalvTimeline* const timeline, const uint64_t frame)
+{
+  uint32_t found = timeline->n_tempos;
+  for (uint32_t i = 0U; i < timeline->n_tempos; ++i) {
+    if (timeline->tempos[i].frame > frame) {
+      break;
+    }
+
+    found = i;
+  }
+
+  return found;
+}
+
+int
+jalv_timeline_add_tempo(JalvTimeline* const timeline,
+                        const uint64_t      frame,
+                        const float         bpm,
+                        const float         beats_per_bar,
+                        const int32_t       beat_unit)
+{
+  if (!(bpm > 0.0f) || bpm > MAX_BPM || !(beats_per_bar > 0.0f) ||
+      beat_unit < 1) {
+    return 1;
+  }
+
+  const JalvTempo tempo = {frame, 0.0, 0.0, bpm, beats_per_bar, beat_unit};
+
+  // Replace any change at the same frame
+  const uint32_t prev = find_tempo(timeline, frame);
+  if (prev < timeline->n_tempos && timeline->tempos[prev].frame == frame) {
+    timeline->tempos[prev] = tempo;
+    return 0;
+  }
+
+  JalvTempo* const tempos = (JalvTempo*)realloc(
+    timeline->tempos, (timeline->n_tempos + 1U) * sizeof(JalvTempo));
+  if (!tempos) {
+    return 1;
+  }
+
+  // Insert after the previous change to keep the map ordered by frame
+  const uint32_t index = prev < timeline->n_tempos ? prev + 1U : 0U;
+  memmove(tempos + index + 1U,
+          tempos + index,
+          (timeline->n_tempos - index) * sizeof(JalvTempo));
+
+  tempos[index]      = tempo;
+  timeline->tempos   = tempos;
+  timeline->n_tempos = timeline->n_tempos + 1U;
+  return 0;
+}
+
+int
+jalv_timeline_parse_tempo(JalvTimeline* const timeline,
+                          const char* const   string)
+{
+  const char* s     = string;
+  char*       end   = NULL;
+  uint64_t    frame = 0U;
+
+  // Parse optional frame
+  if (strchr(s, ':')) {
+    frame = strtoull(s, &end, 10);
+    if (end == s || *end != ':') {
+      return 1;
+    }
+    s = end + 1;
+  }
+
+  // Parse tempo
+  const double bpm = strtod(s, &end);
+  if (end == s) {
+    return 1;
+  }
+
+  // Use the meter of the previous change by default
+  const uint32_t prev          = find_tempo(timeline, frame);
+  double         beats_per_bar = 4.0;
+  long           beat_unit     = 4;
+  if (prev < timeline->n_tempos) {
+    beats_per_bar = timeline->tempos[prev].beats_per_bar;
+    beat_unit     = timeline->tempos[prev].beat_unit;
+  }
+
+  // Parse optional meter
+  if (*end == ',') {
+    s             = end + 1;
+    beats_per_bar = strtod(s, &end);
+    if (end == s || *end != '/') {
+      return 1;
+    }
+
+    s         = end + 1;
+    beat_unit = strtol(s, &end, 10);
+    if (end == s || beat_unit > 256) {
+      return 1;
+    }
+  }
+
+  if (*end) {
+    return 1;
+  }
+
+  return jalv_timeline_add_tempo(timeline,
+                                 frame,
+                                 (float)bpm,
+                                 (float)beats_per_bar,
+                                 (int32_t)beat_unit);
+}
+
+int
+jalv_timeline_prepare(JalvTimeline* const         timeline,
+                      const LV2_Atom_Forge* const forge,
+                      const JalvURIDs* const      urids,
+                      const double                sample_rate)
+{
+  // Start with the default tempo if the map doesn't
+  if ((!timeline->n_tempos || timeline->tempos[0].frame) &&
+      jalv_timeline_add_tempo(timeline, 0U, 120.0f, 4.0f, 4)) {
+    return 1;
+  }
+
+  // Precompute the length of beats and the bar at the start of every change
+  double bar = 0.0;
+  for (uint32_t i = 0U; i < timeline->n_tempos; ++i) {
+    JalvTempo* const tempo = &timeline->tempos[i];
+    if (i > 0U) {
+      const JalvTempo* const prev   = &timeline->tempos[i - 1U];
+      const uint64_t         length = tempo->frame - prev->frame;
+
+      bar += (double)length / prev->frames_per_beat / prev->beats_per_bar;
+    }
+
+    tempo->bar             = bar;
+    tempo->frames_per_beat = sample_rate * 60.0 / tempo->bpm;
+  }
+
+  jalv_time_position_init(&timeline->position, forge, urids);
+
+  timeline->current = 0U;
+  timeline->frame   = 0U;
+  timeline->located = false;
+  return 0;
+}
+
+ZIX_REALTIME const JalvTempo*
+jalv_timeline_tempo(JalvTimeline* const timeline, const uint64_t frame)
+{
+  const JalvTempo* const tempos = timeline->tempos;
+  const uint32_t         n      = timeline->n_tempos;
+
+  // Search from the start when moving backwards, otherwise step forwards
+  uint32_t i = tempos[timeline->current].frame <= frame ? timeline->current
+                                                         : 0U;
+  while (i + 1U < n && tempos[i + 1U].frame <= frame) {
+    ++i;
+  }
+
+  timeline->current = i;
+  return &tempos[i];
+}
+
+ZIX_REALTIME const LV2_Atom*
+jalv_timeline_position(JalvTimeline* const    timeline,
+                       const JalvTempo* const tempo,
+                       const uint64_t         frame)
+{
+  JalvTimePosition* const pos = &timeline->position;
+
+  // Calculate the bar and beat from the start of the tempo
+  const double beats = (double)(frame - tempo->frame) / tempo->frames_per_beat;
+  const double bars  = tempo->bar + (beats / tempo->beats_per_bar);
+  const double bar   = floor(bars);
+
+  *pos->frame         = (int64_t)frame;
+  *pos->speed         = 1.0f;
+  *pos->bar_beat      = (float)((bars - bar) * tempo->beats_per_bar);
+  *pos->bar           = (int64_t)bar;
+  *pos->beat_unit     = tempo->beat_unit;
+  *pos->beats_per_bar = tempo->beats_per_bar;
+  *pos->bpm           = tempo->bpm;
+
+  pos->has_bbt           = true;
+  pos->object->atom.size = pos->bbt_size;
+  return &pos->object->atom;
+}
+
+ZIX_REALTIME uint32_t
+jalv_timeline_block_length(JalvTimeline* const timeline,
+                           const uint32_t      nframes)
+{
+  const uint64_t frame = timeline->frame;
+  if (!timeline->n_tempos) {
+    return nframes;
+  }
+
+  jalv_timeline_tempo(timeline, frame);
+
+  const uint32_t next = timeline->current + 1U;
+  if (next < timeline->n_tempos &&
+      timeline->tempos[next].frame - frame < nframes) {
+    return (uint32_t)(timeline->tempos[next].frame - frame);
+  }
+
+  return nframes;
+}
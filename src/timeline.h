@@ -0,0 +1,130 @@
+// Copyright 2026 David Robillard <d@drobilla.net>
+// SPDX-License-Identifier: ISC
+
+#ifndef JALV_TIMELINE_H
+#define JALV_TIMELINE_H
+
+#include "attributes.h"
+#include "time_position.h"
+#include "urids.h"
+
+#include <lv2/atom/forge.h>
+#include <zix/attributes.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Internal transport with a tempo map for backends without a transport
+JALV_BEGIN_DECLS
+
+/// A tempo and meter that lasts from a frame until the next change
+typedef struct {
+  uint64_t frame;           ///< Frame where the tempo starts
+  double   bar;             ///< Bars before the start (from prepare)
+  double   frames_per_beat; ///< Length of a beat in frames (from prepare)
+  float    bpm;             ///< Tempo in beats per minute
+  float    beats_per_bar;   ///< Number of beats in a bar
+  int32_t  beat_unit;       ///< Note value of a beat, like 4 for quarter notes
+} JalvTempo;
+
+/**
+   An internal transport that rolls through a tempo map.
+
+   This provides musical time to plugins when the backend doesn't have a
+   transport of its own.  The tempo map is a list of tempo and meter changes
+   at specific frames, with the bar at the start of each precomputed, so the
+   position at any frame is a multiply-add from the current tempo.
+
+   The map is built in the main thread, then only read and advanced in the
+   process thread.
+*/
+typedef struct {
+  JalvTempo*       tempos;   ///< Tempo changes ordered by frame
+  uint32_t         n_tempos; ///< Number of tempo changes
+  uint32_t         current;  ///< Index of the tempo at the current frame
+  uint64_t         frame;    ///< Current position in frames
+  bool             located;  ///< Position reported since starting
+  JalvTimePosition position; ///< Position object sent to plugins
+} JalvTimeline;
+
+/// Initialize an empty timeline
+void
+jalv_timeline_init(JalvTimeline* timeline);
+
+/// Free the tempo map of a timeline
+void
+jalv_timeline_cleanup(JalvTimeline* timeline);
+
+/**
+   Add a tempo and meter change, replacing any change at the same frame.
+
+   @return Zero on success, or non-zero if the tempo is invalid or allocation
+   failed.
+*/
+int
+jalv_timeline_add_tempo(JalvTimeline* timeline,
+                        uint64_t      frame,
+                        float         bpm,
+                        float         beats_per_bar,
+                        int32_t       beat_unit);
+
+/**
+   Add a tempo change from a string.
+
+   The string has the form `[FRAME:]BPM[,BEATS/UNIT]`, like "140" or
+   "96000:90,3/4".  The change is at frame zero if no frame is given, and has
+   the meter of the previous change (or 4/4) if no meter is given.
+
+   @return Zero on success, or non-zero if the string is invalid.
+*/
+int
+jalv_timeline_parse_tempo(JalvTimeline* timeline, const char* string);
+
+/**
+   Prepare a timeline to roll from the start.
+
+   This adds a default tempo of 120 BPM in 4/4 at frame zero if necessary,
+   precomputes the position at the start of every tempo change, and builds the
+   position object that is sent to plugins.
+
+   @return Zero on success, or non-zero if allocation failed.
+*/
+int
+jalv_timeline_prepare(JalvTimeline*         timeline,
+                      const LV2_Atom_Forge* forge,
+                      const JalvURIDs*      urids,
+                      double                sample_rate);
+
+/**
+   Return the tempo at a frame.
+
+   This is constant time when moving forwards, since the current tempo is
+   cached.  The timeline must be prepared.
+*/
+ZIX_REALTIME const JalvTempo*
+jalv_timeline_tempo(JalvTimeline* timeline, uint64_t frame);
+
+/**
+   Update the position object to a frame, and return it.
+
+   @param timeline A prepared timeline.
+   @param tempo The tempo at the frame, from jalv_timeline_tempo().
+   @param frame The frame to report the position at.
+*/
+ZIX_REALTIME const LV2_Atom*
+jalv_timeline_position(JalvTimeline*    timeline,
+                       const JalvTempo* tempo,
+                       uint64_t         frame);
+
+/**
+   Return the number of frames in a cycle before the next tempo change.
+
+   Backends that write other input events for a cycle can end cycles there, so
+   that position events are only ever at the start.
+*/
+ZIX_REALTIME uint32_t
+jalv_timeline_block_length(JalvTimeline* timeline, uint32_t nframes);
+
+JALV_END_DECLS
+
+#endif // JALV_TIMELINE_H
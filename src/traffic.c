@@ -0,0 +1,510 @@
+// Copyright 2026 David Robillard <d@drobilla.net>
+// SPDX-License-Identifier: ISC
+
+#include "traffic.h"
+
+#include "comm.h"
+#include "jalv_config.h"
+
+#include <lv2/atom/atom.h>
+#include <lv2/atom/forge.h>
+#include <lv2/atom/util.h>
+#include <lv2/urid/urid.h>
+#include <zix/attributes.h>
+#include <zix/warnings.h>
+
+#if USE_MMAP
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <unistd.h>
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/// Magic bytes at the start of a traffic log
+#define TRAFFIC_MAGIC "jalvtraf"
+
+/// Version of the traffic log format
+#define TRAFFIC_VERSION 2U
+
+/// Direction of a replayed message that is skipped since it can't be remapped
+#define TRAFFIC_SKIPPED UINT32_MAX
+
+/// Header at the start of a traffic log file
+typedef struct {
+  char     magic[8];  ///< TRAFFIC_MAGIC without a terminator
+  uint64_t size;      ///< Size of records in bytes
+  uint32_t version;   ///< TRAFFIC_VERSION
+  uint32_t n_dropped; ///< Messages dropped because the log was full
+} TrafficHeader;
+
+struct JalvTrafficImpl {
+  TrafficHeader*  header;   ///< Mapped file header, followed by records
+  uint8_t*        records;  ///< Start of mapped records
+  LV2_URID_Unmap* unmap;    ///< URID unmap for recording URIs
+  size_t          size;     ///< Space for records in bytes
+  size_t          used;     ///< Bytes of records written
+  uint64_t        frame;    ///< Frame at the start of the current cycle
+  uint32_t        cycle;    ///< Index of the current cycle
+  uint32_t        n_cycles; ///< Number of cycles started
+  uint32_t        n_uris;   ///< Number of URIs recorded
+  int             fd;       ///< Log file descriptor
+};
+
+/// Map from URIDs in a traffic log to URIDs in this process
+typedef struct {
+  LV2_Atom_Forge forge;   ///< Forge for the URIDs of atom types
+  LV2_URID*      urids;   ///< Current URID for each logged URID, or zero
+  uint32_t       n_urids; ///< Number of entries in urids
+} Remapper;
+
+struct JalvReplayImpl {
+  uint64_t* buf;    ///< File contents
+  size_t    offset; ///< Offset of the next record in bytes from the start
+  size_t    end;    ///< Offset of the end of records in bytes from the start
+  uint64_t  last;   ///< Frame after the cycle start of the last message
+};
+
+/// Return the size of a record with a payload, including padding
+static size_t
+record_size(const uint32_t payload_size)
+{
+  return sizeof(JalvTrafficRecord) + ((payload_size + 7U) & ~(size_t)7U);
+}
+
+JalvTraffic*
+jalv_traffic_new(const char* const     path,
+                 const size_t          size,
+                 LV2_URID_Unmap* const unmap)
+{
+#if USE_MMAP
+  const size_t file_size = sizeof(TrafficHeader) + size;
+  const int    fd        = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    return NULL;
+  }
+
+  const int   prot = PROT_READ | PROT_WRITE;
+  void* const map  = ftruncate(fd, (off_t)file_size)
+                       ? MAP_FAILED
+                       : mmap(NULL, file_size, prot, MAP_SHARED, fd, 0);
+  if (map == MAP_FAILED) {
+    close(fd);
+    return NULL;
+  }
+
+  JalvTraffic* const traffic = (JalvTraffic*)calloc(1U, sizeof(JalvTraffic));
+  if (!traffic) {
+    munmap(map, file_size);
+    close(fd);
+    return NULL;
+  }
+
+  // Touch every page now so the process thread never waits for the disk
+  memset(map, 0, file_size);
+
+  TrafficHeader* const header = (TrafficHeader*)map;
+  memcpy(header->magic, TRAFFIC_MAGIC, sizeof(header->magic));
+  header->version = TRAFFIC_VERSION;
+
+  traffic->header  = header;
+  traffic->records = (uint8_t*)(header + 1U);
+  traffic->unmap   = unmap;
+  traffic->size    = size;
+  traffic->fd      = fd;
+  return traffic;
+#else
+  (void)path;
+  (void)size;
+  (void)unmap;
+  return NULL;
+#endif
+}
+
+void
+jalv_traffic_free(JalvTraffic* const traffic)
+{
+#if USE_MMAP
+  if (traffic) {
+    const size_t used = sizeof(TrafficHeader) + traffic->used;
+
+    munmap(traffic->header, sizeof(TrafficHeader) + traffic->size);
+    if (ftruncate(traffic->fd, (off_t)used)) {
+      fprintf(stderr, "warning: Failed to truncate traffic log\n");
+    }
+
+    close(traffic->fd);
+    free(traffic);
+  }
+#else
+  free(traffic);
+#endif
+}
+
+uint32_t
+jalv_traffic_n_dropped(const JalvTraffic* const traffic)
+{
+  return traffic->header->n_dropped;
+}
+
+ZIX_REALTIME void
+jalv_traffic_begin_cycle(JalvTraffic* const traffic, const uint64_t frame)
+{
+  if (traffic) {
+    traffic->frame = frame;
+    traffic->cycle = traffic->n_cycles++;
+  }
+}
+
+/// Write a record to the log, or count it as dropped if the log is full
+ZIX_REALTIME static int
+write_record(JalvTraffic* const         traffic,
+             const JalvTrafficDirection direction,
+             const uint32_t             type,
+             const void* const          head,
+             const uint32_t             head_size,
+             const void* const          body,
+             const uint32_t             body_size)
+{
+  const uint32_t payload_size = head_size + body_size;
+  const size_t   total        = record_size(payload_size);
+  if (total > traffic->size - traffic->used) {
+    ++traffic->header->n_dropped;
+    return 1;
+  }
+
+  const JalvTrafficRecord record = {
+    traffic->frame, traffic->cycle, (uint32_t)direction, type, payload_size};
+
+  // Write the record (the padding is already zero)
+  uint8_t* const out = traffic->records + traffic->used;
+  memcpy(out, &record, sizeof(record));
+  memcpy(out + sizeof(record), head, head_size);
+  if (body_size) {
+    memcpy(out + sizeof(record) + head_size, body, body_size);
+  }
+
+  // Update the size last, so the log is consistent if jalv crashes
+  traffic->used += total;
+  traffic->header->size = traffic->used;
+  return 0;
+}
+
+/// Record any URIs that have been mapped since the last record
+ZIX_REALTIME static void
+record_uris(JalvTraffic* const traffic)
+{
+  LV2_URID_Unmap* const unmap = traffic->unmap;
+  const char*           uri   = NULL;
+
+  ZIX_DISABLE_EFFECT_WARNINGS // Unmapping is lock-free
+  while (unmap && (uri = unmap->unmap(unmap->handle, traffic->n_uris + 1U))) {
+    const uint32_t id = traffic->n_uris + 1U;
+    if (write_record(traffic,
+                     JALV_TRAFFIC_URI,
+                     0U,
+                     &id,
+                     sizeof(id),
+                     uri,
+                     (uint32_t)strlen(uri) + 1U)) {
+      break;
+    }
+
+    traffic->n_uris = id;
+  }
+  ZIX_RESTORE_WARNINGS
+}
+
+ZIX_REALTIME void
+jalv_traffic_record(JalvTraffic* const         traffic,
+                    const JalvTrafficDirection direction,
+                    const uint32_t             type,
+                    const void* const          head,
+                    const uint32_t             head_size,
+                    const void* const          body,
+                    const uint32_t             body_size)
+{
+  if (traffic) {
+    record_uris(traffic);
+    write_record(traffic, direction, type, head, head_size, body, body_size);
+  }
+}
+
+/// Return true if a message from the UI can be replayed in another process
+static bool
+is_replayable(const JalvTrafficRecord* const record)
+{
+  return record->direction == JALV_TRAFFIC_UI_TO_PLUGIN &&
+         (record->type == EVENT_TRANSFER || record->type == STATE_REQUEST ||
+          record->type == TIMED_CHANGE);
+}
+
+/// Set the current URID of a URID in the log from a URI record
+static int
+remapper_add(Remapper* const               remapper,
+             LV2_URID_Map* const           map,
+             const JalvTrafficRecord* const record)
+{
+  const char* const uri = (const char*)(record + 1U) + sizeof(uint32_t);
+  uint32_t          id  = 0U;
+  if (record->size <= sizeof(id)) {
+    return 1;
+  }
+
+  memcpy(&id, record + 1U, sizeof(id));
+  if (!id || id == UINT32_MAX || uri[record->size - sizeof(id) - 1U]) {
+    return 1;
+  }
+
+  if (id >= remapper->n_urids) {
+    LV2_URID* const new_urids =
+      (LV2_URID*)realloc(remapper->urids, (id + 1U) * sizeof(LV2_URID));
+    if (!new_urids) {
+      return 1;
+    }
+
+    memset(new_urids + remapper->n_urids,
+           0,
+           (id + 1U - remapper->n_urids) * sizeof(LV2_URID));
+
+    remapper->urids   = new_urids;
+    remapper->n_urids = id + 1U;
+  }
+
+  remapper->urids[id] = map->map(map->handle, uri);
+  return 0;
+}
+
+/// Replace a URID from the log with the current one, or return false
+static bool
+remap_urid(const Remapper* const remapper, LV2_URID* const urid)
+{
+  if (!*urid) {
+    return true;
+  }
+
+  *urid = (*urid < remapper->n_urids) ? remapper->urids[*urid] : 0U;
+  return *urid;
+}
+
+static bool
+remap_atom(const Remapper* remapper, LV2_Atom* atom, const uint8_t* end);
+
+/// Remap the key, context, and value of a property
+static bool
+remap_property(const Remapper* const         remapper,
+               LV2_Atom_Property_Body* const prop,
+               const uint8_t* const          end)
+{
+  return (const uint8_t*)prop + sizeof(LV2_Atom_Property_Body) <= end &&
+         remap_urid(remapper, &prop->key) &&
+         remap_urid(remapper, &prop->context) &&
+         remap_atom(remapper, &prop->value, end);
+}
+
+/// Remap every URID in an atom that ends before `end`, or return false
+static bool
+remap_atom(const Remapper* const remapper,
+           LV2_Atom* const       atom,
+           const uint8_t* const  end)
+{
+  const LV2_Atom_Forge* const forge = &remapper->forge;
+  const uint8_t* const        body  = (const uint8_t*)(atom + 1U);
+  if (body > end || atom->size > (size_t)(end - body) ||
+      !remap_urid(remapper, &atom->type)) {
+    return false;
+  }
+
+  const uint8_t* const body_end = body + atom->size;
+  const LV2_URID       type     = atom->type;
+  if (type == forge->Object || type == forge->Blank ||
+      type == forge->Resource) {
+    LV2_Atom_Object* const obj = (LV2_Atom_Object*)atom;
+    if (atom->size < sizeof(LV2_Atom_Object_Body) ||
+        !remap_urid(remapper, &obj->body.id) ||
+        !remap_urid(remapper, &obj->body.otype)) {
+      return false;
+    }
+
+    LV2_ATOM_OBJECT_FOREACH (obj, prop) {
+      if (!remap_property(remapper, prop, body_end)) {
+        return false;
+      }
+    }
+  } else if (type == forge->Property) {
+    return remap_property(remapper, (LV2_Atom_Property_Body*)body, body_end);
+  } else if (type == forge->Tuple) {
+    LV2_ATOM_TUPLE_FOREACH ((LV2_Atom_Tuple*)atom, element) {
+      if (!remap_atom(remapper, element, body_end)) {
+        return false;
+      }
+    }
+  } else if (type == forge->Sequence) {
+    LV2_Atom_Sequence* const seq = (LV2_Atom_Sequence*)atom;
+    if (atom->size < sizeof(LV2_Atom_Sequence_Body) ||
+        !remap_urid(remapper, &seq->body.unit)) {
+      return false;
+    }
+
+    LV2_ATOM_SEQUENCE_FOREACH (seq, ev) {
+      if (!remap_atom(remapper, &ev->body, body_end)) {
+        return false;
+      }
+    }
+  } else if (type == forge->Vector) {
+    LV2_Atom_Vector* const vec = (LV2_Atom_Vector*)atom;
+    if (atom->size < sizeof(LV2_Atom_Vector_Body) ||
+        !remap_urid(remapper, &vec->body.child_type)) {
+      return false;
+    }
+
+    if (vec->body.child_type == forge->URID) {
+      LV2_URID* const ids = (LV2_URID*)(&vec->body + 1U);
+      const size_t    n   = (atom->size - sizeof(LV2_Atom_Vector_Body)) /
+                       sizeof(LV2_URID);
+      for (size_t i = 0U; i < n; ++i) {
+        if (!remap_urid(remapper, &ids[i])) {
+          return false;
+        }
+      }
+    }
+  } else if (type == forge->Literal) {
+    LV2_Atom_Literal* const lit = (LV2_Atom_Literal*)atom;
+    return atom->size >= sizeof(LV2_Atom_Literal_Body) &&
+           remap_urid(remapper, &lit->body.datatype) &&
+           remap_urid(remapper, &lit->body.lang);
+  } else if (type == forge->URID) {
+    return atom->size >= sizeof(LV2_URID) &&
+           remap_urid(remapper, &((LV2_Atom_URID*)atom)->body);
+  }
+
+  return true;
+}
+
+/// Remap the atom of an event transfer from the UI, or return false
+static bool
+remap_event(const Remapper* const remapper, JalvTrafficRecord* const record)
+{
+  JalvEventTransfer* const transfer = (JalvEventTransfer*)(record + 1U);
+  const uint8_t* const end = (const uint8_t*)transfer + record->size;
+
+  return record->size >= sizeof(JalvEventTransfer) &&
+         remap_atom(remapper, &transfer->atom, end);
+}
+
+JalvReplay*
+jalv_replay_new(const char* const path, LV2_URID_Map* const map)
+{
+  FILE* const file = fopen(path, "rb");
+  if (!file) {
+    return NULL;
+  }
+
+  // Read the header and check that the records are all there
+  TrafficHeader header = {{0}, 0U, 0U, 0U};
+  long          length = 0L;
+  if (fread(&header, sizeof(header), 1U, file) != 1U ||
+      memcmp(header.magic, TRAFFIC_MAGIC, sizeof(header.magic)) ||
+      header.version != TRAFFIC_VERSION || fseek(file, 0L, SEEK_END) ||
+      (length = ftell(file)) < 0L ||
+      header.size > (uint64_t)length - sizeof(header) ||
+      fseek(file, 0L, SEEK_SET)) {
+    fclose(file);
+    return NULL;
+  }
+
+  // Load the whole file, aligned so payloads can be used directly
+  const size_t      end    = sizeof(header) + (size_t)header.size;
+  JalvReplay* const replay = (JalvReplay*)calloc(1U, sizeof(JalvReplay));
+  uint64_t* const   buf    = (uint64_t*)malloc(end + sizeof(uint64_t));
+  if (!replay || !buf || fread(buf, 1U, end, file) != end) {
+    free(buf);
+    free(replay);
+    fclose(file);
+    return NULL;
+  }
+
+  fclose(file);
+  replay->buf    = buf;
+  replay->offset = sizeof(header);
+  replay->end    = end;
+
+  // Check every record, remap events, and find the end of messages to replay
+  Remapper remapper  = {{0}, NULL, 0U};
+  uint32_t n_skipped = 0U;
+  lv2_atom_forge_init(&remapper.forge, map);
+  for (size_t offset = replay->offset; offset < end;) {
+    JalvTrafficRecord* const record =
+      (JalvTrafficRecord*)((uint8_t*)buf + offset);
+
+    if (end - offset < sizeof(JalvTrafficRecord) ||
+        record_size(record->size) > end - offset ||
+        (record->direction == JALV_TRAFFIC_URI &&
+         remapper_add(&remapper, map, record))) {
+      free(remapper.urids);
+      jalv_replay_free(replay);
+      return NULL;
+    }
+
+    if (is_replayable(record) && record->type == EVENT_TRANSFER &&
+        !remap_event(&remapper, record)) {
+      record->direction = TRAFFIC_SKIPPED;
+      ++n_skipped;
+    }
+
+    if (is_replayable(record)) {
+      replay->last = record->frame + 1U;
+    }
+
+    offset += record_size(record->size);
+  }
+
+  if (n_skipped) {
+    fprintf(stderr,
+            "warning: Skipping %u events with unknown URIDs in traffic log\n",
+            n_skipped);
+  }
+
+  free(remapper.urids);
+  return replay;
+}
+
+void
+jalv_replay_free(JalvReplay* const replay)
+{
+  if (replay) {
+    free(replay->buf);
+    free(replay);
+  }
+}
+
+uint64_t
+jalv_replay_end(const JalvReplay* const replay)
+{
+  return replay->last;
+}
+
+ZIX_REALTIME const JalvTrafficRecord*
+jalv_replay_next(JalvReplay* const replay, const uint64_t end)
+{
+  while (replay->offset < replay->end) {
+    const JalvTrafficRecord* const record =
+      (const JalvTrafficRecord*)((const uint8_t*)replay->buf + replay->offset);
+
+    if (record->frame >= end) {
+      return NULL; // Not due yet
+    }
+
+    replay->offset += record_size(record->size);
+    if (is_replayable(record)) {
+      return record;
+    }
+  }
+
+  return NULL;
+}
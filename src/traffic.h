@@ -0,0 +1,151 @@
+// Copyright 2026 David Robillard <d@drobilla.net>
+// SPDX-License-Identifier: ISC
+
+#ifndef JALV_TRAFFIC_H
+#define JALV_TRAFFIC_H
+
+#include "attributes.h"
+
+#include <lv2/urid/urid.h>
+#include <zix/attributes.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Recording and replaying messages between the plugin and UI
+JALV_BEGIN_DECLS
+
+/// Direction of a message between the plugin and UI
+typedef enum {
+  JALV_TRAFFIC_UI_TO_PLUGIN, ///< Message applied by the process thread
+  JALV_TRAFFIC_PLUGIN_TO_UI, ///< Message sent by the process thread
+  JALV_TRAFFIC_URI,          ///< Not a message, a URI used by later ones
+} JalvTrafficDirection;
+
+/**
+   The header of a message in a traffic log.
+
+   A traffic log starts with the 8 bytes "jalvtraf", a 64-bit size of the
+   records that follow in bytes, a 32-bit version (2), and a 32-bit count of
+   messages that were dropped because the log was full.  Each record is this
+   header, followed by `size` bytes of payload, then zero padding to 64 bits.
+   The type and size are those of the JalvMessageHeader of the message.  All
+   numbers are in the native byte order.
+
+   Before the first message that could use a newly mapped URID, a record
+   with direction #JALV_TRAFFIC_URI and type zero is written, with a payload
+   of the 32-bit URID followed by the null-terminated URI.
+*/
+typedef struct {
+  uint64_t frame;     ///< Frame at the start of the cycle
+  uint32_t cycle;     ///< Index of the cycle since recording started
+  uint32_t direction; ///< JalvTrafficDirection
+  uint32_t type;      ///< JalvMessageType
+  uint32_t size;      ///< Size of payload following this header in bytes
+} JalvTrafficRecord;
+
+/**
+   A log that records messages between the plugin and UI.
+
+   The log is a memory-mapped file of a fixed size, so recording a message in
+   the process thread is only a copy.  Messages are recorded when they're
+   applied or sent by the process thread, so the frame they took effect at is
+   known.  Control changes from the UI, which aren't sent through a ring, are
+   recorded as TIMED_CHANGE messages.
+*/
+typedef struct JalvTrafficImpl JalvTraffic;
+
+/// A traffic log loaded into memory for replaying messages from the UI
+typedef struct JalvReplayImpl JalvReplay;
+
+/**
+   Create a traffic log file and map it into memory.
+
+   @param path Path of the log file to write.
+   @param size Space for records in bytes, which is allocated up front.
+   @param unmap URID unmap that is lock-free, for recording URIs.
+   @return A new traffic log, or null on error or if unsupported.
+*/
+JalvTraffic*
+jalv_traffic_new(const char* path, size_t size, LV2_URID_Unmap* unmap);
+
+/// Finish writing and free a traffic log, truncating the file to its records
+void
+jalv_traffic_free(JalvTraffic* traffic);
+
+/// Return the number of messages dropped because the log was full
+ZIX_PURE_FUNC uint32_t
+jalv_traffic_n_dropped(const JalvTraffic* traffic);
+
+/**
+   Start a new cycle.
+
+   This must be called in the process thread before any messages for the
+   cycle are recorded.  It does nothing if `traffic` is null.
+*/
+ZIX_REALTIME void
+jalv_traffic_begin_cycle(JalvTraffic* traffic, uint64_t frame);
+
+/**
+   Record a message in the current cycle.
+
+   The payload is given in two parts, which are recorded contiguously.  This
+   does nothing if `traffic` is null.
+
+   @param traffic Traffic log, or null.
+   @param direction Direction of the message.
+   @param type Type of the message (JalvMessageType).
+   @param head Start of the payload.
+   @param head_size Size of `head` in bytes.
+   @param body Rest of the payload, or null.
+   @param body_size Size of `body` in bytes.
+*/
+ZIX_REALTIME void
+jalv_traffic_record(JalvTraffic*         traffic,
+                    JalvTrafficDirection direction,
+                    uint32_t             type,
+                    const void*          head,
+                    uint32_t             head_size,
+                    const void*          body,
+                    uint32_t             body_size);
+
+/**
+   Load a traffic log to replay.
+
+   The URIDs in the atoms of event transfers are changed to the URIDs of the
+   same URIs in `map`, since they may differ from those of the process that
+   recorded the log.  Event transfers that use a URID that isn't defined in
+   the log are skipped.
+
+   @param path Path of the log file to read.
+   @param map URID map to remap atoms to.
+   @return A new replay, or null if the file couldn't be read or is invalid.
+*/
+JalvReplay*
+jalv_replay_new(const char* path, LV2_URID_Map* map);
+
+/// Free a replay loaded with jalv_replay_new()
+void
+jalv_replay_free(JalvReplay* replay);
+
+/// Return the frame after the start of the cycle of the last message to replay
+ZIX_PURE_FUNC uint64_t
+jalv_replay_end(const JalvReplay* replay);
+
+/**
+   Return the next message from the UI that's due before a frame.
+
+   Only event transfers, state requests, and timed changes are replayed, since
+   other messages only make sense in the process that recorded them.  The
+   payload immediately follows the returned record, and is 64-bit aligned.
+
+   @param replay Replay to read from.
+   @param end Frame after the end of the current cycle.
+   @return The next message to apply, or null if none are due.
+*/
+ZIX_REALTIME const JalvTrafficRecord*
+jalv_replay_next(JalvReplay* replay, uint64_t end);
+
+JALV_END_DECLS
+
+#endif // JALV_TRAFFIC_H
@@ -0,0 +1,97 @@
+// Copyright 2026 David Robillard <d@drobilla.net>
+// SPDX-License-Identifier: ISC
+
+#include "wakeup.h"
+
+#include "atomic.h"
+#include "jalv_config.h"
+
+#include <zix/attributes.h>
+#include <zix/status.h>
+
+#if USE_PIPE
+#  include <fcntl.h>
+#  include <unistd.h>
+#endif
+
+#include <stdint.h>
+
+ZixStatus
+jalv_wakeup_init(JalvWakeup* const wakeup)
+{
+  wakeup->read_fd  = -1;
+  wakeup->write_fd = -1;
+  wakeup->pending  = 0U;
+
+#if USE_PIPE
+  int fds[2] = {-1, -1};
+  if (pipe(fds)) {
+    return ZIX_STATUS_ERROR;
+  }
+
+  // Never block, the UI drains everything and a full pipe is already awake
+  if (fcntl(fds[0], F_SETFL, O_NONBLOCK) ||
+      fcntl(fds[1], F_SETFL, O_NONBLOCK)) {
+    close(fds[0]);
+    close(fds[1]);
+    return ZIX_STATUS_ERROR;
+  }
+
+  wakeup->read_fd  = fds[0];
+  wakeup->write_fd = fds[1];
+  return ZIX_STATUS_SUCCESS;
+#else
+  return ZIX_STATUS_NOT_SUPPORTED;
+#endif
+}
+
+void
+jalv_wakeup_destroy(JalvWakeup* const wakeup)
+{
+#if USE_PIPE
+  if (wakeup->read_fd >= 0) {
+    close(wakeup->read_fd);
+    close(wakeup->write_fd);
+  }
+#endif
+
+  wakeup->read_fd  = -1;
+  wakeup->write_fd = -1;
+}
+
+int
+jalv_wakeup_fd(const JalvWakeup* const wakeup)
+{
+  return wakeup->read_fd;
+}
+
+ZIX_REALTIME void
+jalv_wakeup_signal(JalvWakeup* const wakeup)
+{
+#if USE_PIPE
+  if (wakeup->write_fd >= 0 && !jalv_atomic_exchange(&wakeup->pending, 1U)) {
+    const char byte = 1;
+    const int  rc   = (int)write(wakeup->write_fd, &byte, 1U);
+    (void)rc; // Can only fail if the pipe is full, so the UI is awake anyway
+  }
+#else
+  (void)wakeup;
+#endif
+}
+
+void
+jalv_wakeup_clear(JalvWakeup* const wakeup)
+{
+#if USE_PIPE
+  if (wakeup->read_fd >= 0) {
+    // Drain the pipe first so a concurrent signal can't be lost
+    char buf[64];
+    while (read(wakeup->read_fd, buf, sizeof(buf)) > 0) {
+    }
+
+    jalv_atomic_store(&wakeup->pending, 0U);
+  }
+#else
+  (void)wakeup;
+#endif
+}
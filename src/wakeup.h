@@ -0,0 +1,64 @@
+// Copyright 2026 David Robillard <d@drobilla.net>
+// SPDX-License-Identifier: ISC
+
+#ifndef JALV_WAKEUP_H
+#define JALV_WAKEUP_H
+
+#include "attributes.h"
+
+#include <zix/attributes.h>
+#include <zix/status.h>
+
+#include <stdint.h>
+
+// Notification from the process thread that wakes up the UI
+JALV_BEGIN_DECLS
+
+/**
+   A notification that the UI has something to update.
+
+   This allows the UI to sleep until there's something to do, by waiting for
+   a file descriptor to become readable, instead of polling at a fixed rate.
+   It's signalled at most once until the UI clears it, so the process thread
+   only makes a system call when the UI is actually waiting.
+
+   On systems without pipes, the file descriptor is -1, and the UI must poll.
+*/
+typedef struct {
+  int      read_fd;  ///< Read end of pipe, or -1
+  int      write_fd; ///< Write end of pipe, or -1
+  uint32_t pending;  ///< Non-zero if signalled since last cleared
+} JalvWakeup;
+
+/// Initialize a wakeup, which is unsupported (but safe to use) on failure
+ZixStatus
+jalv_wakeup_init(JalvWakeup* wakeup);
+
+/// Destroy a wakeup initialized with jalv_wakeup_init()
+void
+jalv_wakeup_destroy(JalvWakeup* wakeup);
+
+/// Return the file descriptor that becomes readable when signalled, or -1
+ZIX_PURE_FUNC int
+jalv_wakeup_fd(const JalvWakeup* wakeup);
+
+/**
+   Wake up the UI if it isn't already woken up.
+
+   This is realtime-safe and async-signal-safe.
+*/
+ZIX_REALTIME void
+jalv_wakeup_signal(JalvWakeup* wakeup);
+
+/**
+   Clear a wakeup, so that it can be signalled again.
+
+   This must be called in the UI thread before reading what there is to
+   update, so that anything sent afterwards wakes it up again.
+*/
+void
+jalv_wakeup_clear(JalvWakeup* wakeup);
+
+JALV_END_DECLS
+
+#endif // JALV_WAKEUP_H
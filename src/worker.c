@@ -1,8 +1,12 @@
-// Copyright 2007-2022 David Robillard <d@drobilla.net>
+// Copyright 2007-2026 David Robillard <d@drobilla.net>
 // SPDX-License-Identifier: ISC
 
 #include "worker.h"
 
+#include "atomic.h"
+#include "clock.h"
+#include "jalv_config.h"
+
 #include <lv2/core/lv2.h>
 #include <lv2/worker/worker.h>
 #include <zix/attributes.h>
@@ -12,9 +16,19 @@
 #include <zix/thread.h>
 #include <zix/warnings.h>
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
+
+#if USE_MLOCK
+#  include <sys/mman.h>
+#endif
 
-#define MAX_PACKET_SIZE 4096U
+#define MAX_INLINE_SIZE 1024U    ///< Maximum size of a response in a ring
+#define N_SLABS 64U              ///< Maximum number of slabs for responses
+#define N_PREALLOCATED_SLABS 4U  ///< Number of slabs allocated up front
 
 typedef enum {
   STATE_SINGLE_THREADED, ///< Single-threaded worker (only state)
@@ -23,26 +37,169 @@ typedef enum {
   STATE_MUST_EXIT,       ///< Thread exit requested
 } WorkerState;
 
+/// Header of a request in the request ring, followed by `size` bytes of body
+typedef struct {
+  uint32_t size; ///< Size of request body in bytes
+  uint32_t pad;  ///< Unused padding
+  uint64_t time; ///< Time the request was scheduled in nanoseconds
+} RequestHeader;
+
+/// Header of a response in the response ring, followed by any inline body
+typedef struct {
+  uint32_t size; ///< Size of response body in bytes
+  uint32_t slab; ///< Index of slab that holds the body plus one, or zero
+} ResponseHeader;
+
+/// Memory for passing a large response to the audio thread without copying
+typedef struct {
+  void*    data;   ///< Slab memory
+  uint32_t size;   ///< Size of slab memory in bytes
+  uint32_t in_use; ///< Non-zero from responding until the response is emitted
+} Slab;
+
+/// A thread that performs work
+typedef struct {
+  JalvWorker* worker;  ///< Worker this thread belongs to
+  ZixThread   thread;  ///< Thread handle
+  ZixSem      flushed; ///< Posted when responses have been emitted
+  void*       request; ///< Request buffer
+  uint8_t*    packets; ///< Buffered response packets (pool only)
+  uint32_t    n_bytes; ///< Size of buffered response packets
+  uint32_t    seq;     ///< Sequence number of current request
+  bool        done;    ///< Work for current request is finished
+  uint64_t    time;    ///< Time current request was scheduled
+} WorkerThread;
+
 struct JalvWorkerImpl {
-  ZixRing*                    requests;  ///< Requests to the worker
-  ZixRing*                    responses; ///< Responses from the worker
-  void*                       response;  ///< Worker response buffer
-  ZixSem*                     lock;      ///< Lock for plugin work() method
-  ZixSem                      sem;       ///< Worker semaphore
-  WorkerState                 state;     ///< Worker state
-  ZixThread                   thread;    ///< Worker thread
-  LV2_Handle                  handle;    ///< Plugin handle
-  const LV2_Worker_Interface* iface;     ///< Plugin worker interface
+  ZixRing*                    requests;       ///< Requests to the worker
+  ZixRing*                    responses;      ///< Responses from the worker
+  void*                       response;       ///< Worker response buffer
+  ZixSem*                     lock;           ///< Lock for plugin work() method
+  ZixSem                      sem;            ///< Worker semaphore
+  ZixSem                      queue_lock;     ///< Lock for reading requests
+  ZixSem                      order_lock;     ///< Lock for ordering responses
+  WorkerState                 state;          ///< Worker state
+  WorkerThread*               threads;        ///< Worker threads
+  uint32_t                    n_threads;      ///< Number of worker threads
+  uint32_t                    n_scheduled;    ///< Requests scheduled
+  uint32_t                    next_seq;       ///< Sequence of next request
+  uint32_t                    next_flush;     ///< Sequence of next response
+  uint32_t                    ring_size;      ///< Size of rings in bytes
+  JalvWorkerStats             stats;          ///< Statistics
+  Slab                        slabs[N_SLABS]; ///< Slabs for large responses
+  LV2_Handle                  handle;         ///< Plugin handle
+  const LV2_Worker_Interface* iface;          ///< Plugin worker interface
 };
 
+/// Allocate (and lock if possible) memory for a slab
+static void*
+slab_alloc(const uint32_t size)
+{
+  void* const data = malloc(size);
+#if USE_MLOCK
+  if (data) {
+    mlock(data, size);
+  }
+#endif
+  return data;
+}
+
+/// Free the memory of a slab
+static void
+slab_free(Slab* const slab)
+{
+#if USE_MLOCK
+  if (slab->data) {
+    munlock(slab->data, slab->size);
+  }
+#endif
+  free(slab->data);
+  slab->data = NULL;
+  slab->size = 0U;
+}
+
+/// Claim a free slab with at least `size` bytes, or return null
+static Slab*
+slab_claim(JalvWorker* const worker, const uint32_t size)
+{
+  // Look for a free slab that is already large enough (slabs never shrink)
+  for (uint32_t i = 0U; i < N_SLABS; ++i) {
+    Slab* const slab = &worker->slabs[i];
+    if (!jalv_atomic_exchange(&slab->in_use, 1U)) {
+      if (slab->size >= size) {
+        return slab;
+      }
+
+      jalv_atomic_store(&slab->in_use, 0U);
+    }
+  }
+
+  // Allocate or grow a free slab, which is fine here since this isn't realtime
+  for (uint32_t i = 0U; i < N_SLABS; ++i) {
+    Slab* const slab = &worker->slabs[i];
+    if (!jalv_atomic_exchange(&slab->in_use, 1U)) {
+      if (slab->size >= size) {
+        return slab; // Grown by another thread since the first search
+      }
+
+      void* const data = slab_alloc(size);
+      if (data) {
+        slab_free(slab);
+        slab->data = data;
+        slab->size = size;
+        return slab;
+      }
+
+      jalv_atomic_store(&slab->in_use, 0U);
+      break;
+    }
+  }
+
+  return NULL;
+}
+
+/// Prepare a response header, and copy a large body into a slab if necessary
+static LV2_Worker_Status
+prepare_response(JalvWorker* const     worker,
+                 ResponseHeader* const header,
+                 const uint32_t        size,
+                 const void* const     data)
+{
+  header->size = size;
+  header->slab = 0U;
+  if (size > MAX_INLINE_SIZE) {
+    Slab* const slab = slab_claim(worker, size);
+    if (!slab) {
+      return LV2_WORKER_ERR_NO_SPACE;
+    }
+
+    memcpy(slab->data, data, size);
+    header->slab = (uint32_t)(slab - worker->slabs) + 1U;
+  }
+
+  return LV2_WORKER_SUCCESS;
+}
+
+/// Release the slab of a response that couldn't be delivered, if any
+static void
+release_response(JalvWorker* const worker, const ResponseHeader* const header)
+{
+  if (header->slab) {
+    jalv_atomic_store(&worker->slabs[header->slab - 1U].in_use, 0U);
+  }
+}
+
+/// Write a response packet to a ring
 static LV2_Worker_Status
-jalv_worker_write_packet(ZixRing* const    target,
-                         const uint32_t    size,
-                         const void* const data)
+jalv_worker_write_packet(JalvWorker* const           worker,
+                         const ResponseHeader* const header,
+                         const void* const           body)
 {
-  ZixRingTransaction tx = zix_ring_begin_write(target);
-  if (zix_ring_amend_write(target, &tx, &size, sizeof(size)) ||
-      zix_ring_amend_write(target, &tx, data, size)) {
+  ZixRing* const     target = worker->responses;
+  ZixRingTransaction tx     = zix_ring_begin_write(target);
+  if (zix_ring_amend_write(target, &tx, header, sizeof(ResponseHeader)) ||
+      (body && zix_ring_amend_write(target, &tx, body, header->size))) {
+    release_response(worker, header);
     return LV2_WORKER_ERR_NO_SPACE;
   }
 
@@ -55,14 +212,142 @@ jalv_worker_respond(LV2_Worker_Respond_Handle handle,
                     const uint32_t            size,
                     const void*               data)
 {
-  return jalv_worker_write_packet(((JalvWorker*)handle)->responses, size, data);
+  JalvWorker* const worker = (JalvWorker*)handle;
+  ResponseHeader    header = {0U, 0U};
+  LV2_Worker_Status st     = prepare_response(worker, &header, size, data);
+  if (!st) {
+    st = jalv_worker_write_packet(worker, &header, header.slab ? NULL : data);
+  }
+
+  return st;
+}
+
+/// Buffer a response in a pool thread until earlier requests are finished
+static LV2_Worker_Status
+jalv_worker_pool_respond(LV2_Worker_Respond_Handle handle,
+                         const uint32_t            size,
+                         const void*               data)
+{
+  WorkerThread* const thread      = (WorkerThread*)handle;
+  JalvWorker* const   worker      = thread->worker;
+  const uint32_t      inline_size = size <= MAX_INLINE_SIZE ? size : 0U;
+  const uint32_t total = (uint32_t)sizeof(ResponseHeader) + inline_size;
+  if (thread->n_bytes + total > worker->ring_size) {
+    return LV2_WORKER_ERR_NO_SPACE;
+  }
+
+  ResponseHeader    header = {0U, 0U};
+  LV2_Worker_Status st     = prepare_response(worker, &header, size, data);
+  if (!st) {
+    uint8_t* const out = thread->packets + thread->n_bytes;
+    memcpy(out, &header, sizeof(header));
+    memcpy(out + sizeof(header), data, inline_size);
+    thread->n_bytes += total;
+  }
+
+  return st;
+}
+
+/// Record the statistics of a finished request, with the order lock held
+static void
+record_request(JalvWorker* const worker, const uint64_t time)
+{
+  const uint64_t now     = jalv_clock_now();
+  const uint64_t latency = now > time ? now - time : 0U;
+
+  worker->stats.total_ns += latency;
+  if (latency > worker->stats.max_ns) {
+    worker->stats.max_ns = latency;
+  }
+
+  ++worker->stats.n_requests;
+}
+
+/// Write the responses buffered by a pool thread to the response ring
+static void
+write_packets(JalvWorker* const worker, WorkerThread* const thread)
+{
+  for (uint32_t offset = 0U; offset < thread->n_bytes;) {
+    ResponseHeader header = {0U, 0U};
+    memcpy(&header, thread->packets + offset, sizeof(header));
+    offset += (uint32_t)sizeof(header);
+
+    const void* const body = header.slab ? NULL : thread->packets + offset;
+    if (jalv_worker_write_packet(worker, &header, body)) {
+      ++worker->stats.n_dropped;
+    }
+
+    offset += header.slab ? 0U : header.size;
+  }
+
+  thread->n_bytes = 0U;
+}
+
+/// Emit buffered responses in request order, with the order lock held
+static void
+flush_responses(JalvWorker* const worker)
+{
+  for (bool progress = true; progress;) {
+    progress = false;
+    for (uint32_t i = 0U; i < worker->n_threads; ++i) {
+      WorkerThread* const thread = &worker->threads[i];
+      if (thread->done && thread->seq == worker->next_flush) {
+        write_packets(worker, thread);
+        record_request(worker, thread->time);
+        thread->done = false;
+        ++worker->next_flush;
+        zix_sem_post(&thread->flushed);
+        progress = true;
+      }
+    }
+  }
+}
+
+/// Read the next request into a thread's buffer and return its size
+static uint32_t
+read_request(WorkerThread* const thread, bool* const ok)
+{
+  JalvWorker* const worker = thread->worker;
+  RequestHeader     header = {0U, 0U, 0U};
+
+  zix_sem_wait(&worker->queue_lock);
+
+  // Read the header of the request
+  zix_ring_read(worker->requests, &header, sizeof(header));
+
+  // Reallocate buffer to accommodate request if necessary
+  void* const new_buf = realloc(thread->request, header.size);
+  if ((*ok = !!new_buf)) {
+    thread->request = new_buf;
+    zix_ring_read(worker->requests, thread->request, header.size);
+  } else {
+    // Reallocation failed, skip request to avoid corrupting ring
+    zix_ring_skip(worker->requests, header.size);
+  }
+
+  // Claim a sequence number and note how many requests are still queued
+  const uint32_t n_scheduled = jalv_atomic_load(&worker->n_scheduled);
+  const uint32_t depth       = n_scheduled - worker->next_seq;
+  thread->seq                = worker->next_seq++;
+  thread->time               = header.time;
+
+  zix_sem_post(&worker->queue_lock);
+
+  zix_sem_wait(&worker->order_lock);
+  if (depth > worker->stats.max_depth) {
+    worker->stats.max_depth = depth;
+  }
+  zix_sem_post(&worker->order_lock);
+
+  return header.size;
 }
 
 static ZixThreadResult ZIX_THREAD_FUNC
 worker_func(void* const data)
 {
-  JalvWorker* const worker = (JalvWorker*)data;
-  void*             buf    = NULL;
+  WorkerThread* const thread = (WorkerThread*)data;
+  JalvWorker* const   worker = thread->worker;
+  const bool          pool   = worker->n_threads > 1U;
 
   while (true) {
     // Wait for a request
@@ -71,54 +356,93 @@ worker_func(void* const data)
       break;
     }
 
-    // Read the size header of the request
-    uint32_t size = 0;
-    zix_ring_read(worker->requests, &size, sizeof(size));
-
-    // Reallocate buffer to accommodate request if necessary
-    void* const new_buf = realloc(buf, size);
-    if (new_buf) {
-      // Read request into buffer
-      buf = new_buf;
-      zix_ring_read(worker->requests, buf, size);
-
+    bool           ok   = false;
+    const uint32_t size = read_request(thread, &ok);
+
+    if (ok && pool) {
+      // Dispatch request to plugin's thread-safe work handler concurrently
+      worker->iface->work(worker->handle,
+                          jalv_worker_pool_respond,
+                          thread,
+                          size,
+                          thread->request);
+    } else if (ok) {
       // Lock and dispatch request to plugin's work handler
       zix_sem_wait(worker->lock);
       worker->iface->work(
-        worker->handle, jalv_worker_respond, worker, size, buf);
+        worker->handle, jalv_worker_respond, worker, size, thread->request);
       zix_sem_post(worker->lock);
-
-    } else {
-      // Reallocation failed, skip request to avoid corrupting ring
-      zix_ring_skip(worker->requests, size);
     }
+
+    // Emit responses for this and any later finished requests in order
+    zix_sem_wait(&worker->order_lock);
+    thread->done = true;
+    flush_responses(worker);
+    zix_sem_post(&worker->order_lock);
+
+    // Wait until this request's responses have been emitted
+    zix_sem_wait(&thread->flushed);
   }
 
-  free(buf);
-  worker->state = STATE_STOPPED;
   return ZIX_THREAD_RESULT;
 }
 
 JalvWorker*
-jalv_worker_new(ZixSem* const lock, const bool threaded)
+jalv_worker_new(ZixSem* const  lock,
+                const uint32_t n_threads,
+                const uint32_t ring_size)
 {
-  JalvWorker* const worker    = (JalvWorker*)calloc(1, sizeof(JalvWorker));
-  ZixRing* const    requests  = zix_ring_new(NULL, MAX_PACKET_SIZE);
-  ZixRing* const    responses = zix_ring_new(NULL, MAX_PACKET_SIZE);
-  void* const       response  = calloc(1, MAX_PACKET_SIZE);
-
-  if (worker && requests && responses && response) {
+  JalvWorker* const   worker    = (JalvWorker*)calloc(1, sizeof(JalvWorker));
+  ZixRing* const      requests  = zix_ring_new(NULL, ring_size);
+  ZixRing* const      responses = zix_ring_new(NULL, ring_size);
+  void* const         response  = calloc(1, MAX_INLINE_SIZE);
+  WorkerThread* const threads =
+    (WorkerThread*)calloc(n_threads + 1U, sizeof(WorkerThread));
+
+  if (worker && requests && responses && response && threads) {
     worker->requests  = requests;
     worker->responses = responses;
     worker->response  = response;
     worker->lock      = lock;
-    worker->state     = threaded ? STATE_STOPPED : STATE_SINGLE_THREADED;
+    worker->state     = n_threads ? STATE_STOPPED : STATE_SINGLE_THREADED;
+    worker->threads   = threads;
+    worker->n_threads = n_threads;
+    worker->ring_size = ring_size;
 
+    zix_sem_init(&worker->queue_lock, 1);
+    zix_sem_init(&worker->order_lock, 1);
     zix_ring_mlock(requests);
     zix_ring_mlock(responses);
-    return worker;
+
+    // Allocate a buffer for holding back responses in each pool thread
+    bool ok = true;
+    for (uint32_t i = 0U; i < n_threads; ++i) {
+      threads[i].worker = worker;
+      if (n_threads > 1U) {
+        threads[i].packets = (uint8_t*)malloc(ring_size);
+        ok                 = ok && threads[i].packets;
+      }
+    }
+
+    // Preallocate some slabs for large responses, the rest are made as needed
+    for (uint32_t i = 0U; ok && i < N_PREALLOCATED_SLABS; ++i) {
+      Slab* const slab = &worker->slabs[i];
+      if ((slab->data = slab_alloc(ring_size))) {
+        slab->size = ring_size;
+      }
+
+      ok = !!slab->data;
+    }
+
+    if (ok) {
+      return worker;
+    }
+
+    jalv_worker_free(worker);
+    return NULL;
   }
 
+  free(threads);
   free(response);
   zix_ring_free(responses);
   zix_ring_free(requests);
@@ -131,29 +455,81 @@ jalv_worker_free(JalvWorker* const worker)
 {
   if (worker) {
     jalv_worker_exit(worker);
+    for (uint32_t i = 0U; i < worker->n_threads; ++i) {
+      free(worker->threads[i].request);
+      free(worker->threads[i].packets);
+    }
+
+    for (uint32_t i = 0U; i < N_SLABS; ++i) {
+      slab_free(&worker->slabs[i]);
+    }
+
+    zix_sem_destroy(&worker->order_lock);
+    zix_sem_destroy(&worker->queue_lock);
     zix_ring_free(worker->requests);
     zix_ring_free(worker->responses);
+    free(worker->threads);
     free(worker->response);
     free(worker);
   }
 }
 
+/// Stop the first `n_threads` threads of a launched worker
+static void
+stop_threads(JalvWorker* const worker, const uint32_t n_threads)
+{
+  worker->state = STATE_MUST_EXIT;
+  for (uint32_t i = 0U; i < n_threads; ++i) {
+    zix_sem_post(&worker->sem);
+  }
+
+  for (uint32_t i = 0U; i < n_threads; ++i) {
+    zix_thread_join(worker->threads[i].thread);
+    zix_sem_destroy(&worker->threads[i].flushed);
+  }
+
+  zix_sem_destroy(&worker->sem);
+  worker->state = STATE_STOPPED;
+}
+
 ZixStatus
 jalv_worker_launch(JalvWorker* const worker)
 {
   ZixStatus st = ZIX_STATUS_SUCCESS;
-  if (worker->state == STATE_STOPPED) {
-    if ((st = zix_sem_init(&worker->sem, 0))) {
-      return st;
+  if (worker->state != STATE_STOPPED) {
+    return st;
+  }
+
+  if ((st = zix_sem_init(&worker->sem, 0))) {
+    return st;
+  }
+
+  worker->n_scheduled = 0U;
+  worker->next_seq    = 0U;
+  worker->next_flush  = 0U;
+  zix_ring_reset(worker->requests);
+
+  worker->state = STATE_LAUNCHED;
+
+  uint32_t n_launched = 0U;
+  for (; n_launched < worker->n_threads; ++n_launched) {
+    WorkerThread* const thread = &worker->threads[n_launched];
+    thread->done               = false;
+    thread->n_bytes            = 0U;
+    if ((st = zix_sem_init(&thread->flushed, 0))) {
+      break;
     }
 
-    if ((st = zix_thread_create(&worker->thread, 4096U, worker_func, worker))) {
-      zix_sem_destroy(&worker->sem);
-      return st;
+    if ((st = zix_thread_create(&thread->thread, 4096U, worker_func, thread))) {
+      zix_sem_destroy(&thread->flushed);
+      break;
     }
+  }
 
-    worker->state = STATE_LAUNCHED;
+  if (st) {
+    stop_threads(worker, n_launched); // Stop threads launched before failure
   }
+
   return st;
 }
 
@@ -161,9 +537,7 @@ void
 jalv_worker_exit(JalvWorker* const worker)
 {
   if (worker && worker->state == STATE_LAUNCHED) {
-    worker->state = STATE_MUST_EXIT;
-    zix_sem_post(&worker->sem);
-    zix_thread_join(worker->thread);
+    stop_threads(worker, worker->n_threads);
   }
 }
 
@@ -178,6 +552,19 @@ jalv_worker_attach(JalvWorker* const                 worker,
   }
 }
 
+void
+jalv_worker_stats(JalvWorker* const worker, JalvWorkerStats* const stats)
+{
+  if (worker->state == STATE_SINGLE_THREADED) {
+    memset(stats, 0, sizeof(JalvWorkerStats));
+    return;
+  }
+
+  zix_sem_wait(&worker->order_lock);
+  *stats = worker->stats;
+  zix_sem_post(&worker->order_lock);
+}
+
 ZIX_REALTIME LV2_Worker_Status
 jalv_worker_schedule(LV2_Worker_Schedule_Handle handle,
                      const uint32_t             size,
@@ -190,8 +577,15 @@ jalv_worker_schedule(LV2_Worker_Schedule_Handle handle,
     st = LV2_WORKER_ERR_UNKNOWN;
 
   } else if (worker->state == STATE_LAUNCHED) {
-    // Schedule a request to be executed by the worker thread
-    if (!(st = jalv_worker_write_packet(worker->requests, size, data))) {
+    // Schedule a request to be executed by a worker thread
+    const RequestHeader header = {size, 0U, jalv_clock_now()};
+    ZixRingTransaction  tx     = zix_ring_begin_write(worker->requests);
+    if (zix_ring_amend_write(worker->requests, &tx, &header, sizeof(header)) ||
+        zix_ring_amend_write(worker->requests, &tx, data, size)) {
+      st = LV2_WORKER_ERR_NO_SPACE;
+    } else {
+      zix_ring_commit_write(worker->requests, &tx);
+      jalv_atomic_store(&worker->n_scheduled, worker->n_scheduled + 1U);
       zix_sem_post(&worker->sem);
     }
 
@@ -213,20 +607,34 @@ jalv_worker_schedule(LV2_Worker_Schedule_Handle handle,
 ZIX_REALTIME void
 jalv_worker_emit_responses(JalvWorker* const worker, LV2_Handle lv2_handle)
 {
-  const uint32_t size_size = (uint32_t)sizeof(uint32_t);
+  const uint32_t header_size = (uint32_t)sizeof(ResponseHeader);
 
   if (worker && worker->responses) {
-    uint32_t size = 0U;
-    while (zix_ring_read(worker->responses, &size, size_size) == size_size) {
-      if (zix_ring_read(worker->responses, worker->response, size) == size) {
-        ZIX_DISABLE_EFFECT_WARNINGS // Assume realtime-safe plugin
-        worker->iface->work_response(lv2_handle, size, worker->response);
-        ZIX_RESTORE_WARNINGS
+    ResponseHeader header = {0U, 0U};
+    while (zix_ring_read(worker->responses, &header, header_size) ==
+           header_size) {
+      ZIX_DISABLE_EFFECT_WARNINGS // Assume realtime-safe plugin
+      if (header.slab) {
+        // Pass the slab directly to the plugin, then return it to the pool
+        Slab* const slab = &worker->slabs[header.slab - 1U];
+        worker->iface->work_response(lv2_handle, header.size, slab->data);
+        jalv_atomic_store(&slab->in_use, 0U);
+      } else if (zix_ring_read(worker->responses,
+                               worker->response,
+                               header.size) == header.size) {
+        worker->iface->work_response(lv2_handle, header.size, worker->response);
       }
+      ZIX_RESTORE_WARNINGS
     }
   }
 }
 
+ZIX_REALTIME bool
+jalv_worker_has_responses(const JalvWorker* const worker)
+{
+  return worker && worker->responses && zix_ring_read_space(worker->responses);
+}
+
 ZIX_REALTIME void
 jalv_worker_end_run(JalvWorker* const worker)
 {
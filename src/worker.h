@@ -1,4 +1,4 @@
-// Copyright 2007-2025 David Robillard <d@drobilla.net>
+// Copyright 2007-2026 David Robillard <d@drobilla.net>
 // SPDX-License-Identifier: ISC
 
 #ifndef JALV_WORKER_H
@@ -24,18 +24,43 @@ JALV_BEGIN_DECLS
    The worker can be used in threaded mode, which allows non-realtime work to be
    done with latency when running realtime, or non-threaded mode, which performs
    work immediately for state restoration or offline rendering.
+
+   In threaded mode, the worker can use a pool of several threads, which call
+   the plugin's work() method concurrently without holding the lock.  This is
+   only safe for plugins that support it, but allows independent requests like
+   disk reads to be done in parallel.  Responses are always delivered to the
+   plugin in the order that the requests were scheduled.
+
+   Requests and small responses are copied through rings.  Larger responses
+   are copied into a slab from a pool of locked memory, and only a reference
+   to the slab is passed through the ring, so the audio thread can pass the
+   response to the plugin without copying it.  Slabs grow as necessary in the
+   worker thread, so the size of responses isn't limited by the ring size.
 */
 typedef struct JalvWorkerImpl JalvWorker;
 
+/// Statistics about the work done by a threaded worker
+typedef struct {
+  uint32_t n_requests; ///< Number of requests finished
+  uint32_t n_dropped;  ///< Number of requests whose responses were dropped
+  uint32_t max_depth;  ///< Maximum number of requests waiting in the queue
+  uint64_t total_ns;   ///< Total time from scheduling to responding
+  uint64_t max_ns;     ///< Maximum time from scheduling to responding
+} JalvWorkerStats;
+
 /**
-   Allocate a new worker and launch its thread if necessary.
+   Allocate a new worker.
 
    @param lock Pointer to lock used to guard doing work.
-   @param threaded If true, launch a thread to perform work in.
+   @param n_threads Number of threads to perform work in, or zero to perform
+   work immediately when it is scheduled.  If this is greater than one, then
+   the plugin's work() method is called concurrently without `lock`.
+   @param ring_size Size of the request and response rings in bytes, which
+   limits the size of requests and the amount of pending work.
    @return A newly allocated worker, or null on error.
 */
 JalvWorker*
-jalv_worker_new(ZixSem* lock, bool threaded);
+jalv_worker_new(ZixSem* lock, uint32_t n_threads, uint32_t ring_size);
 
 /**
    Free a worker allocated with jalv_worker_new().
@@ -46,9 +71,10 @@ void
 jalv_worker_free(JalvWorker* worker);
 
 /**
-   Launch the worker's thread.
+   Launch the worker's threads.
 
-   For threaded workers, this launches the thread if it isn't already running.
+   For threaded workers, this launches the threads if they aren't already
+   running.
    For non-threaded workers, this does nothing.
 
    @return Zero on success, or a non-zero error code if launching failed.
@@ -57,7 +83,7 @@ ZixStatus
 jalv_worker_launch(JalvWorker* worker);
 
 /**
-   Terminate the worker's thread if necessary.
+   Terminate the worker's threads if necessary.
 
    For threaded workers, this blocks until the thread has exited.  For
    non-threaded workers, this does nothing.
@@ -79,6 +105,15 @@ jalv_worker_attach(JalvWorker*                 worker,
                    const LV2_Worker_Interface* iface,
                    LV2_Handle                  handle);
 
+/**
+   Get statistics about the work done by a threaded worker.
+
+   The statistics are accumulated since the worker was allocated.  For
+   non-threaded workers, the statistics are all zero.
+*/
+void
+jalv_worker_stats(JalvWorker* worker, JalvWorkerStats* stats);
+
 /**
    Schedule work to be performed by the worker in the audio thread.
 
@@ -100,6 +135,15 @@ jalv_worker_schedule(LV2_Worker_Schedule_Handle handle,
 ZIX_REALTIME void
 jalv_worker_emit_responses(JalvWorker* worker, LV2_Handle lv2_handle);
 
+/**
+   Return true if there are responses waiting to be emitted to the plugin.
+
+   This is used in the audio thread to run the plugin for a cycle that would
+   otherwise be skipped, so that responses are still delivered.
+*/
+ZIX_REALTIME bool
+jalv_worker_has_responses(const JalvWorker* worker);
+
 /**
    Notify the plugin that the run() cycle is finished.
 